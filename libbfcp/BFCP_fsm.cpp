@@ -1,5 +1,6 @@
 
 #include "BFCP_fsm.h"
+#include "bfcp_probes.h"
 
 BFCP_fsm::~BFCP_fsm(void) {}
 
@@ -1185,7 +1186,7 @@ BFCP_fsm::BFCP_fsm() {
 }
 
 void BFCP_fsm::BFCPFSM_init(
-    st_BFCP_fsm BFCPStateMachine[BFCP_ACT_LAST][BFCP_ACT_LAST]) {
+    const st_BFCP_fsm BFCPStateMachine[BFCP_ACT_LAST][BFCP_ACT_LAST]) {
     memcpy(&m_BFCPStateMachine, BFCPStateMachine, sizeof(m_BFCPStateMachine));
 }
 
@@ -1205,6 +1206,9 @@ bool BFCP_fsm::FsmCtrlPerform(e_BFCP_ACT p_evt, s_bfcp_msg_event* p_bfcp_evt) {
         p_bfcp_evt->sockfd, getBfcpFsmAct(new_bfcpFsmSt));
     bool Status =
         (*this.*m_BFCPStateMachine[m_bfcpFsmSt][p_evt].function)(p_bfcp_evt);
+    BFCP_PROBE5(fsm_transition, (const char *)m_name, (int)m_bfcpFsmSt,
+                (int)p_evt, (int)(Status ? new_bfcpFsmSt : m_bfcpFsmSt),
+                (int)Status);
     if (Status) {
         Log(INF,
             "FSM [%s] action sucessful. Current state [%s] => new state [%s]", m_name,
@@ -1242,84 +1246,84 @@ bool BFCP_fsm::BFCPFSM_NullFunction(s_bfcp_msg_event* p_evt) {
     return false;
 }
 
-bool BFCP_fsm::BFCPFSM_FsmEvent(s_bfcp_msg_event* p_bfcpEvent) {
-    bool status = false;
-    if (!p_bfcpEvent) return status;
+BFCP_fsm::e_BFCP_ACT BFCP_fsm::BFCPFSM_EventAction(
+    const s_bfcp_msg_event* p_bfcpEvent) {
+    if (!p_bfcpEvent) return BFCP_ACT_UNDEFINED;
     Log(INF, _T("BFCPFSM_FsmEvent [%d / %s] status[%s] "), p_bfcpEvent->Event,
         getBfcpDescPrimitive(p_bfcpEvent->Event),
         getBfcpStatus(p_bfcpEvent->Status));
     switch (p_bfcpEvent->Event) {
         case e_primitive_FloorRequest:
-            return FsmCtrlPerform(BFCP_ACT_FloorRequest, p_bfcpEvent);
+            return BFCP_ACT_FloorRequest;
         case e_primitive_FloorRelease:
-            return FsmCtrlPerform(BFCP_ACT_FloorRelease, p_bfcpEvent);
+            return BFCP_ACT_FloorRelease;
         case e_primitive_FloorRequestQuery:
-            return FsmCtrlPerform(BFCP_ACT_FloorRequestQuery, p_bfcpEvent);
+            return BFCP_ACT_FloorRequestQuery;
         case e_primitive_FloorRequestStatus:
             switch (p_bfcpEvent->Status) {
                 case BFCP_PENDING:
                 case BFCP_ACCEPTED:
-                    return FsmCtrlPerform(BFCP_ACT_FloorRequestStatusAccepted,
-                                          p_bfcpEvent);
+                    return BFCP_ACT_FloorRequestStatusAccepted;
                 case BFCP_GRANTED:
-                    return FsmCtrlPerform(BFCP_ACT_FloorRequestStatusGranted,
-                                          p_bfcpEvent);
+                    return BFCP_ACT_FloorRequestStatusGranted;
                 case BFCP_DENIED:
                 case BFCP_CANCELLED:
                 case BFCP_RELEASED:
                 case BFCP_REVOKED:
-                    return FsmCtrlPerform(BFCP_ACT_FloorRequestStatusAborted,
-                                          p_bfcpEvent);
+                    return BFCP_ACT_FloorRequestStatusAborted;
                 default:
                     Log(ERR,
                         _T("BFCPFSM_FsmEvent unknown Event[%d] status[%d]"),
                         p_bfcpEvent->Event, p_bfcpEvent->Status);
-                    return false;
+                    return BFCP_ACT_UNDEFINED;
             }
         case e_primitive_UserQuery:
-            return FsmCtrlPerform(BFCP_ACT_UserQuery, p_bfcpEvent);
+            return BFCP_ACT_UserQuery;
         case e_primitive_UserStatus:
-            return FsmCtrlPerform(BFCP_ACT_UserStatus, p_bfcpEvent);
+            return BFCP_ACT_UserStatus;
         case e_primitive_FloorQuery:
-            return FsmCtrlPerform(BFCP_ACT_FloorQuery, p_bfcpEvent);
+            return BFCP_ACT_FloorQuery;
         case e_primitive_FloorStatus:
             switch (p_bfcpEvent->Status) {
                 case BFCP_PENDING:
                 case BFCP_ACCEPTED:
-                    return FsmCtrlPerform(BFCP_ACT_FloorStatusAccepted,
-                                          p_bfcpEvent);
+                    return BFCP_ACT_FloorStatusAccepted;
                 case BFCP_GRANTED:
-                    return FsmCtrlPerform(BFCP_ACT_FloorStatusGranted,
-                                          p_bfcpEvent);
+                    return BFCP_ACT_FloorStatusGranted;
                 case BFCP_DENIED:
                 case BFCP_CANCELLED:
                 case BFCP_RELEASED:
                 case BFCP_REVOKED:
-                    return FsmCtrlPerform(BFCP_ACT_FloorStatusAborted,
-                                          p_bfcpEvent);
+                    return BFCP_ACT_FloorStatusAborted;
                 default:
                     Log(ERR,
                         _T("BFCPFSM_FsmEvent unknown Event[%d] status[%d]"),
                         p_bfcpEvent->Event, p_bfcpEvent->Status);
-                    return false;
+                    return BFCP_ACT_UNDEFINED;
             }
         case e_primitive_ChairAction:
-            return FsmCtrlPerform(BFCP_ACT_ChairAction, p_bfcpEvent);
+            return BFCP_ACT_ChairAction;
         case e_primitive_ChairActionAck:
-            return FsmCtrlPerform(BFCP_ACT_ChairActionAck, p_bfcpEvent);
+            return BFCP_ACT_ChairActionAck;
         case e_primitive_Hello:
-            return FsmCtrlPerform(BFCP_ACT_Hello, p_bfcpEvent);
+            return BFCP_ACT_Hello;
         case e_primitive_HelloAck:
-            return FsmCtrlPerform(BFCP_ACT_HelloAck, p_bfcpEvent);
+            return BFCP_ACT_HelloAck;
         case e_primitive_Error:
-            return FsmCtrlPerform(BFCP_ACT_Error, p_bfcpEvent);
+            return BFCP_ACT_Error;
         default:
             Log(ERR, _T("BFCPFSM_FsmEvent unknown Event[%d] status[%d]"),
                 p_bfcpEvent->Event, p_bfcpEvent->Status);
-            return false;
+            return BFCP_ACT_UNDEFINED;
     }
 }
 
+bool BFCP_fsm::BFCPFSM_FsmEvent(s_bfcp_msg_event* p_bfcpEvent) {
+    e_BFCP_ACT action = BFCPFSM_EventAction(p_bfcpEvent);
+    if (action == BFCP_ACT_UNDEFINED) return false;
+    return FsmCtrlPerform(action, p_bfcpEvent);
+}
+
 void BFCP_fsm::InitFsmEvent(st_BFCP_fsm_event* p_fsm_evt, e_BFCP_ACT p_state,
                             const s_bfcp_msg_event* p_bfcp_evt) {
     memset(p_fsm_evt, 0, sizeof(st_BFCP_fsm_event));
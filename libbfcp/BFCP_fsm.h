@@ -115,10 +115,12 @@ public:
     
     // event action for fsm
     virtual bool BFCPFSM_FsmEvent( s_bfcp_msg_event* p_evt );
+    // event of the fsm matching a message event, BFCP_ACT_UNDEFINED if none
+    e_BFCP_ACT BFCPFSM_EventAction( const s_bfcp_msg_event* p_evt );
     // logs
     virtual void Log(const  char* pcFile, int iLine, int iErrorLevel, const  char* pcFormat, ...) = 0;
     // Virtual FSM transistion
-    virtual void BFCPFSM_init(st_BFCP_fsm BFCPStateMachine[BFCP_ACT_LAST][BFCP_ACT_LAST]) ;
+    virtual void BFCPFSM_init(const st_BFCP_fsm BFCPStateMachine[BFCP_ACT_LAST][BFCP_ACT_LAST]) ;
     virtual bool BFCPFSM_NullFunction(s_bfcp_msg_event* p_evt );
     virtual bool BFCPFSM_Connected(s_bfcp_msg_event* /*p_evt*/){return true;};
     virtual bool BFCPFSM_Disconnected(s_bfcp_msg_event* /*p_evt*/){return true;};
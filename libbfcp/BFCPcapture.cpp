@@ -0,0 +1,257 @@
+#include "BFCPcapture.h"
+
+#include <string.h>
+
+#include "BFCPmetrics.h"
+
+#ifdef WIN32
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#define BFCP_CAPTURE_PAD(length) \
+    (((length) + BFCP_CAPTURE_ALIGN - 1) & ~(UINT64)(BFCP_CAPTURE_ALIGN - 1))
+
+static UINT64 WallClock() {
+#ifdef WIN32
+    FILETIME ft;
+    ULARGE_INTEGER t;
+    GetSystemTimeAsFileTime(&ft);
+    t.LowPart = ft.dwLowDateTime;
+    t.HighPart = ft.dwHighDateTime;
+    /* 100 ns since 1601 */
+    return t.QuadPart / 10 - 11644473600ULL * 1000000;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (UINT64)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+BFCP_Capture::BFCP_Capture()
+    : m_map(NULL), m_size(0), m_used(0), m_dropped(0), m_start(0) {
+#ifdef WIN32
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+#else
+    m_fd = -1;
+#endif
+}
+
+BFCP_Capture::~BFCP_Capture() { Close(); }
+
+bool BFCP_Capture::Open(const char* pcPath, UINT64 p_size) {
+    st_bfcp_capture_header header;
+
+    if (m_map != NULL || pcPath == NULL) return false;
+    m_size = sizeof(header) + p_size;
+
+#ifdef WIN32
+    m_file = CreateFileA(pcPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                         NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) return false;
+    m_mapping = CreateFileMapping(m_file, NULL, PAGE_READWRITE,
+                                  (DWORD)(m_size >> 32), (DWORD)m_size, NULL);
+    if (m_mapping != NULL)
+        m_map = (UINT8*)MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0,
+                                      (SIZE_T)m_size);
+    if (m_map == NULL) {
+        if (m_mapping != NULL) CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        m_mapping = NULL;
+        m_file = INVALID_HANDLE_VALUE;
+        return false;
+    }
+#else
+    m_fd = open(pcPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) return false;
+    if (ftruncate(m_fd, (off_t)m_size) == 0) {
+        void* map = mmap(NULL, (size_t)m_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, m_fd, 0);
+        if (map != MAP_FAILED) m_map = (UINT8*)map;
+    }
+    if (m_map == NULL) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+#endif
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BFCP_CAPTURE_MAGIC, sizeof(BFCP_CAPTURE_MAGIC));
+    header.version = BFCP_CAPTURE_VERSION;
+    header.header_size = sizeof(header);
+    header.start_us = WallClock();
+    memcpy(m_map, &header, sizeof(header));
+
+    m_used = sizeof(header);
+    m_dropped = 0;
+    m_start = BFCP_Metrics::Now();
+    BFCP_MEMORY_BARRIER();
+    return true;
+}
+
+void BFCP_Capture::Close() {
+    UINT64 used = m_used < m_size ? m_used : m_size;
+
+    if (m_map == NULL) return;
+
+#ifdef WIN32
+    LARGE_INTEGER end;
+    UnmapViewOfFile(m_map);
+    CloseHandle(m_mapping);
+    end.QuadPart = (LONGLONG)used;
+    if (SetFilePointerEx(m_file, end, NULL, FILE_BEGIN)) SetEndOfFile(m_file);
+    CloseHandle(m_file);
+    m_mapping = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    munmap(m_map, (size_t)m_size);
+    if (ftruncate(m_fd, (off_t)used) != 0) {
+        /* The file keeps its zeroed tail, which readers stop at */
+    }
+    close(m_fd);
+    m_fd = -1;
+#endif
+    m_map = NULL;
+}
+
+void BFCP_Capture::Record(int p_direction, int p_transport, BFCP_SOCKET s,
+                          UINT16 p_localPort, const struct sockaddr* p_peer,
+                          const UINT8* p_buffer, UINT32 p_length) {
+    st_bfcp_capture_record record;
+    UINT64 size, offset;
+
+    if (m_map == NULL || p_buffer == NULL || p_length == 0) return;
+
+    memset(&record, 0, sizeof(record));
+    record.time_us = BFCP_Metrics::Now() - m_start;
+    record.length = p_length;
+    record.socket = (INT32)s;
+    record.direction = (UINT8)p_direction;
+    record.transport = (UINT8)p_transport;
+    record.local_port = p_localPort;
+    if (p_peer != NULL && p_peer->sa_family == AF_INET) {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)p_peer;
+        record.peer_family = 4;
+        record.peer_port = ntohs(in->sin_port);
+        memcpy(record.peer_addr, &in->sin_addr, 4);
+    } else if (p_peer != NULL && p_peer->sa_family == AF_INET6) {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*)p_peer;
+        record.peer_family = 6;
+        record.peer_port = ntohs(in6->sin6_port);
+        memcpy(record.peer_addr, &in6->sin6_addr, 16);
+    }
+
+    /* Reserve, then fill: the length is written last, readers stop at 0 */
+    size = sizeof(record) + BFCP_CAPTURE_PAD(p_length);
+    offset = BFCP_ATOMIC_ADD64(&m_used, size);
+    if (offset + size > m_size) {
+        BFCP_ATOMIC_ADD64(&m_dropped, 1);
+        return;
+    }
+    memcpy(m_map + offset + sizeof(record), p_buffer, p_length);
+    record.length = 0;
+    memcpy(m_map + offset, &record, sizeof(record));
+    BFCP_MEMORY_BARRIER();
+    ((st_bfcp_capture_record*)(m_map + offset))->length = p_length;
+}
+
+BFCP_CaptureReader::BFCP_CaptureReader()
+    : m_map(NULL), m_size(0), m_position(0) {
+#ifdef WIN32
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+#endif
+}
+
+BFCP_CaptureReader::~BFCP_CaptureReader() { Close(); }
+
+bool BFCP_CaptureReader::Open(const char* pcPath) {
+    const st_bfcp_capture_header* header;
+
+    if (m_map != NULL || pcPath == NULL) return false;
+
+#ifdef WIN32
+    LARGE_INTEGER size;
+    m_file = CreateFileA(pcPath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) return false;
+    if (GetFileSizeEx(m_file, &size) &&
+        size.QuadPart >= (LONGLONG)sizeof(st_bfcp_capture_header)) {
+        m_size = (UINT64)size.QuadPart;
+        m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping != NULL)
+            m_map = (const UINT8*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0,
+                                                0);
+    }
+#else
+    struct stat st;
+    int fd = open(pcPath, O_RDONLY);
+    if (fd < 0) return false;
+    if (fstat(fd, &st) == 0 &&
+        st.st_size >= (off_t)sizeof(st_bfcp_capture_header)) {
+        void* map =
+            mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            m_map = (const UINT8*)map;
+            m_size = (UINT64)st.st_size;
+        }
+    }
+    close(fd);
+#endif
+    if (m_map == NULL) {
+        Close();
+        return false;
+    }
+
+    header = GetHeader();
+    if (memcmp(header->magic, BFCP_CAPTURE_MAGIC, sizeof(BFCP_CAPTURE_MAGIC)) !=
+            0 ||
+        header->version != BFCP_CAPTURE_VERSION ||
+        header->header_size < sizeof(*header) || header->header_size > m_size) {
+        Close();
+        return false;
+    }
+    Rewind();
+    return true;
+}
+
+void BFCP_CaptureReader::Close() {
+#ifdef WIN32
+    if (m_map != NULL) UnmapViewOfFile(m_map);
+    if (m_mapping != NULL) CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+    m_mapping = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_map != NULL) munmap((void*)m_map, (size_t)m_size);
+#endif
+    m_map = NULL;
+    m_size = 0;
+    m_position = 0;
+}
+
+void BFCP_CaptureReader::Rewind() {
+    m_position = m_map != NULL ? GetHeader()->header_size : 0;
+}
+
+const st_bfcp_capture_record* BFCP_CaptureReader::Next(
+    const UINT8** p_message) {
+    const st_bfcp_capture_record* record;
+
+    if (m_map == NULL || m_position + sizeof(*record) > m_size) return NULL;
+    record = (const st_bfcp_capture_record*)(m_map + m_position);
+    if (record->length == 0 ||
+        m_position + sizeof(*record) + record->length > m_size)
+        return NULL;
+
+    if (p_message != NULL) *p_message = m_map + m_position + sizeof(*record);
+    m_position += sizeof(*record) + BFCP_CAPTURE_PAD(record->length);
+    return record;
+}
@@ -0,0 +1,173 @@
+/**
+ *
+ * \brief Capture of the BFCP messages of a connection
+ *
+ * BFCP_Capture appends every message read or sent by the connections it is
+ * attached to (see BFCPConnection::SetCapture) to a memory-mapped file: the
+ * network and floor control threads reserve their record with one atomic
+ * addition and copy the message, without lock nor system call. The file size
+ * is fixed when it is opened; once it is full the records are dropped and
+ * counted.
+ *
+ * BFCP_CaptureReader walks a capture file, e.g. to replay the messages a
+ * server received (see bench/server).
+ *
+ * File layout, in host byte order: a st_bfcp_capture_header, then records of
+ * a st_bfcp_capture_record followed by the message as seen on the wire,
+ * padded to BFCP_CAPTURE_ALIGN octets. A record of length 0 ends the file.
+ *
+ * \file BFCPcapture.h
+ *
+ * \remarks :
+ * Records are stored in the order they were reserved: two threads recording
+ * at the same time may store them a few microseconds out of time order.
+ * Messages dropped before they were completely read (malformed header, too
+ * big) are not captured.
+ */
+#ifndef BFCP_CAPTURE_H
+#define BFCP_CAPTURE_H
+
+#ifdef WIN32
+#include <winsock2.h>
+#endif
+
+#include "./bfcpmsg/bfcp_messages.h"
+#include "bfcp_threads.h"
+
+#define BFCP_CAPTURE_MAGIC "BFCPCAP"               /** @brief First octets of a capture file */
+#define BFCP_CAPTURE_VERSION 1                      /** @brief Layout of the records */
+#define BFCP_CAPTURE_ALIGN 8                        /** @brief Alignment of the records */
+#define BFCP_CAPTURE_DEFAULT_SIZE (64 * 1024 * 1024) /** @brief Default size of a capture file */
+
+#define BFCP_CAPTURE_IN 0  /** @brief Message read from the socket */
+#define BFCP_CAPTURE_OUT 1 /** @brief Message sent on the socket */
+
+/**  \struct  st_bfcp_capture_header
+ * \brief Beginning of a capture file
+ */
+typedef struct {
+    char magic[8];      /**  \brief  BFCP_CAPTURE_MAGIC */
+    UINT32 version;     /**  \brief  BFCP_CAPTURE_VERSION */
+    UINT32 header_size; /**  \brief  Octets before the first record */
+    UINT64 start_us;    /**  \brief  Wall clock time of the capture start, in microseconds since 1970 */
+} st_bfcp_capture_header;
+
+/**  \struct  st_bfcp_capture_record
+ * \brief One message of a capture file
+ */
+typedef struct {
+    UINT64 time_us;      /**  \brief  Microseconds since the capture start */
+    UINT32 length;       /**  \brief  Octets of the message following the record */
+    INT32 socket;        /**  \brief  Socket of the connection */
+    UINT8 direction;     /**  \brief  BFCP_CAPTURE_IN or BFCP_CAPTURE_OUT */
+    UINT8 transport;     /**  \brief  BFCP_OVER_TCP, BFCP_OVER_UDP... */
+    UINT16 local_port;   /**  \brief  Local port of the socket */
+    UINT16 peer_port;    /**  \brief  Port of the remote endpoint */
+    UINT8 peer_family;   /**  \brief  4 or 6, 0 if unknown */
+    UINT8 reserved;
+    UINT8 peer_addr[16]; /**  \brief  IPv4 (first 4 octets) or IPv6 address of the remote endpoint */
+} st_bfcp_capture_record;
+
+/**
+ *
+ * @class BFCP_Capture
+ * @brief Memory-mapped recorder of the messages of one or more connections
+ *
+ */
+class BFCP_Capture {
+   public:
+    BFCP_Capture();
+    ~BFCP_Capture();
+
+    /**
+     * Create (or truncate) the capture file and map it.
+     * @param pcPath file name
+     * @param p_size octets reserved for the records
+     * @return true success, false the file could not be created or mapped
+     */
+    bool Open(const char* pcPath, UINT64 p_size = BFCP_CAPTURE_DEFAULT_SIZE);
+
+    /**
+     * Unmap the file and cut it to the records written. The connections must
+     * be detached (SetCapture(NULL)) or closed first.
+     */
+    void Close();
+
+    bool IsOpen() { return m_map != NULL; }
+
+    /**
+     * Append a message.
+     * @param p_direction BFCP_CAPTURE_IN or BFCP_CAPTURE_OUT
+     * @param p_peer remote endpoint, NULL if unknown
+     */
+    void Record(int p_direction, int p_transport, BFCP_SOCKET s,
+                UINT16 p_localPort, const struct sockaddr* p_peer,
+                const UINT8* p_buffer, UINT32 p_length);
+
+    /** Records dropped because the file was full */
+    UINT64 GetDropped() { return m_dropped; }
+
+   private:
+    BFCP_Capture(const BFCP_Capture&);
+    BFCP_Capture& operator=(const BFCP_Capture&);
+
+    UINT8* m_map;
+    UINT64 m_size;
+    volatile UINT64 m_used;
+    volatile UINT64 m_dropped;
+    UINT64 m_start;  /* BFCP_Metrics::Now() at the capture start */
+#ifdef WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#else
+    int m_fd;
+#endif
+};
+
+/**
+ *
+ * @class BFCP_CaptureReader
+ * @brief Sequential reader of a capture file
+ *
+ */
+class BFCP_CaptureReader {
+   public:
+    BFCP_CaptureReader();
+    ~BFCP_CaptureReader();
+
+    /**
+     * Map a capture file.
+     * @return true success, false the file could not be read or is not a
+     * capture
+     */
+    bool Open(const char* pcPath);
+    void Close();
+
+    const st_bfcp_capture_header* GetHeader() {
+        return (const st_bfcp_capture_header*)m_map;
+    }
+
+    /**
+     * Next record.
+     * @param p_message set to the message of the record
+     * @return the record, NULL at the end of the capture
+     */
+    const st_bfcp_capture_record* Next(const UINT8** p_message);
+
+    /** Go back to the first record */
+    void Rewind();
+
+   private:
+    BFCP_CaptureReader(const BFCP_CaptureReader&);
+    BFCP_CaptureReader& operator=(const BFCP_CaptureReader&);
+
+    const UINT8* m_map;
+    UINT64 m_size;
+    UINT64 m_position;
+#ifdef WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+};
+
+#endif  // BFCP_CAPTURE_H
@@ -0,0 +1,273 @@
+#include "BFCPchannel.h"
+
+#include <map>
+#include <string.h>
+
+#ifndef WIN32
+#include <errno.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+/* Listeners per port and socket values, under a spin lock: only taken to
+   listen, connect and accept */
+static volatile UINT64 s_table_lock = 0;
+static std::map<UINT16, BFCP_ChannelListener*>* s_listeners = NULL;
+static volatile UINT64 s_next_socket = BFCP_CHANNEL_SOCKET_BASE;
+
+static void LockTable() {
+    while (!BFCP_ATOMIC_CAS64(&s_table_lock, 0, 1)) BFCP_SLEEP(0);
+}
+
+static void UnlockTable() {
+    BFCP_MEMORY_BARRIER();
+    s_table_lock = 0;
+}
+
+static BFCP_SOCKET NewSocket() {
+    return (BFCP_SOCKET)BFCP_ATOMIC_ADD64(&s_next_socket, 1);
+}
+
+BFCP_ChannelSignal::BFCP_ChannelSignal()
+    : m_references(1), m_events(0), m_waiting(0) {
+#ifdef WIN32
+    m_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_cond, NULL);
+#endif
+}
+
+BFCP_ChannelSignal::~BFCP_ChannelSignal() {
+#ifdef WIN32
+    CloseHandle(m_event);
+#else
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+void BFCP_ChannelSignal::Notify() {
+    /* The atomic addition is a full barrier: either the reader sees the new
+       count before it sleeps, or we see it waiting */
+    BFCP_ATOMIC_ADD64(&m_events, 1);
+    if (!m_waiting) return;
+#ifdef WIN32
+    SetEvent(m_event);
+#else
+    pthread_mutex_lock(&m_mutex);
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+#endif
+}
+
+void BFCP_ChannelSignal::Wait(UINT64 p_seen, int p_timeout) {
+#ifdef WIN32
+    BFCP_ATOMIC_ADD64(&m_waiting, 1);
+    if (m_events == p_seen) WaitForSingleObject(m_event, p_timeout);
+    BFCP_ATOMIC_ADD64(&m_waiting, -1);
+#else
+    struct timeval now;
+    struct timespec until;
+
+    gettimeofday(&now, NULL);
+    until.tv_sec = now.tv_sec + p_timeout / 1000;
+    until.tv_nsec = (now.tv_usec + (p_timeout % 1000) * 1000) * 1000;
+    if (until.tv_nsec >= 1000000000) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&m_mutex);
+    BFCP_ATOMIC_ADD64(&m_waiting, 1);
+    while (m_events == p_seen) {
+        if (pthread_cond_timedwait(&m_cond, &m_mutex, &until) == ETIMEDOUT)
+            break;
+    }
+    BFCP_ATOMIC_ADD64(&m_waiting, -1);
+    pthread_mutex_unlock(&m_mutex);
+#endif
+}
+
+BFCP_ChannelListener::BFCP_ChannelListener(UINT16 p_port,
+                                           BFCP_ChannelSignal* p_signal)
+    : m_port(p_port), m_socket(NewSocket()), m_signal(p_signal), m_queued(0) {}
+
+BFCP_Channel* BFCP_ChannelListener::Accept() {
+    BFCP_Channel* channel;
+
+    if (m_queued == 0) return NULL;
+    LockTable();
+    channel = m_pending.front();
+    m_pending.pop_front();
+    m_queued--;
+    UnlockTable();
+    return channel;
+}
+
+BFCP_ChannelListener* BFCP_Channel::Listen(UINT16 p_port,
+                                           BFCP_ChannelSignal* p_signal) {
+    BFCP_ChannelListener* listener = NULL;
+
+    LockTable();
+    if (s_listeners == NULL)
+        s_listeners = new std::map<UINT16, BFCP_ChannelListener*>();
+    if (s_listeners->find(p_port) == s_listeners->end()) {
+        listener = new BFCP_ChannelListener(p_port, p_signal);
+        (*s_listeners)[p_port] = listener;
+    }
+    UnlockTable();
+    return listener;
+}
+
+void BFCP_Channel::Unlisten(BFCP_ChannelListener* p_listener) {
+    BFCP_Channel* channel;
+
+    if (p_listener == NULL) return;
+    LockTable();
+    s_listeners->erase(p_listener->m_port);
+    UnlockTable();
+
+    /* Nobody can queue a channel any more */
+    while ((channel = p_listener->Accept()) != NULL)
+        channel->Close(BFCP_CHANNEL_PASSIVE);
+    delete p_listener;
+}
+
+BFCP_Channel* BFCP_Channel::Connect(UINT16 p_port,
+                                    BFCP_ChannelSignal* p_signal) {
+    std::map<UINT16, BFCP_ChannelListener*>::iterator it;
+    BFCP_ChannelListener* listener;
+    BFCP_Channel* channel = NULL;
+
+    LockTable();
+    if (s_listeners != NULL &&
+        (it = s_listeners->find(p_port)) != s_listeners->end()) {
+        listener = it->second;
+        channel = new BFCP_Channel(p_signal, listener->m_signal);
+        listener->m_pending.push_back(channel);
+        listener->m_queued++;
+        listener->m_signal->Notify();
+    }
+    UnlockTable();
+    return channel;
+}
+
+BFCP_Channel::BFCP_Channel(BFCP_ChannelSignal* p_active,
+                           BFCP_ChannelSignal* p_passive)
+    : m_references(2) {
+    for (int end = 0; end < 2; end++) {
+        Queue* queue = &m_queues[end];
+        for (UINT64 i = 0; i < BFCP_CHANNEL_SIZE; i++) {
+            queue->slots[i].sequence = i;
+            queue->slots[i].message = NULL;
+        }
+        queue->tail = 0;
+        queue->head = 0;
+        m_sockets[end] = NewSocket();
+        m_closed[end] = false;
+    }
+    m_queues[BFCP_CHANNEL_ACTIVE].signal = p_active;
+    m_queues[BFCP_CHANNEL_PASSIVE].signal = p_passive;
+    p_active->Acquire();
+    p_passive->Acquire();
+}
+
+BFCP_Channel::~BFCP_Channel() {
+    bfcp_message* message;
+
+    for (int end = 0; end < 2; end++) {
+        while ((message = Pop(&m_queues[end])) != NULL)
+            bfcp_free_message(message);
+        m_queues[end].signal->Release();
+    }
+}
+
+bool BFCP_Channel::Push(Queue* p_queue, bfcp_message* p_message) {
+    UINT64 position;
+    Slot* slot;
+
+    for (;;) {
+        position = p_queue->tail;
+        slot = &p_queue->slots[position & (BFCP_CHANNEL_SIZE - 1)];
+        INT64 lag = (INT64)(slot->sequence - position);
+        if (lag == 0) {
+            if (BFCP_ATOMIC_CAS64(&p_queue->tail, position, position + 1))
+                break;
+        } else if (lag < 0) {
+            return false; /* Full */
+        }
+        /* else another producer took the slot, retry */
+    }
+    slot->message = p_message;
+    BFCP_MEMORY_BARRIER();
+    slot->sequence = position + 1;
+    return true;
+}
+
+bfcp_message* BFCP_Channel::Peek(Queue* p_queue) {
+    Slot* slot = &p_queue->slots[p_queue->head & (BFCP_CHANNEL_SIZE - 1)];
+
+    if (slot->sequence != p_queue->head + 1) return NULL;
+    BFCP_MEMORY_BARRIER();
+    return slot->message;
+}
+
+bfcp_message* BFCP_Channel::Pop(Queue* p_queue) {
+    Slot* slot = &p_queue->slots[p_queue->head & (BFCP_CHANNEL_SIZE - 1)];
+    bfcp_message* message = Peek(p_queue);
+
+    if (message == NULL) return NULL;
+    slot->sequence = p_queue->head + BFCP_CHANNEL_SIZE;
+    p_queue->head++;
+    return message;
+}
+
+int BFCP_Channel::Send(int p_end, const bfcp_message* p_message) {
+    Queue* queue = &m_queues[1 - p_end];
+    bfcp_message* copy;
+    int waited = 0;
+
+    if (m_closed[p_end] || m_closed[1 - p_end]) return -3;
+    copy = bfcp_copy_message((bfcp_message*)p_message);
+    if (copy == NULL) return -3;
+
+    while (!Push(queue, copy)) {
+        if (waited >= BFCP_CHANNEL_SEND_TIMEOUT || m_closed[1 - p_end]) {
+            bfcp_free_message(copy);
+            return -2;
+        }
+        queue->signal->Notify();
+        BFCP_SLEEP(1);
+        waited++;
+    }
+    queue->signal->Notify();
+    return 0;
+}
+
+int BFCP_Channel::Receive(int p_end, unsigned char* p_buffer, int p_size) {
+    Queue* queue = &m_queues[p_end];
+    bfcp_message* message = Peek(queue);
+    int length;
+
+    if (message == NULL) {
+        /* Closed is set after the last push of the other end */
+        if (!m_closed[1 - p_end]) return 0;
+        BFCP_MEMORY_BARRIER();
+        message = Peek(queue);
+        if (message == NULL) return -1;
+    }
+    /* Never cut a message: it stays queued for a larger buffer */
+    if (message->length > p_size) return -2;
+    length = message->length;
+    memcpy(p_buffer, message->buffer, length);
+    bfcp_free_message(Pop(queue));
+    return length;
+}
+
+void BFCP_Channel::Close(int p_end) {
+    m_closed[p_end] = true;
+    BFCP_MEMORY_BARRIER();
+    m_queues[1 - p_end].signal->Notify();
+    if (BFCP_ATOMIC_ADD64(&m_references, -1) == 1) delete this;
+}
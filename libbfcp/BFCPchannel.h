@@ -0,0 +1,207 @@
+/**
+ *
+ * \brief In-process BFCP transport
+ *
+ * BFCP_OVER_MEMORY connects a BFCPConnection to a listening one of the same
+ * process without any socket, e.g. BFCP_Participant instances to a
+ * BFCP_Server for benchmarks and large tests:
+ *
+ * \li the passive connection listens on a port of a process-wide table
+ *     (BFCP_Channel::Listen), its local address is ignored;
+ * \li the active connection creates a BFCP_Channel to the remote port
+ *     (BFCP_Channel::Connect), which the listener accepts;
+ * \li a channel is a pair of bounded lock-free queues of messages, one per
+ *     direction, that any thread can send to and the network thread of the
+ *     receiving connection reads: the messages then follow the path of the
+ *     messages read from a socket (validation, metrics, capture,
+ *     ProcessBFCPmessage), and OnBFCPConnected/OnBFCPDisconnected are called
+ *     as for TCP.
+ *
+ * The channels and the listeners are identified by socket values above
+ * BFCP_CHANNEL_SOCKET_BASE, which are never real sockets.
+ *
+ * \file BFCPchannel.h
+ *
+ * \remarks :
+ * The transport is reliable and ordered like TCP. A sender waits while the
+ * queue of the receiver is full, up to BFCP_CHANNEL_SEND_TIMEOUT.
+ */
+#ifndef BFCP_CHANNEL_H
+#define BFCP_CHANNEL_H
+
+#include <list>
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+#include "./bfcpmsg/bfcp_messages.h"
+#include "bfcp_threads.h"
+
+#define BFCP_CHANNEL_SIZE 256              /** @brief Messages queued per direction (power of two) */
+#define BFCP_CHANNEL_SEND_TIMEOUT 10000    /** @brief Milliseconds a sender waits on a full queue */
+#define BFCP_CHANNEL_SOCKET_BASE 0x40000000 /** @brief First socket value of the channels */
+
+#define BFCP_CHANNEL_ACTIVE 0  /** @brief End of the connecting side */
+#define BFCP_CHANNEL_PASSIVE 1 /** @brief End of the listening side */
+
+/**
+ *
+ * @class BFCP_ChannelSignal
+ * @brief Wakes up the thread reading one or more channels
+ *
+ * Notify() only takes a lock when the reader is waiting. Shared by the
+ * connection and its channels, which may outlive it: created with one
+ * reference, deleted by the last Release().
+ */
+class BFCP_ChannelSignal {
+   public:
+    BFCP_ChannelSignal();
+
+    void Acquire() { BFCP_ATOMIC_ADD64(&m_references, 1); }
+    void Release() {
+        if (BFCP_ATOMIC_ADD64(&m_references, -1) == 1) delete this;
+    }
+
+    /** Count of the notifications, read before looking for messages */
+    UINT64 Events() { return m_events; }
+
+    void Notify();
+
+    /**
+     * Wait for a notification after 'p_seen' (see Events), at most
+     * 'p_timeout' milliseconds.
+     */
+    void Wait(UINT64 p_seen, int p_timeout);
+
+   private:
+    ~BFCP_ChannelSignal();
+    BFCP_ChannelSignal(const BFCP_ChannelSignal&);
+    BFCP_ChannelSignal& operator=(const BFCP_ChannelSignal&);
+
+    volatile UINT64 m_references;
+    volatile UINT64 m_events;
+    volatile UINT64 m_waiting;
+#ifdef WIN32
+    HANDLE m_event;
+#else
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_cond;
+#endif
+};
+
+class BFCP_ChannelListener;
+
+/**
+ *
+ * @class BFCP_Channel
+ * @brief In-process connection: one message queue per direction
+ *
+ */
+class BFCP_Channel {
+   public:
+    /**
+     * Listen on 'p_port'.
+     * @param p_signal notified when a channel is queued for Accept() and when
+     * a message arrives on an accepted channel
+     * @return NULL if the port is already listened on
+     */
+    static BFCP_ChannelListener* Listen(UINT16 p_port,
+                                        BFCP_ChannelSignal* p_signal);
+
+    /** Stop listening: the channels not accepted yet are closed */
+    static void Unlisten(BFCP_ChannelListener* p_listener);
+
+    /**
+     * Open a channel to the listener of 'p_port'.
+     * @param p_signal notified when a message arrives on the active end
+     * @return NULL if nobody listens on the port
+     */
+    static BFCP_Channel* Connect(UINT16 p_port, BFCP_ChannelSignal* p_signal);
+
+    /** true if 's' is the socket value of a channel end or a listener */
+    static bool IsSocket(BFCP_SOCKET s) {
+        return s != BFCP_INVALID_SOCKET && s >= (BFCP_SOCKET)BFCP_CHANNEL_SOCKET_BASE;
+    }
+
+    /** Socket value of one end */
+    BFCP_SOCKET Socket(int p_end) { return m_sockets[p_end]; }
+
+    /**
+     * Queue a copy of 'p_message' for the other end.
+     * @return 0 sent, -2 the queue stayed full, -3 the channel is closed
+     */
+    int Send(int p_end, const bfcp_message* p_message);
+
+    /**
+     * Copy the next message for 'p_end' in 'p_buffer'.
+     * @return its length, 0 if there is none, -1 if there is none and the
+     * other end is closed, -2 if it is longer than 'p_size' (it stays queued)
+     */
+    int Receive(int p_end, unsigned char* p_buffer, int p_size);
+
+    /**
+     * Close 'p_end': the other end reads the messages already queued, then
+     * gets -1 from Receive. The channel is deleted when both ends are closed.
+     */
+    void Close(int p_end);
+
+   private:
+    struct Slot {
+        volatile UINT64 sequence;
+        bfcp_message* message;
+    };
+
+    /* Bounded multi-producer, single-consumer queue */
+    struct Queue {
+        Slot slots[BFCP_CHANNEL_SIZE];
+        char padding1[64];
+        volatile UINT64 tail; /* Producers */
+        char padding2[64];
+        UINT64 head; /* Consumer */
+        BFCP_ChannelSignal* signal; /* Of the consumer */
+    };
+
+    BFCP_Channel(BFCP_ChannelSignal* p_active, BFCP_ChannelSignal* p_passive);
+    ~BFCP_Channel();
+    BFCP_Channel(const BFCP_Channel&);
+    BFCP_Channel& operator=(const BFCP_Channel&);
+
+    static bool Push(Queue* p_queue, bfcp_message* p_message);
+    static bfcp_message* Peek(Queue* p_queue);
+    static bfcp_message* Pop(Queue* p_queue);
+
+    /* m_queues[end] holds the messages for 'end' */
+    Queue m_queues[2];
+    BFCP_SOCKET m_sockets[2];
+    volatile bool m_closed[2];
+    volatile UINT64 m_references;
+};
+
+/**
+ *
+ * @class BFCP_ChannelListener
+ * @brief Port listened on by a passive BFCP_OVER_MEMORY connection
+ *
+ */
+class BFCP_ChannelListener {
+   public:
+    BFCP_SOCKET Socket() { return m_socket; }
+
+    /** Next channel opened to the port, NULL if none */
+    BFCP_Channel* Accept();
+
+   private:
+    friend class BFCP_Channel;
+
+    BFCP_ChannelListener(UINT16 p_port, BFCP_ChannelSignal* p_signal);
+
+    UINT16 m_port;
+    BFCP_SOCKET m_socket;
+    BFCP_ChannelSignal* m_signal;
+    /* Channels to accept, under the lock of the listener table */
+    std::list<BFCP_Channel*> m_pending;
+    volatile UINT64 m_queued;
+};
+
+#endif  // BFCP_CHANNEL_H
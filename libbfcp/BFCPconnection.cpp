@@ -5,6 +5,7 @@
 #include <sstream>
 
 #include "BFCPexception.h"
+#include "bfcp_probes.h"
 
 using ::std::map;
 using ::std::pair;
@@ -69,6 +70,9 @@ std::string GetErrorText() {
 
 #endif  // WIN32
 
+/* Read time of the message dispatched by the calling thread, see ReceivedAt */
+static BFCP_THREAD_LOCAL UINT64 s_received_us = 0;
+
 static inline const char *TRANSPORT_NAME(int p_transp) {
     switch (p_transp) {
         case BFCP_OVER_TCP:
@@ -80,6 +84,9 @@ static inline const char *TRANSPORT_NAME(int p_transp) {
         case BFCP_OVER_UDP:
             return "UDP";
 
+        case BFCP_OVER_MEMORY:
+            return "MEMORY";
+
         default:
             return "unknown";
     }
@@ -146,6 +153,8 @@ BFCPConnection::BFCPConnection(int transport) : m_remoteClient(transport) {
     m_eRole = BFCPConnectionRole::ACTIVE;
     m_bConnected = false;
     m_isStarted = false;
+    m_logLevel = 0;
+    m_capture = NULL;
 
 #ifdef WIN32
     WSADATA wsaData;
@@ -162,6 +171,7 @@ BFCPConnection::BFCPConnection(int transport) : m_remoteClient(transport) {
 #endif
     m_thread = BFCP_NULL_THREAD_HANDLE;
     m_timer_thread = BFCP_NULL_THREAD_HANDLE;
+    m_channelSignal = new BFCP_ChannelSignal();
     //Log(INF, "%s %p\n", __FUNCTION__, this);
 }
 
@@ -181,6 +191,7 @@ BFCPConnection::~BFCPConnection(void) {
     close(pipefd[0]);
     close(pipefd[1]);
 #endif
+    m_channelSignal->Release();
 }
 
 bool BFCPConnection::SelLocalConnection(const char *localAddress, UINT16 port,
@@ -282,7 +293,17 @@ bool BFCPConnection::SetRemoteAddressAndPort(BFCP_SOCKET s,
 /* Send an already composed message (buffer) to the FCS */
 int BFCPConnection::sendBFCPmessage(BFCP_SOCKET s, bfcp_message *message,
                                     bool retrans) {
+    bfcp_shared_message *shared = NULL;
+    int ret = SendShared(s, message, &shared, retrans);
+    bfcp_release_shared_message(shared);
+    return ret;
+}
+
+int BFCPConnection::SendShared(BFCP_SOCKET s, bfcp_message *message,
+                               bfcp_shared_message **shared, bool retrans) {
     int ret, transp;
+    UINT64 start = BFCP_Metrics::Now();
+    bfcp_header header;
 
     if (s == BFCP_INVALID_SOCKET) return -1;
     if (message == NULL) return -1;
@@ -296,9 +317,10 @@ int BFCPConnection::sendBFCPmessage(BFCP_SOCKET s, bfcp_message *message,
             Log(ERR,
                 "FD [%d] is using TCP or TLS transport and is not connected.",
                 s);
+            m_metrics.SendError();
             return -3;
         }
-        ret = m_remoteClient.SendData(this, s, message);
+        ret = m_remoteClient.SendData(this, s, message, shared);
     } else {
         std::map<BFCP_SOCKET, Client2ServerInfo>::iterator it;
         bool lock = false;
@@ -313,17 +335,26 @@ int BFCPConnection::sendBFCPmessage(BFCP_SOCKET s, bfcp_message *message,
             /* not a client socket */
             if (lock) bfcp_mutex_unlock(m_mutConnect);
             Log(ERR, "Invalid FD [%d] - no in the client list", s);
+            m_metrics.SendError();
             return -5;
         }
 
         transp = it->second.GetTransport();
-        ret = it->second.SendData(this, s, message);
+        ret = it->second.SendData(this, s, message, shared);
         if (lock) {
             bfcp_mutex_unlock(m_mutConnect);
         }
     }
 
-    if (ret < 0) return ret;
+    if (ret < 0) {
+        m_metrics.SendError();
+        return ret;
+    }
+
+    if (bfcp_peek_header(message->buffer, message->length, &header) < 0)
+        header.primitive = e_primitive_InvalidPrimitive;
+    m_metrics.Sent(header.primitive, message->length);
+    m_metrics.Duration(&st_bfcp_metrics::send_us, start);
 
     if (transp == BFCP_OVER_UDP && !retrans) {
         /*
@@ -331,12 +362,16 @@ int BFCPConnection::sendBFCPmessage(BFCP_SOCKET s, bfcp_message *message,
          * we have to store transaction in a table in order to manage
          * retransmission
          */
-        UINT16 transID = bfcp_get_transactionID(message);
+        if (header.primitive == e_primitive_InvalidPrimitive) return -1;
+        UINT16 transID = header.transactionID;
         if (transID != 0) {
-            Transaction t(s, message);
+            if (*shared == NULL)
+                *shared = bfcp_new_shared_message(message->buffer,
+                                                  message->length);
+            Transaction t(s, *shared);
 
             bfcp_mutex_lock(m_SessionMutex);
-            if (IsTransactionStart(bfcp_get_primitive(message)))
+            if (IsTransactionStart(header.primitive))
                 transactionMap[transID] = t;
             bfcp_mutex_unlock(m_SessionMutex);
 #ifndef WIN32
@@ -350,15 +385,112 @@ int BFCPConnection::sendBFCPmessage(BFCP_SOCKET s, bfcp_message *message,
     return 0;
 }
 
+int BFCPConnection::sendBFCPtemplate(BFCP_SOCKET s, const bfcp_template *tpl,
+                                     UINT32 conferenceID, UINT16 transactionID,
+                                     UINT16 userID) {
+    unsigned char buffer[BFCP_TEMPLATE_MAX_SIZE];
+    bfcp_message message;
+    int length;
+
+    length = bfcp_template_stamp(tpl, buffer, sizeof(buffer), conferenceID,
+                                 transactionID, userID);
+    if (length < 0) return -1;
+
+    message.buffer = buffer;
+    message.position = 0;
+    message.length = (UINT16)length;
+    return sendBFCPmessage(s, &message);
+}
+
+/* Primitives offered to ProcessLazyBFCPmessage before being parsed */
+static bool IsLazyPrimitive(e_bfcp_primitives primitive) {
+    return primitive == e_primitive_Hello ||
+           primitive == e_primitive_HelloAck ||
+           primitive == e_primitive_ChairActionAck;
+}
+
+int BFCPConnection::DispatchBFCPmessage(bfcp_message *message, BFCP_SOCKET s,
+                                        int transport) {
+    bfcp_header header;
+    bfcp_lazy_message lazy;
+    bfcp_received_message *parsed;
+    UINT64 start;
+    int ret;
+
+    if (bfcp_peek_header(message->buffer, message->length, &header) == 0 &&
+        IsLazyPrimitive(header.primitive) &&
+        bfcp_lazy_parse(&lazy, message->buffer, message->length) == 0) {
+        start = BFCP_Metrics::Now();
+        if (ProcessLazyBFCPmessage(&lazy, s, transport)) {
+            m_metrics.Duration(&st_bfcp_metrics::process_us, start);
+            s_received_us = 0;
+            return 0;
+        }
+    }
+
+    /* ReadData and ReplayBFCPmessage have validated the message */
+    parsed = bfcp_parse_validated_message(message);
+    if (!parsed) {
+        Log(ERR, "BFCP failed to parse incoming message on socket [%d].", s);
+        m_metrics.ParseError(BFCP_PARSING_ERROR);
+        s_received_us = 0;
+        return -1;
+    }
+    parsed->transport = transport;
+    for (bfcp_received_message_error *error = parsed->errors; error != NULL;
+         error = error->next)
+        m_metrics.ParseError(error->code);
+
+    /* ProcessBFCPmessage releases the parsed message */
+    start = BFCP_Metrics::Now();
+    ret = ProcessBFCPmessage(parsed, s);
+    m_metrics.Duration(&st_bfcp_metrics::process_us, start);
+    s_received_us = 0;
+    return ret;
+}
+
+UINT64 BFCPConnection::ReceivedAt() { return s_received_us; }
+
+int BFCPConnection::ReplayBFCPmessage(const UINT8 *p_buffer, UINT16 p_length,
+                                      BFCP_SOCKET s, int p_transport) {
+    bfcp_message *message;
+    bfcp_header header;
+    int ret;
+
+    s_received_us = BFCP_Metrics::Now();
+    if (p_buffer == NULL ||
+        bfcp_validate_message(p_buffer, p_length) == BFCP_PARSING_ERROR) {
+        m_metrics.ParseError(BFCP_PARSING_ERROR);
+        return -1;
+    }
+    message = bfcp_new_message((unsigned char *)p_buffer, p_length);
+    if (!message) return -1;
+    if (bfcp_peek_header(message->buffer, message->length, &header) < 0) {
+        bfcp_free_message(message);
+        return -1;
+    }
+    m_metrics.Received(header.primitive, p_length);
+    ret = DispatchBFCPmessage(message, s, p_transport);
+    bfcp_free_message(message);
+    return ret;
+}
+
+void BFCPConnection::GetMetrics(st_bfcp_metrics *p_metrics) {
+    m_metrics.Snapshot(p_metrics);
+}
+
 int BFCPConnection::CloseOutgoingTransaction(BFCP_SOCKET s, bfcp_message *m) {
-    if (IsTransactionAnswer(bfcp_get_primitive(m))) {
+    bfcp_header header;
+    if (m == NULL || bfcp_peek_header(m->buffer, m->length, &header) < 0)
+        return 0;
+    if (IsTransactionAnswer(header.primitive)) {
         /*
          * This was not a retransmission and transport is not reliable
          * we have to store transaction in a table in order to manage
          * retransmission
          */
 
-        UINT16 transID = bfcp_get_transactionID(m);
+        UINT16 transID = header.transactionID;
 
         if (transID != 0) {
             bfcp_mutex_lock(m_SessionMutex);
@@ -528,8 +660,10 @@ void BFCPConnection::disconnect() {
                 for (it = m_ClientSocket.begin(); it != m_ClientSocket.end();
                      it++) {
                     BFCP_SOCKET s = it->first;
+                    it->second.CloseChannel();
                     it->second.CloseSocket(s);
                 }
+                m_metrics.ConnectionClosed(m_ClientSocket.size());
                 m_ClientSocket.clear();
             }
             bfcp_mutex_unlock(m_mutConnect);
@@ -544,6 +678,12 @@ void BFCPConnection::disconnect() {
 
             m_remoteClient.CloseSocket(m_Socket);
             m_Socket = BFCP_INVALID_SOCKET;
+            m_channelSignal->Notify();
+#ifndef WIN32
+            /* Closing the socket does not end the select of RunLoop */
+            if (write(pipefd[1], "ok", 2) < 0)
+                Log(INF, "BFCPConnection: failed to signal the RunLoop");
+#endif
 
             while (count > 0 && (m_bConnected || m_isStarted)) {
                 BFCP_SLEEP(waitRange);
@@ -556,7 +696,10 @@ void BFCPConnection::disconnect() {
                 m_thread);
 #ifndef WIN32
             if (m_timer_thread) {
+                /* Under the mutex, not to signal before it waits */
+                bfcp_mutex_lock(m_SessionMutex);
                 pthread_cond_signal(&m_timer_cond);
+                bfcp_mutex_unlock(m_SessionMutex);
                 pthread_join(m_timer_thread, NULL);
             }
 #endif
@@ -631,6 +774,8 @@ void *BFCPConnection::ManageRetransmission(void *pParam)
                            "%u after %u ms",
                            tID, duration);
                     retTransactions[tID] = it->second;
+                    c->m_metrics.Retransmission();
+                    BFCP_PROBE2(retransmit, (int)tID, duration);
 
                     // ret = c->sendBFCPmessage(it->second.m_sockfd,
                     // it->second.message, true);
@@ -648,6 +793,8 @@ void *BFCPConnection::ManageRetransmission(void *pParam)
                            "-BFCPConnection: outgoing transaction %u has "
                            "expired. Socket %d will be closed",
                            tID, it->second.m_sockfd);
+                    c->m_metrics.T1Expired();
+                    BFCP_PROBE2(t1_expired, (int)tID, (int)it->second.m_sockfd);
                     need_disconnect = true;
                     break;
             }
@@ -670,8 +817,11 @@ void *BFCPConnection::ManageRetransmission(void *pParam)
 
         /* Do the retransmission ! */
         for (it = retTransactions.begin(); it != retTransactions.end(); it++) {
-            ret = c->sendBFCPmessage(it->second.m_sockfd, it->second.message,
-                                     true);
+            bfcp_shared_message *shared =
+                bfcp_retain_shared_message(it->second.shared);
+            ret = c->SendShared(it->second.m_sockfd, it->second.message,
+                                &shared, true);
+            bfcp_release_shared_message(shared);
             if (ret == -3) {
                 c->OnBFCPDisconnected(it->second.m_sockfd);
                 gettimeofday(&waituntil, NULL);
@@ -710,11 +860,20 @@ void *BFCPConnection::EntryPoint(void *pParam)
 #endif
 {
     bool Status = true;
+    bool opened = false;
     if (pParam) {
         BFCPConnection *bfcpConnection = (BFCPConnection *)pParam;
         bfcpConnection->Log(INF,
                             ">> BFCPConnection: transport thread starting %p.", bfcpConnection);
 
+        if (bfcpConnection->m_remoteClient.GetTransport() == BFCP_OVER_MEMORY) {
+            bfcpConnection->RunChannelLoop();
+            bfcpConnection->m_isStarted = false;
+            bfcpConnection->m_bConnected = false;
+            bfcpConnection->Log(INF, "<< BFCP connection thread exiting");
+            return 0;
+        }
+
         try {
             sockaddr_in out_addr;
             memset(&out_addr, 0, sizeof(sockaddr_in));
@@ -780,6 +939,8 @@ void *BFCPConnection::EntryPoint(void *pParam)
                             bfcpConnection->getRemotePort());
 
                         bfcpConnection->m_bConnected = true;
+                        bfcpConnection->m_metrics.ConnectionOpened();
+                        opened = true;
                         // Alert application
                         bfcpConnection->OnBFCPConnected(
                             bfcpConnection->m_Socket,
@@ -798,6 +959,7 @@ void *BFCPConnection::EntryPoint(void *pParam)
             bfcpConnection->Log(ERR, "BFCPConnection: %s", e.what());
         }
 
+        if (opened) bfcpConnection->m_metrics.ConnectionClosed();
         bfcpConnection->m_isStarted = false;
         bfcpConnection->m_bConnected = false;
 
@@ -980,6 +1142,7 @@ void BFCPConnection::RunLoop() {
             fdset = allSet;
             tv.tv_sec = 1;
             int nready = select((int)listenSocket + 1, &fdset, NULL, NULL, &tv);
+            BFCP_PROBE2(loop_wakeup, m_remoteClient.GetTransport(), nready);
             if (m_bClose || m_Socket == BFCP_INVALID_SOCKET) continue;
 
             // Log(INF, "BFCPConnection::transmitLoop nready=%d, m_Socket: %d, %p, role: %d\n",nready, m_Socket, this, m_eRole);
@@ -1065,7 +1228,7 @@ void BFCPConnection::RunLoop() {
                         m_remoteClient.GetTransport() == BFCP_OVER_UDP) {
                         ret = m_remoteClient.ReadData(this, m_Socket);
 
-                        if (ret == 1 && m_remoteClient.parsed_msg != NULL) {
+                        if (ret == 1) {
                             if (m_remoteClient.GetTransport() ==
                                 BFCP_OVER_UDP) {
                                 int retClose = CloseOutgoingTransaction(
@@ -1074,12 +1237,14 @@ void BFCPConnection::RunLoop() {
                                 if (!m_remoteClient.HandleRemoteRetrans(
                                         this, m_Socket,
                                         m_remoteClient.message)) {
-                                    ProcessBFCPmessage(
-                                        m_remoteClient.parsed_msg, m_Socket);
+                                    DispatchBFCPmessage(
+                                        m_remoteClient.message, m_Socket,
+                                        BFCP_OVER_UDP);
                                 }
                             } else {
-                                ProcessBFCPmessage(m_remoteClient.parsed_msg,
-                                                   m_Socket);
+                                DispatchBFCPmessage(
+                                    m_remoteClient.message, m_Socket,
+                                    m_remoteClient.GetTransport());
                             }
                             m_remoteClient.CleanupRead();
                         } else if (ret == -3) {
@@ -1125,6 +1290,7 @@ void BFCPConnection::RunLoop() {
                                     acceptSocket, c2s));
                             FD_SET(acceptSocket, &allSet);
                             bfcp_mutex_unlock(m_mutConnect);
+                            m_metrics.ConnectionOpened();
 
                             if (acceptSocket > listenSocket)
                                 listenSocket = acceptSocket;
@@ -1174,19 +1340,19 @@ void BFCPConnection::RunLoop() {
                     //    TRANSPORT_NAME(it->second.GetTransport()), s);
 
                     ret = it->second.ReadData(this, s);
-                    if (ret == 1 && it->second.parsed_msg != NULL) {
+                    if (ret == 1) {
                         if (it->second.GetTransport() == BFCP_OVER_UDP) {
                             if (CloseOutgoingTransaction(
                                     s, it->second.message) == 1) {
                                 Log(INF, "Closed transaction %u",
-                                    it->second.parsed_msg->entity
-                                        ->transactionID);
+                                    it->second.header.transactionID);
                             }
 
                             if (!it->second.HandleRemoteRetrans(
                                     this, s, it->second.message)) {
-                                ProcessBFCPmessage(it->second.parsed_msg, s);
-                                if (it->second.parsed_msg->primitive ==
+                                DispatchBFCPmessage(it->second.message, s,
+                                                    BFCP_OVER_UDP);
+                                if (it->second.header.primitive ==
                                     e_primitive_GoodbyeAck) {
                                     /* We 've receive a GoodbyeAck so we need to
                                      * close everything */
@@ -1209,7 +1375,8 @@ void BFCPConnection::RunLoop() {
                                 it->second.GetRemoteAddrAndPort(),
                                 m_ClientSocket.size() + 1,
                                 s);
-                            ProcessBFCPmessage(it->second.parsed_msg, s);
+                            DispatchBFCPmessage(it->second.message, s,
+                                                it->second.GetTransport());
                         }
 
                         it->second.CleanupRead();
@@ -1232,6 +1399,8 @@ void BFCPConnection::RunLoop() {
                     /* remove disconnected socket from set and client list */
                     m_ClientSocket.erase(s);  // Remove from list
                     FD_CLR(s, &allSet);       // and from set
+                    Client2ServerInfo::CloseSocket(s);
+                    m_metrics.ConnectionClosed();
 
                     /* Recompute last FD for select */
                     listenSocket = m_Socket;
@@ -1256,6 +1425,131 @@ void BFCPConnection::RunLoop() {
     Log(INF, "Closed");
 }
 
+bool BFCPConnection::ReadChannel(Client2ServerInfo &c2s, BFCP_SOCKET s,
+                                 bool *closed) {
+    bool busy = false;
+    int ret;
+
+    /* A few messages per channel and round, so that none is starved */
+    for (int count = 0; count < 16 && !m_bClose; count++) {
+        ret = c2s.ReadData(this, s);
+        if (ret == 0) break;
+        busy = true;
+        if (ret == 1) {
+            DispatchBFCPmessage(c2s.message, s, c2s.GetTransport());
+            c2s.CleanupRead();
+        } else if (ret == -3) {
+            *closed = true;
+            break;
+        }
+    }
+    return busy;
+}
+
+void BFCPConnection::RunChannelLoop() {
+    BFCP_ChannelListener *listener = NULL;
+    BFCP_Channel *channel;
+    std::map<BFCP_SOCKET, Client2ServerInfo>::iterator it;
+    BFCP_SOCKET s;
+    UINT64 seen;
+    bool busy, closed;
+
+    if (m_eRole == BFCPConnectionRole::ACTIVE) {
+        channel = BFCP_Channel::Connect(getRemotePort(), m_channelSignal);
+        if (channel == NULL) {
+            Log(ERR, "BFCP in-process connection to port %d failed: nothing listens",
+                getRemotePort());
+            return;
+        }
+        m_remoteClient.SetChannel(channel, BFCP_CHANNEL_ACTIVE);
+        m_Socket = channel->Socket(BFCP_CHANNEL_ACTIVE);
+        m_bConnected = true;
+        m_metrics.ConnectionOpened();
+        OnBFCPConnected(m_Socket, getRemoteAdress(), getRemotePort());
+    } else {
+        listener = BFCP_Channel::Listen(getLocalPort(), m_channelSignal);
+        if (listener == NULL) {
+            Log(ERR, "BFCP in-process port %d is already listened on",
+                getLocalPort());
+            return;
+        }
+        m_Socket = listener->Socket();
+        m_bConnected = true;
+        Log(INF, "BFCPConnection: wait for in-process connections on port %d",
+            getLocalPort());
+    }
+
+    while (!m_bClose) {
+        /* Read before the channels: a message queued meanwhile wakes us up */
+        seen = m_channelSignal->Events();
+        busy = false;
+
+        if (listener == NULL) {
+            closed = false;
+            busy = ReadChannel(m_remoteClient, m_Socket, &closed);
+            if (closed) {
+                if (!m_bClose) OnBFCPDisconnected(m_Socket);
+                m_bClose = true;
+            }
+        } else {
+            while ((channel = listener->Accept()) != NULL) {
+                Client2ServerInfo c2s(BFCP_OVER_MEMORY);
+                s = channel->Socket(BFCP_CHANNEL_PASSIVE);
+                c2s.SetChannel(channel, BFCP_CHANNEL_PASSIVE);
+
+                bfcp_mutex_lock(m_mutConnect);
+                m_ClientSocket.insert(
+                    std::pair<BFCP_SOCKET, Client2ServerInfo>(s, c2s));
+                bfcp_mutex_unlock(m_mutConnect);
+                m_metrics.ConnectionOpened();
+                busy = true;
+
+                // Alert application
+                if (!m_bClose)
+                    OnBFCPConnected(s, c2s.GetRemoteAddr(), c2s.GetRemotePort());
+            }
+
+            bfcp_mutex_lock(m_mutConnect);
+            s = BFCP_INVALID_SOCKET;
+            for (it = m_ClientSocket.begin();
+                 it != m_ClientSocket.end() && !m_bClose; it++) {
+                closed = false;
+                if (ReadChannel(it->second, it->first, &closed)) busy = true;
+                if (closed) {
+                    s = it->first;
+                    it->second.CloseChannel();
+                    m_ClientSocket.erase(it);
+                    m_metrics.ConnectionClosed();
+                    break;
+                }
+            }
+            bfcp_mutex_unlock(m_mutConnect);
+            if (s != BFCP_INVALID_SOCKET && !m_bClose) OnBFCPDisconnected(s);
+        }
+
+        if (!busy && !m_bClose) {
+            m_channelSignal->Wait(seen, 100);
+            BFCP_PROBE2(loop_wakeup, BFCP_OVER_MEMORY,
+                        (int)(m_channelSignal->Events() - seen));
+        }
+    }
+
+    if (listener == NULL) {
+        m_remoteClient.CloseChannel();
+        m_metrics.ConnectionClosed();
+    } else {
+        BFCP_Channel::Unlisten(listener);
+        /* Channels accepted while disconnect() was closing the others */
+        bfcp_mutex_lock(m_mutConnect);
+        for (it = m_ClientSocket.begin(); it != m_ClientSocket.end(); it++)
+            it->second.CloseChannel();
+        m_metrics.ConnectionClosed(m_ClientSocket.size());
+        m_ClientSocket.clear();
+        bfcp_mutex_unlock(m_mutConnect);
+    }
+    Log(INF, "Closed");
+}
+
 BFCP_SOCKET BFCPConnection::Client2ServerInfo::CreateSocket() {
     BFCP_SOCKET fd = BFCP_INVALID_SOCKET;
     struct sockaddr *addr = (struct sockaddr *)&m_localAddress;
@@ -1431,7 +1725,6 @@ void BFCPConnection::Client2ServerInfo::Init() {
     message = NULL;
     recvidx = 0;
     msgsize = 0;
-    parsed_msg = NULL;
 
     // memset(recvBuffer, 0, sizeof(recvBuffer));
     memset(&m_localAddress, 0, sizeof(m_localAddress));
@@ -1446,6 +1739,8 @@ void BFCPConnection::Client2ServerInfo::Init() {
     m_remoteAddressAndPort.clear();
     m_remoteAddressStr.clear();
     m_localAddressStr.clear();
+    m_channel = NULL;
+    m_channelEnd = BFCP_CHANNEL_ACTIVE;
 
     PrintAddress((struct sockaddr *)addr, m_localAddressStr, m_localPort);
 }
@@ -1553,6 +1848,28 @@ int BFCPConnection::Client2ServerInfo::ReadData(BFCPConnection *c,
             recvidx += error;
             break;
 
+        case BFCP_OVER_MEMORY:
+            /* Whole messages, copied from the channel */
+            error = m_channel ? m_channel->Receive(m_channelEnd, recvBuffer,
+                                                   BFCP_MAX_ALLOWED_SIZE)
+                              : -1;
+            if (error == -2) {
+                c->Log(ERR,
+                       "BFCP in-process connection [%d] message larger than "
+                       "%d bytes.",
+                       s, BFCP_MAX_ALLOWED_SIZE);
+                CleanupRead();
+                return -3;
+            }
+            if (error < 0) {
+                c->Log(INF, "BFCP in-process connection [%d] closed.", s);
+                CleanupRead();
+                return -3;
+            }
+            if (error == 0) return 0;
+            recvidx = error;
+            break;
+
         default:
             c->Log(ERR, "BFCP unsupported transport %d for socket [%d].",
                    GetTransport(), s);
@@ -1560,25 +1877,44 @@ int BFCPConnection::Client2ServerInfo::ReadData(BFCPConnection *c,
     }
 
     if (msgsize == 0 && recvidx >= 12) {
-        message = bfcp_new_message(recvBuffer, recvidx);
-        int msgz = bfcp_get_length(message);
-        if (msgz < 0) {
+        bfcp_header header;
+        if (bfcp_peek_header(recvBuffer, recvidx, &header) < 0) {
             c->Log(ERR, "BFCP parse header error: invalid payload length.");
+            c->m_metrics.ParseError(BFCP_WRONG_LENGTH);
             CleanupRead();
             return -1;
         }
 
-        msgsize = bfcp_get_length(message) * 4 + 12;
+        msgsize = header.length;
 
         if (msgsize > BFCP_MAX_ALLOWED_SIZE) {
             c->Log(ERR, "BFCP message too big. Discarding");
+            c->m_metrics.ParseError(BFCP_WRONG_LENGTH);
             CleanupRead();
             return -2;
         }
     }
 
     if (msgsize > 0 && recvidx >= msgsize) {
-        /* We have enough data - parse the whole thing*/
+        BFCP_Capture *capture = c->m_capture;
+        s_received_us = BFCP_Metrics::Now();
+        BFCP_PROBE3(read_done, (int)s, recvidx, GetTransport());
+        if (capture != NULL)
+            capture->Record(BFCP_CAPTURE_IN, GetTransport(), s, m_localPort,
+                            GetTransport() == BFCP_OVER_UDP
+                                ? (struct sockaddr *)&addr
+                                : (struct sockaddr *)&m_remoteAddress,
+                            recvBuffer, recvidx);
+
+        /* We have enough data - validate the whole thing, it is parsed when
+         * dispatched */
+        if (bfcp_validate_message(recvBuffer, recvidx) == BFCP_PARSING_ERROR) {
+            c->Log(ERR, "BFCP malformed attributes on socket [%d]. Discarding",
+                   s);
+            c->m_metrics.ParseError(BFCP_PARSING_ERROR);
+            CleanupRead();
+            return -1;
+        }
         if (message != NULL) bfcp_free_message(message);
         message = bfcp_new_message(recvBuffer, recvidx);
         if (!message) {
@@ -1587,23 +1923,16 @@ int BFCPConnection::Client2ServerInfo::ReadData(BFCPConnection *c,
             return -1;
         }
 
-        parsed_msg = bfcp_parse_message(message);
-        if (!parsed_msg) {
-            /* Failed to parse */
-            CleanupRead();
-            c->Log(ERR, "BFCP failed to parse incoming message on socket [%d].",
-                   s);
-            return -1;
-        }
+        bfcp_peek_header(message->buffer, message->length, &header);
 
-        /* Message correctly parsed */
+        /* Message correctly framed */
         if (GetTransport() == BFCP_OVER_UDP)
             SetRemoteAddress((struct sockaddr *)&addr, addrlen);
-        parsed_msg->transport = GetTransport();
+        c->m_metrics.Received(header.primitive, recvidx);
         return 1;
     }
 
-    if (GetTransport() == BFCP_OVER_UDP) {
+    if (GetTransport() == BFCP_OVER_UDP || GetTransport() == BFCP_OVER_MEMORY) {
         c->Log(ERR, "BFCP message incomplete. Discarding");
         CleanupRead();
         return -2;
@@ -1613,25 +1942,37 @@ int BFCPConnection::Client2ServerInfo::ReadData(BFCPConnection *c,
     return 0;
 
 transport_read_error:
-    CloseSocket(s);
+    /* The owner of the socket closes it (RunLoop) */
     CleanupRead();
     return -3;
 }
 
 #define TCP_CHUNK 1400
 
-int BFCPConnection::Client2ServerInfo::SendData(BFCPConnection *c,
-                                                BFCP_SOCKET s,
-                                                bfcp_message *msg) {
+int BFCPConnection::Client2ServerInfo::SendData(
+    BFCPConnection *c, BFCP_SOCKET s, bfcp_message *msg,
+    bfcp_shared_message **shared) {
     int ret;
+    bfcp_shared_message *local = NULL;
 
     if (s == BFCP_INVALID_SOCKET) {
         c->Log(ERR, "Cannot send data. Invalid socket");
         return -1;
     }
-
-    if (GetTransport() == BFCP_OVER_UDP) {
-        UINT16 trID = bfcp_get_transactionID(msg);
+    BFCP_PROBE3(send, (int)s, msg->length, GetTransport());
+
+    if (GetTransport() == BFCP_OVER_MEMORY) {
+        ret = m_channel ? m_channel->Send(m_channelEnd, msg) : -3;
+        if (ret < 0) {
+            c->Log(ERR, "In-process BFCP message sending failed on [%d]: %s", s,
+                   ret == -2 ? "queue full" : "closed");
+            return ret;
+        }
+    } else if (GetTransport() == BFCP_OVER_UDP) {
+        bfcp_header header;
+        UINT16 trID = 0;
+        if (bfcp_peek_header(msg->buffer, msg->length, &header) == 0)
+            trID = header.transactionID;
 
         if (m_remoteAddressAndPort.empty()) {
             c->Log(ERR, "UDP/BFCP Could not send msg: no destination address.");
@@ -1649,8 +1990,12 @@ int BFCPConnection::Client2ServerInfo::SendData(BFCPConnection *c,
                m_remotePort);
         /* record answer sent */
         if (trID > 0) {
-            Transaction t(s, msg);
+            if (shared == NULL) shared = &local;
+            if (*shared == NULL)
+                *shared = bfcp_new_shared_message(msg->buffer, msg->length);
+            Transaction t(s, *shared);
             answerMap[trID] = t;
+            bfcp_release_shared_message(local);
         }
     } else {
         int total = 0; /* How many bytes have been sent so far */
@@ -1689,11 +2034,19 @@ int BFCPConnection::Client2ServerInfo::SendData(BFCPConnection *c,
             }
         }
     }
+
+    BFCP_Capture *capture = c->m_capture;
+    if (capture != NULL)
+        capture->Record(BFCP_CAPTURE_OUT, GetTransport(), s, m_localPort,
+                        (struct sockaddr *)&m_remoteAddress, msg->buffer,
+                        msg->length);
     return 0;
 }
 
 int BFCPConnection::Client2ServerInfo::CloseSocket(BFCP_SOCKET s) {
     if (s == BFCP_INVALID_SOCKET) return -1;
+    /* Channels are closed with CloseChannel() */
+    if (BFCP_Channel::IsSocket(s)) return 0;
 
     // Log(INF, "BFCP shutdown socket[0x%p] ",s);
     shutdown(s, 2);
@@ -1735,6 +2088,7 @@ BFCP_SOCKET BFCPConnection::AddClient(int transport, int role,
                 // m_ClientSocket.insert(
                 // std::pair<BFCP_SOCKET,Client2ServerInfo>(fd,c2s) );
                 bfcp_mutex_unlock(m_mutConnect);
+                m_metrics.ConnectionOpened();
 
 #ifndef WIN32
                 /* This will unblock the select in RunLoop ! */
@@ -1779,6 +2133,7 @@ bool BFCPConnection::RemoveClient(BFCP_SOCKET s) {
 
         if (m_ClientSocket.erase(s) > 0) {
             Client2ServerInfo::CloseSocket(s);
+            m_metrics.ConnectionClosed();
         }
 
         if (lock) bfcp_mutex_unlock(m_mutConnect);
@@ -1786,12 +2141,11 @@ bool BFCPConnection::RemoveClient(BFCP_SOCKET s) {
     }
     return false;
 }
-BFCPConnection::Transaction::Transaction(BFCP_SOCKET s, bfcp_message *m)
+BFCPConnection::Transaction::Transaction(BFCP_SOCKET s,
+                                         bfcp_shared_message *m)
     : m_sockfd(s) {
-    if (!m)
-        message = NULL;
-    else
-        message = bfcp_copy_message(m);
+    shared = bfcp_retain_shared_message(m);
+    message = shared ? &shared->message : NULL;
 
     gettimeofday(&timerExpiration, 0);
     timerExpiration.tv_usec += 500 * 1000;
@@ -1800,22 +2154,32 @@ BFCPConnection::Transaction::Transaction(BFCP_SOCKET s, bfcp_message *m)
 }
 
 BFCPConnection::Transaction::Transaction() : m_sockfd(BFCP_INVALID_SOCKET) {
+    shared = NULL;
     message = NULL;
     timerExpiration.tv_sec = 0;
     timerExpiration.tv_usec = 0;
     timerDuration = 1;
 }
 
+BFCPConnection::Transaction::Transaction(const Transaction &other)
+    : m_sockfd(other.m_sockfd) {
+    shared = bfcp_retain_shared_message(other.shared);
+    message = shared ? &shared->message : NULL;
+    timerExpiration = other.timerExpiration;
+    timerDuration = other.timerDuration;
+}
+
 BFCPConnection::Transaction::~Transaction() {
-    if (message) bfcp_free_message(message);
+    bfcp_release_shared_message(shared);
 }
 
 BFCPConnection::Transaction &BFCPConnection::Transaction::operator=(
     const Transaction &other) {
-    if (!other.message)
-        message = NULL;
-    else
-        message = bfcp_copy_message(other.message);
+    /* Retain first: other may share our message */
+    bfcp_shared_message *previous = shared;
+    shared = bfcp_retain_shared_message(other.shared);
+    message = shared ? &shared->message : NULL;
+    bfcp_release_shared_message(previous);
     timerExpiration = other.timerExpiration;
     timerDuration = other.timerDuration;
     m_sockfd = other.m_sockfd;
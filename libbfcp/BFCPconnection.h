@@ -48,12 +48,17 @@
 #endif
 
 #include "./bfcpmsg/bfcp_messages.h"
+#include "BFCPcapture.h"
+#include "BFCPchannel.h"
+#include "BFCPlog.h"
+#include "BFCPmetrics.h"
 #include "bfcp_threads.h"
 
 #define BFCP_OVER_TCP 0
 #define BFCP_OVER_TLS 1
 #define BFCP_OVER_UDP 2
 #define BFCP_OVER_DTLS 3
+#define BFCP_OVER_MEMORY 4 /** @brief In-process channels, see BFCPchannel.h */
 
 #define BFCP_FCS_DEFAULT_PORT \
     2345 /** @brief The default port the Floor Control Server will bind to */
@@ -101,6 +106,18 @@ class BFCPConnection {
      * @return -1 , socket are closed , null sucess .
      */
     virtual int ProcessBFCPmessage(bfcp_received_message* m, BFCP_SOCKET s) = 0;
+    /**
+     * This virtual callback is called first for the Hello, HelloAck and
+     * ChairActionAck messages, which can be processed without being parsed:
+     * 'm' only locates their attributes in the received buffer.
+     * @param transport transport on which the message was received
+     * @return true the message was processed, false to have it parsed and
+     * given to ProcessBFCPmessage (default).
+     */
+    virtual bool ProcessLazyBFCPmessage(const bfcp_lazy_message* m,
+                                        BFCP_SOCKET s, int transport) {
+        return false;
+    }
     /**
      * This virtual callback is called when you are connected
      * @param socket connected socket
@@ -224,6 +241,19 @@ class BFCPConnection {
     int sendBFCPmessage(BFCP_SOCKET client_sock, bfcp_message* message,
                         bool donotresend = false);
 
+    /**
+     * Push a pre-encoded message template on socket, stamped with the given
+     * IDs in a stack copy (nothing is allocated).
+     *
+     * @param client_sock client socket
+     * @param tpl message template, see bfcp_template_init
+     *
+     * @return  same as sendBFCPmessage, -1 if the template is not built
+     */
+    int sendBFCPtemplate(BFCP_SOCKET client_sock, const bfcp_template* tpl,
+                         UINT32 conferenceID, UINT16 transactionID,
+                         UINT16 userID);
+
     /**
      * Open the connection and starts the transmit loop.
      */
@@ -243,6 +273,40 @@ class BFCPConnection {
      */
     bool GetServerInfo(char* localIp, int* localPort);
 
+    /**
+     * Copy the metrics recorded since the connection was created, without
+     * locking the network threads.
+     * @param p_metrics receives the metrics
+     */
+    virtual void GetMetrics(st_bfcp_metrics* p_metrics);
+
+    /**
+     * Set the minimum level of the traces: the lower ones are dropped before
+     * they are formatted or handed to the application.
+     * @param iErrorLevel 0 all traces (default), 1 WAR and ERR, 2 ERR only,
+     * 3 none
+     */
+    void SetLogLevel(int iErrorLevel) { m_logLevel = iErrorLevel; }
+    int GetLogLevel() { return m_logLevel; }
+
+    /**
+     * Record the messages read and sent by this connection in 'p_capture',
+     * NULL to stop. The capture must stay open while it is attached.
+     */
+    void SetCapture(BFCP_Capture* p_capture) { m_capture = p_capture; }
+
+    /**
+     * Parse a message as if it had been read on socket 's' over
+     * 'p_transport' (BFCP_OVER_TCP, BFCP_OVER_UDP...) and process it in the
+     * calling thread (see BFCP_CaptureReader). Nothing is read from
+     * the network: the answers go to 's' if it is a connected socket and
+     * are otherwise counted as send errors.
+     * @return -1 the message could not be parsed, else the return of
+     * ProcessBFCPmessage
+     */
+    int ReplayBFCPmessage(const UINT8* p_buffer, UINT16 p_length,
+                          BFCP_SOCKET s, int p_transport);
+
    protected:
     /**
      * Add a new client. Can be active, passive TCP or TLS client. Can be UDP
@@ -270,6 +334,21 @@ class BFCPConnection {
     bool SetRemoteAddressAndPort(BFCP_SOCKET s, const char* remoteIp,
                                  UINT16 remotePort);
 
+    /**
+     * Time (see BFCP_Metrics::Now) the message being processed was read, in
+     * ProcessBFCPmessage; 0 elsewhere
+     */
+    static UINT64 ReceivedAt();
+
+    /** Messages, errors and durations of this connection */
+    BFCP_Metrics m_metrics;
+
+    /** Minimum level of the traces, checked first by Log() */
+    volatile int m_logLevel;
+
+    /** Recorder of the messages, NULL if not captured */
+    BFCP_Capture* volatile m_capture;
+
 #ifdef WIN32
     static unsigned __stdcall EntryPoint(void* pParam);
     static unsigned __stdcall ManageRetransmission(void* pParam);
@@ -283,7 +362,8 @@ class BFCPConnection {
     class Transaction {
        public:
         Transaction();
-        Transaction(BFCP_SOCKET s, bfcp_message* m);
+        Transaction(BFCP_SOCKET s, bfcp_shared_message* m);
+        Transaction(const Transaction& other);
         virtual ~Transaction();
 
         Transaction& operator=(const Transaction& other);
@@ -297,6 +377,9 @@ class BFCPConnection {
         void MarkTransmission();
 
        public:
+        bfcp_shared_message* shared; /* <! encoded message, shared (not copied)
+                                      * between the send path, the transaction
+                                      * table and the answer cache */
         bfcp_message* message; /* <! message that created the transaction and
                                 * need to be resent if no ack is received this
                                 * can also be the answer to resend in case of
@@ -345,7 +428,8 @@ class BFCPConnection {
             msgsize = 0;
 
             message = NULL;
-            parsed_msg = NULL;
+            m_channel = other.m_channel;
+            m_channelEnd = other.m_channelEnd;
             // return *this;
         }
 
@@ -414,7 +498,8 @@ class BFCPConnection {
          *        -2 - no destination address available
          *        -3 - transport error.
          **/
-        int SendData(BFCPConnection* c, BFCP_SOCKET s, bfcp_message* m);
+        int SendData(BFCPConnection* c, BFCP_SOCKET s, bfcp_message* m,
+                     bfcp_shared_message** shared = NULL);
 
         static int CloseSocket(BFCP_SOCKET s);
 
@@ -437,7 +522,25 @@ class BFCPConnection {
          **/
         bool HasReliableTransport() {
             return GetTransport() == BFCP_OVER_TCP ||
-                   GetTransport() == BFCP_OVER_TLS;
+                   GetTransport() == BFCP_OVER_TLS ||
+                   GetTransport() == BFCP_OVER_MEMORY;
+        }
+
+        /**
+         * Use an end of an in-process channel (BFCP_OVER_MEMORY) as socket
+         **/
+        void SetChannel(BFCP_Channel* channel, int end) {
+            m_channel = channel;
+            m_channelEnd = end;
+        }
+
+        /**
+         * Close the channel end if there is one, the peer is then told that
+         * the connection is closed
+         **/
+        void CloseChannel() {
+            if (m_channel) m_channel->Close(m_channelEnd);
+            m_channel = NULL;
         }
 
         void CleanupRead();
@@ -491,6 +594,10 @@ class BFCPConnection {
         struct sockaddr_storage m_localAddress;
         struct sockaddr_storage m_remoteAddress;
 
+        /* In-process transport */
+        BFCP_Channel* m_channel;
+        int m_channelEnd;
+
         /* Incoming messages handling */
         unsigned char recvBuffer[BFCP_MAX_ALLOWED_SIZE];
         int recvidx;
@@ -504,7 +611,8 @@ class BFCPConnection {
 
        public:
         bfcp_message* message;
-        bfcp_received_message* parsed_msg;
+        /** Common Header of 'message' */
+        bfcp_header header;
     };
 
     /**
@@ -515,6 +623,34 @@ class BFCPConnection {
      **/
     int CloseOutgoingTransaction(BFCP_SOCKET s, bfcp_message* m);
 
+    /**
+     * sendBFCPmessage on a message whose shared copy may already exist:
+     * '*shared' is created on the first need to keep the message (UDP), and
+     * then reused by the answer cache and the transaction table. The caller
+     * releases it.
+     */
+    int SendShared(BFCP_SOCKET s, bfcp_message* message,
+                   bfcp_shared_message** shared, bool retrans);
+
+    /**
+     * Process a validated message, timed in the metrics: by
+     * ProcessLazyBFCPmessage if it takes it, else parsed by
+     * ProcessBFCPmessage
+     * @return -1 the message could not be parsed, else the return of
+     * ProcessBFCPmessage
+     */
+    int DispatchBFCPmessage(bfcp_message* message, BFCP_SOCKET s,
+                            int transport);
+
+    /**
+     * RunLoop of the BFCP_OVER_MEMORY connections: listen or connect, then
+     * read the channels until disconnect()
+     */
+    void RunChannelLoop();
+
+    /** Read and process the messages queued on a channel end */
+    bool ReadChannel(Client2ServerInfo& c2s, BFCP_SOCKET s, bool* closed);
+
     std::map<UINT16, Transaction> transactionMap;
 
     /**
@@ -592,6 +728,9 @@ class BFCPConnection {
 #endif
 
     BFCP_THREAD_HANDLE m_timer_thread;
+
+    /** Wakes up RunChannelLoop (BFCP_OVER_MEMORY) */
+    BFCP_ChannelSignal* m_channelSignal;
 };
 
 #endif  // BFCP_CONNECTION_H
@@ -0,0 +1,530 @@
+#include "BFCPlog.h"
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#ifdef QN_CROSS_COMPILE
+#include <android/log.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+/* A trace as pushed: the format, followed by the arguments of its conversions
+ * as read from the va_list ('*' widths and precisions as int, integers as 64
+ * bits, doubles, pointers, and the strings inline) */
+typedef struct {
+    const char* file;
+    int line;
+    int level;
+    unsigned char args;      /* Conversions whose argument was captured */
+    unsigned char truncated; /* The format or a string did not fit */
+    char payload[BFCP_LOG_PAYLOAD];
+} bfcp_log_record;
+
+/* Ring of one thread: only the owner moves the head, only the writer thread
+ * moves the tail */
+typedef struct {
+    bfcp_log_record records[BFCP_LOG_RING_SIZE];
+    volatile unsigned long head;
+    unsigned long tail_seen; /* Last tail read by the owner */
+    volatile unsigned long dropped; /* Records lost because the ring was full */
+    char padding[64];
+    volatile unsigned long tail;
+    unsigned long reported; /* Drops already reported to the writer */
+    bool owned;             /* A live thread pushes in this ring (s_mutex) */
+} bfcp_log_ring;
+
+/* A conversion specification: %[flags][width][.precision][length]conversion */
+typedef struct {
+    const char* begin;  /* The '%' */
+    const char* length; /* The length modifier, or the conversion */
+    const char* end;    /* After the conversion */
+    int stars;          /* Width and precision given as arguments */
+    char size;          /* 0, 'H' (hh), 'h', 'l', 'L' (ll, q, L), 'z', 'j', 't' */
+    char conversion;
+} bfcp_log_spec;
+
+enum {
+    BFCP_LOG_ARG_NONE,
+    BFCP_LOG_ARG_SIGNED,
+    BFCP_LOG_ARG_UNSIGNED,
+    BFCP_LOG_ARG_DOUBLE,
+    BFCP_LOG_ARG_POINTER,
+    BFCP_LOG_ARG_STRING,
+    BFCP_LOG_ARG_UNKNOWN
+};
+
+volatile bool BFCP_AsyncLog::s_started = false;
+
+static bfcp_log_ring* s_rings[BFCP_LOG_MAX_RINGS];
+static volatile int s_ring_count = 0;
+static bfcp_mutex_t s_mutex;
+static bool s_mutex_ready = false;
+static BFCP_LogWriter s_writer = NULL;
+static volatile bool s_stop = false;
+static BFCP_THREAD_HANDLE s_thread = BFCP_NULL_THREAD_HANDLE;
+static BFCP_THREAD_LOCAL bfcp_log_ring* s_thread_ring = NULL;
+#ifndef WIN32
+static pthread_key_t s_ring_key; /* Releases the ring when its thread exits */
+#endif
+
+static void WriteStderr(const char* pcFile, int iLine, int iErrorLevel,
+                        const char* pcText) {
+#ifdef QN_CROSS_COMPILE
+    __android_log_print(ANDROID_LOG_VERBOSE, " QnTvmt \tBFCP\t", "%s %d %s\n",
+                        pcFile, iLine, pcText);
+#else
+    fprintf(stderr, "%s:%d | %d | %s\n", pcFile ? pcFile : "", iLine,
+            iErrorLevel, pcText);
+#endif
+}
+
+static bool ParseSpec(const char* p, bfcp_log_spec* spec) {
+    spec->begin = p++;
+    spec->stars = 0;
+    spec->size = 0;
+    while (*p && strchr("-+ #0'", *p)) p++;
+    if (*p == '*') {
+        spec->stars++;
+        p++;
+    } else {
+        while (isdigit((unsigned char)*p)) p++;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->stars++;
+            p++;
+        } else {
+            while (isdigit((unsigned char)*p)) p++;
+        }
+    }
+    spec->length = p;
+    switch (*p) {
+        case 'h':
+        case 'l':
+            spec->size = *p++;
+            if (*p == spec->size) {
+                spec->size = (*p++ == 'h') ? 'H' : 'L';
+            }
+            break;
+        case 'q':
+        case 'L':
+            spec->size = 'L';
+            p++;
+            break;
+        case 'z':
+        case 'j':
+        case 't':
+            spec->size = *p++;
+            break;
+        default:
+            break;
+    }
+    if (*p == 0) return false;
+    spec->conversion = *p++;
+    spec->end = p;
+    return true;
+}
+
+static int ArgKind(const bfcp_log_spec* spec) {
+    switch (spec->conversion) {
+        case '%':
+            return BFCP_LOG_ARG_NONE;
+        case 'd':
+        case 'i':
+            return BFCP_LOG_ARG_SIGNED;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            return BFCP_LOG_ARG_UNSIGNED;
+        case 'c':
+            return spec->size == 0 ? BFCP_LOG_ARG_SIGNED : BFCP_LOG_ARG_UNKNOWN;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            return BFCP_LOG_ARG_DOUBLE;
+        case 'p':
+        case 'n':
+            return BFCP_LOG_ARG_POINTER;
+        case 's':
+            return spec->size == 0 ? BFCP_LOG_ARG_STRING : BFCP_LOG_ARG_UNKNOWN;
+        default:
+            return BFCP_LOG_ARG_UNKNOWN;
+    }
+}
+
+template <typename T>
+static int PrintArg(char* out, size_t size, const char* format, int stars,
+                    const int* star, T value) {
+    switch (stars) {
+        case 0:
+            return snprintf(out, size, format, value);
+        case 1:
+            return snprintf(out, size, format, star[0], value);
+        default:
+            return snprintf(out, size, format, star[0], star[1], value);
+    }
+}
+
+/* Format a record as vsnprintf would have when it was pushed */
+static void FormatRecord(const bfcp_log_record* record, char* text,
+                         size_t size) {
+    const char* p = record->payload;
+    const char* arg = record->payload + strlen(record->payload) + 1;
+    size_t len = 0;
+    int captured = 0;
+    bfcp_log_spec spec;
+    char format[32];
+    int star[2];
+
+    while (*p && len + 1 < size) {
+        size_t prefix;
+        int kind, n = 0;
+
+        if (*p != '%') {
+            text[len++] = *p++;
+            continue;
+        }
+        if (!ParseSpec(p, &spec)) break;
+        kind = ArgKind(&spec);
+        if (kind == BFCP_LOG_ARG_NONE) {
+            text[len++] = '%';
+            p = spec.end;
+            continue;
+        }
+        prefix = spec.length - spec.begin;
+        if (captured >= record->args || prefix + 4 > sizeof(format)) break;
+
+        for (int i = 0; i < spec.stars; i++) {
+            memcpy(&star[i], arg, sizeof(int));
+            arg += sizeof(int);
+        }
+
+        /* The specification without its length modifier: the value was
+         * stored with its own type */
+        memcpy(format, spec.begin, prefix);
+        format[prefix] = 0;
+        switch (kind) {
+            case BFCP_LOG_ARG_SIGNED:
+            case BFCP_LOG_ARG_UNSIGNED: {
+                long long value;
+                memcpy(&value, arg, sizeof(value));
+                arg += sizeof(value);
+                if (spec.conversion == 'c') {
+                    strcat(format, "c");
+                    n = PrintArg(text + len, size - len, format, spec.stars,
+                                 star, (int)value);
+                } else {
+                    strcat(format, "ll");
+                    strncat(format, &spec.conversion, 1);
+                    n = (kind == BFCP_LOG_ARG_SIGNED)
+                            ? PrintArg(text + len, size - len, format,
+                                       spec.stars, star, value)
+                            : PrintArg(text + len, size - len, format,
+                                       spec.stars, star,
+                                       (unsigned long long)value);
+                }
+                break;
+            }
+            case BFCP_LOG_ARG_DOUBLE: {
+                double value;
+                memcpy(&value, arg, sizeof(value));
+                arg += sizeof(value);
+                strncat(format, &spec.conversion, 1);
+                n = PrintArg(text + len, size - len, format, spec.stars, star,
+                             value);
+                break;
+            }
+            case BFCP_LOG_ARG_POINTER: {
+                void* value;
+                memcpy(&value, arg, sizeof(value));
+                arg += sizeof(value);
+                if (spec.conversion == 'p') {
+                    strcat(format, "p");
+                    n = PrintArg(text + len, size - len, format, spec.stars,
+                                 star, value);
+                }
+                break;
+            }
+            case BFCP_LOG_ARG_STRING:
+                strcat(format, "s");
+                n = PrintArg(text + len, size - len, format, spec.stars, star,
+                             arg);
+                arg += strlen(arg) + 1;
+                break;
+        }
+        if (n > 0) len += ((size_t)n < size - len) ? (size_t)n : size - len - 1;
+        captured++;
+        p = spec.end;
+    }
+
+    if ((*p || record->truncated) && len + 4 < size) {
+        memcpy(text + len, "...", 3);
+        len += 3;
+    }
+    text[len] = 0;
+}
+
+#ifndef WIN32
+static void ReleaseRing(void* p) {
+    bfcp_mutex_lock(s_mutex);
+    ((bfcp_log_ring*)p)->owned = false;
+    bfcp_mutex_unlock(s_mutex);
+}
+#endif
+
+/* Ring of the calling thread: the ring of a thread that exited, or a new one */
+static bfcp_log_ring* ThreadRing() {
+    bfcp_log_ring* ring = s_thread_ring;
+
+    if (ring) return ring;
+
+    bfcp_mutex_lock(s_mutex);
+    for (int i = 0; i < s_ring_count && !ring; i++)
+        if (!s_rings[i]->owned) ring = s_rings[i];
+    if (!ring && s_ring_count < BFCP_LOG_MAX_RINGS) {
+        ring = (bfcp_log_ring*)calloc(1, sizeof(bfcp_log_ring));
+        if (ring) {
+            s_rings[s_ring_count] = ring;
+            BFCP_MEMORY_BARRIER();
+            s_ring_count++;
+        }
+    }
+    if (ring) ring->owned = true;
+    bfcp_mutex_unlock(s_mutex);
+
+#ifndef WIN32
+    if (ring) pthread_setspecific(s_ring_key, ring);
+#endif
+    s_thread_ring = ring;
+    return ring;
+}
+
+/* Write the records pushed so far: false if there were none */
+static bool Drain() {
+    bool busy = false;
+    int count = s_ring_count;
+    char text[BFCP_STRING_SIZE];
+
+    BFCP_MEMORY_BARRIER();
+    for (int i = 0; i < count; i++) {
+        bfcp_log_ring* ring = s_rings[i];
+        unsigned long head = ring->head;
+        unsigned long dropped;
+
+        BFCP_MEMORY_BARRIER();
+        while (ring->tail != head) {
+            const bfcp_log_record* record =
+                &ring->records[ring->tail & (BFCP_LOG_RING_SIZE - 1)];
+            FormatRecord(record, text, sizeof(text));
+            s_writer(record->file, record->line, record->level, text);
+            BFCP_MEMORY_BARRIER();
+            ring->tail++;
+            busy = true;
+        }
+
+        dropped = ring->dropped;
+        if (dropped != ring->reported) {
+            snprintf(text, sizeof(text),
+                     "%lu traces dropped: the log ring of a thread was full",
+                     dropped - ring->reported);
+            s_writer(__FILE__, __LINE__, 1, text);
+            ring->reported = dropped;
+        }
+    }
+    return busy;
+}
+
+#ifdef WIN32
+static unsigned __stdcall WriterThread(void*)
+#else
+static void* WriterThread(void*)
+#endif
+{
+    while (!s_stop) {
+        if (!Drain()) BFCP_SLEEP(1);
+    }
+    Drain();
+    return 0;
+}
+
+bool BFCP_AsyncLog::Start(BFCP_LogWriter p_writer) {
+    if (s_started) return true;
+
+    if (!s_mutex_ready) {
+        bfcp_mutex_init(s_mutex, NULL);
+#ifndef WIN32
+        if (pthread_key_create(&s_ring_key, ReleaseRing) != 0) return false;
+#endif
+        s_mutex_ready = true;
+    }
+    s_writer = p_writer ? p_writer : WriteStderr;
+    s_stop = false;
+    BFCP_THREAD_START(s_thread, WriterThread, NULL);
+    if (s_thread == BFCP_NULL_THREAD_HANDLE) return false;
+    s_started = true;
+    return true;
+}
+
+void BFCP_AsyncLog::Stop() {
+    if (!s_started) return;
+
+    s_started = false;
+    s_stop = true;
+#ifdef WIN32
+    WaitForSingleObject(s_thread, INFINITE);
+    CloseHandle(s_thread);
+#else
+    pthread_join(s_thread, NULL);
+#endif
+    s_thread = BFCP_NULL_THREAD_HANDLE;
+}
+
+bool BFCP_AsyncLog::Push(const char* pcFile, int iLine, int iErrorLevel,
+                         const char* pcFormat, va_list args) {
+    bfcp_log_ring* ring;
+    bfcp_log_record* record;
+    bfcp_log_spec spec;
+    unsigned long head;
+    size_t length, used;
+
+    if (!s_started || pcFormat == NULL) return false;
+    ring = ThreadRing();
+    if (ring == NULL) return false;
+
+    /* Read the tail of the writer thread only when the ring looks full */
+    head = ring->head;
+    if (head - ring->tail_seen >= BFCP_LOG_RING_SIZE) {
+        ring->tail_seen = ring->tail;
+        if (head - ring->tail_seen >= BFCP_LOG_RING_SIZE) {
+            ring->dropped++;
+            return true;
+        }
+    }
+
+    record = &ring->records[head & (BFCP_LOG_RING_SIZE - 1)];
+    record->file = pcFile;
+    record->line = iLine;
+    record->level = iErrorLevel;
+    record->args = 0;
+    record->truncated = 0;
+
+    length = strlen(pcFormat);
+    if (length >= BFCP_LOG_PAYLOAD) {
+        length = BFCP_LOG_PAYLOAD - 1;
+        record->truncated = 1;
+    }
+    memcpy(record->payload, pcFormat, length);
+    record->payload[length] = 0;
+    used = length + 1;
+
+    /* Read the arguments as the copied format tells, up to the first one that
+     * does not fit */
+    for (const char* p = strchr(record->payload, '%');
+         p != NULL && !record->truncated; p = strchr(p, '%')) {
+        char* out = record->payload + used;
+        int kind;
+
+        if (!ParseSpec(p, &spec)) break;
+        p = spec.end;
+        kind = ArgKind(&spec);
+        if (kind == BFCP_LOG_ARG_NONE) continue;
+        if (kind == BFCP_LOG_ARG_UNKNOWN) break;
+        if (used + spec.stars * sizeof(int) + sizeof(long long) >
+            BFCP_LOG_PAYLOAD) {
+            record->truncated = 1;
+            break;
+        }
+
+        for (int i = 0; i < spec.stars; i++) {
+            int star = va_arg(args, int);
+            memcpy(out, &star, sizeof(star));
+            out += sizeof(star);
+        }
+
+        switch (kind) {
+            case BFCP_LOG_ARG_SIGNED: {
+                long long value;
+                switch (spec.size) {
+                    case 'l': value = va_arg(args, long); break;
+                    case 'L':
+                    case 'j': value = va_arg(args, long long); break;
+                    case 'z': value = (long long)va_arg(args, size_t); break;
+                    case 't': value = va_arg(args, ptrdiff_t); break;
+                    case 'h': value = (short)va_arg(args, int); break;
+                    case 'H': value = (signed char)va_arg(args, int); break;
+                    default: value = va_arg(args, int); break;
+                }
+                memcpy(out, &value, sizeof(value));
+                out += sizeof(value);
+                break;
+            }
+            case BFCP_LOG_ARG_UNSIGNED: {
+                unsigned long long value;
+                switch (spec.size) {
+                    case 'l': value = va_arg(args, unsigned long); break;
+                    case 'L':
+                    case 'j': value = va_arg(args, unsigned long long); break;
+                    case 'z': value = va_arg(args, size_t); break;
+                    case 't': value = (unsigned long long)va_arg(args, ptrdiff_t); break;
+                    case 'h': value = (unsigned short)va_arg(args, unsigned int); break;
+                    case 'H': value = (unsigned char)va_arg(args, unsigned int); break;
+                    default: value = va_arg(args, unsigned int); break;
+                }
+                memcpy(out, &value, sizeof(value));
+                out += sizeof(value);
+                break;
+            }
+            case BFCP_LOG_ARG_DOUBLE: {
+                double value = (spec.size == 'L')
+                                   ? (double)va_arg(args, long double)
+                                   : va_arg(args, double);
+                memcpy(out, &value, sizeof(value));
+                out += sizeof(value);
+                break;
+            }
+            case BFCP_LOG_ARG_POINTER: {
+                void* value = va_arg(args, void*);
+                memcpy(out, &value, sizeof(value));
+                out += sizeof(value);
+                break;
+            }
+            case BFCP_LOG_ARG_STRING: {
+                const char* value = va_arg(args, const char*);
+                size_t room = record->payload + BFCP_LOG_PAYLOAD - out - 1;
+                if (value == NULL) value = "(null)";
+                length = strlen(value);
+                if (length > room) {
+                    length = room;
+                    record->truncated = 1;
+                }
+                memcpy(out, value, length);
+                out[length] = 0;
+                out += length + 1;
+                break;
+            }
+        }
+        used = out - record->payload;
+        record->args++;
+    }
+
+    BFCP_MEMORY_BARRIER();
+    ring->head = head + 1;
+    return true;
+}
@@ -0,0 +1,77 @@
+/**
+ *
+ * \brief Asynchronous log backend
+ *
+ * Takes the formatting and the writing of the traces off the network and
+ * floor control threads: Push() copies the format and its arguments in a
+ * ring owned by the calling thread (one producer, no lock, no allocation once
+ * the ring exists), and a background thread formats the records and hands
+ * them to the writer (stderr by default).
+ *
+ * BFCP_Server and BFCP_Participant push their traces here when they have no
+ * event listener and the backend is started. Applications which receive the
+ * traces in their ServerEvent/ParticipantEvent Log callback can push the
+ * va_list they get as well.
+ *
+ * \file BFCPlog.h
+ *
+ * \remarks :
+ * The file name must outlive the record (use the INF, WAR and ERR macros);
+ * the format and the %s arguments are copied, truncated to fit a record.
+ * Records of one thread are written in order, records of different threads
+ * are interleaved as they are collected. When a ring is full the record is
+ * dropped and counted, and the writer is told how many were lost.
+ */
+#ifndef BFCP_LOG_H
+#define BFCP_LOG_H
+
+#include <stdarg.h>
+
+#include "./bfcpmsg/bfcp_messages.h"
+#include "bfcp_threads.h"
+
+#define BFCP_LOG_RING_SIZE 256 /** @brief Records per thread (power of two) */
+#define BFCP_LOG_PAYLOAD 224   /** @brief Octets of a record for the format and its arguments */
+#define BFCP_LOG_MAX_RINGS 64  /** @brief Threads that can push at the same time */
+
+/** \brief Writes a formatted trace, on the background thread */
+typedef void (*BFCP_LogWriter)(const char* pcFile, int iLine, int iErrorLevel,
+                               const char* pcText);
+
+/**
+ *
+ * @class BFCP_AsyncLog
+ * @brief Per-thread rings of unformatted traces and their writer thread
+ *
+ */
+class BFCP_AsyncLog {
+   public:
+    /**
+     * Start the writer thread, before the connections that log are opened.
+     * @param p_writer writer of the formatted traces, NULL for stderr
+     * @return true success (or already started), false failed
+     */
+    static bool Start(BFCP_LogWriter p_writer = NULL);
+
+    /**
+     * Write the records pushed so far and stop the writer thread. Traces
+     * pushed afterwards are refused.
+     */
+    static void Stop();
+
+    static bool IsStarted() { return s_started; }
+
+    /**
+     * Queue a trace for the writer thread.
+     * @return true the trace is queued (or dropped because the ring of the
+     * thread is full), false the backend is not started or has no ring left
+     * for this thread: 'args' was not read, write the trace synchronously.
+     */
+    static bool Push(const char* pcFile, int iLine, int iErrorLevel,
+                     const char* pcFormat, va_list args);
+
+   private:
+    static volatile bool s_started;
+};
+
+#endif  // BFCP_LOG_H
@@ -0,0 +1,159 @@
+#include "BFCPmetrics.h"
+
+#include <string.h>
+
+#ifndef WIN32
+#include <time.h>
+#endif
+
+/* Shard of each thread, given round robin on its first record */
+static BFCP_THREAD_LOCAL int s_thread_shard = -1;
+static UINT64 s_next_shard = 0;
+
+static inline int PrimitiveIndex(e_bfcp_primitives primitive) {
+    return (primitive > e_primitive_InvalidPrimitive &&
+            primitive < BFCP_METRICS_PRIMITIVES)
+               ? (int)primitive
+               : 0;
+}
+
+static inline void Sum(UINT64* total, const volatile UINT64* shard,
+                       int count) {
+    for (int i = 0; i < count; i++) total[i] += shard[i];
+}
+
+static void SumHistogram(st_bfcp_histogram* total,
+                         const volatile st_bfcp_histogram* shard) {
+    total->count += shard->count;
+    total->sum_us += shard->sum_us;
+    Sum(total->buckets, shard->buckets, BFCP_HISTOGRAM_BUCKETS);
+}
+
+int bfcp_histogram_bucket(UINT64 us) {
+    int power = 0;
+    int bucket;
+
+    if (us < BFCP_HISTOGRAM_LINEAR) return (int)us;
+
+    /* Keep the 4 most significant bits: 1xxx, the last 3 give the sub bucket */
+    while (us >= 2 * BFCP_HISTOGRAM_SUB_BUCKETS) {
+        us >>= 1;
+        power++;
+    }
+    bucket = BFCP_HISTOGRAM_LINEAR + (power - 1) * BFCP_HISTOGRAM_SUB_BUCKETS +
+             (int)(us - BFCP_HISTOGRAM_SUB_BUCKETS);
+    return bucket < BFCP_HISTOGRAM_BUCKETS ? bucket
+                                           : BFCP_HISTOGRAM_BUCKETS - 1;
+}
+
+UINT64 bfcp_histogram_bucket_floor(int bucket) {
+    int power;
+
+    if (bucket < BFCP_HISTOGRAM_LINEAR) return bucket < 0 ? 0 : bucket;
+    bucket -= BFCP_HISTOGRAM_LINEAR;
+    power = bucket / BFCP_HISTOGRAM_SUB_BUCKETS + 1;
+    return (UINT64)(BFCP_HISTOGRAM_SUB_BUCKETS +
+                    bucket % BFCP_HISTOGRAM_SUB_BUCKETS)
+           << power;
+}
+
+UINT64 bfcp_histogram_percentile(const st_bfcp_histogram* histogram,
+                                 double percentile) {
+    UINT64 rank, seen = 0;
+
+    if (histogram == NULL || histogram->count == 0) return 0;
+    rank = (UINT64)(histogram->count * percentile / 100.0 + 0.5);
+    if (rank == 0) rank = 1;
+
+    for (int i = 0; i < BFCP_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank)
+            return i + 1 < BFCP_HISTOGRAM_BUCKETS
+                       ? bfcp_histogram_bucket_floor(i + 1) - 1
+                       : bfcp_histogram_bucket_floor(i);
+    }
+    return bfcp_histogram_bucket_floor(BFCP_HISTOGRAM_BUCKETS - 1);
+}
+
+BFCP_Metrics::BFCP_Metrics() { memset(m_shards, 0, sizeof(m_shards)); }
+
+UINT64 BFCP_Metrics::Now() {
+#ifdef WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER now;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (UINT64)(now.QuadPart / frequency.QuadPart * 1000000 +
+                    now.QuadPart % frequency.QuadPart * 1000000 /
+                        frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (UINT64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+st_bfcp_metrics* BFCP_Metrics::Shard() {
+    if (s_thread_shard < 0)
+        s_thread_shard =
+            (int)(BFCP_ATOMIC_ADD64(&s_next_shard, 1) % BFCP_METRICS_SHARDS);
+    return &m_shards[s_thread_shard].metrics;
+}
+
+void BFCP_Metrics::Received(e_bfcp_primitives primitive, UINT32 length) {
+    st_bfcp_metrics* shard = Shard();
+    BFCP_ATOMIC_ADD64(&shard->received[PrimitiveIndex(primitive)], 1);
+    BFCP_ATOMIC_ADD64(&shard->bytes_received, length);
+}
+
+void BFCP_Metrics::Sent(e_bfcp_primitives primitive, UINT32 length) {
+    st_bfcp_metrics* shard = Shard();
+    BFCP_ATOMIC_ADD64(&shard->sent[PrimitiveIndex(primitive)], 1);
+    BFCP_ATOMIC_ADD64(&shard->bytes_sent, length);
+}
+
+void BFCP_Metrics::ParseError(e_bfcp_error_codes code) {
+    int index = (code >= 0 && code < BFCP_METRICS_ERRORS) ? (int)code : 0;
+    BFCP_ATOMIC_ADD64(&Shard()->parse_errors[index], 1);
+}
+
+void BFCP_Metrics::Duration(st_bfcp_histogram st_bfcp_metrics::*histogram,
+                            UINT64 start, UINT64 end) {
+    UINT64 now = end ? end : Now();
+    UINT64 elapsed = now > start ? now - start : 0;
+    st_bfcp_histogram* shard = &(Shard()->*histogram);
+
+    BFCP_ATOMIC_ADD64(&shard->count, 1);
+    BFCP_ATOMIC_ADD64(&shard->sum_us, elapsed);
+    BFCP_ATOMIC_ADD64(&shard->buckets[bfcp_histogram_bucket(elapsed)], 1);
+}
+
+void BFCP_Metrics::Snapshot(st_bfcp_metrics* p_metrics) const {
+    if (p_metrics == NULL) return;
+    memset(p_metrics, 0, sizeof(*p_metrics));
+
+    for (int i = 0; i < BFCP_METRICS_SHARDS; i++) {
+        const volatile st_bfcp_metrics* shard = &m_shards[i].metrics;
+
+        Sum(p_metrics->received, shard->received, BFCP_METRICS_PRIMITIVES);
+        Sum(p_metrics->sent, shard->sent, BFCP_METRICS_PRIMITIVES);
+        Sum(p_metrics->parse_errors, shard->parse_errors, BFCP_METRICS_ERRORS);
+        p_metrics->bytes_received += shard->bytes_received;
+        p_metrics->bytes_sent += shard->bytes_sent;
+        p_metrics->send_errors += shard->send_errors;
+        p_metrics->retransmissions += shard->retransmissions;
+        p_metrics->t1_expired += shard->t1_expired;
+        p_metrics->connections_opened += shard->connections_opened;
+        p_metrics->connections_closed += shard->connections_closed;
+        SumHistogram(&p_metrics->process_us, &shard->process_us);
+        SumHistogram(&p_metrics->send_us, &shard->send_us);
+        SumHistogram(&p_metrics->callback_us, &shard->callback_us);
+        SumHistogram(&p_metrics->request_pending_us, &shard->request_pending_us);
+        SumHistogram(&p_metrics->request_notify_us, &shard->request_notify_us);
+        SumHistogram(&p_metrics->request_decision_us,
+                     &shard->request_decision_us);
+        SumHistogram(&p_metrics->request_grant_us, &shard->request_grant_us);
+        SumHistogram(&p_metrics->request_total_us, &shard->request_total_us);
+        SumHistogram(&p_metrics->request_status_us, &shard->request_status_us);
+    }
+}
@@ -0,0 +1,137 @@
+/**
+ *
+ * \brief BFCP connection metrics
+ *
+ * Counters and latency histograms recorded by the network and floor control
+ * threads of a connection, without taking any lock: each thread adds to one of
+ * a few cache line aligned shards with atomic additions, and a snapshot sums
+ * the shards. Monitoring can thus read them as often as it likes without
+ * slowing the messages down.
+ *
+ * Histograms count durations in microseconds in log-linear buckets: one bucket
+ * per microsecond below BFCP_HISTOGRAM_LINEAR, then BFCP_HISTOGRAM_SUB_BUCKETS
+ * buckets per power of two (12.5% precision), up to about two minutes.
+ *
+ * \file BFCPmetrics.h
+ *
+ * \remarks :
+ * A snapshot is not a consistent cut: counters recorded while it is summed may
+ * or may not be included.
+ */
+#ifndef BFCP_METRICS_H
+#define BFCP_METRICS_H
+
+#include "./bfcpmsg/bfcp_messages.h"
+#include "bfcp_threads.h"
+
+#define BFCP_METRICS_PRIMITIVES \
+    (e_primitive_GoodbyeAck + 1) /** @brief Primitives counted (0 for the unknown ones) */
+#define BFCP_METRICS_ERRORS \
+    (BFCP_PARSING_ERROR + 1) /** @brief Error codes counted, see e_bfcp_error_codes */
+#define BFCP_METRICS_SHARDS 4 /** @brief Number of per-thread shards */
+
+#define BFCP_HISTOGRAM_LINEAR 16    /** @brief Durations counted one microsecond per bucket */
+#define BFCP_HISTOGRAM_SUB_BUCKETS 8 /** @brief Buckets per power of two above */
+#define BFCP_HISTOGRAM_MAX_POWER 27 /** @brief Power of two starting the last group of buckets, which ends at 2^28 us (longer durations go in the last bucket) */
+#define BFCP_HISTOGRAM_BUCKETS                                 \
+    (BFCP_HISTOGRAM_LINEAR + (BFCP_HISTOGRAM_MAX_POWER - 3) * \
+                                 BFCP_HISTOGRAM_SUB_BUCKETS)
+
+/**  \struct  st_bfcp_histogram
+ * \brief Distribution of durations in microseconds
+ */
+typedef struct {
+    UINT64 count;  /**  \brief  Number of durations recorded */
+    UINT64 sum_us; /**  \brief  Sum of the durations, for the mean */
+    UINT64 buckets[BFCP_HISTOGRAM_BUCKETS]; /**  \brief  See bfcp_histogram_bucket */
+} st_bfcp_histogram;
+
+/**  \struct  st_bfcp_metrics
+ * \brief Metrics of a connection since it was created
+ */
+typedef struct {
+    UINT64 received[BFCP_METRICS_PRIMITIVES]; /**  \brief  Messages parsed, per primitive */
+    UINT64 sent[BFCP_METRICS_PRIMITIVES];     /**  \brief  Messages sent (retransmissions included), per primitive */
+    UINT64 parse_errors[BFCP_METRICS_ERRORS]; /**  \brief  Errors in the messages received, per error code */
+    UINT64 bytes_received;     /**  \brief  Octets of the messages parsed */
+    UINT64 bytes_sent;         /**  \brief  Octets of the messages sent */
+    UINT64 send_errors;        /**  \brief  Messages that could not be sent */
+    UINT64 retransmissions;    /**  \brief  Requests sent again on an unreliable transport */
+    UINT64 t1_expired;         /**  \brief  Requests never answered on an unreliable transport */
+    UINT64 connections_opened; /**  \brief  Connections accepted or established */
+    UINT64 connections_closed; /**  \brief  Connections lost or closed */
+    st_bfcp_histogram process_us;  /**  \brief  Processing of a received message */
+    st_bfcp_histogram send_us;     /**  \brief  Sending of a message */
+    st_bfcp_histogram callback_us; /**  \brief  Application callbacks */
+    st_bfcp_histogram request_pending_us;  /**  \brief  FloorRequest read to Pending list (floor control server only) */
+    st_bfcp_histogram request_notify_us;   /**  \brief  Pending list to application (chair) notified (floor control server only) */
+    st_bfcp_histogram request_decision_us; /**  \brief  Application notified to its first FloorRequestRespons (floor control server only) */
+    st_bfcp_histogram request_grant_us;    /**  \brief  First FloorRequestRespons to Granted (floor control server only) */
+    st_bfcp_histogram request_total_us;    /**  \brief  FloorRequest read to Granted (floor control server only) */
+    st_bfcp_histogram request_status_us;   /**  \brief  FloorRequest read to each FloorRequestStatus sent (floor control server only) */
+    UINT16 pending_count;  /**  \brief  Requests in the Pending list (floor control server only) */
+    UINT16 accepted_count; /**  \brief  Requests in the Accepted list (floor control server only) */
+    UINT16 granted_count;  /**  \brief  Requests in the Granted list (floor control server only) */
+} st_bfcp_metrics;
+
+/** \brief Bucket of a duration in microseconds */
+int bfcp_histogram_bucket(UINT64 us);
+/** \brief Smallest duration counted in a bucket */
+UINT64 bfcp_histogram_bucket_floor(int bucket);
+/** \brief Duration under which 'percentile' % of the durations were recorded (upper bound of its bucket) */
+UINT64 bfcp_histogram_percentile(const st_bfcp_histogram* histogram,
+                                 double percentile);
+
+/**
+ *
+ * @class BFCP_Metrics
+ * @brief Lock-free metrics registry of a connection
+ *
+ */
+class BFCP_Metrics {
+   public:
+    BFCP_Metrics();
+
+    /** Current time in microseconds, on a monotonic clock */
+    static UINT64 Now();
+
+    void Received(e_bfcp_primitives primitive, UINT32 length);
+    void Sent(e_bfcp_primitives primitive, UINT32 length);
+    void ParseError(e_bfcp_error_codes code);
+    void SendError() { Add(&st_bfcp_metrics::send_errors); }
+    void Retransmission() { Add(&st_bfcp_metrics::retransmissions); }
+    void T1Expired() { Add(&st_bfcp_metrics::t1_expired); }
+    void ConnectionOpened() { Add(&st_bfcp_metrics::connections_opened); }
+    void ConnectionClosed(UINT64 count = 1) {
+        Add(&st_bfcp_metrics::connections_closed, count);
+    }
+
+    /**
+     * Record the time elapsed from 'start' to 'end' (see Now, 0: now) in a
+     * histogram, e.g. Duration(&st_bfcp_metrics::process_us, start)
+     */
+    void Duration(st_bfcp_histogram st_bfcp_metrics::*histogram,
+                  UINT64 start, UINT64 end = 0);
+
+    /** Sum the shards in 'p_metrics' (queue depths are left to 0) */
+    void Snapshot(st_bfcp_metrics* p_metrics) const;
+
+   private:
+    BFCP_Metrics(const BFCP_Metrics&);
+    BFCP_Metrics& operator=(const BFCP_Metrics&);
+
+    /** Shard of the calling thread */
+    st_bfcp_metrics* Shard();
+    void Add(UINT64 st_bfcp_metrics::*counter, UINT64 value = 1) {
+        BFCP_ATOMIC_ADD64(&(Shard()->*counter), value);
+    }
+
+    /* Padded so that two shards never share a cache line */
+    struct Slot {
+        st_bfcp_metrics metrics;
+        char padding[64];
+    };
+    Slot m_shards[BFCP_METRICS_SHARDS];
+};
+
+#endif  // BFCP_METRICS_H
@@ -0,0 +1,454 @@
+/**
+ *
+ * \brief Microbenchmark of the BFCP codec
+ *
+ * Measures bfcp_build_message and bfcp_parse_message for every primitive of
+ * e_bfcp_primitives, plus nested FloorRequestStatus/FloorStatus/UserStatus
+ * payloads as the server sends them. For each case it reports the time, the
+ * number of allocations and the bytes allocated per operation; allocations
+ * are counted by linking with -Wl,--wrap on the allocator (see the Makefile).
+ * A case whose operations don't free all they allocate fails.
+ *
+ * Before measuring, every entry of the attribute schema table is encoded at
+ * its bounds and parsed back: the bench fails if the builder and the parser
+ * disagree with the table.
+ *
+ * Usage: codec_bench [-t milliseconds per case] [-f case name filter]
+ *
+ * \file codec_bench.c
+ *
+ * \remarks :
+ */
+
+/* ==========================================================================*/
+/* include(s)                                                                */
+/* ==========================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bfcp_messages.h"
+#include "bfcp_strings.h"
+
+/* ==========================================================================*/
+/* Allocation accounting                                                     */
+/* ==========================================================================*/
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+void __wrap_free(void *ptr);
+
+static unsigned long bench_allocs = 0;
+static unsigned long bench_bytes = 0;
+static long bench_live = 0;	/* Blocks allocated and not freed */
+
+void *__wrap_malloc(size_t size)
+{
+	void *ptr = __real_malloc(size);
+	bench_allocs++;
+	bench_bytes += size;
+	if(ptr)
+		bench_live++;
+	return ptr;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	void *ptr = __real_calloc(nmemb, size);
+	bench_allocs++;
+	bench_bytes += nmemb*size;
+	if(ptr)
+		bench_live++;
+	return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	void *moved = __real_realloc(ptr, size);
+	bench_allocs++;
+	bench_bytes += size;
+	if(!ptr && moved)
+		bench_live++;
+	return moved;
+}
+
+void __wrap_free(void *ptr)
+{
+	if(ptr)
+		bench_live--;
+	__real_free(ptr);
+}
+
+/* ==========================================================================*/
+/* Payloads                                                                  */
+/* ==========================================================================*/
+
+#define BENCH_CONFERENCE	0x12345678
+#define BENCH_USER		1
+#define BENCH_CHAIR		2
+
+typedef struct bench_case {
+	const char *name;
+	bfcp_arguments *arguments;
+	bfcp_message *message;	/* Built once, the input of the parse measure */
+} bench_case;
+
+static char *bench_strdup(const char *text)
+{
+	char *copy = (char *)calloc(strlen(text)+1, sizeof(char));
+	if(copy)
+		strcpy(copy, text);
+	return copy;
+}
+
+static bfcp_arguments *bench_arguments(e_bfcp_primitives primitive)
+{
+	bfcp_arguments *arguments = bfcp_new_arguments();
+	if(!arguments)
+		return NULL;
+	arguments->primitive = primitive;
+	arguments->entity = bfcp_new_entity(BENCH_CONFERENCE, 4242, BENCH_USER);
+	return arguments;
+}
+
+/* A Floor Request Information as the server sends it: an overall status, one
+   status per floor, the beneficiary and the chair that granted it */
+static bfcp_floor_request_information *bench_floor_request_information(UINT16 frqID, int floors, int detailed)
+{
+	bfcp_floor_request_status *fRS = NULL;
+	bfcp_overall_request_status *oRS;
+	bfcp_user_information *beneficiary = NULL, *requested_by = NULL;
+	int i;
+
+	oRS = bfcp_new_overall_request_status(frqID, BFCP_GRANTED, 0, detailed ? "Granted by the chair" : NULL);
+	for(i = 0; i < floors; i++) {
+		bfcp_floor_request_status *floor = bfcp_new_floor_request_status((UINT16)(i+1), BFCP_GRANTED, 0, detailed ? "Floor in use" : NULL);
+		if(fRS == NULL)
+			fRS = floor;
+		else
+			bfcp_add_floor_request_status_list(fRS, floor, NULL);
+	}
+	if(detailed) {
+		beneficiary = bfcp_new_user_information(BENCH_USER, "Conference Room A", "sip:room-a@example.com");
+		requested_by = bfcp_new_user_information(BENCH_CHAIR, "Chair", "sip:chair@example.com");
+	}
+	return bfcp_new_floor_request_information(frqID, oRS, fRS, beneficiary, requested_by, BFCP_NORMAL_PRIORITY,
+		detailed ? "Presentation of the quarterly results" : NULL);
+}
+
+static bfcp_arguments *bench_primitive_arguments(e_bfcp_primitives primitive)
+{
+	bfcp_arguments *arguments = bench_arguments(primitive);
+	if(!arguments)
+		return NULL;
+	switch(primitive) {
+		case e_primitive_FloorRequest:
+			arguments->fID = bfcp_new_floor_id_list(1, 0);
+			arguments->bID = BENCH_USER;
+			arguments->pInfo = bench_strdup("Share my screen");
+			arguments->priority = BFCP_NORMAL_PRIORITY;
+			break;
+		case e_primitive_FloorRelease:
+		case e_primitive_FloorRequestQuery:
+			arguments->frqID = 7;
+			break;
+		case e_primitive_FloorRequestStatus:
+		case e_primitive_ChairAction:
+			arguments->frqInfo = bench_floor_request_information(7, 1, 0);
+			break;
+		case e_primitive_UserQuery:
+			arguments->bID = BENCH_USER;
+			break;
+		case e_primitive_UserStatus:
+			arguments->beneficiary = bfcp_new_user_information(BENCH_USER, "Conference Room A", NULL);
+			arguments->frqInfo = bench_floor_request_information(7, 1, 0);
+			break;
+		case e_primitive_FloorQuery:
+			arguments->fID = bfcp_new_floor_id_list(1, 0);
+			break;
+		case e_primitive_FloorStatus:
+			arguments->fID = bfcp_new_floor_id_list(1, 0);
+			arguments->frqInfo = bench_floor_request_information(7, 1, 0);
+			break;
+		case e_primitive_HelloAck:
+			arguments->primitives = bfcp_new_supported_list(e_primitive_FloorRequest, e_primitive_FloorRelease,
+				e_primitive_FloorRequestStatus, e_primitive_FloorStatus, e_primitive_Hello, e_primitive_HelloAck,
+				e_primitive_Error, e_primitive_Goodbye, e_primitive_GoodbyeAck, 0);
+			arguments->attributes = bfcp_new_supported_list(BENEFICIARY_ID, FLOOR_ID, FLOOR_REQUEST_ID, PRIORITY,
+				REQUEST_STATUS, ERROR_CODE, ERROR_INFO, PARTICIPANT_PROVIDED_INFO, STATUS_INFO,
+				SUPPORTED_ATTRIBUTES, SUPPORTED_PRIMITIVES, FLOOR_REQUEST_INFORMATION, FLOOR_REQUEST_STATUS,
+				OVERALL_REQUEST_STATUS, 0);
+			break;
+		case e_primitive_Error:
+			arguments->error = bfcp_new_error(BFCP_INVALID_FLOORID, NULL);
+			arguments->eInfo = bench_strdup("Floor 9 does not exist");
+			break;
+		default:	/* Acks, Hello and Goodbye only have the Common Header */
+			break;
+	}
+	return arguments;
+}
+
+/* The nested payloads: several requests on several floors, with all their optional attributes (each
+   FLOOR-REQUEST-INFORMATION must fit in the 255 octets of an attribute Length, i.e. 3 floors at most) */
+static bfcp_arguments *bench_nested_arguments(e_bfcp_primitives primitive, int requests, int floors)
+{
+	bfcp_arguments *arguments = bench_arguments(primitive);
+	int i;
+
+	if(!arguments)
+		return NULL;
+	for(i = 0; i < requests; i++) {
+		bfcp_floor_request_information *frqInfo = bench_floor_request_information((UINT16)(i+1), floors, 1);
+		if(arguments->frqInfo == NULL)
+			arguments->frqInfo = frqInfo;
+		else
+			bfcp_add_floor_request_information_list(arguments->frqInfo, frqInfo, NULL);
+	}
+	if(primitive == e_primitive_FloorStatus)
+		arguments->fID = bfcp_new_floor_id_list(1, 0);
+	else if(primitive == e_primitive_UserStatus)
+		arguments->beneficiary = bfcp_new_user_information(BENCH_USER, "Conference Room A", "sip:room-a@example.com");
+	return arguments;
+}
+
+/* ==========================================================================*/
+/* Schema round trip                                                         */
+/* ==========================================================================*/
+
+/* Octets valid in every OctetString: an error code, a primitive, an attribute (type << 1) or text */
+static UINT8 bench_octets[255];
+#define BENCH_OCTET	2
+
+/* A grouped attribute that may contain 'type', preferably directly in a primitive */
+static UINT32 bench_schema_parent(UINT32 type)
+{
+	UINT32 parent, found = 0;
+	for(parent = 1; parent <= BFCP_LAST_ATTRIBUTE; parent++) {
+		const bfcp_attribute_schema *schema = bfcp_get_attribute_schema(parent);
+		if(!schema || (schema->kind != e_bfcp_kind_grouped) || !(schema->children & ((UINT32)1 << type)))
+			continue;
+		if(schema->top_level)
+			return parent;
+		if(!found)
+			found = parent;
+	}
+	return found;
+}
+
+/* Encode 'type' with all the children its schema allows: OctetStrings have their minimum length, except 'target' which has 'length' */
+static void bench_schema_encode(bfcp_encoder *encoder, UINT32 type, UINT32 target, UINT32 length)
+{
+	const bfcp_attribute_schema *schema = bfcp_get_attribute_schema(type);
+	UINT32 child, offset;
+
+	switch(schema->kind) {
+		case e_bfcp_kind_u16:
+			bfcp_encode_attribute_u16(encoder, (e_bfcp_attibutes)type, 0x0101);
+			break;
+		case e_bfcp_kind_octets:
+			bfcp_encode_attribute_list(encoder, (e_bfcp_attibutes)type, bench_octets,
+				(UINT16)(((type == target) ? length : schema->min_length)-2));
+			break;
+		case e_bfcp_kind_grouped:
+			offset = bfcp_encode_group_begin(encoder, (e_bfcp_attibutes)type, 1);
+			for(child = 1; child <= BFCP_LAST_ATTRIBUTE; child++) {
+				if(schema->children & ((UINT32)1 << child))
+					bench_schema_encode(encoder, child, target, length);
+			}
+			bfcp_encode_group_end(encoder, offset);
+			break;
+	}
+}
+
+/* Encode a message holding 'type' (in its parents if it can't be in a primitive) and parse it back */
+static int bench_schema_round_trip(UINT32 type, UINT32 length)
+{
+	unsigned char buffer[1024];
+	bfcp_encoder encoder;
+	bfcp_message message;
+	bfcp_received_message *received;
+	bfcp_received_attribute *attribute;
+	UINT32 top = type;
+	int encoded, ok;
+
+	while(top && !bfcp_get_attribute_schema(top)->top_level)
+		top = bench_schema_parent(top);
+	if(!top)
+		return -1;
+	bfcp_encode_begin(&encoder, buffer, sizeof(buffer), e_primitive_FloorRequestStatus, BENCH_CONFERENCE, 4242, BENCH_USER, 0);
+	bench_schema_encode(&encoder, top, type, length);
+	encoded = bfcp_encode_end(&encoder);
+	if((encoded < 0) || (encoded > (int)sizeof(buffer)))
+		return -1;
+
+	memset(&message, 0, sizeof(message));
+	message.buffer = buffer;
+	message.length = (UINT16)encoded;
+	received = bfcp_parse_message(&message);
+	if(!received)
+		return -1;
+	attribute = received->first_attribute;
+	ok = !received->errors && (received->arguments != NULL) && (attribute != NULL) && (attribute->next == NULL) &&
+		((UINT32)attribute->type == top) &&
+		((type != top) || (bfcp_get_attribute_schema(type)->kind != e_bfcp_kind_octets) || ((UINT32)attribute->length == length));
+	bfcp_free_received_message(received);
+	return ok ? 0 : -1;
+}
+
+/* Check every entry of the schema table at its bounds: the top level OctetStrings at their minimum and maximum
+   Length, the others at their minimum Length in all the attributes that may contain them */
+static int bench_check_schema(void)
+{
+	int failures = 0;
+	UINT32 type;
+
+	memset(bench_octets, BENCH_OCTET, sizeof(bench_octets));
+	for(type = 1; type <= BFCP_LAST_ATTRIBUTE; type++) {
+		const bfcp_attribute_schema *schema = bfcp_get_attribute_schema(type);
+		if(!schema)
+			continue;
+		if(bench_schema_round_trip(type, schema->min_length) < 0 ||
+				((schema->kind == e_bfcp_kind_octets) && schema->top_level && (bench_schema_round_trip(type, schema->max_length) < 0))) {
+			printf("%-28s %-6s %12s\n", getBfcpAttribute((e_bfcp_attibutes)type), "schema", "FAILED");
+			failures++;
+		}
+	}
+	return failures;
+}
+
+/* ==========================================================================*/
+/* Measures                                                                  */
+/* ==========================================================================*/
+
+static double bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec*1e9+now.tv_nsec;
+}
+
+static int bench_build(bench_case *c, unsigned long iterations)
+{
+	unsigned long i;
+	for(i = 0; i < iterations; i++) {
+		bfcp_message *message = bfcp_build_message(c->arguments);
+		if(!message)
+			return -1;
+		bfcp_free_message(message);
+	}
+	return 0;
+}
+
+static int bench_parse(bench_case *c, unsigned long iterations)
+{
+	unsigned long i;
+	for(i = 0; i < iterations; i++) {
+		bfcp_received_message *received;
+		c->message->position = 0;
+		received = bfcp_parse_message(c->message);
+		if(!received || received->errors)
+			return -1;
+		bfcp_free_received_message(received);
+	}
+	return 0;
+}
+
+/* Run an operation long enough to last 'duration' nanoseconds, and print its costs: -1 if it failed or leaked */
+static int bench_run(bench_case *c, const char *operation, int (*run)(bench_case *, unsigned long), double duration)
+{
+	unsigned long iterations = 1, allocs, bytes;
+	long live = bench_live;
+	double start, elapsed;
+
+	/* Warm up, and find how many iterations last the requested duration */
+	for(;;) {
+		start = bench_now();
+		if(run(c, iterations) < 0) {
+			printf("%-28s %-6s %12s\n", c->name, operation, "FAILED");
+			return -1;
+		}
+		elapsed = bench_now()-start;
+		if((elapsed >= duration/10) || (iterations >= 100000000UL))
+			break;
+		iterations = iterations*10;
+	}
+	if(elapsed > 0)
+		iterations = (unsigned long)(iterations*(duration/elapsed))+1;
+
+	allocs = bench_allocs;
+	bytes = bench_bytes;
+	start = bench_now();
+	run(c, iterations);
+	elapsed = bench_now()-start;
+	allocs = bench_allocs-allocs;
+	bytes = bench_bytes-bytes;
+
+	printf("%-28s %-6s %12.1f %10.2f %12.1f %8u\n", c->name, operation, elapsed/iterations,
+		(double)allocs/iterations, (double)bytes/iterations, (unsigned)c->message->length);
+	if(bench_live != live) {
+		printf("%-28s %-6s %12s %ld blocks not freed\n", c->name, operation, "LEAKED", bench_live-live);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	bench_case cases[32];
+	const char *filter = NULL;
+	double duration = 200e6;	/* 200 ms per case and operation */
+	int count = 0, failures = 0, i, primitive;
+
+	for(i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "-t") && (i+1 < argc))
+			duration = atof(argv[++i])*1e6;
+		else if(!strcmp(argv[i], "-f") && (i+1 < argc))
+			filter = argv[++i];
+		else {
+			fprintf(stderr, "Usage: %s [-t milliseconds per case] [-f case name filter]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	for(primitive = e_primitive_FloorRequest; primitive <= e_primitive_GoodbyeAck; primitive++) {
+		cases[count].name = getBfcpDescPrimitive((e_bfcp_primitives)primitive);
+		cases[count].arguments = bench_primitive_arguments((e_bfcp_primitives)primitive);
+		count++;
+	}
+	cases[count].name = "FloorRequestStatus/nested";
+	cases[count++].arguments = bench_nested_arguments(e_primitive_FloorRequestStatus, 1, 3);
+	cases[count].name = "FloorStatus/nested";
+	cases[count++].arguments = bench_nested_arguments(e_primitive_FloorStatus, 4, 2);
+	cases[count].name = "UserStatus/nested";
+	cases[count++].arguments = bench_nested_arguments(e_primitive_UserStatus, 2, 2);
+
+	if(bench_check_schema())
+		return 1;
+
+	printf("%-28s %-6s %12s %10s %12s %8s\n", "case", "op", "ns/op", "allocs/op", "bytes/op", "length");
+	for(i = 0; i < count; i++) {
+		if(filter && !strstr(cases[i].name, filter))
+			continue;
+		cases[i].message = cases[i].arguments ? bfcp_build_message(cases[i].arguments) : NULL;
+		if(!cases[i].message) {
+			printf("%-28s %-6s %12s\n", cases[i].name, "build", "FAILED");
+			failures++;
+			continue;
+		}
+		if(bench_run(&cases[i], "build", bench_build, duration) < 0)
+			failures++;
+		if(bench_run(&cases[i], "parse", bench_parse, duration) < 0)
+			failures++;
+		bfcp_free_message(cases[i].message);
+	}
+	for(i = 0; i < count; i++)
+		bfcp_free_arguments(cases[i].arguments);
+
+	return failures ? 1 : 0;
+}
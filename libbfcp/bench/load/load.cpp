@@ -0,0 +1,774 @@
+/**
+ *
+ * \brief Headless load generator for a Floor Control Server
+ *
+ * Simulates thousands of participants speaking the same protocol as
+ * BFCP_Participant (Hello, FloorRequest, FloorRelease, FloorRequestQuery,
+ * HelloAck and the FloorStatus/FloorRequestStatus acks) over TCP or UDP,
+ * multiplexed on a few threads instead of the threads of one BFCP_Participant
+ * per user. Actions arrive open-loop (Poisson arrivals at a fixed rate, never
+ * throttled by the answers of the server) and follow a request/release/query
+ * mix; an optional chair grants or denies the pending requests at random.
+ * At the end it reports the throughput and the floor grant latency (from the
+ * FloorRequest to the FloorRequestStatus saying Granted). It exits with 2 when
+ * Error replies answer most of the requests, releases and queries.
+ *
+ * The users firstUserID..firstUserID+endpoints-1 (and the chair) must have
+ * been added to the conference of the FCS beforehand. Over UDP the FCS opens
+ * one port per user (BFCP_Server::OpenUdpConnection): with -P the endpoint i
+ * talks to port + i, the chair to port + endpoints.
+ *
+ * \file load.cpp
+ *
+ * \remarks : Linux only (poll and BSD sockets)
+ */
+
+/* ==========================================================================*/
+/* include(s)                                                                */
+/* ==========================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <vector>
+#include <algorithm>
+#include "bfcp_messages_cpp.h"
+#include "bfcp_strings.h"
+#include "../../bfcp_threads.h"
+
+/* ==========================================================================*/
+/* Configuration                                                             */
+/* ==========================================================================*/
+
+/* Receive buffer of an endpoint: the FloorStatus of a deep queue lists every
+   request, up to the largest message the library sends */
+#define LOAD_BUFFER_SIZE BFCP_MAX_ALLOWED_SIZE
+
+/* Silence that ends the run once the arrivals are over */
+#define LOAD_DRAIN_MS 250
+
+typedef enum {
+    LOAD_REQUEST = 0,
+    LOAD_RELEASE,
+    LOAD_QUERY,
+    LOAD_ACTIONS
+} e_load_action;
+
+struct LoadConfig {
+    const char *host;
+    int port;
+    bool udp;                 /* BFCP over UDP, or else over TCP */
+    bool userPorts;           /* UDP: one server port per endpoint */
+    UINT32 conferenceID;
+    UINT16 firstUserID;
+    int endpoints;
+    UINT16 floorID;
+    int threads;
+    double rate;              /* Arrivals per second, all threads together */
+    double duration;          /* Seconds */
+    int mix[LOAD_ACTIONS];    /* Weights of the actions */
+    UINT16 chairID;           /* 0: no chair */
+    double grantProbability;  /* Chair policy: grant, or else deny */
+    double chairDelay;        /* Chair policy: maximum think time (ms) */
+};
+
+static LoadConfig config;
+static struct sockaddr_in server_address;
+
+/* ==========================================================================*/
+/* Endpoints and statistics                                                  */
+/* ==========================================================================*/
+
+struct LoadStats {
+    unsigned long arrivals, skipped;
+    unsigned long sent[LOAD_ACTIONS];
+    unsigned long chairActions, acks, sendErrors;
+    unsigned long received, invalid, errors, chairActionAcks;
+    unsigned long grants, denied, cancelled, released, revoked;
+    unsigned long disconnected;
+};
+
+struct Endpoint {
+    int sock;
+    UINT16 userID;
+    bool chair;
+    bool ready;                /* HelloAck received */
+    UINT16 transactionID;      /* Last one used */
+    bool requesting;           /* A FloorRequest is in progress */
+    bool granted;
+    UINT16 floorRequestID;
+    double requestTime;
+    UINT16 length;             /* Bytes in buffer (TCP reassembly) */
+    unsigned char buffer[LOAD_BUFFER_SIZE];
+};
+
+/* A chair decision waiting for its think time */
+struct ChairDecision {
+    double due;
+    UINT16 floorRequestID;
+};
+
+struct Worker {
+    int index;
+    std::vector<Endpoint *> endpoints;  /* Those taking part in the arrivals */
+    std::vector<Endpoint *> polled;     /* The endpoints of fds, chair included */
+    std::vector<struct pollfd> fds;
+    Endpoint *chair;           /* Only on the first worker */
+    unsigned int seed;
+    LoadStats stats;
+    std::vector<double> latencies;  /* Floor grant latencies (ms) */
+    BFCP_THREAD_HANDLE thread;
+};
+
+static bfcp_mutex_t chair_mutex;
+static std::vector<ChairDecision> chair_decisions;
+
+static bfcp_template hello_template, helloack_template;
+static bfcp_template floorstatusack_template, floorrequeststatusack_template;
+
+static const UINT8 load_primitives[] = {
+    e_primitive_FloorRequest, e_primitive_FloorRelease, e_primitive_FloorQuery,
+    e_primitive_FloorStatus,  e_primitive_Hello,        e_primitive_HelloAck,
+    e_primitive_Goodbye,      e_primitive_GoodbyeAck,   e_primitive_Error};
+static const UINT8 load_attributes[] = {
+    BENEFICIARY_ID, FLOOR_ID, FLOOR_REQUEST_ID, PRIORITY, REQUEST_STATUS,
+    ERROR_CODE, ERROR_INFO, PARTICIPANT_PROVIDED_INFO, STATUS_INFO,
+    SUPPORTED_ATTRIBUTES, SUPPORTED_PRIMITIVES, USER_DISPLAY_NAME, USER_URI,
+    BENEFICIARY_INFORMATION, FLOOR_REQUEST_INFORMATION,
+    REQUESTED_BY_INFORMATION, FLOOR_REQUEST_STATUS, OVERALL_REQUEST_STATUS,
+    NONCE, DIGEST};
+
+static double load_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+/* Uniform in [0, 1) */
+static double load_random(Worker *w) {
+    return rand_r(&w->seed) / ((double)RAND_MAX + 1.0);
+}
+
+/* Time to the next Poisson arrival (ms) */
+static double load_interarrival(Worker *w, double rate) {
+    return -log(1.0 - load_random(w)) * 1e3 / rate;
+}
+
+static UINT16 load_next_transaction(Endpoint *e) {
+    e->transactionID++;
+    if (e->transactionID == 0) e->transactionID = 1;
+    return e->transactionID;
+}
+
+/* ==========================================================================*/
+/* Transport                                                                 */
+/* ==========================================================================*/
+
+static int load_open(Endpoint *e, int index) {
+    int type = (config.udp) ? SOCK_DGRAM : SOCK_STREAM;
+    struct sockaddr_in address = server_address;
+    int on = 1;
+    int s = socket(AF_INET, type, 0);
+    if (s < 0) return -1;
+    if (config.userPorts)
+        address.sin_port = htons((unsigned short)(config.port + index));
+    /* UDP too: only the answers of our server port are received */
+    if (connect(s, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        close(s);
+        return -1;
+    }
+    if (type == SOCK_STREAM)
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+    e->sock = s;
+    return 0;
+}
+
+static bool load_send(Worker *w, Endpoint *e, const unsigned char *buffer,
+                      int length) {
+    ssize_t sent;
+    if (e->sock < 0 || length <= 0) return false;
+    sent = send(e->sock, buffer, length, MSG_NOSIGNAL);
+    if (sent != length) {
+        w->stats.sendErrors++;
+        return false;
+    }
+    return true;
+}
+
+static bool load_send_message(Worker *w, Endpoint *e, bfcp_message *message) {
+    return message && load_send(w, e, message->buffer, message->length);
+}
+
+static bool load_send_template(Worker *w, Endpoint *e, const bfcp_template *tpl,
+                               UINT16 transactionID) {
+    unsigned char buffer[BFCP_TEMPLATE_MAX_SIZE];
+    int length = bfcp_template_stamp(tpl, buffer, sizeof(buffer),
+                                     config.conferenceID, transactionID,
+                                     e->userID);
+    return load_send(w, e, buffer, length);
+}
+
+static void load_disconnect(Worker *w, Endpoint *e, struct pollfd *fd) {
+    close(e->sock);
+    e->sock = -1;
+    e->ready = false;
+    fd->fd = -1;
+    w->stats.disconnected++;
+}
+
+/* ==========================================================================*/
+/* Participant behaviour                                                     */
+/* ==========================================================================*/
+
+static void load_chair_decision(UINT16 floorRequestID, double now,
+                                Worker *w) {
+    ChairDecision decision;
+    decision.due = now + load_random(w) * config.chairDelay;
+    decision.floorRequestID = floorRequestID;
+    bfcp_mutex_lock(chair_mutex);
+    chair_decisions.push_back(decision);
+    bfcp_mutex_unlock(chair_mutex);
+}
+
+/* FloorRequestStatus or FloorStatus about the request of an endpoint */
+static void load_floor_status(Worker *w, Endpoint *e,
+                              const BFCP_ReceivedMessage &received,
+                              double now) {
+    const bfcp_floor_request_information *frqInfo =
+        received.arguments() ? received.arguments()->frqInfo : NULL;
+    e_bfcp_status status;
+
+    if (!frqInfo || !frqInfo->oRS || !frqInfo->oRS->rs) return;
+    status = (e_bfcp_status)frqInfo->oRS->rs->rs;
+
+    /* Same acknowledgement policy as BFCP_Participant */
+    if (status != BFCP_PENDING && status != BFCP_ACCEPTED) {
+        if (load_send_template(w, e,
+                               received.primitive() == e_primitive_FloorStatus
+                                   ? &floorstatusack_template
+                                   : &floorrequeststatusack_template,
+                               received.transactionID()))
+            w->stats.acks++;
+    }
+    if (!e->requesting || e->chair) return;
+
+    /* A FloorStatus lists the requests of every user: follow the one of this
+     * endpoint, whose FloorRequestID comes in the FloorRequestStatus
+     * answering its FloorRequest */
+    while (frqInfo && (e->floorRequestID
+                           ? frqInfo->frqID != e->floorRequestID
+                           : received.primitive() != e_primitive_FloorRequestStatus))
+        frqInfo = frqInfo->next;
+    if (!frqInfo || !frqInfo->oRS || !frqInfo->oRS->rs) return;
+    status = (e_bfcp_status)frqInfo->oRS->rs->rs;
+
+    if (e->floorRequestID == 0) {
+        e->floorRequestID = frqInfo->frqID;
+        if (status == BFCP_PENDING && config.chairID)
+            load_chair_decision(frqInfo->frqID, now, w);
+    }
+    switch (status) {
+        case BFCP_GRANTED:
+            if (!e->granted) {
+                e->granted = true;
+                w->stats.grants++;
+                w->latencies.push_back(now - e->requestTime);
+            }
+            break;
+        case BFCP_DENIED:
+            w->stats.denied++;
+            e->requesting = false;
+            break;
+        case BFCP_CANCELLED:
+            w->stats.cancelled++;
+            e->requesting = false;
+            break;
+        case BFCP_RELEASED:
+            w->stats.released++;
+            e->requesting = false;
+            break;
+        case BFCP_REVOKED:
+            w->stats.revoked++;
+            e->requesting = false;
+            break;
+        default:
+            break;
+    }
+    if (!e->requesting) {
+        e->granted = false;
+        e->floorRequestID = 0;
+    }
+}
+
+static void load_received(Worker *w, Endpoint *e, unsigned char *buffer,
+                          UINT16 length) {
+    bfcp_message message;
+    double now = load_now();
+
+    message.buffer = buffer;
+    message.position = 0;
+    message.length = length;
+    BFCP_ReceivedMessage received(&message);
+
+    w->stats.received++;
+    if (!received || received.hasErrors()) {
+        w->stats.invalid++;
+        return;
+    }
+    switch (received.primitive()) {
+        case e_primitive_HelloAck:
+            e->ready = true;
+            break;
+        case e_primitive_Hello:
+            load_send_template(w, e, &helloack_template,
+                               received.transactionID());
+            break;
+        case e_primitive_FloorRequestStatus:
+        case e_primitive_FloorStatus:
+            load_floor_status(w, e, received, now);
+            break;
+        case e_primitive_ChairActionAck:
+            w->stats.chairActionAcks++;
+            break;
+        case e_primitive_Error:
+            w->stats.errors++;
+            if (e->requesting && e->floorRequestID == 0) e->requesting = false;
+            break;
+        default:
+            break;
+    }
+}
+
+static void load_read(Worker *w, Endpoint *e, struct pollfd *fd) {
+    for (;;) {
+        ssize_t n;
+        if (config.udp) {
+            n = recv(e->sock, e->buffer, sizeof(e->buffer), 0);
+            if (n < 0) return;
+            if (n > 0) load_received(w, e, e->buffer, (UINT16)n);
+            continue;
+        }
+        n = recv(e->sock, e->buffer + e->length,
+                 sizeof(e->buffer) - e->length, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            load_disconnect(w, e, fd);
+            return;
+        }
+        if (n < 0) return;
+        e->length = (UINT16)(e->length + n);
+
+        /* Split the stream in messages (Payload Length in 32 bits words) */
+        while (e->length >= 4) {
+            UINT32 length = ((e->buffer[2] << 8) | e->buffer[3]) * 4 + 12;
+            if (length > sizeof(e->buffer)) {
+                load_disconnect(w, e, fd);
+                return;
+            }
+            if (e->length < length) break;
+            load_received(w, e, e->buffer, (UINT16)length);
+            e->length = (UINT16)(e->length - length);
+            memmove(e->buffer, e->buffer + length, e->length);
+        }
+    }
+}
+
+/* One arrival of the open-loop process: an action of a random endpoint */
+static void load_arrival(Worker *w, double now) {
+    Endpoint *e;
+    int pick, action, total = 0;
+
+    w->stats.arrivals++;
+    if (w->endpoints.empty()) return;
+    e = w->endpoints[rand_r(&w->seed) % w->endpoints.size()];
+
+    for (action = 0; action < LOAD_ACTIONS; action++)
+        total += config.mix[action];
+    pick = total > 0 ? rand_r(&w->seed) % total : 0;
+    for (action = 0; action < LOAD_ACTIONS - 1; action++) {
+        if (pick < config.mix[action]) break;
+        pick -= config.mix[action];
+    }
+
+    if (!e->ready) {
+        w->stats.skipped++;
+        return;
+    }
+    switch (action) {
+        case LOAD_REQUEST: {
+            if (e->requesting) break;
+            BFCP_Encoder<64> encoder(e_primitive_FloorRequest,
+                                     config.conferenceID,
+                                     load_next_transaction(e), e->userID);
+            encoder.u16(FLOOR_ID, config.floorID)
+                .u16(BENEFICIARY_ID, e->userID);
+            if (!load_send_message(w, e, encoder.message())) return;
+            e->requesting = true;
+            e->granted = false;
+            e->floorRequestID = 0;
+            e->requestTime = now;
+            w->stats.sent[action]++;
+            return;
+        }
+        case LOAD_RELEASE:
+        case LOAD_QUERY: {
+            if (!e->requesting || e->floorRequestID == 0) break;
+            BFCP_Encoder<64> encoder(action == LOAD_RELEASE
+                                         ? e_primitive_FloorRelease
+                                         : e_primitive_FloorRequestQuery,
+                                     config.conferenceID,
+                                     load_next_transaction(e), e->userID);
+            encoder.u16(FLOOR_REQUEST_ID, e->floorRequestID);
+            if (load_send_message(w, e, encoder.message()))
+                w->stats.sent[action]++;
+            return;
+        }
+    }
+    w->stats.skipped++;  /* Nothing to do for this endpoint right now */
+}
+
+/* Send the chair decisions whose think time is over (first worker only) */
+static void load_chair(Worker *w, double now) {
+    std::vector<ChairDecision> due;
+    size_t i;
+
+    bfcp_mutex_lock(chair_mutex);
+    for (i = 0; i < chair_decisions.size();) {
+        if (chair_decisions[i].due <= now) {
+            due.push_back(chair_decisions[i]);
+            chair_decisions[i] = chair_decisions.back();
+            chair_decisions.pop_back();
+        } else
+            i++;
+    }
+    bfcp_mutex_unlock(chair_mutex);
+
+    for (i = 0; i < due.size(); i++) {
+        e_bfcp_status status = load_random(w) < config.grantProbability
+                                   ? BFCP_GRANTED
+                                   : BFCP_DENIED;
+        BFCP_Encoder<64> encoder(e_primitive_ChairAction, config.conferenceID,
+                                 load_next_transaction(w->chair),
+                                 w->chair->userID);
+        encoder.group(FLOOR_REQUEST_INFORMATION, due[i].floorRequestID)
+            .group(OVERALL_REQUEST_STATUS, due[i].floorRequestID)
+            .requestStatus(status, 0)
+            .end()
+            .group(FLOOR_REQUEST_STATUS, config.floorID)
+            .requestStatus(status, 0)
+            .end()
+            .end();
+        if (load_send_message(w, w->chair, encoder.message()))
+            w->stats.chairActions++;
+    }
+}
+
+static void *load_worker(void *arg) {
+    Worker *w = (Worker *)arg;
+    double start = load_now(), end = start + config.duration * 1e3;
+    double rate = config.rate / config.threads;
+    double next = start + load_interarrival(w, rate);
+    double now = start;
+    size_t i;
+
+    while (now < end) {
+        double wakeup = std::min(next, end);
+        struct timespec timeout;
+        if (w->chair) wakeup = std::min(wakeup, now + 1.0);
+        if (wakeup < now) wakeup = now;
+        timeout.tv_sec = (time_t)((wakeup - now) / 1e3);
+        timeout.tv_nsec = (long)(fmod(wakeup - now, 1e3) * 1e6);
+
+        if (ppoll(&w->fds[0], w->fds.size(), &timeout, NULL) > 0) {
+            for (i = 0; i < w->fds.size(); i++) {
+                if (w->fds[i].revents & (POLLIN | POLLERR | POLLHUP))
+                    load_read(w, w->polled[i], &w->fds[i]);
+            }
+        }
+        now = load_now();
+        /* Open loop: catch up with the arrivals missed while busy */
+        while (next <= now && next < end) {
+            load_arrival(w, now);
+            next += load_interarrival(w, rate);
+        }
+        if (w->chair) load_chair(w, now);
+    }
+
+    /* Drain what the FCS still has to send (LOAD_DRAIN_MS of silence, 10 s
+     * at most): closing the sockets on its backlog would turn it into send
+     * errors of the server */
+    end = now + 10e3;
+    while (now < end) {
+        struct timespec timeout = {0, LOAD_DRAIN_MS * 1000000L};
+        if (ppoll(&w->fds[0], w->fds.size(), &timeout, NULL) <= 0) break;
+        for (i = 0; i < w->fds.size(); i++) {
+            if (w->fds[i].revents & (POLLIN | POLLERR | POLLHUP))
+                load_read(w, w->polled[i], &w->fds[i]);
+        }
+        now = load_now();
+    }
+    return NULL;
+}
+
+/* ==========================================================================*/
+/* Report                                                                    */
+/* ==========================================================================*/
+
+static double load_percentile(const std::vector<double> &sorted, double q) {
+    size_t i;
+    if (sorted.empty()) return 0;
+    i = (size_t)(q * sorted.size());
+    if (i >= sorted.size()) i = sorted.size() - 1;
+    return sorted[i];
+}
+
+/* Print the report: false when Error replies answer most of the requests,
+ * releases and queries, the run then measures the FCS rejecting them */
+static bool load_report(std::vector<Worker> &workers, double elapsed) {
+    LoadStats total;
+    std::vector<double> latencies;
+    unsigned long sent, asked;
+    size_t i;
+    int a;
+
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < workers.size(); i++) {
+        const LoadStats &s = workers[i].stats;
+        total.arrivals += s.arrivals;
+        total.skipped += s.skipped;
+        for (a = 0; a < LOAD_ACTIONS; a++) total.sent[a] += s.sent[a];
+        total.chairActions += s.chairActions;
+        total.acks += s.acks;
+        total.sendErrors += s.sendErrors;
+        total.received += s.received;
+        total.invalid += s.invalid;
+        total.errors += s.errors;
+        total.chairActionAcks += s.chairActionAcks;
+        total.grants += s.grants;
+        total.denied += s.denied;
+        total.cancelled += s.cancelled;
+        total.released += s.released;
+        total.revoked += s.revoked;
+        total.disconnected += s.disconnected;
+        latencies.insert(latencies.end(), workers[i].latencies.begin(),
+                         workers[i].latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    asked = total.sent[LOAD_REQUEST] + total.sent[LOAD_RELEASE] +
+            total.sent[LOAD_QUERY];
+    sent = asked + total.chairActions + total.acks;
+    elapsed = elapsed / 1e3;
+
+    printf("duration          %.1f s, %d endpoints over %s, %d threads\n",
+           elapsed, config.endpoints,
+           config.udp ? "UDP" : "TCP", config.threads);
+    printf("arrivals          %lu (%lu skipped: endpoint not ready or idle)\n",
+           total.arrivals, total.skipped);
+    printf("sent              %lu msg (%.0f msg/s): %lu requests, %lu "
+           "releases, %lu queries, %lu chair actions, %lu acks, %lu errors\n",
+           sent, sent / elapsed, total.sent[LOAD_REQUEST],
+           total.sent[LOAD_RELEASE], total.sent[LOAD_QUERY],
+           total.chairActions, total.acks, total.sendErrors);
+    printf("received          %lu msg (%.0f msg/s): %lu invalid, %lu Error, "
+           "%lu ChairActionAck\n",
+           total.received, total.received / elapsed, total.invalid,
+           total.errors, total.chairActionAcks);
+    printf("outcomes          %lu granted (%.0f/s), %lu denied, %lu "
+           "cancelled, %lu released, %lu revoked\n",
+           total.grants, total.grants / elapsed, total.denied,
+           total.cancelled, total.released, total.revoked);
+    printf("grant latency     p50 %.3f ms, p99 %.3f ms, p999 %.3f ms, max "
+           "%.3f ms\n",
+           load_percentile(latencies, 0.50), load_percentile(latencies, 0.99),
+           load_percentile(latencies, 0.999),
+           latencies.empty() ? 0 : latencies.back());
+    printf("error replies     %lu (%.1f%% of the requests, releases and "
+           "queries)\n",
+           total.errors, asked ? 100.0 * total.errors / asked : 0);
+    if (total.disconnected)
+        printf("disconnected      %lu endpoints\n", total.disconnected);
+    if (total.errors * 2 > asked) {
+        fprintf(stderr, "Error replies dominate: check the scenario of the "
+                        "FCS\n");
+        return false;
+    }
+    return true;
+}
+
+/* ==========================================================================*/
+/* Main                                                                      */
+/* ==========================================================================*/
+
+static void load_usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -s host        FCS address (127.0.0.1)\n"
+            "  -p port        FCS port (2345)\n"
+            "  -T tcp|udp     transport (tcp)\n"
+            "  -P             UDP: endpoint i uses the FCS port + i\n"
+            "  -c confID      conference ID (1)\n"
+            "  -u userID      first user ID (1)\n"
+            "  -n endpoints   simulated participants (100)\n"
+            "  -f floorID     floor ID (1)\n"
+            "  -t threads     worker threads, at most one per endpoint (4)\n"
+            "  -r rate        arrivals per second (100)\n"
+            "  -d seconds     duration (10)\n"
+            "  -m r:l:q       request:release:query mix (5:4:1)\n"
+            "  -C chairID     chair user ID (0: no chair)\n"
+            "  -g probability chair grant probability (0.9)\n"
+            "  -D ms          chair maximum think time (10)\n",
+            name);
+}
+
+static bool load_options(int argc, char *argv[]) {
+    int opt;
+
+    config.host = "127.0.0.1";
+    config.port = 2345;
+    config.udp = false;
+    config.userPorts = false;
+    config.conferenceID = 1;
+    config.firstUserID = 1;
+    config.endpoints = 100;
+    config.floorID = 1;
+    config.threads = 4;
+    config.rate = 100;
+    config.duration = 10;
+    config.mix[LOAD_REQUEST] = 5;
+    config.mix[LOAD_RELEASE] = 4;
+    config.mix[LOAD_QUERY] = 1;
+    config.chairID = 0;
+    config.grantProbability = 0.9;
+    config.chairDelay = 10;
+
+    while ((opt = getopt(argc, argv, "s:p:T:Pc:u:n:f:t:r:d:m:C:g:D:h")) != -1) {
+        switch (opt) {
+            case 's': config.host = optarg; break;
+            case 'p': config.port = atoi(optarg); break;
+            case 'T':
+                if (!strcmp(optarg, "udp"))
+                    config.udp = true;
+                else if (!strcmp(optarg, "tcp"))
+                    config.udp = false;
+                else
+                    return false;
+                break;
+            case 'P': config.userPorts = true; break;
+            case 'c': config.conferenceID = strtoul(optarg, NULL, 10); break;
+            case 'u': config.firstUserID = (UINT16)atoi(optarg); break;
+            case 'n': config.endpoints = atoi(optarg); break;
+            case 'f': config.floorID = (UINT16)atoi(optarg); break;
+            case 't': config.threads = atoi(optarg); break;
+            case 'r': config.rate = atof(optarg); break;
+            case 'd': config.duration = atof(optarg); break;
+            case 'm':
+                if (sscanf(optarg, "%d:%d:%d", &config.mix[LOAD_REQUEST],
+                           &config.mix[LOAD_RELEASE],
+                           &config.mix[LOAD_QUERY]) != 3)
+                    return false;
+                break;
+            case 'C': config.chairID = (UINT16)atoi(optarg); break;
+            case 'g': config.grantProbability = atof(optarg); break;
+            case 'D': config.chairDelay = atof(optarg); break;
+            default: return false;
+        }
+    }
+    /* A worker polls the sockets of its own endpoints: none may be idle */
+    if (config.threads > config.endpoints) config.threads = config.endpoints;
+    return config.endpoints > 0 && config.threads > 0 && config.rate > 0 &&
+           config.duration > 0 &&
+           config.firstUserID + config.endpoints <= 0x10000;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<Worker> workers;
+    std::vector<Endpoint> endpoints;
+    struct hostent *host;
+    double start;
+    int i, connected = 0;
+    bool sound;
+
+    if (!load_options(argc, argv)) {
+        load_usage(argv[0]);
+        return 1;
+    }
+    host = gethostbyname(config.host);
+    if (!host) {
+        fprintf(stderr, "Unknown host %s\n", config.host);
+        return 1;
+    }
+    memset(&server_address, 0, sizeof(server_address));
+    server_address.sin_family = AF_INET;
+    server_address.sin_port = htons(config.port);
+    memcpy(&server_address.sin_addr, host->h_addr, host->h_length);
+
+    bfcp_mutex_init(chair_mutex, NULL);
+    bfcp_template_init(&hello_template, e_primitive_Hello, 0, NULL, 0, NULL, 0);
+    bfcp_template_init(&helloack_template, e_primitive_HelloAck, 0,
+                       load_primitives, sizeof(load_primitives),
+                       load_attributes, sizeof(load_attributes));
+    bfcp_template_init(&floorstatusack_template, e_primitive_FloorStatusAck, 0,
+                       NULL, 0, NULL, 0);
+    bfcp_template_init(&floorrequeststatusack_template,
+                       e_primitive_FloorRequestStatusAck, 0, NULL, 0, NULL, 0);
+
+    /* The endpoints, and the chair after them */
+    endpoints.resize(config.endpoints + (config.chairID ? 1 : 0));
+    workers.resize(config.threads);
+    for (i = 0; i < config.threads; i++) {
+        workers[i].index = i;
+        workers[i].chair = NULL;
+        workers[i].seed = (unsigned int)time(NULL) ^ (i * 2654435761U);
+        memset(&workers[i].stats, 0, sizeof(workers[i].stats));
+    }
+    for (i = 0; i < (int)endpoints.size(); i++) {
+        Endpoint *e = &endpoints[i];
+        Worker *w = &workers[i % config.threads];
+        struct pollfd fd;
+
+        memset(e, 0, sizeof(*e));
+        e->chair = (i == config.endpoints);
+        e->userID = e->chair ? config.chairID : (UINT16)(config.firstUserID + i);
+        if (e->chair) w = &workers[0];
+        if (load_open(e, i) < 0) {
+            fprintf(stderr, "User %u: can't connect to %s:%d (%s)\n", e->userID,
+                    config.host, config.userPorts ? config.port + i : config.port,
+                    strerror(errno));
+            e->sock = -1;
+            continue;
+        }
+        connected++;
+        if (e->chair)
+            w->chair = e;
+        else
+            w->endpoints.push_back(e);
+        w->polled.push_back(e);
+        fd.fd = e->sock;
+        fd.events = POLLIN;
+        fd.revents = 0;
+        w->fds.push_back(fd);
+        load_send_template(w, e, &hello_template, load_next_transaction(e));
+    }
+    if (!connected) return 1;
+
+    start = load_now();
+    for (i = 0; i < config.threads; i++)
+        BFCP_THREAD_START(workers[i].thread, load_worker, &workers[i]);
+    for (i = 0; i < config.threads; i++) pthread_join(workers[i].thread, NULL);
+    sound = load_report(workers, load_now() - start);
+
+    for (i = 0; i < (int)endpoints.size(); i++)
+        if (endpoints[i].sock >= 0) close(endpoints[i].sock);
+    bfcp_mutex_destroy(chair_mutex);
+    return sound ? 0 : 2;
+}
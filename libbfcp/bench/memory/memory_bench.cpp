@@ -0,0 +1,450 @@
+/**
+ *
+ * \brief In-process floor control benchmark
+ *
+ * Runs one BFCP_Server and its BFCP_Participant instances in the same
+ * process, connected by BFCP_OVER_MEMORY channels instead of sockets (see
+ * BFCPchannel.h), to measure the cost of the floor control logic alone. Every
+ * participant loops on FloorRequest, waits until it is granted, then
+ * FloorRelease and waits until it is released; the server accepts and grants
+ * each request from its OnBfcpServerEvent callback. Only the requester is
+ * informed: the FloorStatus of the grants of the others would move the FSM of
+ * a participant to Share, where its own grant is not notified. At the end it
+ * reports the floor grant latency (from bfcp_floorRequest_participant to the
+ * FloorRequestStatus saying Granted) and the metrics of the server.
+ *
+ * With -T tcp the same runs over loopback TCP connections. With -R every
+ * participant is replaced after each release by a new BFCP_Participant of
+ * the same user, as the applications reconnect (reconnect storm): the
+ * reconnection latency is measured from the deletion to the HelloAck.
+ *
+ * Built with "make ALLOC_STATS=yes", the bench fails if the live allocations
+ * of the library are not back to where they started once the participants
+ * and the server are deleted (see bfcp_alloc.h).
+ *
+ * Usage: bfcpMemoryBench [-n participants] [-d seconds] [-T memory|tcp] [-R]
+ *                        [-v]
+ *
+ * \file memory_bench.cpp
+ *
+ * \remarks : Linux only
+ */
+
+/* ==========================================================================*/
+/* include(s)                                                                */
+/* ==========================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <vector>
+#include <algorithm>
+#include "../../bfcpsrvctl/bfcpsrv/bfcp_server.h"
+#include "../../bfcpsrvctl/bfcpcli/bfcp_participant.h"
+#include "../../bfcpmsg/bfcp_alloc.h"
+
+/* ==========================================================================*/
+/* Configuration                                                             */
+/* ==========================================================================*/
+
+#define MEMORY_CONFERENCE 1
+#define MEMORY_FLOOR 1
+#define MEMORY_PORT 2345       /* Channel port, or loopback port with -T tcp */
+#define MEMORY_STALL 1.0       /* Seconds without answer before giving up */
+
+static int memory_participants = 16;
+static double memory_duration = 5;
+static int memory_transport = BFCP_OVER_MEMORY;
+static bool memory_reconnect = false;
+static bool memory_verbose = false;
+
+static double memory_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void memory_log(const char *pcFile, int iLine, int iErrorLevel,
+                       const char *pcFormat, va_list args) {
+    if (!memory_verbose || iErrorLevel < 2) return;
+    fprintf(stderr, "%s:%d | ", pcFile ? pcFile : "", iLine);
+    vfprintf(stderr, pcFormat, args);
+    fputc('\n', stderr);
+}
+
+/* ==========================================================================*/
+/* Driver                                                                    */
+/* ==========================================================================*/
+
+typedef enum {
+    MEMORY_CONNECTING = 0, /* Until HelloAck */
+    MEMORY_IDLE,
+    MEMORY_REQUESTING,
+    MEMORY_GRANTED,
+    MEMORY_RELEASING
+} e_memory_state;
+
+/**
+ * The state of the participants, changed by their callbacks and by the main
+ * thread, which calls the BFCP_Participant API outside of the lock: a
+ * callback runs on the network thread of the participant, which holds the
+ * participant while it waits for the lock.
+ */
+static pthread_mutex_t memory_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t memory_cond = PTHREAD_COND_INITIALIZER;
+static std::vector<double> memory_latencies; /* ms */
+static std::vector<double> memory_reconnects; /* ms */
+static unsigned long memory_aborted = 0, memory_stalled = 0;
+
+class MemoryParticipant : public BFCP_Participant::ParticipantEvent {
+   public:
+    MemoryParticipant(UINT16 p_userID)
+        : m_userID(p_userID), m_state(MEMORY_CONNECTING), m_since(0),
+          m_released(false), m_participant(NULL) {}
+
+    ~MemoryParticipant() { Disconnect(); }
+
+    bool Connect() {
+        m_participant =
+            new BFCP_Participant(MEMORY_CONFERENCE, m_userID, MEMORY_FLOOR, 0,
+                                 this, memory_transport);
+        m_participant->SetLogLevel(memory_verbose ? 2 : 3);
+        /* Over memory the remote address is not used, only the port */
+        return m_participant->OpenTcpConnection("127.0.0.1", 0, "127.0.0.1",
+                                                MEMORY_PORT, false);
+    }
+
+    void Disconnect() {
+        if (!m_participant) return;
+        m_participant->CloseTcpConnection();
+        delete m_participant;
+        m_participant = NULL;
+    }
+
+    bool OnBfcpParticipantEvent(BFCP_fsm::e_BFCP_ACT p_evt,
+                                BFCP_fsm::st_BFCP_fsm_event * /*p_FsmEvent*/) {
+        pthread_mutex_lock(&memory_mutex);
+        switch (p_evt) {
+            case BFCP_fsm::BFCP_ACT_HelloAck:
+                if (m_state != MEMORY_CONNECTING) break;
+                /* m_since is only set by a reconnection */
+                if (m_since > 0)
+                    memory_reconnects.push_back((memory_now() - m_since) * 1e3);
+                m_state = MEMORY_IDLE;
+                break;
+            case BFCP_fsm::BFCP_ACT_FloorRequestStatusGranted:
+                if (m_state == MEMORY_REQUESTING) {
+                    memory_latencies.push_back((memory_now() - m_since) * 1e3);
+                    m_state = MEMORY_GRANTED;
+                }
+                break;
+            case BFCP_fsm::BFCP_ACT_FloorRequestStatusAborted:
+                /* Released, or revoked before we released */
+                if (m_state != MEMORY_RELEASING) memory_aborted++;
+                if (m_state == MEMORY_RELEASING) m_released = true;
+                if (m_state != MEMORY_CONNECTING) m_state = MEMORY_IDLE;
+                break;
+            default:
+                break;
+        }
+        pthread_cond_signal(&memory_cond);
+        pthread_mutex_unlock(&memory_mutex);
+        return true;
+    }
+
+    void Log(const char *pcFile, int iLine, int iErrorLevel,
+             const char *pcFormat, va_list args) {
+        memory_log(pcFile, iLine, iErrorLevel, pcFormat, args);
+    }
+
+    /* Next action, under memory_mutex: the state it leads to, or -1 */
+    int Next(double p_now) {
+        switch (m_state) {
+            case MEMORY_IDLE:
+                m_since = p_now;
+                if (memory_reconnect && m_released) {
+                    m_released = false;
+                    return m_state = MEMORY_CONNECTING;
+                }
+                return m_state = MEMORY_REQUESTING;
+            case MEMORY_CONNECTING:
+                /* Only a reconnection can stall: retry it */
+                if (m_since > 0 && p_now - m_since > MEMORY_STALL) {
+                    memory_stalled++;
+                    m_since = p_now;
+                    return MEMORY_CONNECTING;
+                }
+                return -1;
+            case MEMORY_GRANTED:
+                m_since = p_now;
+                return m_state = MEMORY_RELEASING;
+            case MEMORY_REQUESTING:
+            case MEMORY_RELEASING:
+                if (p_now - m_since > MEMORY_STALL) {
+                    memory_stalled++;
+                    m_state = MEMORY_IDLE;
+                }
+                return -1;
+            default:
+                return -1;
+        }
+    }
+
+    /* Perform the action returned by Next, without memory_mutex */
+    void Perform(int p_state) {
+        if (p_state == MEMORY_CONNECTING) {
+            Disconnect();
+            Connect();
+        } else if (p_state == MEMORY_REQUESTING)
+            m_participant->bfcp_floorRequest_participant(MEMORY_FLOOR);
+        else if (p_state == MEMORY_RELEASING)
+            m_participant->bfcp_floorRelease_participant();
+    }
+
+   private:
+    UINT16 m_userID;
+    e_memory_state m_state;
+    double m_since;
+    bool m_released; /* Since the last reconnection */
+    BFCP_Participant *m_participant;
+};
+
+/* ==========================================================================*/
+/* Server                                                                    */
+/* ==========================================================================*/
+
+class MemoryServer : public BFCP_Server::ServerEvent {
+   public:
+    MemoryServer() : m_server(NULL), m_failed(0) {}
+
+    bool Start(int p_users) {
+        m_server = new BFCP_Server(1, MEMORY_CONFERENCE, 0, MEMORY_FLOOR, 0,
+                                   this, memory_transport);
+        m_server->SetLogLevel(memory_verbose ? 2 : 3);
+        for (int user = 1; user <= p_users; user++) {
+            if (!m_server->AddUser((UINT16)user)) return false;
+        }
+        return m_server->OpenTcpConnection("127.0.0.1", MEMORY_PORT, NULL, 0,
+                                           true);
+    }
+
+    void Stop() {
+        if (!m_server) return;
+        m_server->CloseTcpConnection();
+        delete m_server;
+        m_server = NULL;
+    }
+
+    bool OnBfcpServerEvent(BFCP_fsm::e_BFCP_ACT p_evt,
+                           BFCP_fsm::st_BFCP_fsm_event *p_FsmEvent) {
+        if (!p_FsmEvent || p_evt != BFCP_fsm::BFCP_ACT_FloorRequest)
+            return true;
+        if (!Respond(p_FsmEvent, BFCP_ACCEPTED) ||
+            !Respond(p_FsmEvent, BFCP_GRANTED))
+            m_failed++;
+        return true;
+    }
+
+    void Log(const char *pcFile, int iLine, int iErrorLevel,
+             const char *pcFormat, va_list args) {
+        memory_log(pcFile, iLine, iErrorLevel, pcFormat, args);
+    }
+
+    void Report() {
+        st_bfcp_metrics metrics;
+        UINT64 received = 0, sent = 0;
+        int i;
+
+        m_server->GetMetrics(&metrics);
+        for (i = 0; i < BFCP_METRICS_PRIMITIVES; i++) {
+            received += metrics.received[i];
+            sent += metrics.sent[i];
+        }
+        printf("server            %lu received, %lu sent (%lu send errors), "
+               "%lu failed answers\n"
+               "connections       %lu opened, %lu closed\n"
+               "process us        p50 %lu p99 %lu\n"
+               "callback us       p50 %lu p99 %lu\n"
+               "request total us  p50 %lu p99 %lu (grant %lu/%lu after the "
+               "decision)\n",
+               (unsigned long)received, (unsigned long)sent,
+               (unsigned long)metrics.send_errors, m_failed,
+               (unsigned long)metrics.connections_opened,
+               (unsigned long)metrics.connections_closed,
+               (unsigned long)bfcp_histogram_percentile(&metrics.process_us, 50),
+               (unsigned long)bfcp_histogram_percentile(&metrics.process_us, 99),
+               (unsigned long)bfcp_histogram_percentile(&metrics.callback_us, 50),
+               (unsigned long)bfcp_histogram_percentile(&metrics.callback_us, 99),
+               (unsigned long)bfcp_histogram_percentile(&metrics.request_total_us, 50),
+               (unsigned long)bfcp_histogram_percentile(&metrics.request_total_us, 99),
+               (unsigned long)bfcp_histogram_percentile(&metrics.request_grant_us, 50),
+               (unsigned long)bfcp_histogram_percentile(&metrics.request_grant_us, 99));
+    }
+
+   private:
+    bool Respond(BFCP_fsm::st_BFCP_fsm_event *p_evt, e_bfcp_status p_status) {
+        return m_server->FloorRequestRespons(
+            p_evt->userID, p_evt->userID, p_evt->TransactionID,
+            p_evt->FloorRequestID, p_status, 0, BFCP_NORMAL_PRIORITY, false);
+    }
+
+    BFCP_Server *m_server;
+    unsigned long m_failed;
+};
+
+/* ==========================================================================*/
+/* Main                                                                      */
+/* ==========================================================================*/
+
+/* Report the types whose live allocations differ from 'p_baseline': false if
+   any does */
+static bool memory_check_leaks(const bfcp_alloc_counters *p_baseline) {
+    bfcp_alloc_counters counters[BFCP_ALLOC_TYPES];
+    bool drained = true;
+    int type;
+
+    bfcp_alloc_get_counters(counters);
+    for (type = 0; type < BFCP_ALLOC_TYPES; type++) {
+        INT64 objects =
+            counters[type].live_objects - p_baseline[type].live_objects;
+        INT64 bytes = counters[type].live_bytes - p_baseline[type].live_bytes;
+        if (!objects && !bytes) continue;
+        printf("leak              %s: %lld objects, %lld bytes\n",
+               bfcp_alloc_type_name(type), (long long)objects,
+               (long long)bytes);
+        drained = false;
+    }
+    if (drained) printf("live allocations  back to the baseline\n");
+    return drained;
+}
+
+static double memory_percentile(const std::vector<double> &sorted, double q) {
+    size_t i;
+    if (sorted.empty()) return 0;
+    i = (size_t)(q * sorted.size());
+    if (i >= sorted.size()) i = sorted.size() - 1;
+    return sorted[i];
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<MemoryParticipant *> participants;
+    std::vector<int> actions;
+    bfcp_alloc_counters baseline[BFCP_ALLOC_TYPES];
+    MemoryServer server;
+    double start, end, now;
+    struct timespec until;
+    int opt, i, ready;
+
+    while ((opt = getopt(argc, argv, "n:d:T:Rvh")) != -1) {
+        switch (opt) {
+            case 'n': memory_participants = atoi(optarg); break;
+            case 'd': memory_duration = atof(optarg); break;
+            case 'T':
+                if (!strcmp(optarg, "tcp"))
+                    memory_transport = BFCP_OVER_TCP;
+                else if (!strcmp(optarg, "memory"))
+                    memory_transport = BFCP_OVER_MEMORY;
+                else
+                    memory_participants = 0;
+                break;
+            case 'R': memory_reconnect = true; break;
+            case 'v': memory_verbose = true; break;
+            default:
+                fprintf(stderr,
+                        "Usage: %s [-n participants] [-d seconds] "
+                        "[-T memory|tcp] [-R] [-v]\n"
+                        "  -n participants   participants (16)\n"
+                        "  -d seconds        duration (5)\n"
+                        "  -T transport      memory channels or loopback TCP "
+                        "(memory)\n"
+                        "  -R                reconnect after each release\n"
+                        "  -v                warnings and errors of the library\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (memory_participants <= 0 || memory_participants > 65535 ||
+        memory_duration <= 0) {
+        fprintf(stderr, "Invalid options\n");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    BFCP_msg_SetLogLevel(memory_verbose ? 2 : 3);
+    bfcp_alloc_get_counters(baseline);
+    if (!server.Start(memory_participants)) {
+        fprintf(stderr, "Can't start the server\n");
+        return 1;
+    }
+    for (i = 0; i < memory_participants; i++) {
+        participants.push_back(new MemoryParticipant((UINT16)(i + 1)));
+        if (!participants.back()->Connect()) {
+            fprintf(stderr, "User %d: can't connect\n", i + 1);
+            return 1;
+        }
+    }
+    actions.resize(participants.size());
+
+    start = memory_now();
+    end = start + memory_duration;
+    while ((now = memory_now()) < end) {
+        pthread_mutex_lock(&memory_mutex);
+        for (i = 0, ready = 0; i < (int)participants.size(); i++) {
+            actions[i] = participants[i]->Next(now);
+            if (actions[i] >= 0) ready++;
+        }
+        if (!ready) {
+            /* Until a callback changes a state, or 10 ms for the stalls */
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += 10000000;
+            if (until.tv_nsec >= 1000000000) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&memory_cond, &memory_mutex, &until);
+        }
+        pthread_mutex_unlock(&memory_mutex);
+        for (i = 0; i < (int)participants.size(); i++) {
+            if (actions[i] >= 0) participants[i]->Perform(actions[i]);
+        }
+    }
+    now = memory_now() - start;
+
+    for (i = 0; i < (int)participants.size(); i++) delete participants[i];
+    /* Leave the server network thread time to see the channels closed */
+    usleep(200000);
+
+    pthread_mutex_lock(&memory_mutex);
+    std::sort(memory_latencies.begin(), memory_latencies.end());
+    std::sort(memory_reconnects.begin(), memory_reconnects.end());
+    printf("duration          %.1f s, %d participants over %s\n", now,
+           memory_participants,
+           memory_transport == BFCP_OVER_TCP ? "loopback TCP"
+                                             : "memory channels");
+    printf("grants            %lu (%.0f/s), %lu aborted, %lu stalled\n",
+           (unsigned long)memory_latencies.size(),
+           memory_latencies.size() / now, memory_aborted, memory_stalled);
+    printf("grant latency     p50 %.3f ms, p99 %.3f ms, p999 %.3f ms, max "
+           "%.3f ms\n",
+           memory_percentile(memory_latencies, 0.50),
+           memory_percentile(memory_latencies, 0.99),
+           memory_percentile(memory_latencies, 0.999),
+           memory_latencies.empty() ? 0 : memory_latencies.back());
+    if (memory_reconnect)
+        printf("reconnects        %lu (%.0f/s), p50 %.3f ms, p99 %.3f ms, max "
+               "%.3f ms\n",
+               (unsigned long)memory_reconnects.size(),
+               memory_reconnects.size() / now,
+               memory_percentile(memory_reconnects, 0.50),
+               memory_percentile(memory_reconnects, 0.99),
+               memory_reconnects.empty() ? 0 : memory_reconnects.back());
+    pthread_mutex_unlock(&memory_mutex);
+    server.Report();
+    server.Stop();
+    if (bfcp_alloc_enabled() && !memory_check_leaks(baseline)) return 1;
+    return 0;
+}
@@ -0,0 +1,247 @@
+#!/bin/bash
+#---------------------------------------------------------------------------
+#
+#  MODULE   : libbfcp
+#
+#  \file    : perf.sh
+#
+#  \brief   : performance regression suite ("make perf", "make perf-soak")
+#
+#  Runs fixed scenarios with the benchmark tools of libbfcp/bench, prints one
+#  line per measurement and compares it with thresholds.conf:
+#
+#    codec        codec_bench: ns and allocations per build/parse
+#    fanout-tcp   bfcpLoad, 1000 TCP participants, against bfcpBenchServer:
+#                 every request granted and broadcast to all of them
+#    fanout-udp   the same over UDP, one server port per participant
+#    chair        bfcpLoad against the random-deny chair policy
+#    reconnect    bfcpMemoryBench -T tcp -R: BFCP_Participant instances
+#                 replaced after every release
+#    inproc       bfcpMemoryBench: BFCP_Server and BFCP_Participant over
+#                 memory channels
+#    soak         bfcpLoad against bfcpBenchServer for -s seconds (1800),
+#                 following the resident memory of the server (only run when
+#                 named)
+#
+#  Usage: perf.sh [-b] [-s seconds] [scenario...]
+#
+#    -b   print the measurements as thresholds.conf lines (new baseline)
+#         instead of checking them
+#
+#  A measurement fails when it is worse than its threshold by more than the
+#  tolerance of thresholds.conf. The exit status is the number of failures.
+#
+#  \remarks : Linux only, the servers listen on 127.0.0.1 ports 2350-2353 and
+#  UDP 22000-22999
+#
+#---------------------------------------------------------------------------
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+BENCH=$(dirname "$HERE")
+THRESHOLDS=$HERE/thresholds.conf
+WORK=$(mktemp -d /tmp/bfcpperf.XXXXXX)
+
+baseline=0
+soak_seconds=1800
+failures=0
+
+while getopts "bs:h" opt; do
+    case $opt in
+        b) baseline=1 ;;
+        s) soak_seconds=$OPTARG ;;
+        *) echo "Usage: $0 [-b] [-s seconds] [scenario...]" >&2; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+scenarios=${*:-codec fanout-tcp fanout-udp chair reconnect inproc}
+
+trap 'kill $server 2>/dev/null; rm -rf "$WORK"' EXIT
+# 1000 participants: as many sockets on each side
+ulimit -n 4096 2>/dev/null
+
+# Compare 'value' of 'scenario metric' with its threshold, or print it
+measure() {
+    local scenario=$1 metric=$2 value=$3
+
+    if [ -z "$value" ]; then
+        printf "%-12s %-34s %12s  FAIL\n" $scenario $metric "missing"
+        failures=$((failures + 1))
+        return
+    fi
+    if [ $baseline = 1 ]; then
+        awk -v s="$scenario" -v m="$metric" -v v="$value" '
+            $1 == s && $2 == m { printf "%-12s %-34s %s %s %s\n", s, m, $3, v, $5; found = 1 }
+            END { if (!found) printf "# %-10s %-34s - %s\n", s, m, v }' "$THRESHOLDS"
+        return
+    fi
+    awk -v s="$scenario" -v m="$metric" -v v="$value" '
+        $1 == "tolerance" && tolerance == "" { tolerance = $2 / 100 }
+        $1 == s && $2 == m { kind = $3; limit = $4; if ($5 != "") tolerance = $5 / 100 }
+        END {
+            if (kind == "") { printf "%-12s %-34s %12s\n", s, m, v; exit 0 }
+            if (kind == "max") bad = v > limit * (1 + tolerance)
+            else bad = v < limit * (1 - tolerance)
+            printf "%-12s %-34s %12s  %s %-10s %s\n", s, m, v, kind, limit,
+                   bad ? "FAIL" : "ok"
+            exit bad
+        }' "$THRESHOLDS" || failures=$((failures + 1))
+}
+
+# Start bfcpBenchServer with 'config' in the background, wait until it listens
+start_server() {
+    server=
+    "$BENCH/server/bfcpBenchServer" "$HERE/$1" > "$WORK/server.log" 2>&1 &
+    server=$!
+    for i in $(seq 1 100); do
+        grep -q "listening on" "$WORK/server.log" && return 0
+        kill -0 $server 2>/dev/null || break
+        sleep 0.1
+    done
+    echo "$1: bfcpBenchServer did not start" >&2
+    cat "$WORK/server.log" >&2
+    return 1
+}
+
+# SIGTERM makes the server print its final report
+stop_server() {
+    kill -TERM $server 2>/dev/null
+    wait $server 2>/dev/null
+    server=
+}
+
+# Measurements of a bfcpLoad report
+load_measures() {
+    local scenario=$1 log=$2
+
+    measure $scenario grants_per_s \
+        "$(sed -n 's/^outcomes .*granted (\([0-9.]*\)\/s).*/\1/p' "$log")"
+    measure $scenario received_msg_per_s \
+        "$(sed -n 's/^received .*msg (\([0-9.]*\) msg\/s).*/\1/p' "$log")"
+    measure $scenario grant_p50_ms \
+        "$(sed -n 's/^grant latency *p50 \([0-9.]*\) ms.*/\1/p' "$log")"
+    measure $scenario grant_p99_ms \
+        "$(sed -n 's/^grant latency .* p99 \([0-9.]*\) ms.*/\1/p' "$log")"
+    measure $scenario error_replies_pct \
+        "$(sed -n 's/^error replies *[0-9]* (\([0-9.]*\)%.*/\1/p' "$log")"
+    measure $scenario disconnected \
+        "$(sed -n 's/^disconnected *\([0-9]*\).*/\1/p' "$log" | grep . || echo 0)"
+}
+
+# Measurements of the final report of bfcpBenchServer
+server_measures() {
+    local scenario=$1 log=$2
+
+    measure $scenario server_send_errors \
+        "$(sed -n 's/^  sent .*(\([0-9]*\) send errors).*/\1/p' "$log")"
+    measure $scenario server_process_p99_us \
+        "$(sed -n 's/^  process us *p50 [0-9]* p99 \([0-9]*\).*/\1/p' "$log")"
+}
+
+scenario_codec() {
+    "$BENCH/codec/codec_bench" -t 100 > "$WORK/codec.log" || return 1
+    while read -r name op ns allocs bytes length; do
+        [ "$op" = build ] || [ "$op" = parse ] || continue
+        measure codec "$name.$op.ns" "$ns"
+        measure codec "$name.$op.allocs" "$allocs"
+    done < "$WORK/codec.log"
+}
+
+scenario_fanout_tcp() {
+    start_server fanout-tcp.conf || return 1
+    "$BENCH/load/bfcpLoad" -p 2350 -n 1000 -t 2 -r 40 -d 10 \
+        > "$WORK/load.log" 2>&1
+    stop_server
+    load_measures fanout-tcp "$WORK/load.log"
+    server_measures fanout-tcp "$WORK/server.log"
+}
+
+scenario_fanout_udp() {
+    start_server fanout-udp.conf || return 1
+    "$BENCH/load/bfcpLoad" -T udp -P -p 22000 -n 1000 -t 2 -r 20 -d 10 \
+        > "$WORK/load.log" 2>&1
+    stop_server
+    load_measures fanout-udp "$WORK/load.log"
+    server_measures fanout-udp "$WORK/server.log"
+}
+
+scenario_chair() {
+    local granted denied
+
+    start_server chair.conf || return 1
+    "$BENCH/load/bfcpLoad" -p 2352 -n 200 -t 2 -r 2000 -m 6:3:1 -d 10 \
+        > "$WORK/load.log" 2>&1
+    stop_server
+    load_measures chair "$WORK/load.log"
+    server_measures chair "$WORK/server.log"
+    granted=$(sed -n 's/^  granted *\([0-9]*\).*/\1/p' "$WORK/server.log")
+    denied=$(sed -n 's/^  denied *\([0-9]*\).*/\1/p' "$WORK/server.log")
+    measure chair decisions_per_s $(( (granted + denied) / 10 ))
+}
+
+# Measurements of a bfcpMemoryBench report
+memory_measures() {
+    local scenario=$1 log=$2
+
+    measure $scenario grants_per_s \
+        "$(sed -n 's/^grants .*(\([0-9.]*\)\/s).*/\1/p' "$log")"
+    measure $scenario grant_p99_ms \
+        "$(sed -n 's/^grant latency .* p99 \([0-9.]*\) ms.*/\1/p' "$log")"
+    measure $scenario stalled \
+        "$(sed -n 's/^grants .*, \([0-9]*\) stalled.*/\1/p' "$log")"
+}
+
+scenario_reconnect() {
+    "$BENCH/memory/bfcpMemoryBench" -T tcp -R -n 50 -d 10 \
+        > "$WORK/memory.log" 2>&1 || return 1
+    memory_measures reconnect "$WORK/memory.log"
+    measure reconnect reconnects_per_s \
+        "$(sed -n 's/^reconnects .*(\([0-9.]*\)\/s).*/\1/p' "$WORK/memory.log")"
+    measure reconnect reconnect_p99_ms \
+        "$(sed -n 's/^reconnects .* p99 \([0-9.]*\) ms.*/\1/p' "$WORK/memory.log")"
+}
+
+scenario_inproc() {
+    "$BENCH/memory/bfcpMemoryBench" -n 16 -d 5 > "$WORK/memory.log" 2>&1 ||
+        return 1
+    memory_measures inproc "$WORK/memory.log"
+}
+
+rss_kb() {
+    sed -n 's/^VmRSS:[[:space:]]*\([0-9]*\) kB/\1/p' /proc/$1/status 2>/dev/null
+}
+
+# The growth is counted from the end of the first tenth, once the pools,
+# the slabs and the connections of the users are allocated
+scenario_soak() {
+    local warmup=$((soak_seconds / 10)) load start end
+
+    start_server soak.conf || return 1
+    "$BENCH/load/bfcpLoad" -p 2353 -n 200 -t 2 -r 500 -d "$soak_seconds" \
+        > "$WORK/load.log" 2>&1 &
+    load=$!
+    sleep "$warmup"
+    start=$(rss_kb $server)
+    wait $load
+    end=$(rss_kb $server)
+    stop_server
+    load_measures soak "$WORK/load.log"
+    server_measures soak "$WORK/server.log"
+    measure soak server_rss_kb "$end"
+    measure soak server_rss_growth_kb $((end - start))
+}
+
+for scenario in $scenarios; do
+    case $scenario in
+        codec | fanout-tcp | fanout-udp | chair | reconnect | inproc | soak)
+            "scenario_${scenario//-/_}" ||
+                { echo "$scenario: FAILED to run" >&2; failures=$((failures + 1)); }
+            ;;
+        *)
+            echo "Unknown scenario $scenario" >&2
+            failures=$((failures + 1))
+            ;;
+    esac
+done
+
+[ $baseline = 1 ] || echo "--- $failures failure(s)"
+exit $failures
@@ -0,0 +1,933 @@
+/**
+ *
+ * \brief Headless scripted Floor Control Server for benchmarks
+ *
+ * Runs one BFCP_Server per conference described in a configuration file,
+ * without any console: the floor requests are answered by a chair policy
+ * (auto-grant, FIFO or random deny) and the run-time counters are printed
+ * periodically and at the end, followed by the library metrics of each
+ * server (see BFCP_Server::GetMetrics) and, with a library built with
+ * "make ALLOC_STATS=yes", the allocations of the process per structure type
+ * (see bfcp_alloc.h). Together with bfcpLoad it gives a reproducible
+ * end-to-end benchmark (see "make bench-run").
+ *
+ * Configuration file, one directive per line ('#' starts a comment):
+ *
+ *     seed <n>                  random seed of the policies (1)
+ *     stats <seconds>           period of the counters, 0: only at the end (1)
+ *     duration <seconds>        0: until SIGINT or SIGTERM (0)
+ *     policy <name> [p]         auto-grant, fifo or random-deny with the
+ *                               deny probability p (fifo)
+ *     conference <confID> floor <floorID> port <port> [address <addr>]
+ *                [udp <port>]      with udp, the users also get one UDP port
+ *                                  each, from <port> up in the order of the
+ *                                  "users" lines (see bfcpLoad -T udp -P)
+ *     users <first>[-<last>]    users to add to the conference
+ *
+ * "policy" and "users" apply to the last conference declared; a "policy"
+ * before any conference is the default of all of them.
+ *
+ * Usage: bfcpBenchServer [-v] [-l ms] [-w capture] [-r capture [-s speed] [-d]]
+ *                        config
+ *
+ *     -l ms        print the stages of the floor requests granted more than
+ *                  ms milliseconds after they were received (see
+ *                  BFCP_Server::SetRequestTracing)
+ *     -w capture   record the messages of the servers (see BFCP_Capture)
+ *     -r capture   replay the messages the servers of a capture received to
+ *                  the servers of the same conference IDs, then stop: over
+ *                  one loopback TCP connection per captured connection, or
+ *                  with -d directly in the servers, which then do not listen
+ *                  (their answers are counted as send errors)
+ *     -s speed     1 replays with the captured timing (default), 2 twice as
+ *                  fast..., 0 as fast as possible
+ *
+ * \file fcs_bench.cpp
+ *
+ * \remarks : Linux only, BFCP over TCP (one listening port per conference)
+ */
+
+/* ==========================================================================*/
+/* include(s)                                                                */
+/* ==========================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netinet/tcp.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "../../bfcpsrvctl/bfcpsrv/bfcp_server.h"
+#include "../../bfcpmsg/bfcp_alloc.h"
+
+/* ==========================================================================*/
+/* Counters                                                                  */
+/* ==========================================================================*/
+
+struct BenchCounters {
+    unsigned long requests, granted, queued, denied, revoked;
+    unsigned long released, failed;
+    unsigned long queue, maxQueue;  /* Current and deepest FIFO */
+};
+
+static volatile sig_atomic_t bench_stop = 0;
+static bool bench_verbose = false;
+static double bench_slow_ms = 0;
+static BFCP_Capture bench_capture;
+
+static void bench_signal(int) { bench_stop = 1; }
+
+static UINT64 bench_sum(const UINT64 *p_counters, int p_count) {
+    UINT64 sum = 0;
+    for (int i = 0; i < p_count; i++) sum += p_counters[i];
+    return sum;
+}
+
+static double bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Print the allocation counters of the process: the live KB of each type
+   when 'periodic', else a table with the rates over 'seconds' (nothing when
+   the library was built without them) */
+static void bench_alloc_report(bool periodic, double seconds) {
+    bfcp_alloc_counters c[BFCP_ALLOC_TYPES];
+    int i;
+
+    if (!bfcp_alloc_enabled()) return;
+    bfcp_alloc_get_counters(c);
+    if (periodic) {
+        printf("live KB");
+        for (i = 0; i < BFCP_ALLOC_TYPES; i++)
+            printf(" %s %.1f", bfcp_alloc_type_name(i), c[i].live_bytes / 1024.0);
+        printf("\n");
+        return;
+    }
+    printf("allocations    live objects    live KB   alloc/s    free/s\n");
+    for (i = 0; i < BFCP_ALLOC_TYPES; i++) {
+        printf("  %-10s %15ld %10.1f %9.0f %9.0f\n", bfcp_alloc_type_name(i),
+               (long)c[i].live_objects, c[i].live_bytes / 1024.0,
+               seconds > 0 ? c[i].allocs / seconds : 0,
+               seconds > 0 ? c[i].frees / seconds : 0);
+    }
+}
+
+/* ==========================================================================*/
+/* Chair policies                                                            */
+/* ==========================================================================*/
+
+/**
+ * Decides the floor requests of one conference in place of a chair. Events
+ * are delivered under the policy mutex.
+ */
+class BenchPolicy {
+   public:
+    virtual ~BenchPolicy() {}
+    virtual const char *name() const = 0;
+    virtual void OnRequest(BFCP_fsm::st_BFCP_fsm_event *p_evt) = 0;
+    virtual void OnRelease(BFCP_fsm::st_BFCP_fsm_event * /*p_evt*/) {}
+
+    void SetServer(BFCP_Server *p_server, BenchCounters *p_counters) {
+        m_server = p_server;
+        m_counters = p_counters;
+    }
+
+   protected:
+    BenchPolicy() : m_server(NULL), m_counters(NULL) {}
+
+    bool Respond(UINT16 p_userID, UINT16 p_floorRequestID, UINT16 p_TransactionID,
+                 e_bfcp_status p_status, UINT16 p_queue_position = 0) {
+        bool Status = m_server->FloorRequestRespons(
+            p_userID, p_userID, p_TransactionID, p_floorRequestID, p_status,
+            p_queue_position, BFCP_NORMAL_PRIORITY, p_status == BFCP_GRANTED);
+        if (!Status) m_counters->failed++;
+        return Status;
+    }
+
+    /* Accept then grant a pending request */
+    bool Grant(UINT16 p_userID, UINT16 p_floorRequestID, UINT16 p_TransactionID) {
+        if (!Respond(p_userID, p_floorRequestID, p_TransactionID, BFCP_ACCEPTED) ||
+            !Respond(p_userID, p_floorRequestID, p_TransactionID, BFCP_GRANTED))
+            return false;
+        m_counters->granted++;
+        return true;
+    }
+
+    BFCP_Server *m_server;
+    BenchCounters *m_counters;
+};
+
+/** Grant every request at once, revoking the current holder (samples/server) */
+class AutoGrantPolicy : public BenchPolicy {
+   public:
+    const char *name() const { return "auto-grant"; }
+
+    void OnRequest(BFCP_fsm::st_BFCP_fsm_event *p_evt) {
+        e_bfcp_status bfcp_status = BFCP_PENDING;
+        UINT32 userID = 0, beneficiaryID = 0;
+        UINT16 floorRequestID = 0;
+
+        if (m_server->GetFloorState(&bfcp_status, &userID, &beneficiaryID,
+                                    &floorRequestID) &&
+            bfcp_status == BFCP_GRANTED && userID) {
+            if (Respond((UINT16)userID, floorRequestID, p_evt->TransactionID,
+                        BFCP_REVOKED))
+                m_counters->revoked++;
+        }
+        Grant(p_evt->userID, p_evt->FloorRequestID, p_evt->TransactionID);
+    }
+};
+
+/**
+ * One holder at a time, the other requests wait in a FIFO. They stay Pending
+ * on the server until their turn: requests left Accepted would be granted all
+ * together by the server on the next release.
+ */
+class FifoPolicy : public BenchPolicy {
+   public:
+    FifoPolicy() : m_holder(0) {}
+    const char *name() const { return "fifo"; }
+
+    void OnRequest(BFCP_fsm::st_BFCP_fsm_event *p_evt) {
+        if (!m_holder) {
+            if (Grant(p_evt->userID, p_evt->FloorRequestID, p_evt->TransactionID))
+                m_holder = p_evt->FloorRequestID;
+            return;
+        }
+        m_queue.push_back(Waiting(p_evt->userID, p_evt->FloorRequestID));
+        m_counters->queued++;
+        UpdateQueue();
+    }
+
+    void OnRelease(BFCP_fsm::st_BFCP_fsm_event *p_evt) {
+        std::deque<Waiting>::iterator it;
+
+        m_counters->released++;
+        if (p_evt->FloorRequestID != m_holder) {
+            /* A queued request cancelled by its participant */
+            for (it = m_queue.begin(); it != m_queue.end(); ++it) {
+                if (it->floorRequestID == p_evt->FloorRequestID) {
+                    m_queue.erase(it);
+                    break;
+                }
+            }
+            UpdateQueue();
+            return;
+        }
+        m_holder = 0;
+        while (!m_holder && !m_queue.empty()) {
+            Waiting next = m_queue.front();
+            m_queue.pop_front();
+            if (Grant(next.userID, next.floorRequestID, 0))
+                m_holder = next.floorRequestID;
+        }
+        UpdateQueue();
+    }
+
+   private:
+    struct Waiting {
+        Waiting(UINT16 p_userID, UINT16 p_floorRequestID)
+            : userID(p_userID), floorRequestID(p_floorRequestID) {}
+        UINT16 userID;
+        UINT16 floorRequestID;
+    };
+
+    void UpdateQueue() {
+        m_counters->queue = m_queue.size();
+        if (m_counters->queue > m_counters->maxQueue)
+            m_counters->maxQueue = m_counters->queue;
+    }
+
+    UINT16 m_holder;  /* Floor request ID granted, 0 if the floor is free */
+    std::deque<Waiting> m_queue;
+};
+
+/** Deny a share of the requests at random, the others go to the FIFO */
+class RandomDenyPolicy : public FifoPolicy {
+   public:
+    RandomDenyPolicy(double p_probability, unsigned int p_seed)
+        : m_probability(p_probability), m_seed(p_seed) {}
+    const char *name() const { return "random-deny"; }
+
+    void OnRequest(BFCP_fsm::st_BFCP_fsm_event *p_evt) {
+        if (rand_r(&m_seed) < m_probability * ((double)RAND_MAX + 1)) {
+            if (Respond(p_evt->userID, p_evt->FloorRequestID, p_evt->TransactionID,
+                        BFCP_DENIED))
+                m_counters->denied++;
+            return;
+        }
+        FifoPolicy::OnRequest(p_evt);
+    }
+
+   private:
+    double m_probability;
+    unsigned int m_seed;
+};
+
+/* ==========================================================================*/
+/* Conferences                                                               */
+/* ==========================================================================*/
+
+struct BenchPolicyConfig {
+    std::string name;
+    double probability;
+};
+
+struct BenchConference {
+    UINT32 confID;
+    UINT16 floorID;
+    int port;
+    int udpPort; /* 0: TCP only */
+    std::string address;
+    std::vector<std::pair<UINT16, UINT16> > users;
+    BenchPolicyConfig policy;
+};
+
+/**
+ * The listener of one BFCP_Server: counts its events and hands the floor
+ * requests and releases to the policy.
+ */
+class BenchConferenceServer : public BFCP_Server::ServerEvent {
+   public:
+    BenchConferenceServer(const BenchConference &p_conference, BenchPolicy *p_policy)
+        : m_conference(p_conference), m_policy(p_policy), m_server(NULL),
+          m_listening(false) {
+        memset(&m_counters, 0, sizeof(m_counters));
+        memset(&m_last, 0, sizeof(m_last));
+        bfcp_mutex_init(m_mutex, NULL);
+    }
+
+    ~BenchConferenceServer() {
+        delete m_policy;
+        bfcp_mutex_destroy(m_mutex);
+    }
+
+    /* Create the server, listening on its port unless 'p_listen' is false */
+    bool Start(bool p_listen) {
+        size_t i;
+        unsigned int user;
+
+        bfcp_mutex_lock(m_mutex);
+        m_server = new BFCP_Server(1, m_conference.confID, 0, m_conference.floorID,
+                                   0, this, BFCP_OVER_TCP);
+        /* Only the errors reach Log(), the other traces cost a comparison */
+        m_server->SetLogLevel(bench_verbose ? 2 : 3);
+        m_policy->SetServer(m_server, &m_counters);
+        if (bench_slow_ms > 0) m_server->SetRequestTracing(true);
+        bfcp_mutex_unlock(m_mutex);
+        for (i = 0; i < m_conference.users.size(); i++) {
+            for (user = m_conference.users[i].first;
+                 user <= m_conference.users[i].second; user++) {
+                if (!m_server->AddUser((UINT16)user)) {
+                    fprintf(stderr, "Conference %u: can't add user %u\n",
+                            m_conference.confID, user);
+                    return false;
+                }
+            }
+        }
+        if (bench_capture.IsOpen()) m_server->SetCapture(&bench_capture);
+        if (!p_listen) {
+            printf("conference %u floor %u replayed directly, policy %s\n",
+                   m_conference.confID, m_conference.floorID, m_policy->name());
+            return true;
+        }
+        if (!m_server->OpenTcpConnection(m_conference.address.c_str(),
+                                         m_conference.port, NULL, 0,
+                                         BFCPConnectionRole::PASSIVE)) {
+            fprintf(stderr, "Conference %u: can't listen on %s:%d\n",
+                    m_conference.confID, m_conference.address.c_str(),
+                    m_conference.port);
+            return false;
+        }
+        m_listening = true;
+        printf("conference %u floor %u listening on %s:%d, policy %s\n",
+               m_conference.confID, m_conference.floorID,
+               m_conference.address.c_str(), m_conference.port, m_policy->name());
+        return OpenUdpPorts();
+    }
+
+    /* One UDP port per user, on the address of the TCP listener */
+    bool OpenUdpPorts() {
+        size_t i;
+        unsigned int user;
+        int port = m_conference.udpPort;
+
+        if (port <= 0) return true;
+        for (i = 0; i < m_conference.users.size(); i++) {
+            for (user = m_conference.users[i].first;
+                 user <= m_conference.users[i].second; user++, port++) {
+                if (!m_server->OpenUdpConnection((UINT16)user, NULL, port)) {
+                    fprintf(stderr, "Conference %u: can't open UDP port %d "
+                            "for user %u\n", m_conference.confID, port, user);
+                    return false;
+                }
+            }
+        }
+        printf("conference %u UDP ports %d-%d\n", m_conference.confID,
+               m_conference.udpPort, port - 1);
+        return true;
+    }
+
+    void Stop() {
+        if (!m_server) return;
+        if (m_listening) m_server->CloseTcpConnection();
+        m_server->SetCapture(NULL);
+    }
+
+    const BenchConference &Conference() const { return m_conference; }
+    BFCP_Server *Server() { return m_server; }
+
+    bool OnBfcpServerEvent(BFCP_fsm::e_BFCP_ACT p_evt,
+                           BFCP_fsm::st_BFCP_fsm_event *p_FsmEvent) {
+        if (!p_FsmEvent) return false;
+
+        bfcp_mutex_lock(m_mutex);
+        switch (p_evt) {
+            case BFCP_fsm::BFCP_ACT_FloorRequest:
+                m_counters.requests++;
+                if (m_server) m_policy->OnRequest(p_FsmEvent);
+                break;
+            case BFCP_fsm::BFCP_ACT_FloorRelease:
+                if (m_server) m_policy->OnRelease(p_FsmEvent);
+                break;
+            default:
+                break;
+        }
+        bfcp_mutex_unlock(m_mutex);
+        return true;
+    }
+
+    /* Called with the server locked, only reads the event */
+    void OnBfcpRequestTrace(const st_bfcp_request_trace_event *p_event) {
+        const bfcp_request_trace *t = &p_event->trace;
+
+        if (p_event->stage != BFCP_TRACE_GRANTED ||
+            (t->granted - t->received) / 1000.0 < bench_slow_ms)
+            return;
+        printf("slow conf %u user %u request %u: total %lu us, pending %lu "
+               "notify %lu decision %lu grant %lu\n",
+               p_event->conferenceID, p_event->userID, p_event->floorRequestID,
+               (unsigned long)(t->granted - t->received),
+               (unsigned long)(t->pending ? t->pending - t->received : 0),
+               (unsigned long)(t->notified && t->pending ? t->notified - t->pending : 0),
+               (unsigned long)(t->decided && t->notified ? t->decided - t->notified : 0),
+               (unsigned long)(t->decided ? t->granted - t->decided : 0));
+    }
+
+    void Log(const char *pcFile, int iLine, int iErrorLevel,
+             const char *pcFormat, va_list args) {
+        if (!bench_verbose || iErrorLevel < 2) return;
+        if (BFCP_AsyncLog::Push(pcFile, iLine, iErrorLevel, pcFormat, args))
+            return;
+        fprintf(stderr, "%s:%d | ", pcFile ? pcFile : "", iLine);
+        vfprintf(stderr, pcFormat, args);
+        fputc('\n', stderr);
+    }
+
+    /* Print the counters, as rates since the previous call when 'interval' is set */
+    void Report(double interval) {
+        BenchCounters c;
+
+        bfcp_mutex_lock(m_mutex);
+        c = m_counters;
+        bfcp_mutex_unlock(m_mutex);
+        if (interval > 0) {
+            printf("conf %-6u req/s %8.0f grant/s %8.0f deny/s %6.0f "
+                   "rel/s %8.0f queue %4lu fail %lu\n",
+                   m_conference.confID, (c.requests - m_last.requests) / interval,
+                   (c.granted - m_last.granted) / interval,
+                   (c.denied - m_last.denied) / interval,
+                   (c.released - m_last.released) / interval, c.queue, c.failed);
+        } else {
+            printf("conference %u (%s)\n"
+                   "  requests        %lu\n"
+                   "  granted         %lu\n"
+                   "  queued          %lu (deepest %lu)\n"
+                   "  denied          %lu\n"
+                   "  revoked         %lu\n"
+                   "  released        %lu\n"
+                   "  failed answers  %lu\n",
+                   m_conference.confID, m_policy->name(), c.requests,
+                   c.granted, c.queued, c.maxQueue, c.denied, c.revoked,
+                   c.released, c.failed);
+            if (m_server) {
+                st_bfcp_metrics metrics;
+                m_server->GetMetrics(&metrics);
+                printf("  received        %lu (%lu parse errors)\n"
+                       "  sent            %lu (%lu send errors)\n"
+                       "  connections     %lu opened, %lu closed\n"
+                       "  process us      p50 %lu p99 %lu\n"
+                       "  send us         p50 %lu p99 %lu\n"
+                       "  callback us     p50 %lu p99 %lu\n"
+                       "  request stages  p50/p99 us: pending %lu/%lu "
+                       "notify %lu/%lu decision %lu/%lu grant %lu/%lu\n"
+                       "  request total   p50 %lu p99 %lu (received to granted)\n"
+                       "  request status  p50 %lu p99 %lu (received to each "
+                       "FloorRequestStatus)\n",
+                       (unsigned long)bench_sum(metrics.received, BFCP_METRICS_PRIMITIVES),
+                       (unsigned long)bench_sum(metrics.parse_errors, BFCP_METRICS_ERRORS),
+                       (unsigned long)bench_sum(metrics.sent, BFCP_METRICS_PRIMITIVES),
+                       (unsigned long)metrics.send_errors,
+                       (unsigned long)metrics.connections_opened,
+                       (unsigned long)metrics.connections_closed,
+                       (unsigned long)bfcp_histogram_percentile(&metrics.process_us, 50),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.process_us, 99),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.send_us, 50),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.send_us, 99),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.callback_us, 50),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.callback_us, 99),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_pending_us, 50),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_pending_us, 99),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_notify_us, 50),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_notify_us, 99),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_decision_us, 50),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_decision_us, 99),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_grant_us, 50),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_grant_us, 99),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_total_us, 50),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_total_us, 99),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_status_us, 50),
+                       (unsigned long)bfcp_histogram_percentile(&metrics.request_status_us, 99));
+            }
+        }
+        m_last = c;
+    }
+
+   private:
+    BenchConference m_conference;
+    BenchPolicy *m_policy;
+    BFCP_Server *m_server;
+    bool m_listening;
+    bfcp_mutex_t m_mutex;
+    BenchCounters m_counters;
+    BenchCounters m_last;
+};
+
+/* ==========================================================================*/
+/* Configuration file                                                        */
+/* ==========================================================================*/
+
+struct BenchConfig {
+    unsigned int seed;
+    double stats;
+    double duration;
+    BenchPolicyConfig policy;
+    std::vector<BenchConference> conferences;
+};
+
+static bool bench_policy(BenchPolicyConfig *p_policy, char *p_args) {
+    char *name = strtok(p_args, " \t");
+    char *probability = strtok(NULL, " \t");
+
+    if (!name) return false;
+    p_policy->name = name;
+    p_policy->probability = probability ? atof(probability) : 0.5;
+    if (!strcmp(name, "auto-grant") || !strcmp(name, "fifo"))
+        return probability == NULL;
+    return !strcmp(name, "random-deny") && p_policy->probability >= 0 &&
+           p_policy->probability <= 1;
+}
+
+static bool bench_conference(BenchConfig *p_config, char *p_args) {
+    BenchConference conference;
+    char *key, *value;
+
+    conference.confID = 0;
+    conference.floorID = 0;
+    conference.port = 0;
+    conference.udpPort = 0;
+    conference.address = "0.0.0.0";
+    conference.policy = p_config->policy;
+    value = strtok(p_args, " \t");
+    if (!value) return false;
+    conference.confID = strtoul(value, NULL, 10);
+    while ((key = strtok(NULL, " \t")) != NULL) {
+        if (!(value = strtok(NULL, " \t"))) return false;
+        if (!strcmp(key, "floor"))
+            conference.floorID = (UINT16)atoi(value);
+        else if (!strcmp(key, "port"))
+            conference.port = atoi(value);
+        else if (!strcmp(key, "address"))
+            conference.address = value;
+        else if (!strcmp(key, "udp"))
+            conference.udpPort = atoi(value);
+        else
+            return false;
+    }
+    if (!conference.confID || !conference.floorID || conference.port <= 0)
+        return false;
+    p_config->conferences.push_back(conference);
+    return true;
+}
+
+static bool bench_users(BenchConference *p_conference, char *p_args) {
+    unsigned int first, last;
+    int n = sscanf(p_args, "%u-%u", &first, &last);
+
+    if (n == 1) last = first;
+    if (n < 1 || !first || first > last || last > 0xFFFF) return false;
+    p_conference->users.push_back(std::make_pair((UINT16)first, (UINT16)last));
+    return true;
+}
+
+static bool bench_read_config(const char *p_file, BenchConfig *p_config) {
+    FILE *f = fopen(p_file, "r");
+    char line[512];
+    int number = 0;
+
+    if (!f) {
+        fprintf(stderr, "Can't open %s\n", p_file);
+        return false;
+    }
+    p_config->seed = 1;
+    p_config->stats = 1;
+    p_config->duration = 0;
+    p_config->policy.name = "fifo";
+    p_config->policy.probability = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        char *directive, *args, *comment = strchr(line, '#');
+        bool ok;
+
+        number++;
+        if (comment) *comment = '\0';
+        directive = strtok(line, " \t\r\n");
+        if (!directive) continue;
+        args = strtok(NULL, "\r\n");
+        if (!args) args = (char *)"";
+
+        if (!strcmp(directive, "seed"))
+            ok = sscanf(args, "%u", &p_config->seed) == 1;
+        else if (!strcmp(directive, "stats"))
+            ok = sscanf(args, "%lf", &p_config->stats) == 1 && p_config->stats >= 0;
+        else if (!strcmp(directive, "duration"))
+            ok = sscanf(args, "%lf", &p_config->duration) == 1 &&
+                 p_config->duration >= 0;
+        else if (!strcmp(directive, "policy"))
+            ok = bench_policy(p_config->conferences.empty()
+                                  ? &p_config->policy
+                                  : &p_config->conferences.back().policy,
+                              args);
+        else if (!strcmp(directive, "conference"))
+            ok = bench_conference(p_config, args);
+        else if (!strcmp(directive, "users"))
+            ok = !p_config->conferences.empty() &&
+                 bench_users(&p_config->conferences.back(), args);
+        else
+            ok = false;
+
+        if (!ok) {
+            fprintf(stderr, "%s:%d: invalid \"%s\" directive\n", p_file, number,
+                    directive);
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    if (p_config->conferences.empty()) {
+        fprintf(stderr, "%s: no conference\n", p_file);
+        return false;
+    }
+    return true;
+}
+
+static BenchPolicy *bench_new_policy(const BenchPolicyConfig &p_policy,
+                                     unsigned int p_seed) {
+    if (p_policy.name == "auto-grant") return new AutoGrantPolicy();
+    if (p_policy.name == "random-deny")
+        return new RandomDenyPolicy(p_policy.probability, p_seed);
+    return new FifoPolicy();
+}
+
+/* ==========================================================================*/
+/* Replay                                                                    */
+/* ==========================================================================*/
+
+/**
+ * Sends the messages received in a capture to the servers of the same
+ * conference IDs, on its own thread. Only the messages are replayed: the
+ * chair decisions are the policies' of this run.
+ */
+class BenchReplay {
+   public:
+    BenchReplay(const std::vector<BenchConferenceServer *> &p_servers,
+                double p_speed, bool p_direct)
+        : done(false), m_servers(p_servers), m_speed(p_speed),
+          m_direct(p_direct), m_replayed(0), m_skipped(0), m_failed(0),
+          m_answered(0), m_maxLate(0), m_elapsed(0) {}
+
+    ~BenchReplay() {
+        std::map<std::string, int>::iterator it;
+        for (it = m_connections.begin(); it != m_connections.end(); ++it)
+            if (it->second >= 0) close(it->second);
+    }
+
+    bool Open(const char *p_file) {
+        if (m_reader.Open(p_file)) return true;
+        fprintf(stderr, "Can't read capture %s\n", p_file);
+        return false;
+    }
+
+    static void *Thread(void *p_replay) {
+        ((BenchReplay *)p_replay)->Run();
+        return NULL;
+    }
+
+    void Run() {
+        const st_bfcp_capture_record *record;
+        const UINT8 *message;
+        bfcp_header header;
+        BenchConferenceServer *server;
+        double start = bench_now(), due, now;
+        UINT64 first = 0;
+        bool timed = false;
+
+        while (!bench_stop && (record = m_reader.Next(&message)) != NULL) {
+            if (record->direction != BFCP_CAPTURE_IN) continue;
+            if (m_speed > 0) {
+                if (!timed) {
+                    first = record->time_us;
+                    timed = true;
+                }
+                due = start + (record->time_us - first) / 1e6 / m_speed;
+                while ((now = bench_now()) < due && !bench_stop) Wait(due - now);
+                if (now - due > m_maxLate) m_maxLate = now - due;
+            }
+            if (bfcp_peek_header(message, record->length, &header) < 0 ||
+                (server = Find(header.conferenceID)) == NULL ||
+                (!m_direct && record->transport != BFCP_OVER_TCP)) {
+                m_skipped++;
+                continue;
+            }
+            if (m_direct) {
+                server->Server()->ReplayBFCPmessage(
+                    message, (UINT16)record->length, (BFCP_SOCKET)record->socket,
+                    record->transport);
+                m_replayed++;
+            } else if (Send(Connection(record, server), message, record->length)) {
+                m_replayed++;
+            } else {
+                m_failed++;
+            }
+        }
+        m_elapsed = bench_now() - start;
+        /* Let the last answers arrive */
+        if (!m_direct) Wait(0.2);
+        done = true;
+    }
+
+    void Report() {
+        printf("replay (%s, speed %g): %lu messages in %.1f s (%.0f/s), "
+               "%lu skipped, %lu failed, %.1f ms late at most",
+               m_direct ? "direct" : "loopback", m_speed, m_replayed, m_elapsed,
+               m_elapsed > 0 ? m_replayed / m_elapsed : 0.0, m_skipped, m_failed,
+               m_maxLate * 1000);
+        if (!m_direct) printf(", %lu answer octets", m_answered);
+        printf("\n");
+    }
+
+    volatile bool done;
+
+   private:
+    BenchConferenceServer *Find(UINT32 p_confID) {
+        for (size_t i = 0; i < m_servers.size(); i++)
+            if (m_servers[i]->Conference().confID == p_confID) return m_servers[i];
+        return NULL;
+    }
+
+    /* Loopback connection standing for a captured one, -1 if it failed */
+    int Connection(const st_bfcp_capture_record *p_record,
+                   BenchConferenceServer *p_server) {
+        std::string key((const char *)&p_record->socket, sizeof(p_record->socket));
+        std::map<std::string, int>::iterator it;
+        const BenchConference &conference = p_server->Conference();
+        struct sockaddr_in addr;
+        int fd, one = 1;
+
+        key.append((const char *)&p_record->peer_port, sizeof(p_record->peer_port));
+        key.append((const char *)p_record->peer_addr, sizeof(p_record->peer_addr));
+        it = m_connections.find(key);
+        if (it != m_connections.end()) return it->second;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((UINT16)conference.port);
+        if (conference.address == "0.0.0.0" ||
+            inet_pton(AF_INET, conference.address.c_str(), &addr.sin_addr) != 1)
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd >= 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        m_connections[key] = fd;
+        return fd;
+    }
+
+    bool Send(int p_fd, const UINT8 *p_message, UINT32 p_length) {
+        UINT32 sent = 0;
+        ssize_t n;
+
+        if (p_fd < 0) return false;
+        while (sent < p_length) {
+            n = send(p_fd, p_message + sent, p_length - sent, 0);
+            if (n <= 0) return false;
+            sent += (UINT32)n;
+        }
+        return true;
+    }
+
+    /* Wait 'p_seconds', reading the answers meanwhile */
+    void Wait(double p_seconds) {
+        std::vector<struct pollfd> fds;
+        std::map<std::string, int>::iterator it;
+        char buffer[4096];
+        ssize_t n;
+        int timeout = (int)(p_seconds * 1000);
+
+        for (it = m_connections.begin(); it != m_connections.end(); ++it) {
+            if (it->second < 0) continue;
+            struct pollfd pfd = {it->second, POLLIN, 0};
+            fds.push_back(pfd);
+        }
+        if (fds.empty() || timeout == 0) {
+            if (!fds.empty()) poll(&fds[0], fds.size(), 0);
+            usleep((useconds_t)(p_seconds * 1e6));
+        } else if (poll(&fds[0], fds.size(), timeout) <= 0) {
+            return;
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (!fds[i].revents) continue;
+            while ((n = recv(fds[i].fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+                m_answered += n;
+        }
+    }
+
+    BFCP_CaptureReader m_reader;
+    std::vector<BenchConferenceServer *> m_servers;
+    double m_speed;
+    bool m_direct;
+    /* Captured connection (socket, peer port and address) -> loopback socket */
+    std::map<std::string, int> m_connections;
+    unsigned long m_replayed, m_skipped, m_failed, m_answered;
+    double m_maxLate, m_elapsed;
+};
+
+/* ==========================================================================*/
+/* Main                                                                      */
+/* ==========================================================================*/
+
+static int bench_usage(const char *p_name) {
+    fprintf(stderr,
+            "Usage: %s [-v] [-l ms] [-w capture] [-r capture [-s speed] [-d]] "
+            "config\n",
+            p_name);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<BenchConferenceServer *> servers;
+    BenchConfig config;
+    BenchReplay *replay = NULL;
+    pthread_t replayThread;
+    const char *captureFile = NULL, *replayFile = NULL;
+    double start, last, now, speed = 1;
+    size_t i;
+    int opt;
+    bool started = true, direct = false;
+
+    while ((opt = getopt(argc, argv, "vhl:w:r:s:d")) != -1) {
+        switch (opt) {
+            case 'v': bench_verbose = true; break;
+            case 'l': bench_slow_ms = atof(optarg); break;
+            case 'w': captureFile = optarg; break;
+            case 'r': replayFile = optarg; break;
+            case 's': speed = atof(optarg); break;
+            case 'd': direct = true; break;
+            default: return bench_usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || speed < 0 || (direct && !replayFile))
+        return bench_usage(argv[0]);
+    if (!bench_read_config(argv[optind], &config)) return 1;
+    if (captureFile && !bench_capture.Open(captureFile)) {
+        fprintf(stderr, "Can't create capture %s\n", captureFile);
+        return 1;
+    }
+    /* The error traces are written off the network and floor control threads */
+    if (bench_verbose) BFCP_AsyncLog::Start();
+
+    signal(SIGINT, bench_signal);
+    signal(SIGTERM, bench_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < config.conferences.size() && started; i++) {
+        BenchConferenceServer *server = new BenchConferenceServer(
+            config.conferences[i],
+            bench_new_policy(config.conferences[i].policy,
+                             config.seed + (unsigned int)i));
+        servers.push_back(server);
+        started = server->Start(!direct);
+    }
+    /* The codec traces go to stderr once a server installed its callback */
+    BFCP_msg_SetLogLevel(bench_verbose ? 2 : 3);
+    fflush(stdout);
+
+    if (started && replayFile) {
+        replay = new BenchReplay(servers, speed, direct);
+        started = replay->Open(replayFile) &&
+                  pthread_create(&replayThread, NULL, BenchReplay::Thread,
+                                 replay) == 0;
+        if (!started) {
+            delete replay;
+            replay = NULL;
+        }
+    }
+
+    start = last = bench_now();
+    while (started && !bench_stop && !(replay && replay->done)) {
+        usleep(100000);
+        now = bench_now();
+        if (config.duration > 0 && now - start >= config.duration) break;
+        if (config.stats > 0 && now - last >= config.stats) {
+            for (i = 0; i < servers.size(); i++) servers[i]->Report(now - last);
+            bench_alloc_report(true, 0);
+            fflush(stdout);
+            last = now;
+        }
+    }
+
+    now = bench_now();
+    printf("--- %.1f s\n", now - start);
+    if (replay) {
+        bench_stop = 1;
+        pthread_join(replayThread, NULL);
+        replay->Report();
+        delete replay;
+    }
+    for (i = 0; i < servers.size(); i++) {
+        servers[i]->Stop();
+        servers[i]->Report(0);
+    }
+    bench_alloc_report(false, now - start);
+    if (bench_capture.IsOpen()) {
+        printf("capture %s: %lu records dropped\n", captureFile,
+               (unsigned long)bench_capture.GetDropped());
+        bench_capture.Close();
+    }
+    fflush(stdout);
+    BFCP_AsyncLog::Stop();
+    /* The BFCP_Server instances are left to the process exit: their threads
+       may still be delivering events to the listeners */
+    return started ? 0 : 1;
+}
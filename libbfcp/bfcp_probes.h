@@ -0,0 +1,56 @@
+/**
+ *
+ * \brief Static trace points of the library (USDT)
+ *
+ * Built with "make USDT=yes" on Linux (BFCP_USDT defined, <sys/sdt.h> from
+ * systemtap-sdt-devel), the library carries SystemTap/USDT probes of the
+ * "bfcp" provider that perf, bpftrace or stap attach to a running process:
+ *
+ *     # bpftrace -e 'usdt:./libbfcp.so:bfcp:read_done { @[arg2] = count(); }'
+ *     # perf buildid-cache --add ./bfcpServer ; perf list sdt_bfcp:*
+ *
+ * A probe is a nop instruction until a tracer attaches to it: the only cost
+ * is computing its arguments. Without BFCP_USDT the probes are empty
+ * statements that do not evaluate their arguments.
+ *
+ * Probes and arguments:
+ * \li loop_wakeup(transport, ready): the network thread returned from
+ *     select (ready descriptors, -1 on error) or from waiting for in-process
+ *     channels (notifications received)
+ * \li read_done(socket, length, transport): a whole message was read
+ * \li parse_entry(length), parse_exit(primitive, has_errors): around
+ *     bfcp_parse_message, primitive is 0 when the message was dropped
+ * \li fsm_transition(name, state, event, new_state, performed): action of a
+ *     state machine done, new_state is the state after it
+ * \li send(socket, length, transport): message handed to SendData
+ * \li retransmit(transactionID, elapsed_ms): T1 fired for a transaction
+ * \li t1_expired(transactionID, socket): transaction given up
+ * \li watchdog_expired(conferenceID, floorRequestID): a pending request was
+ *     not answered by its chair in time
+ *
+ * \file bfcp_probes.h
+ *
+ * \remarks : usable from C (codec) and C++
+ */
+#ifndef _BFCP_PROBES_
+#define _BFCP_PROBES_
+
+#if defined(BFCP_USDT) && !defined(WIN32)
+
+#include <sys/sdt.h>
+
+#define BFCP_PROBE1(name, a) DTRACE_PROBE1(bfcp, name, a)
+#define BFCP_PROBE2(name, a, b) DTRACE_PROBE2(bfcp, name, a, b)
+#define BFCP_PROBE3(name, a, b, c) DTRACE_PROBE3(bfcp, name, a, b, c)
+#define BFCP_PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(bfcp, name, a, b, c, d, e)
+
+#else
+
+#define BFCP_PROBE1(name, a) do { } while (0)
+#define BFCP_PROBE2(name, a, b) do { } while (0)
+#define BFCP_PROBE3(name, a, b, c) do { } while (0)
+#define BFCP_PROBE5(name, a, b, c, d, e) do { } while (0)
+
+#endif
+
+#endif  // _BFCP_PROBES_
@@ -32,6 +32,10 @@ typedef pthread_mutex_t bfcp_mutex_t;
 #define BFCP_SLEEP(x) usleep(x*1000)
 
 #define BFCP_CURRENT_THREAD() pthread_self()
+#define BFCP_MEMORY_BARRIER() __sync_synchronize()
+#define BFCP_ATOMIC_ADD64(p,v) __sync_fetch_and_add(p,v)
+#define BFCP_ATOMIC_CAS64(p,o,n) __sync_bool_compare_and_swap(p,o,n)
+#define BFCP_THREAD_LOCAL __thread
 
 #else // WIN32
 #if !defined(_MT)
@@ -56,6 +60,10 @@ typedef CRITICAL_SECTION  bfcp_mutex_t;
 #define BFCP_THREAD_KILL(HThread)    TerminateThread(HThread,1);CloseHandle(HThread);  
 #define BFCP_NULL_THREAD_HANDLE NULL
 #define BFCP_SLEEP(x) Sleep(x)
+#define BFCP_MEMORY_BARRIER() MemoryBarrier()
+#define BFCP_ATOMIC_ADD64(p,v) InterlockedExchangeAdd64((volatile LONGLONG*)(p),(LONGLONG)(v))
+#define BFCP_ATOMIC_CAS64(p,o,n) (InterlockedCompareExchange64((volatile LONGLONG*)(p),(LONGLONG)(n),(LONGLONG)(o))==(LONGLONG)(o))
+#define BFCP_THREAD_LOCAL __declspec(thread)
 #endif
 #endif
 
@@ -0,0 +1,139 @@
+/**
+ *
+ * \brief Allocation accounting per structure type
+ *
+ * \file bfcp_alloc.c
+ *
+ * \remarks :
+ */
+
+#include "bfcp_alloc.h"
+#include "../bfcp_threads.h"
+
+#ifdef BFCP_ALLOC_STATS
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#define BFCP_USABLE_SIZE(p) malloc_size(p)
+#elif defined(WIN32)
+#include <malloc.h>
+#define BFCP_USABLE_SIZE(p) _msize(p)
+#else
+#include <malloc.h>
+#define BFCP_USABLE_SIZE(p) malloc_usable_size(p)
+#endif
+#endif
+
+static const char *bfcp_alloc_names[BFCP_ALLOC_TYPES] = {
+	"message",
+	"attribute",
+	"received",
+	"request",
+	"queue",
+	"slab",
+	"user",
+	"floor"
+};
+
+/* Updated with atomic additions, from any thread */
+static bfcp_alloc_counters bfcp_alloc_stats[BFCP_ALLOC_TYPES];
+
+/* 1 when the library was built with the allocation counters */
+int bfcp_alloc_enabled(void)
+{
+#ifdef BFCP_ALLOC_STATS
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/* Copy the counters of all the types (BFCP_ALLOC_TYPES entries) */
+void bfcp_alloc_get_counters(bfcp_alloc_counters *counters)
+{
+	int i;
+
+	if(counters == NULL)
+		return;
+	/* Each counter is read on its own: a snapshot taken while other threads
+	   allocate may be off by the allocations in progress */
+	for(i = 0; i < BFCP_ALLOC_TYPES; i++) {
+		counters[i].allocs = BFCP_ATOMIC_ADD64(&bfcp_alloc_stats[i].allocs, 0);
+		counters[i].frees = BFCP_ATOMIC_ADD64(&bfcp_alloc_stats[i].frees, 0);
+		counters[i].alloc_bytes = BFCP_ATOMIC_ADD64(&bfcp_alloc_stats[i].alloc_bytes, 0);
+		counters[i].live_objects = BFCP_ATOMIC_ADD64(&bfcp_alloc_stats[i].live_objects, 0);
+		counters[i].live_bytes = BFCP_ATOMIC_ADD64(&bfcp_alloc_stats[i].live_bytes, 0);
+	}
+}
+
+/* Name of a structure type */
+const char *bfcp_alloc_type_name(int type)
+{
+	if((type < 0) || (type >= BFCP_ALLOC_TYPES))
+		return "unknown";
+	return bfcp_alloc_names[type];
+}
+
+#ifdef BFCP_ALLOC_STATS
+
+/* Count objects allocated (objects > 0) or freed (objects < 0) */
+void bfcp_alloc_count(int type, INT64 objects, INT64 bytes)
+{
+	bfcp_alloc_counters *stats;
+
+	if((type < 0) || (type >= BFCP_ALLOC_TYPES))
+		return;
+	stats = &bfcp_alloc_stats[type];
+	if(objects > 0) {
+		BFCP_ATOMIC_ADD64(&stats->allocs, objects);
+		BFCP_ATOMIC_ADD64(&stats->alloc_bytes, bytes);
+	} else
+		BFCP_ATOMIC_ADD64(&stats->frees, -objects);
+	BFCP_ATOMIC_ADD64(&stats->live_objects, objects);
+	BFCP_ATOMIC_ADD64(&stats->live_bytes, bytes);
+}
+
+void *bfcp_alloc_calloc(int type, size_t number, size_t size)
+{
+	void *ptr = calloc(number, size);
+	if(ptr != NULL)
+		bfcp_alloc_count(type, 1, (INT64)BFCP_USABLE_SIZE(ptr));
+	return ptr;
+}
+
+void *bfcp_alloc_malloc(int type, size_t size)
+{
+	void *ptr = malloc(size);
+	if(ptr != NULL)
+		bfcp_alloc_count(type, 1, (INT64)BFCP_USABLE_SIZE(ptr));
+	return ptr;
+}
+
+/* A block that moves or changes size counts as a free and an allocation */
+void *bfcp_alloc_realloc(int type, void *ptr, size_t size)
+{
+	INT64 old_size = 0;
+	void *new_ptr;
+
+	if(ptr != NULL)
+		old_size = (INT64)BFCP_USABLE_SIZE(ptr);
+	new_ptr = realloc(ptr, size);
+	if(new_ptr == NULL) {
+		if((ptr != NULL) && (size == 0))
+			bfcp_alloc_count(type, -1, -old_size);
+		return NULL;
+	}
+	if(ptr != NULL)
+		bfcp_alloc_count(type, -1, -old_size);
+	bfcp_alloc_count(type, 1, (INT64)BFCP_USABLE_SIZE(new_ptr));
+	return new_ptr;
+}
+
+void bfcp_alloc_free(int type, void *ptr)
+{
+	if(ptr == NULL)
+		return;
+	bfcp_alloc_count(type, -1, -(INT64)BFCP_USABLE_SIZE(ptr));
+	free(ptr);
+}
+
+#endif
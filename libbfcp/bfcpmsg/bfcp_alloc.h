@@ -0,0 +1,98 @@
+/**
+ *
+ * \brief Allocation accounting per structure type
+ *
+ * The codec (bfcp_new_* and the parser), the request queues, the user lists
+ * and the floor lists of the server allocate through the BFCP_CALLOC,
+ * BFCP_MALLOC, BFCP_REALLOC and BFCP_FREE wrappers below, tagged with the type
+ * of structure they hold. Built with "make ALLOC_STATS=yes" (BFCP_ALLOC_STATS
+ * defined), each type counts its allocations, frees, live objects and live
+ * bytes, which bfcp_alloc_get_counters returns at any time: two snapshots
+ * give the alloc/free rates, the live counters attribute the memory growth of
+ * a long conference to a subsystem.
+ *
+ * Objects carved out of a pool (slab) are counted with BFCP_ALLOC_OBJECT and
+ * BFCP_FREE_OBJECT, the pool itself under BFCP_ALLOC_SLAB: comparing both
+ * shows what the pool keeps in reserve.
+ *
+ * Bytes are the usable size of the heap blocks (malloc_usable_size, _msize),
+ * so that a free does not need to know what was asked for.
+ *
+ * Without BFCP_ALLOC_STATS the wrappers are the plain C library functions and
+ * the counters stay at 0.
+ *
+ * \file bfcp_alloc.h
+ *
+ * \remarks : a block must be freed with the type it was allocated with
+ */
+
+#ifndef _BFCP_ALLOC_H
+#define _BFCP_ALLOC_H
+
+#include "bfcp_messages.h"
+
+/* Structure types */
+typedef enum {
+	BFCP_ALLOC_MESSAGE = 0,		/* Messages, their buffers and the shared messages */
+	BFCP_ALLOC_ATTRIBUTE,		/* Arguments and the attribute lists of bfcp_new_* and of the parser */
+	BFCP_ALLOC_RECEIVED,		/* Received messages, their attributes and errors */
+	BFCP_ALLOC_REQUEST,		/* FloorRequest nodes, their floors and queries (slab objects) */
+	BFCP_ALLOC_QUEUE,		/* Request queues and the texts of their nodes */
+	BFCP_ALLOC_SLAB,		/* Chunks of the slabs */
+	BFCP_ALLOC_USER,		/* User lists and user entries */
+	BFCP_ALLOC_FLOOR,		/* Floor lists of the conferences */
+	BFCP_ALLOC_TYPES
+} e_bfcp_alloc_type;
+
+/* Counters of a structure type */
+typedef struct bfcp_alloc_counters {
+	UINT64 allocs;		/* Allocations so far */
+	UINT64 frees;		/* Frees so far */
+	UINT64 alloc_bytes;	/* Bytes allocated so far */
+	INT64 live_objects;	/* Objects allocated and not freed */
+	INT64 live_bytes;	/* Bytes allocated and not freed */
+} bfcp_alloc_counters;
+
+
+#if defined __cplusplus
+	extern "C" {
+#endif
+
+/* 1 when the library was built with the allocation counters */
+int bfcp_alloc_enabled(void);
+/* Copy the counters of all the types (BFCP_ALLOC_TYPES entries) */
+void bfcp_alloc_get_counters(bfcp_alloc_counters *counters);
+/* Name of a structure type */
+const char *bfcp_alloc_type_name(int type);
+
+#ifdef BFCP_ALLOC_STATS
+
+void *bfcp_alloc_calloc(int type, size_t number, size_t size);
+void *bfcp_alloc_malloc(int type, size_t size);
+void *bfcp_alloc_realloc(int type, void *ptr, size_t size);
+void bfcp_alloc_free(int type, void *ptr);
+void bfcp_alloc_count(int type, INT64 objects, INT64 bytes);
+
+#define BFCP_CALLOC(type, number, size) bfcp_alloc_calloc(type, number, size)
+#define BFCP_MALLOC(type, size) bfcp_alloc_malloc(type, size)
+#define BFCP_REALLOC(type, ptr, size) bfcp_alloc_realloc(type, ptr, size)
+#define BFCP_FREE(type, ptr) bfcp_alloc_free(type, ptr)
+#define BFCP_ALLOC_OBJECT(type, size) bfcp_alloc_count(type, 1, (INT64)(size))
+#define BFCP_FREE_OBJECT(type, size) bfcp_alloc_count(type, -1, -(INT64)(size))
+
+#else
+
+#define BFCP_CALLOC(type, number, size) calloc(number, size)
+#define BFCP_MALLOC(type, size) malloc(size)
+#define BFCP_REALLOC(type, ptr, size) realloc(ptr, size)
+#define BFCP_FREE(type, ptr) free(ptr)
+#define BFCP_ALLOC_OBJECT(type, size) do { } while (0)
+#define BFCP_FREE_OBJECT(type, size) do { } while (0)
+
+#endif
+
+#if defined __cplusplus
+	}
+#endif
+
+#endif
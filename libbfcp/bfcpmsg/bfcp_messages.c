@@ -14,9 +14,20 @@
  */
 
 #include "bfcp_messages.h"
+#include "bfcp_alloc.h"
+#ifdef WIN32
+#include <windows.h>
+#define BFCP_ATOMIC_INC(p) InterlockedIncrement(p)
+#define BFCP_ATOMIC_DEC(p) InterlockedDecrement(p)
+#else
+#define BFCP_ATOMIC_INC(p) __sync_add_and_fetch(p, 1)
+#define BFCP_ATOMIC_DEC(p) __sync_sub_and_fetch(p, 1)
+#endif
 
 
 static tLog_callback  _Log_callback     =NULL; /*!\brief fonction app.  */
+static int           _Log_level        =0;    /*!\brief niveau minimum demande */
+int BFCP_msg_log_threshold = 3;                 /*!\brief niveau minimum effectif (3 : pas de callback) */
 
 /*!  
  *  \brief  Affectation d'un pointeur de fonction
@@ -26,6 +37,18 @@ static tLog_callback  _Log_callback     =NULL; /*!\brief fonction app.  */
 void BFCP_msg_LogCallback(tLog_callback trace_function)
 {
   _Log_callback = trace_function;
+  BFCP_msg_log_threshold = _Log_callback ? _Log_level : 3;
+}
+
+/*!  
+ *  \brief  Niveau minimum des traces du codec
+ *  \param  level     Les traces de niveau inferieur ne sont pas formatees
+ *  \retval void
+ */
+void BFCP_msg_SetLogLevel(int level)
+{
+  _Log_level = level;
+  BFCP_msg_log_threshold = _Log_callback ? _Log_level : 3;
 }
 
 //#define DEBUG_PARSE true
@@ -56,7 +79,7 @@ void DumpBfcpBuff(char* txt , unsigned char* dp , int sz )
 #endif
 }
 
-void BFCP_msgLog(char* pcFile, int iLine, int iErrLevel , char* pcFormat, ...){
+void (BFCP_msgLog)(char* pcFile, int iLine, int iErrLevel , char* pcFormat, ...){
     if ( _Log_callback){
 	va_list ap ; 
     char buf[BFCP_STRING_SIZE]={0};
@@ -70,7 +93,7 @@ void BFCP_msgLog(char* pcFile, int iLine, int iErrLevel , char* pcFormat, ...){
 /* Create a New Arguments Structure */
 bfcp_arguments *bfcp_new_arguments(void)
 {
-	bfcp_arguments *arguments = (bfcp_arguments *) calloc(1, sizeof(bfcp_arguments));
+	bfcp_arguments *arguments = (bfcp_arguments *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_arguments));
 	if(!arguments)	/* We could not allocate the memory, return with a failure */
 		return NULL;
 	arguments->primitive = e_primitive_InvalidPrimitive;
@@ -110,20 +133,20 @@ int bfcp_free_arguments(bfcp_arguments *arguments)
 	if(arguments->rs)
 		res += bfcp_free_request_status(arguments->rs);
 	if(arguments->pInfo)
-		free(arguments->pInfo);
+		BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, arguments->pInfo);
 	if(arguments->sInfo)
-		free(arguments->sInfo);
+		BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, arguments->sInfo);
 	if(arguments->error)
 		res += bfcp_free_error(arguments->error);
 	if(arguments->eInfo)
-		free(arguments->eInfo);
+		BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, arguments->eInfo);
 	if(arguments->primitives)
 		res += bfcp_free_supported_list(arguments->primitives);
 	if(arguments->attributes)
 		res += bfcp_free_supported_list(arguments->attributes);
 	if(arguments->digest)
 		res += bfcp_free_digest(arguments->digest);
-	free(arguments);
+	BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, arguments);
 	if(!res)	/* No error occurred, succesfully freed the structure */
 		return 0;
 	else		/* res was not 0, so some error occurred, return with a failure */
@@ -133,17 +156,17 @@ int bfcp_free_arguments(bfcp_arguments *arguments)
 /* Create a New Message (if buffer is NULL or length is 0, creates an empty message) */
 bfcp_message *bfcp_new_message(unsigned char *buffer, UINT16 length)
 {
-	bfcp_message *message = (bfcp_message *) calloc(1, sizeof(bfcp_message));
+	bfcp_message *message = (bfcp_message *) BFCP_CALLOC(BFCP_ALLOC_MESSAGE, 1, sizeof(bfcp_message));
 	if(!message){	/* We could not allocate the memory, return a with failure */
 	    BFCP_msgLog(INF,"bfcp_new_message: Error  We could not allocate the memory!");
 		return NULL;
 		}
 	if(!buffer) {	/* Buffer is empty, so we want an empy message, a template */
-		message->buffer = (unsigned char*) calloc(BFCP_MAX_ALLOWED_SIZE, sizeof(unsigned char));
+		message->buffer = (unsigned char*) BFCP_CALLOC(BFCP_ALLOC_MESSAGE, BFCP_MAX_ALLOWED_SIZE, sizeof(unsigned char));
 		message->position = 12;			/* We start after the Common Header (12 octets) */
 		message->length = 12;			/* even if we haven't written it yet */
 	} else {	/* Buffer is not empty, create a message around it */
-		message->buffer = (unsigned char*) calloc(length, sizeof(unsigned char));
+		message->buffer = (unsigned char*) BFCP_CALLOC(BFCP_ALLOC_MESSAGE, length, sizeof(unsigned char));
 		memcpy(message->buffer, buffer, length);	/* We copy the buffer in our message */
 		message->position = 0;				/* Start from the beginning */
 		message->length = length;			/* The length of the message is the length we pass */
@@ -157,12 +180,12 @@ bfcp_message *bfcp_copy_message(bfcp_message *message)
     if(!message)	/* The message is not valid, return with a failure */
         return NULL;
     else {
-        bfcp_message *copy = (bfcp_message*)calloc(sizeof(bfcp_message), sizeof(unsigned char));
+        bfcp_message *copy = (bfcp_message*)BFCP_CALLOC(BFCP_ALLOC_MESSAGE, sizeof(bfcp_message), sizeof(unsigned char));
         if(!copy)	/* We could not allocate the memory, return a with failure */
             return NULL;
         copy->position = 0;
         copy->length = message->length;
-        copy->buffer = (unsigned char*) calloc(copy->length, sizeof(unsigned char));
+        copy->buffer = (unsigned char*) BFCP_CALLOC(BFCP_ALLOC_MESSAGE, copy->length, sizeof(unsigned char));
         memcpy(copy->buffer, message->buffer, copy->length);
         return copy;
     }
@@ -174,15 +197,47 @@ int bfcp_free_message(bfcp_message *message)
 	if(!message)	/* There's nothing to free, return with a failure */
 		return -1;
 	if(message->buffer)
-		free(message->buffer);
-	free(message);
+		BFCP_FREE(BFCP_ALLOC_MESSAGE, message->buffer);
+	BFCP_FREE(BFCP_ALLOC_MESSAGE, message);
 	return 0;
 }
 
+/* Create a Shared Message holding a copy of a buffer (one reference) */
+bfcp_shared_message *bfcp_new_shared_message(const unsigned char *buffer, UINT16 length)
+{
+	bfcp_shared_message *shared;
+	if(!buffer || !length)	/* There's nothing to share, return with a failure */
+		return NULL;
+	shared = (bfcp_shared_message *) BFCP_MALLOC(BFCP_ALLOC_MESSAGE, sizeof(bfcp_shared_message)+length);
+	if(!shared)	/* We could not allocate the memory, return a with failure */
+		return NULL;
+	shared->message.buffer = (unsigned char *)(shared+1);	/* The bytes follow the structure */
+	memcpy(shared->message.buffer, buffer, length);
+	shared->message.position = 0;
+	shared->message.length = length;
+	shared->references = 1;
+	return shared;
+}
+
+/* Take a reference on a Shared Message */
+bfcp_shared_message *bfcp_retain_shared_message(bfcp_shared_message *shared)
+{
+	if(shared)
+		BFCP_ATOMIC_INC(&shared->references);
+	return shared;
+}
+
+/* Drop a reference on a Shared Message, freeing it with the last one */
+void bfcp_release_shared_message(bfcp_shared_message *shared)
+{
+	if(shared && (BFCP_ATOMIC_DEC(&shared->references) == 0))
+		BFCP_FREE(BFCP_ALLOC_MESSAGE, shared);
+}
+
 /* Create a New Entity (Conference ID, Transaction ID, User ID) */
 bfcp_entity *bfcp_new_entity(UINT32 conferenceID, UINT16 transactionID, UINT16 userID)
 {
-	bfcp_entity *entity = (bfcp_entity*)calloc(1, sizeof(bfcp_entity));
+	bfcp_entity *entity = (bfcp_entity*)BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_entity));
 	if(!entity)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	entity->conferenceID = conferenceID;
@@ -196,7 +251,7 @@ int bfcp_free_entity(bfcp_entity *entity)
 {
 	if(!entity)	/* There's nothing to free, return with a failure */
 		return -1;
-	free(entity);
+	BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, entity);
 	return 0;
 }
 
@@ -206,7 +261,7 @@ bfcp_floor_id_list *bfcp_new_floor_id_list(unsigned fID, ...)
 	bfcp_floor_id_list *first, *previous, *next;
 	va_list ap;
 	va_start(ap, fID);
-	first = (bfcp_floor_id_list *) calloc(1, sizeof(bfcp_floor_id_list));
+	first = (bfcp_floor_id_list *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_floor_id_list));
 	if(!first)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	first->ID = fID;
@@ -214,7 +269,7 @@ bfcp_floor_id_list *bfcp_new_floor_id_list(unsigned fID, ...)
 	previous = first;
 	fID = va_arg(ap, int);
 	while(fID) {
-		next = (bfcp_floor_id_list *) calloc(1, sizeof(bfcp_floor_id_list));
+		next = (bfcp_floor_id_list *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_floor_id_list));
 		if(!next)	/* We could not allocate the memory, return a with failure */
 			return NULL;
 		next->ID = fID;
@@ -241,7 +296,7 @@ int bfcp_add_floor_id_list(bfcp_floor_id_list *list, unsigned fID, ...)
 		next = previous->next;
 	}	/* previous is now the pointer to the actually last element in the list */
 	while(fID) {
-		next = (bfcp_floor_id_list *)calloc(1, sizeof(bfcp_floor_id_list));
+		next = (bfcp_floor_id_list *)BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_floor_id_list));
 		if(!next)	/* We could not allocate the memory, return a with failure */
 			return -1;
 		next->ID = fID;
@@ -263,7 +318,7 @@ int bfcp_free_floor_id_list(bfcp_floor_id_list *list)
         bfcp_floor_id_list *next = NULL, *temp = list;
         while(temp) {
             next = temp->next;
-            free(temp);
+            BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, temp);
             temp = next;
         }
     }
@@ -276,14 +331,14 @@ bfcp_supported_list *bfcp_new_supported_list(unsigned element, ...)
 	bfcp_supported_list *first, *previous, *next;
 	va_list ap;
 	va_start(ap, element);
-	first = (bfcp_supported_list *) calloc(1, sizeof(bfcp_supported_list));
+	first = (bfcp_supported_list *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_supported_list));
 	if(!first)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	first->element = element;
 	previous = first;
 	element = va_arg(ap, int);
 	while(element) {
-		next = (bfcp_supported_list *) calloc(1, sizeof(bfcp_supported_list));
+		next = (bfcp_supported_list *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_supported_list));
 		if(!next)	/* We could not allocate the memory, return a with failure */
 			return NULL;
 		next->element = element;
@@ -304,7 +359,7 @@ int bfcp_free_supported_list(bfcp_supported_list *list)
         bfcp_supported_list *next = NULL, *temp = list;
         while(temp) {
             next = temp->next;
-            free(temp);
+            BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, temp);
             temp = next;
         }
     }
@@ -314,7 +369,7 @@ int bfcp_free_supported_list(bfcp_supported_list *list)
 /* Create a New Request Status (RequestStatus/QueuePosition) */
 bfcp_request_status *bfcp_new_request_status(UINT16 rs, UINT16 qp)
 {
-	bfcp_request_status *request_status = (bfcp_request_status *) calloc(1, sizeof(bfcp_request_status));
+	bfcp_request_status *request_status = (bfcp_request_status *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_request_status));
 	if(!request_status)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	request_status->rs = rs;
@@ -327,14 +382,14 @@ int bfcp_free_request_status(bfcp_request_status *request_status)
 {
 	if(!request_status)	/* There's nothing to free, return with a failure */
 		return -1;
-	free(request_status);
+	BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, request_status);
 	return 0;
 }
 
 /* Create a New Error (Code/Details) */
 bfcp_error *bfcp_new_error(e_bfcp_error_codes code, bfcp_unknown_m_error_details *details)
 {
-	bfcp_error *error = (bfcp_error *)calloc(1, sizeof(bfcp_error));
+	bfcp_error *error = (bfcp_error *)BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_error));
 	if(!error)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	error->code = code;
@@ -345,9 +400,13 @@ bfcp_error *bfcp_new_error(e_bfcp_error_codes code, bfcp_unknown_m_error_details
 /* Free an Error (Code/Details) */
 int bfcp_free_error(bfcp_error *error)
 {
+	int res = 0;
 	if(!error)	/* There's nothing to free, return with a failure */
 		return -1;
-	return bfcp_free_unknown_m_error_details_list(error->details);
+	if(error->details)
+		res = bfcp_free_unknown_m_error_details_list(error->details);
+	BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, error);
+	return res;
 }
 
 /* Create a New Error Details list (for Error 4: UNKNOWN_M) (last argument MUST be 0) */
@@ -356,7 +415,7 @@ bfcp_unknown_m_error_details *bfcp_new_unknown_m_error_details_list(unsigned att
 	bfcp_unknown_m_error_details *first, *previous, *next;
 	va_list ap;
 	va_start(ap, attribute);
-	first = (bfcp_unknown_m_error_details *) calloc(1, sizeof(bfcp_unknown_m_error_details));
+	first = (bfcp_unknown_m_error_details *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_unknown_m_error_details));
 	if(!first)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	first->unknown_type = attribute;
@@ -364,7 +423,7 @@ bfcp_unknown_m_error_details *bfcp_new_unknown_m_error_details_list(unsigned att
 	previous = first;
 	attribute = va_arg(ap, int);
 	while(attribute) {
-		next = (bfcp_unknown_m_error_details *)calloc(1, sizeof(bfcp_unknown_m_error_details));
+		next = (bfcp_unknown_m_error_details *)BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_unknown_m_error_details));
 		if(!next)	/* We could not allocate the memory, return a with failure */
 			return NULL;
 		next->unknown_type = attribute;
@@ -391,7 +450,7 @@ int bfcp_add_unknown_m_error_details_list(bfcp_unknown_m_error_details *list, un
 		next = previous->next;
 	}	/* previous is now the pointer to the actually last element in the list */
 	while(attribute) {
-		next = (bfcp_unknown_m_error_details *)calloc(1, sizeof(bfcp_unknown_m_error_details));
+		next = (bfcp_unknown_m_error_details *)BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_unknown_m_error_details));
 		if(!next)	/* We could not allocate the memory, return a with failure */
 			return -1;
 		next->unknown_type = attribute;
@@ -413,7 +472,7 @@ int bfcp_free_unknown_m_error_details_list(bfcp_unknown_m_error_details *details
         bfcp_unknown_m_error_details *next = NULL, *temp = details;
         while(temp) {
             next = temp->next;
-            free(temp);
+            BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, temp);
             temp = next;
         }
     }
@@ -423,16 +482,16 @@ int bfcp_free_unknown_m_error_details_list(bfcp_unknown_m_error_details *details
 /* Create a New User (Beneficiary/RequestedBy) Information */
 bfcp_user_information *bfcp_new_user_information(UINT16 ID, char *display, char *uri)
 {
-	bfcp_user_information *info = (bfcp_user_information *)calloc(1, sizeof(bfcp_user_information));
+	bfcp_user_information *info = (bfcp_user_information *)BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_user_information));
 	if(!info)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	info->ID = ID;
 	if(display) {
-		info->display = (char*) calloc(strlen(display)+1, sizeof(char));
+		info->display = (char*) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, strlen(display)+1, sizeof(char));
 		info->display = strcpy(info->display, display);	/* We copy the Display string */
 	}
 	if(uri) {
-		info->uri = (char*) calloc(strlen(uri)+1, sizeof(char));
+		info->uri = (char*) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, strlen(uri)+1, sizeof(char));
 		info->uri = strcpy(info->uri, uri);		/* We copy the URI string */
 	}
 	return info;
@@ -444,17 +503,17 @@ int bfcp_free_user_information(bfcp_user_information *info)
 	if(!info)	/* There's nothing to free, return with a failure */
 		return -1;
 	if(info->display)
-		free(info->display);
+		BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, info->display);
 	if(info->uri)
-		free(info->uri);
-	free(info);
+		BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, info->uri);
+	BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, info);
 	return 0;
 }
 
 /* Create a new Floor Request Information */
 bfcp_floor_request_information *bfcp_new_floor_request_information(UINT16 frqID, bfcp_overall_request_status *oRS, bfcp_floor_request_status *fRS, bfcp_user_information *beneficiary, bfcp_user_information *requested_by, e_bfcp_priority priority , char *pInfo)
 {
-	bfcp_floor_request_information *frqInfo = (bfcp_floor_request_information *) calloc(1, sizeof(bfcp_floor_request_information));
+	bfcp_floor_request_information *frqInfo = (bfcp_floor_request_information *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_floor_request_information));
 	if(!frqInfo)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	frqInfo->frqID = frqID;
@@ -464,7 +523,7 @@ bfcp_floor_request_information *bfcp_new_floor_request_information(UINT16 frqID,
 	frqInfo->requested_by = requested_by;
 	frqInfo->priority = priority;
 	if(pInfo) {
-		frqInfo->pInfo = (char*)calloc(strlen(pInfo)+1, sizeof(char));
+		frqInfo->pInfo = (char*)BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, strlen(pInfo)+1, sizeof(char));
 		frqInfo->pInfo = strcpy(frqInfo->pInfo, pInfo);	/* We copy the Participant Provided Info */
 	}
 	frqInfo->next = NULL;	/* We link them through bfcp_list_floor_request_information (...) */
@@ -532,8 +591,8 @@ int bfcp_free_floor_request_information_list(bfcp_floor_request_information *frq
             if(temp->requested_by)
                 res += bfcp_free_user_information(temp->requested_by);
             if(temp->pInfo)
-                free(temp->pInfo);
-            free(temp);
+                BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, temp->pInfo);
+            BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, temp);
             temp = next;
         }
     }
@@ -546,7 +605,7 @@ int bfcp_free_floor_request_information_list(bfcp_floor_request_information *frq
 /* Create a New Floor Request Status (FloorID/RequestStatus/QueuePosition/StatusInfo) */
 bfcp_floor_request_status *bfcp_new_floor_request_status(UINT16 fID, UINT16 rs, UINT16 qp, char *sInfo)
 {
-	bfcp_floor_request_status *floor_request_status = (bfcp_floor_request_status *) calloc(1, sizeof(bfcp_floor_request_status));
+	bfcp_floor_request_status *floor_request_status = (bfcp_floor_request_status *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_floor_request_status));
 	if(!floor_request_status)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	floor_request_status->fID = fID;
@@ -554,7 +613,7 @@ bfcp_floor_request_status *bfcp_new_floor_request_status(UINT16 fID, UINT16 rs,
 	if(!floor_request_status->rs)
 		return NULL;
 	if(sInfo) {
-		floor_request_status->sInfo = (char*) calloc(strlen(sInfo)+1, sizeof(char));
+		floor_request_status->sInfo = (char*) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, strlen(sInfo)+1, sizeof(char));
 		if(!floor_request_status->sInfo)
 			return NULL;
 		floor_request_status->sInfo = strcpy(floor_request_status->sInfo, sInfo);	/* We copy the Status Info */
@@ -618,8 +677,8 @@ int bfcp_free_floor_request_status_list(bfcp_floor_request_status *floor_request
             if(temp->rs)
                 res += bfcp_free_request_status(temp->rs);
             if(temp->sInfo)
-                free(temp->sInfo);
-            free(temp);
+                BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, temp->sInfo);
+            BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, temp);
             temp = next;
         }
     }
@@ -632,7 +691,7 @@ int bfcp_free_floor_request_status_list(bfcp_floor_request_status *floor_request
 /* Create a New Overall Request Status (FloorRequestID/RequestStatus/QueuePosition/StatusInfo) */
 bfcp_overall_request_status *bfcp_new_overall_request_status(UINT16 frqID, UINT16 rs, UINT16 qp, char *sInfo)
 {
-	bfcp_overall_request_status *overall_request_status = (bfcp_overall_request_status *) calloc(1, sizeof(bfcp_overall_request_status));
+	bfcp_overall_request_status *overall_request_status = (bfcp_overall_request_status *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_overall_request_status));
 	if(!overall_request_status)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	overall_request_status->frqID = frqID;
@@ -640,7 +699,7 @@ bfcp_overall_request_status *bfcp_new_overall_request_status(UINT16 frqID, UINT1
 	if(!overall_request_status->rs)
 		return NULL;
 	if(sInfo) {
-		overall_request_status->sInfo = (char*) calloc(strlen(sInfo)+1, sizeof(char));
+		overall_request_status->sInfo = (char*) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, strlen(sInfo)+1, sizeof(char));
 		if(!overall_request_status->sInfo)
 			return NULL;
 		overall_request_status->sInfo = strcpy(overall_request_status->sInfo, sInfo);	/* We copy the Status Info */
@@ -673,18 +732,15 @@ int bfcp_free_overall_request_status(bfcp_overall_request_status *overall_reques
 	if(overall_request_status->rs)
 		res += bfcp_free_request_status(overall_request_status->rs);
 	if(overall_request_status->sInfo)
-		free(overall_request_status->sInfo);
-	free(overall_request_status);
-#if HSU
-	overall_request_status->floorID = 0;
-#endif // HSU
+		BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, overall_request_status->sInfo);
+	BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, overall_request_status);
 	return res;
 }
 
 /* Create a New Digest */
 bfcp_digest *bfcp_new_digest(UINT16 algorithm)
 {
-	bfcp_digest *digest = (bfcp_digest *) calloc(1, sizeof(bfcp_digest));
+	bfcp_digest *digest = (bfcp_digest *) BFCP_CALLOC(BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_digest));
 	if(!digest)	/* We could not allocate the memory, return a with failure */
 		return NULL;
 	digest->algorithm = algorithm;
@@ -698,7 +754,7 @@ int bfcp_free_digest(bfcp_digest *digest)
 	if(!digest)	/* There's nothing to free, return with a failure */
 		return -1;
 	if(digest->text)
-		free(digest->text);
-	free(digest);
+		BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, digest->text);
+	BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, digest);
 	return 0;
 }
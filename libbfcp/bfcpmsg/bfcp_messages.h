@@ -105,8 +105,31 @@ typedef void (*tLog_callback)(char *pcFile, int iLine, int iErrLevel,
  */
 void BFCP_msg_LogCallback(tLog_callback trace_function);
 
+/*!
+ *      \brief  Niveau minimum des traces du codec (INF = 0, WAR = 1, ERR = 2)
+ *      \param  level     Les traces de niveau inferieur ne sont pas formatees
+ *      \retval void
+ */
+void BFCP_msg_SetLogLevel(int level);
+
 /*     Debug Methods */
 void BFCP_msgLog(char *pcFile, int iLine, int iErrLevel, char *pcFormat, ...);
+
+/*     Traces below BFCP_MSG_LOG_LEVEL are removed at compile time (the release
+ * build defines it to 1 to drop the INF traces), the others are only formatted
+ * when a callback is installed and their level reaches BFCP_msg_log_threshold
+ */
+#ifndef BFCP_MSG_LOG_LEVEL
+#define BFCP_MSG_LOG_LEVEL 0
+#endif
+/*     Runtime threshold: 3 (no traces) until a callback is installed */
+extern int BFCP_msg_log_threshold;
+#define BFCP_msgLog(...) BFCP_MSG_LOG_GATE(__VA_ARGS__)
+#define BFCP_MSG_LOG_GATE(pcFile, iLine, iErrLevel, ...)              \
+    (((iErrLevel) >= BFCP_MSG_LOG_LEVEL &&                            \
+      (iErrLevel) >= BFCP_msg_log_threshold)                          \
+         ? (BFCP_msgLog)(pcFile, iLine, iErrLevel, __VA_ARGS__)       \
+         : (void)0)
 void DumpBfcpBuff(char *txt, unsigned char *dp, int sz);
 
 /**     \brief BFCP primitives
@@ -261,6 +284,30 @@ typedef enum {
     DIGEST = 20
 } e_bfcp_attibutes;
 
+/*     The last attribute type known by the codec */
+#define BFCP_LAST_ATTRIBUTE DIGEST
+
+/*     Kind of payload of an attribute */
+typedef enum {
+    e_bfcp_kind_unknown = 0, /*     Not an attribute of the codec */
+    e_bfcp_kind_u16,         /*     A 16 bits value */
+    e_bfcp_kind_octets,      /*     An OctetString (text, list, error) */
+    e_bfcp_kind_grouped      /*     A 16 bits ID followed by attributes */
+} e_bfcp_attribute_kind;
+
+/*     Schema of an attribute: what the decoder accepts and the encoder emits */
+typedef struct bfcp_attribute_schema {
+    UINT8 kind;       /*     The kind of payload (e_bfcp_attribute_kind) */
+    UINT8 min_length; /*     The minimum Length (TLV header included) */
+    UINT8 max_length; /*     The maximum Length (TLV header included) */
+    UINT8 top_level;  /*     Whether it may appear directly in a primitive */
+    UINT32 children;  /*     If grouped, the mask (1 << type) of the
+                         attributes it may contain */
+} bfcp_attribute_schema;
+
+extern const bfcp_attribute_schema
+    bfcp_attribute_schemas[BFCP_LAST_ATTRIBUTE + 1];
+
 /**     \brief REQUEST-STATUS format
  *
  *       Request Status: This 8-bit field contains the status of the request,
@@ -663,6 +710,81 @@ typedef struct bfcp_message {
     UINT16 length;   /*  @brief    The length of the message */
 } bfcp_message;
 
+/*     Immutable encoded message shared by reference counting (retransmission
+ * table and answer cache of a sent message): the bytes follow the structure,
+ * in the same allocation */
+typedef struct bfcp_shared_message {
+    bfcp_message message; /*  @brief    The message, on the bytes below: it
+                             must not be modified nor freed */
+    volatile long references; /*  @brief    The number of holders */
+} bfcp_shared_message;
+
+/*     Common Header of a message, as decoded by bfcp_peek_header */
+typedef struct bfcp_header {
+    UINT8 version;   /*  @brief    The protocol version (must be 1) */
+    UINT8 responder; /*  @brief    R bit: the message is a response */
+    UINT8 fragment;  /*  @brief    F bit: the message is a fragment */
+    UINT8 reserved;  /*  @brief    The 5 bits following the version */
+    e_bfcp_primitives primitive; /*  @brief    The primitive */
+    UINT32 length; /*  @brief    The length of the whole message (Common
+                      Header included), from the payload length */
+    UINT32 conferenceID;  /*  @brief    The ConferenceID */
+    UINT16 transactionID; /*  @brief    The TransactionID */
+    UINT16 userID;        /*  @brief    The UserID */
+} bfcp_header;
+
+/*     Decode the 12 octets Common Header of a raw message, without logging nor
+ * allocating: used to route a message before parsing it. Return 0 on success,
+ * -1 if there are less than 12 octets */
+static __inline int bfcp_peek_header(const unsigned char *buffer, UINT32 size,
+                                     bfcp_header *header) {
+    UINT32 ch32;
+    UINT16 ch16;
+
+    if (!buffer || !header || size < 12) return -1;
+    memcpy(&ch32, buffer, 4);
+    ch32 = ntohl(ch32);
+    header->version = (UINT8)((ch32 & 0xE0000000) >> 29);
+    header->reserved = (UINT8)((ch32 & 0x1F000000) >> 24);
+    header->responder = (UINT8)((ch32 & 0x10000000) >> 28);
+    header->fragment = (UINT8)((ch32 & 0x08000000) >> 27);
+    header->primitive = (e_bfcp_primitives)((ch32 & 0x00FF0000) >> 16);
+    header->length = (ch32 & 0x0000FFFF) * 4 + 12;
+    memcpy(&ch32, buffer + 4, 4);
+    header->conferenceID = ntohl(ch32);
+    memcpy(&ch16, buffer + 8, 2);
+    header->transactionID = ntohs(ch16);
+    memcpy(&ch16, buffer + 10, 2);
+    header->userID = ntohs(ch16);
+    return 0;
+}
+
+/*     Streaming encoder writing a message in a caller buffer */
+typedef struct bfcp_encoder {
+    unsigned char *buffer; /*  @brief    The caller buffer (NULL to only compute
+                              the size of the message) */
+    UINT32 size;           /*  @brief    The size of the caller buffer */
+    UINT32 length; /*  @brief    The length of the message so far, even past the
+                      end of the caller buffer */
+    int failed; /*  @brief    Set when an attribute can't be encoded (not of
+                   the kind its schema gives, or grouped attribute longer
+                   than 255 octets): bfcp_encode_end then fails */
+    int grow;   /*  @brief    Set by the caller after bfcp_encode_begin: a
+                   message larger than the caller buffer moves to a heap one,
+                   freed by bfcp_encode_release */
+    unsigned char *heap; /*  @brief    That heap buffer, or NULL */
+} bfcp_encoder;
+
+/*     Maximum size of a message template */
+#define BFCP_TEMPLATE_MAX_SIZE 128
+
+/*     Pre-encoded message whose only variable fields are the IDs of its Common
+ * Header: stamped in a stack copy instead of being built each time */
+typedef struct bfcp_template {
+    UINT16 length; /*  @brief    The length of the message (0 if not built) */
+    unsigned char buffer[BFCP_TEMPLATE_MAX_SIZE]; /*  @brief    The message */
+} bfcp_template;
+
 /*     Helping Structures for bit masks and so on */
 typedef struct bfcp_entity {
     UINT32 conferenceID;
@@ -799,6 +921,27 @@ typedef struct bfcp_received_message {
     int transport;
 } bfcp_received_message;
 
+/*     Maximum number of attributes of a lazily parsed message */
+#define BFCP_LAZY_MAX_ATTRIBUTES 16
+
+typedef struct bfcp_lazy_attribute { /*     Framing of an attribute that has not
+                                        been decoded yet */
+    UINT8 type;                      /*     The attribute type */
+    UINT8 mandatory_bit;             /*     The Mandatory Bit */
+    UINT8 length;                    /*     The length of the attribute */
+    UINT16 position; /*     Its position in the message buffer */
+} bfcp_lazy_attribute;
+
+typedef struct bfcp_lazy_message { /*     A received message whose attributes
+                                      are only decoded on demand */
+    unsigned char *buffer;  /*     The message buffer (not copied) */
+    bfcp_header header;     /*     The Common Header */
+    e_bfcp_error_codes error; /*     The framing error, if parsing failed */
+    UINT16 count;           /*     The number of top-level attributes */
+    bfcp_lazy_attribute
+        attributes[BFCP_LAZY_MAX_ATTRIBUTES]; /*     Their framing */
+} bfcp_lazy_message;
+
 typedef struct bfcp_received_message_error {
     e_bfcp_error_codes code;    /*     The Parsing-specific Error Code */
     e_bfcp_attibutes attribute; /*     The attribute where the error happened */
@@ -818,6 +961,13 @@ bfcp_message *bfcp_new_message(unsigned char *buffer, UINT16 length);
 bfcp_message *bfcp_copy_message(bfcp_message *message);
 /*     Free a Message */
 int bfcp_free_message(bfcp_message *message);
+/*     Create a Shared Message holding a copy of a buffer (one reference) */
+bfcp_shared_message *bfcp_new_shared_message(const unsigned char *buffer,
+                                             UINT16 length);
+/*     Take a reference on a Shared Message */
+bfcp_shared_message *bfcp_retain_shared_message(bfcp_shared_message *shared);
+/*     Drop a reference on a Shared Message, freeing it with the last one */
+void bfcp_release_shared_message(bfcp_shared_message *shared);
 
 /*     Create a New Entity (Conference ID, Transaction ID, User ID) */
 bfcp_entity *bfcp_new_entity(UINT32 conferenceID, UINT16 transactionID,
@@ -926,6 +1076,9 @@ bfcp_message *bfcp_build_message(bfcp_arguments *arguments);
 /*     Build Headers */
 void bfcp_build_commonheader(bfcp_message *message, bfcp_entity *entity,
                              e_bfcp_primitives primitive, int unreliable);
+/*     Rewrite TransactionID and UserID of an encoded message */
+void bfcp_stamp_commonheader(bfcp_message *message, UINT16 transactionID,
+                             UINT16 userID);
 void bfcp_build_attribute_tlv(bfcp_message *message, UINT16 position,
                               UINT16 type, UINT16 mandatory_bit, UINT16 length);
 
@@ -1005,6 +1158,59 @@ int bfcp_build_attribute_OVERALL_REQUEST_STATUS(
 int bfcp_build_attribute_NONCE(bfcp_message *message, UINT16 nonce);
 int bfcp_build_attribute_DIGEST(bfcp_message *message, bfcp_digest *digest);
 
+/*     Attribute Schema Methods */
+const bfcp_attribute_schema *bfcp_get_attribute_schema(UINT32 type);
+/*     Check an attribute against the schema, either directly in a primitive
+ * (parent is NULL) or in a grouped attribute: return 0 if it is valid,
+ * BFCP_UNKNOWN_ATTRIBUTE, BFCP_WRONG_LENGTH (also when it overflows its
+ * parent) or BFCP_PARSING_ERROR (not allowed there) */
+int bfcp_check_attribute(const bfcp_received_attribute *parent,
+                         const bfcp_received_attribute *attribute);
+
+/*     Encode Methods (caller buffer, no allocation unless 'grow' is set) */
+void bfcp_encode_begin(bfcp_encoder *encoder, unsigned char *buffer,
+                       UINT32 size, e_bfcp_primitives primitive,
+                       UINT32 conferenceID, UINT16 transactionID,
+                       UINT16 userID, int unreliable);
+int bfcp_encode_end(bfcp_encoder *encoder);
+void bfcp_encode_release(bfcp_encoder *encoder);
+void bfcp_encode_attribute_u16(bfcp_encoder *encoder, e_bfcp_attibutes type,
+                               UINT16 value);
+void bfcp_encode_attribute_PRIORITY(bfcp_encoder *encoder,
+                                    e_bfcp_priority priority);
+void bfcp_encode_attribute_REQUEST_STATUS(bfcp_encoder *encoder,
+                                          e_bfcp_status status,
+                                          UINT8 queue_position);
+void bfcp_encode_attribute_text(bfcp_encoder *encoder, e_bfcp_attibutes type,
+                                const char *text);
+void bfcp_encode_attribute_list(bfcp_encoder *encoder, e_bfcp_attibutes type,
+                                const UINT8 *elements, UINT16 count);
+void bfcp_encode_attribute_ERROR_CODE(bfcp_encoder *encoder,
+                                      e_bfcp_error_codes code,
+                                      const UINT8 *unknown_types,
+                                      UINT16 count);
+UINT32 bfcp_encode_group_begin(bfcp_encoder *encoder, e_bfcp_attibutes type,
+                               UINT16 ID);
+void bfcp_encode_group_end(bfcp_encoder *encoder, UINT32 offset);
+
+/*     Encode Specific Messages: return the exact length of the message, which
+       was only written if it fits in 'size' (-1 on failure) */
+int bfcp_encode_message_Error(unsigned char *buffer, UINT32 size,
+                              UINT32 conferenceID, UINT16 transactionID,
+                              UINT16 userID, e_bfcp_error_codes code,
+                              const UINT8 *unknown_types, UINT16 count,
+                              const char *eInfo, int unreliable);
+
+/*     Message Template Methods: the template is encoded once, then only
+       stamped with the IDs of each message */
+int bfcp_template_init(bfcp_template *tpl, e_bfcp_primitives primitive,
+                       int unreliable, const UINT8 *primitives,
+                       UINT16 nprimitives, const UINT8 *attributes,
+                       UINT16 nattributes);
+int bfcp_template_stamp(const bfcp_template *tpl, unsigned char *buffer,
+                        UINT32 size, UINT32 conferenceID, UINT16 transactionID,
+                        UINT16 userID);
+
 /*     Parse Methods */
 UINT16 bfcp_get_length(bfcp_message *message);
 e_bfcp_primitives bfcp_get_primitive(bfcp_message *message);
@@ -1020,6 +1226,9 @@ int bfcp_free_received_message_errors(bfcp_received_message_error *errors);
 bfcp_received_attribute *bfcp_new_received_attribute(void);
 int bfcp_free_received_attribute(bfcp_received_attribute *recvA);
 bfcp_received_message *bfcp_parse_message(bfcp_message *message);
+/*     Same as bfcp_parse_message, for a message bfcp_validate_message already
+ * accepted (the transport validates what it reads) */
+bfcp_received_message *bfcp_parse_validated_message(bfcp_message *message);
 bfcp_received_attribute *bfcp_parse_attribute(bfcp_message *message);
 int bfcp_parse_arguments(bfcp_received_message *recvM, bfcp_message *message);
 int bfcp_parse_attribute_BENEFICIARY_ID(bfcp_message *message,
@@ -1063,6 +1272,28 @@ int bfcp_parse_attribute_NONCE(bfcp_message *message,
 bfcp_digest *bfcp_parse_attribute_DIGEST(bfcp_message *message,
                                          bfcp_received_attribute *recvA);
 
+/*     Framing Validation Methods (no allocation): return 0 if the message is
+ * valid, BFCP_PARSING_ERROR if its attributes can't be walked safely (drop it),
+ * or else BFCP_WRONG_VERSION, BFCP_WRONG_LENGTH or
+ * BFCP_UNKNOWN_MANDATORY_ATTRIBUTE, which bfcp_parse_message reports */
+int bfcp_validate_message(const unsigned char *buffer, UINT32 length);
+
+/*     Lazy Parse Methods (no allocation: the buffer must outlive the lazy
+ * message) */
+/*     Validate the framing of a message and locate its attributes: return 0 on
+ * success, -1 on framing error (see 'error'), -2 if there are more than
+ * BFCP_LAZY_MAX_ATTRIBUTES attributes (use bfcp_parse_message instead) */
+int bfcp_lazy_parse(bfcp_lazy_message *lazy, unsigned char *buffer,
+                    UINT32 length);
+int bfcp_lazy_find(const bfcp_lazy_message *lazy, e_bfcp_attibutes type,
+                   int nth);
+UINT16 bfcp_lazy_get_u16(const bfcp_lazy_message *lazy, e_bfcp_attibutes type,
+                         int nth);
+int bfcp_lazy_get_attribute(const bfcp_lazy_message *lazy,
+                            e_bfcp_attibutes type, int nth,
+                            bfcp_message *message,
+                            bfcp_received_attribute *recvA);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
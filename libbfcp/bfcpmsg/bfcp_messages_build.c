@@ -72,6 +72,8 @@ bfcp_message *bfcp_build_message(bfcp_arguments* arguments)
             return bfcp_build_message_GoodbyeAck(arguments->entity);
 		case e_primitive_Error:
 			return bfcp_build_message_Error(arguments->entity, arguments->error, arguments->eInfo, arguments->unreliable);
+		case e_primitive_ErrorAck:
+			return bfcp_build_message_ErrorAck(arguments->entity);
 		default:
 			return NULL;	/* Unrecognized Primitive: return with a failure */
 	}
@@ -110,6 +112,19 @@ void bfcp_build_commonheader(bfcp_message *message, bfcp_entity *entity, e_bfcp_
 	            entity->conferenceID, entity->userID, entity->transactionID);
 }
 
+/* Rewrite the TransactionID and UserID of an already built message: used to
+   encode a notification once and send it to several participants */
+void bfcp_stamp_commonheader(bfcp_message *message, UINT16 transactionID, UINT16 userID)
+{
+	UINT16 ch16;	/* 16 bits */
+	if(!message || !message->buffer || message->length < 12)
+		return;
+	ch16 = htons(transactionID);
+	memcpy(message->buffer+8, &ch16, 2);
+	ch16 = htons(userID);
+	memcpy(message->buffer+10, &ch16, 2);
+}
+
 /* Build the first 16 bits of the Attribute */
 void bfcp_build_attribute_tlv(bfcp_message *message, UINT16 position, UINT16 type, UINT16 mandatory_bit, UINT16 length)
 {
@@ -0,0 +1,194 @@
+/**
+ *
+ * \brief C++ owners over the bfcpmsg structures
+ *
+ * Header-only helpers for the C++ callers of the codec: owners free their
+ * structure when they go out of scope (they can't be copied, ownership is
+ * handed over with release()), and BFCP_Encoder streams a message in a stack
+ * buffer through the bfcp_encode_* methods, without building the arguments
+ * tree nor allocating (but for the rare message larger than that buffer).
+ *
+ * \file bfcp_messages_cpp.h
+ *
+ * \remarks :
+ */
+#ifndef _BFCP_MESSAGES_CPP_H
+#define _BFCP_MESSAGES_CPP_H
+
+#include "bfcp_messages.h"
+
+#ifdef __cplusplus
+
+/**
+ * Sole owner of a codec structure, freed with 'Free' on destruction.
+ */
+template <typename T, int (*Free)(T *)>
+class BFCP_Owner {
+   public:
+    explicit BFCP_Owner(T *p = NULL) : m_p(p) {}
+    ~BFCP_Owner() {
+        if (m_p) Free(m_p);
+    }
+
+    T *get() const { return m_p; }
+    T *operator->() const { return m_p; }
+    bool operator!() const { return m_p == NULL; }
+
+    /** Give up ownership, the caller frees the structure */
+    T *release() {
+        T *p = m_p;
+        m_p = NULL;
+        return p;
+    }
+
+    /** Free the structure owned so far, and own 'p' instead */
+    void reset(T *p = NULL) {
+        if (m_p && m_p != p) Free(m_p);
+        m_p = p;
+    }
+
+    void swap(BFCP_Owner &other) {
+        T *p = m_p;
+        m_p = other.m_p;
+        other.m_p = p;
+    }
+
+   private:
+    BFCP_Owner(const BFCP_Owner &);
+    BFCP_Owner &operator=(const BFCP_Owner &);
+
+    T *m_p;
+};
+
+typedef BFCP_Owner<bfcp_message, bfcp_free_message> BFCP_Message;
+typedef BFCP_Owner<bfcp_arguments, bfcp_free_arguments> BFCP_Arguments;
+typedef BFCP_Owner<bfcp_floor_request_information,
+                   bfcp_free_floor_request_information_list>
+    BFCP_FloorRequestInfo;
+
+/**
+ * Owner of a parsed message, with accessors that are safe on partially
+ * parsed messages (texts are never NULL).
+ */
+class BFCP_ReceivedMessage
+    : public BFCP_Owner<bfcp_received_message, bfcp_free_received_message> {
+   public:
+    explicit BFCP_ReceivedMessage(bfcp_received_message *p = NULL)
+        : BFCP_Owner<bfcp_received_message, bfcp_free_received_message>(p) {}
+
+    /** Parse a raw message: check the result with operator! */
+    explicit BFCP_ReceivedMessage(bfcp_message *message)
+        : BFCP_Owner<bfcp_received_message, bfcp_free_received_message>(
+              bfcp_parse_message(message)) {}
+
+    e_bfcp_primitives primitive() const {
+        return get() ? get()->primitive : e_primitive_InvalidPrimitive;
+    }
+    UINT32 conferenceID() const {
+        return (get() && get()->entity) ? get()->entity->conferenceID : 0;
+    }
+    UINT16 transactionID() const {
+        return (get() && get()->entity) ? get()->entity->transactionID : 0;
+    }
+    UINT16 userID() const {
+        return (get() && get()->entity) ? get()->entity->userID : 0;
+    }
+    bool hasErrors() const { return get() && get()->errors; }
+    const bfcp_arguments *arguments() const {
+        return get() ? get()->arguments : NULL;
+    }
+    const char *statusInfo() const { return Text(arguments(), &bfcp_arguments::sInfo); }
+    const char *errorInfo() const { return Text(arguments(), &bfcp_arguments::eInfo); }
+    const char *participantInfo() const {
+        return Text(arguments(), &bfcp_arguments::pInfo);
+    }
+
+   private:
+    static const char *Text(const bfcp_arguments *arguments,
+                            char *bfcp_arguments::*field) {
+        return (arguments && arguments->*field) ? arguments->*field : "";
+    }
+};
+
+/**
+ * Message encoded in an internal buffer of 'Size' octets (on the stack when
+ * the encoder is), to be sent with sendBFCPmessage(s, encoder.message()). A
+ * larger message moves to the heap, up to BFCP_MAX_ALLOWED_SIZE octets.
+ */
+template <unsigned int Size>
+class BFCP_Encoder {
+   public:
+    BFCP_Encoder(e_bfcp_primitives primitive, UINT32 conferenceID,
+                 UINT16 transactionID, UINT16 userID, int unreliable = 0) {
+        m_encoder.heap = NULL;
+        reset(primitive, conferenceID, transactionID, userID, unreliable);
+    }
+    ~BFCP_Encoder() { bfcp_encode_release(&m_encoder); }
+
+    /** Start another message, in place of the one encoded so far */
+    void reset(e_bfcp_primitives primitive, UINT32 conferenceID,
+               UINT16 transactionID, UINT16 userID, int unreliable = 0) {
+        bfcp_encode_release(&m_encoder);
+        bfcp_encode_begin(&m_encoder, m_buffer, Size, primitive, conferenceID,
+                          transactionID, userID, unreliable);
+        m_encoder.grow = 1;
+        m_message.buffer = m_buffer;
+        m_message.position = 0;
+        m_message.length = 0;
+        m_depth = 0;
+    }
+
+    BFCP_Encoder &u16(e_bfcp_attibutes type, UINT16 value) {
+        bfcp_encode_attribute_u16(&m_encoder, type, value);
+        return *this;
+    }
+    BFCP_Encoder &priority(e_bfcp_priority priority) {
+        bfcp_encode_attribute_PRIORITY(&m_encoder, priority);
+        return *this;
+    }
+    BFCP_Encoder &text(e_bfcp_attibutes type, const char *text) {
+        bfcp_encode_attribute_text(&m_encoder, type, text);
+        return *this;
+    }
+    BFCP_Encoder &requestStatus(e_bfcp_status status, UINT8 queue_position) {
+        bfcp_encode_attribute_REQUEST_STATUS(&m_encoder, status, queue_position);
+        return *this;
+    }
+
+    /** Open a grouped attribute, closed by end(): groups nest twice at most */
+    BFCP_Encoder &group(e_bfcp_attibutes type, UINT16 ID) {
+        UINT32 offset = bfcp_encode_group_begin(&m_encoder, type, ID);
+        if (m_depth < 2) m_groups[m_depth] = offset;
+        m_depth++;
+        return *this;
+    }
+    BFCP_Encoder &end() {
+        if (m_depth > 0 && --m_depth < 2)
+            bfcp_encode_group_end(&m_encoder, m_groups[m_depth]);
+        return *this;
+    }
+
+    /** Complete the message: NULL if it can't be encoded */
+    bfcp_message *message() {
+        int length = bfcp_encode_end(&m_encoder);
+        if (m_depth != 0 || length < 0 || length > (int)m_encoder.size)
+            return NULL;
+        m_message.buffer = m_encoder.buffer;
+        m_message.length = (UINT16)length;
+        return &m_message;
+    }
+
+   private:
+    BFCP_Encoder(const BFCP_Encoder &);
+    BFCP_Encoder &operator=(const BFCP_Encoder &);
+
+    unsigned char m_buffer[Size];
+    bfcp_encoder m_encoder;
+    bfcp_message m_message;
+    UINT32 m_groups[2];
+    int m_depth;
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -0,0 +1,299 @@
+/**
+ *
+ * \brief Methodes for encoding messages in caller buffers
+ *
+ * Unlike the bfcp_build_message_* methods, the encoder takes flat parameters
+ * and streams the message in a buffer owned by the caller (stack buffer, ring
+ * slot...), so that it never allocates. When the buffer is too small (or NULL)
+ * nothing past its end is written, but the exact size needed is still
+ * computed, so that the encoder can also be used to size the buffer first.
+ * A caller that sets 'grow' instead has the message moved to a heap buffer
+ * when it outgrows its own.
+ *
+ * \file bfcp_messages_encode.c
+ *
+ * \remarks :
+ */
+
+/* ==========================================================================*/
+/* include(s)                                                                */
+/* ==========================================================================*/
+#include "bfcp_messages.h"
+#include "bfcp_alloc.h"
+
+/* ==========================================================================*/
+/* Code                                                                      */
+/* ==========================================================================*/
+
+/* Move the message to a heap buffer of at least 'size' bytes: on failure the encoder only counts from now on */
+static void bfcp_encode_grow(bfcp_encoder *encoder, UINT32 size)
+{
+	UINT32 newsize = encoder->size*2;
+	unsigned char *heap;
+
+	if(newsize < size)
+		newsize = size;
+	if(newsize > BFCP_MAX_ALLOWED_SIZE)
+		newsize = BFCP_MAX_ALLOWED_SIZE;
+	heap = (unsigned char *)BFCP_REALLOC(BFCP_ALLOC_MESSAGE, encoder->heap, newsize);
+	if(!heap) {
+		encoder->grow = 0;
+		return;
+	}
+	if(!encoder->heap)
+		memcpy(heap, encoder->buffer, encoder->length);
+	encoder->buffer = encoder->heap = heap;
+	encoder->size = newsize;
+}
+
+/* Reserve 'length' bytes at the end of the message: return where to write them,
+   or NULL if they don't fit in the caller buffer (they are still accounted) */
+static unsigned char *bfcp_encode_reserve(bfcp_encoder *encoder, UINT32 length)
+{
+	unsigned char *buffer = NULL;
+	if(encoder->grow && (encoder->buffer != NULL) && (encoder->length <= encoder->size) &&
+			(encoder->length+length > encoder->size) && (encoder->length+length <= BFCP_MAX_ALLOWED_SIZE))
+		bfcp_encode_grow(encoder, encoder->length+length);
+	if((encoder->buffer != NULL) && (encoder->length+length <= encoder->size))
+		buffer = encoder->buffer+encoder->length;
+	encoder->length = encoder->length+length;
+	return buffer;
+}
+
+/* Write the TLV of an attribute at a given offset, if it is in the caller buffer */
+static void bfcp_encode_tlv(bfcp_encoder *encoder, UINT32 offset, UINT16 type, UINT16 length)
+{
+	UINT16 tlv;
+	if((encoder->buffer == NULL) || (offset+2 > encoder->size))
+		return;
+	tlv = htons((UINT16)((type << 9) | (1 << 8) | (length & 0x00FF)));	/* Mandatory bit always set */
+	memcpy(encoder->buffer+offset, &tlv, 2);
+}
+
+/* Get the schema of an attribute to encode, or fail the message if the type isn't of the kind expected */
+static const bfcp_attribute_schema *bfcp_encode_schema(bfcp_encoder *encoder, e_bfcp_attibutes type, e_bfcp_attribute_kind kind)
+{
+	const bfcp_attribute_schema *schema = bfcp_get_attribute_schema(type);
+	if((schema == NULL) || (schema->kind != kind)) {
+		encoder->failed = 1;
+		return NULL;
+	}
+	return schema;
+}
+
+/* Add a 16 bits value with its TLV, the whole attribute or the head of a grouped attribute */
+static void bfcp_encode_u16(bfcp_encoder *encoder, e_bfcp_attibutes type, UINT16 value)
+{
+	UINT32 offset = encoder->length;
+	unsigned char *buffer = bfcp_encode_reserve(encoder, 4);
+	if(!buffer)
+		return;
+	value = htons(value);
+	memcpy(buffer+2, &value, 2);
+	bfcp_encode_tlv(encoder, offset, type, 4);
+}
+
+/* Start a message: reserve the Common Header */
+void bfcp_encode_begin(bfcp_encoder *encoder, unsigned char *buffer, UINT32 size, e_bfcp_primitives primitive, UINT32 conferenceID, UINT16 transactionID, UINT16 userID, int unreliable)
+{
+	unsigned char *header;
+	UINT32 ch32;
+	UINT16 ch16;
+
+	encoder->buffer = buffer;
+	encoder->size = (buffer != NULL) ? size : 0;
+	encoder->length = 0;
+	encoder->failed = 0;
+	encoder->grow = 0;
+	encoder->heap = NULL;
+
+	header = bfcp_encode_reserve(encoder, 12);
+	if(!header)
+		return;
+	/* Version 1, unreliable response marker and primitive: the payload length is set by bfcp_encode_end */
+	ch32 = htonl((1 << 29) | ((unreliable ? 1 : 0) << 24) | ((primitive & 0xFF) << 16));
+	memcpy(header, &ch32, 4);
+	ch32 = htonl(conferenceID);
+	memcpy(header+4, &ch32, 4);
+	ch16 = htons(transactionID);
+	memcpy(header+8, &ch16, 2);
+	ch16 = htons(userID);
+	memcpy(header+10, &ch16, 2);
+}
+
+/* Complete a message: return its exact length (if larger than the caller buffer, the message was not written), or -1 if it can't be encoded */
+int bfcp_encode_end(bfcp_encoder *encoder)
+{
+	UINT16 ch16;
+	if(encoder->failed)
+		return -1;
+	if((encoder->length > BFCP_MAX_ALLOWED_SIZE) || ((encoder->length%4) != 0))
+		return -1;
+	if((encoder->buffer != NULL) && (encoder->length <= encoder->size)) {
+		ch16 = htons((UINT16)((encoder->length-12)/4));	/* Payload length in 32 bits words */
+		memcpy(encoder->buffer+2, &ch16, 2);
+	}
+	return (int)encoder->length;
+}
+
+/* Free the heap buffer of a message that grew out of the caller buffer */
+void bfcp_encode_release(bfcp_encoder *encoder)
+{
+	if(encoder->heap)
+		BFCP_FREE(BFCP_ALLOC_MESSAGE, encoder->heap);
+	encoder->heap = NULL;
+}
+
+/* Add a 16 bits attribute (FLOOR-ID, BENEFICIARY-ID, FLOOR-REQUEST-ID or NONCE) */
+void bfcp_encode_attribute_u16(bfcp_encoder *encoder, e_bfcp_attibutes type, UINT16 value)
+{
+	if(bfcp_encode_schema(encoder, type, e_bfcp_kind_u16) == NULL)
+		return;
+	bfcp_encode_u16(encoder, type, value);
+}
+
+/* Add a PRIORITY attribute */
+void bfcp_encode_attribute_PRIORITY(bfcp_encoder *encoder, e_bfcp_priority priority)
+{
+	bfcp_encode_attribute_u16(encoder, PRIORITY, (UINT16)((priority & 0x07) << 13));	/* 13 Reserved bits */
+}
+
+/* Add a REQUEST-STATUS attribute */
+void bfcp_encode_attribute_REQUEST_STATUS(bfcp_encoder *encoder, e_bfcp_status status, UINT8 queue_position)
+{
+	bfcp_encode_attribute_u16(encoder, REQUEST_STATUS, (UINT16)(((status & 0xFF) << 8) | queue_position));
+}
+
+/* Add an attribute made of raw octets followed by padding (ERROR-CODE, SUPPORTED-*, texts) */
+static void bfcp_encode_attribute_octets(bfcp_encoder *encoder, e_bfcp_attibutes type, const unsigned char *prefix, UINT32 prefix_len, const unsigned char *octets, UINT32 len)
+{
+	const bfcp_attribute_schema *schema = bfcp_encode_schema(encoder, type, e_bfcp_kind_octets);
+	UINT32 offset = encoder->length;
+	UINT32 attrlen;
+	UINT32 padding;
+	unsigned char *buffer;
+
+	if(schema == NULL)
+		return;
+	if(2+prefix_len+len > schema->max_length) {	/* Truncate to what the decoder accepts */
+		BFCP_msgLog(WAR, "bfcp_encode: attribute %d of %u octets truncated to %d", type, prefix_len+len, schema->max_length-2);
+		len = schema->max_length-2-prefix_len;
+	}
+	attrlen = 2+prefix_len+len;
+	if(attrlen < schema->min_length)	/* Empty text or list: the decoder would reject it, leave it out */
+		return;
+	padding = (attrlen%4) ? 4-(attrlen%4) : 0;
+	buffer = bfcp_encode_reserve(encoder, attrlen+padding);
+	if(!buffer)
+		return;
+	if(prefix_len)
+		memcpy(buffer+2, prefix, prefix_len);
+	if(len)
+		memcpy(buffer+2+prefix_len, octets, len);
+	if(padding)
+		memset(buffer+attrlen, 0, padding);
+	bfcp_encode_tlv(encoder, offset, type, (UINT16)attrlen);
+}
+
+/* Add a text attribute (ERROR-INFO, PARTICIPANT-PROVIDED-INFO, STATUS-INFO, USER-DISPLAY-NAME or USER-URI) */
+void bfcp_encode_attribute_text(bfcp_encoder *encoder, e_bfcp_attibutes type, const char *text)
+{
+	if(!text)
+		return;
+	bfcp_encode_attribute_octets(encoder, type, NULL, 0, (const unsigned char *)text, (UINT32)strlen(text));
+}
+
+/* Add a SUPPORTED-PRIMITIVES or SUPPORTED-ATTRIBUTES attribute */
+void bfcp_encode_attribute_list(bfcp_encoder *encoder, e_bfcp_attibutes type, const UINT8 *elements, UINT16 count)
+{
+	bfcp_encode_attribute_octets(encoder, type, NULL, 0, elements, count);
+}
+
+/* Add an ERROR-CODE attribute, with the unknown attribute types for BFCP_UNKNOWN_MANDATORY_ATTRIBUTE */
+void bfcp_encode_attribute_ERROR_CODE(bfcp_encoder *encoder, e_bfcp_error_codes code, const UINT8 *unknown_types, UINT16 count)
+{
+	unsigned char raw = (unsigned char)code;
+	unsigned char details[255];
+	UINT16 i;
+
+	if(code != BFCP_UNKNOWN_MANDATORY_ATTRIBUTE)
+		count = 0;
+	if(count > sizeof(details)-3)
+		count = sizeof(details)-3;
+	for(i = 0; i < count; i++)
+		details[i] = (unsigned char)(unknown_types[i] << 1);	/* Attribute: 7 bits, then the Reserved bit */
+	bfcp_encode_attribute_octets(encoder, ERROR_CODE, &raw, 1, details, count);
+}
+
+/* Open a grouped attribute (FLOOR-REQUEST-INFORMATION, ...) with its leading 16 bits ID: return the offset to pass to bfcp_encode_group_end */
+UINT32 bfcp_encode_group_begin(bfcp_encoder *encoder, e_bfcp_attibutes type, UINT16 ID)
+{
+	UINT32 offset = encoder->length;
+	if(bfcp_encode_schema(encoder, type, e_bfcp_kind_grouped) != NULL)
+		bfcp_encode_u16(encoder, type, ID);
+	return offset;
+}
+
+/* Close a grouped attribute, now that the length of its content is known */
+void bfcp_encode_group_end(bfcp_encoder *encoder, UINT32 offset)
+{
+	UINT16 type;
+	if(encoder->length-offset > 0xFF) {	/* The attribute length is 8 bits */
+		encoder->failed = 1;
+		return;
+	}
+	if((encoder->buffer == NULL) || (encoder->length > encoder->size))
+		return;
+	type = (UINT16)(encoder->buffer[offset] >> 1);
+	bfcp_encode_tlv(encoder, offset, type, (UINT16)(encoder->length-offset));
+}
+
+/* Encode an Error message */
+int bfcp_encode_message_Error(unsigned char *buffer, UINT32 size, UINT32 conferenceID, UINT16 transactionID, UINT16 userID, e_bfcp_error_codes code, const UINT8 *unknown_types, UINT16 count, const char *eInfo, int unreliable)
+{
+	bfcp_encoder encoder;
+	bfcp_encode_begin(&encoder, buffer, size, e_primitive_Error, conferenceID, transactionID, userID, unreliable);
+	bfcp_encode_attribute_ERROR_CODE(&encoder, code, unknown_types, count);
+	if(eInfo && *eInfo)
+		bfcp_encode_attribute_text(&encoder, ERROR_INFO, eInfo);
+	return bfcp_encode_end(&encoder);
+}
+
+/* Pre-encode a message whose only variable fields are the IDs of the Common Header (acks, Hello, HelloAck) */
+int bfcp_template_init(bfcp_template *tpl, e_bfcp_primitives primitive, int unreliable, const UINT8 *primitives, UINT16 nprimitives, const UINT8 *attributes, UINT16 nattributes)
+{
+	bfcp_encoder encoder;
+	int length;
+
+	if(!tpl)
+		return -1;
+	tpl->length = 0;
+	bfcp_encode_begin(&encoder, tpl->buffer, sizeof(tpl->buffer), primitive, 0, 0, 0, unreliable);
+	if(primitives && nprimitives)
+		bfcp_encode_attribute_list(&encoder, SUPPORTED_PRIMITIVES, primitives, nprimitives);
+	if(attributes && nattributes)
+		bfcp_encode_attribute_list(&encoder, SUPPORTED_ATTRIBUTES, attributes, nattributes);
+	length = bfcp_encode_end(&encoder);
+	if((length < 0) || (length > (int)sizeof(tpl->buffer)))
+		return -1;
+	tpl->length = (UINT16)length;
+	return 0;
+}
+
+/* Copy a template in a caller buffer, stamping its IDs: return the length of the message, or -1 */
+int bfcp_template_stamp(const bfcp_template *tpl, unsigned char *buffer, UINT32 size, UINT32 conferenceID, UINT16 transactionID, UINT16 userID)
+{
+	UINT32 ch32;
+	UINT16 ch16;
+
+	if(!tpl || !buffer || (tpl->length == 0) || (tpl->length > size))
+		return -1;
+	memcpy(buffer, tpl->buffer, tpl->length);
+	ch32 = htonl(conferenceID);
+	memcpy(buffer+4, &ch32, 4);
+	ch16 = htons(transactionID);
+	memcpy(buffer+8, &ch16, 2);
+	ch16 = htons(userID);
+	memcpy(buffer+10, &ch16, 2);
+	return tpl->length;
+}
@@ -13,7 +13,9 @@
  * \remarks :
  */
 #include "bfcp_messages.h"
+#include "bfcp_alloc.h"
 #include "bfcp_strings.h"
+#include "../bfcp_probes.h"
 
 /* ==========================================================================*/
 /* Code                                                                      */
@@ -124,7 +126,8 @@ UINT16 bfcp_get_userID(bfcp_message *message) {
 
 bfcp_received_message *bfcp_new_received_message(void) {
     bfcp_received_message *recvM =
-        (bfcp_received_message *)calloc(1, sizeof(bfcp_received_message));
+        (bfcp_received_message *)BFCP_CALLOC(BFCP_ALLOC_RECEIVED, 1,
+                                             sizeof(bfcp_received_message));
     if (!recvM) /* We could not allocate the memory, return with a failure */
     {
         return NULL;
@@ -151,7 +154,7 @@ int bfcp_free_received_message(bfcp_received_message *recvM) {
     if (recvM->first_attribute)
         res += bfcp_free_received_attribute(recvM->first_attribute);
     if (recvM->errors) res += bfcp_free_received_message_errors(recvM->errors);
-    free(recvM);
+    BFCP_FREE(BFCP_ALLOC_RECEIVED, recvM);
     if (!res) /* No error occurred, succesfully freed the structure */
         return 0;
     else /* res was not 0, so some error occurred, return with a failure */
@@ -165,7 +168,8 @@ bfcp_received_message_error *bfcp_received_message_add_error(
 
     /* temp = (bfcp_received_message_error *) = malloc(
      * sizeof(bfcp_received_message_error) ); */
-    temp = malloc(sizeof(bfcp_received_message_error));
+    temp = BFCP_MALLOC(BFCP_ALLOC_RECEIVED,
+                       sizeof(bfcp_received_message_error));
     if (temp == NULL)
         return NULL; /* We could not allocate the memory, return with a failure
                       */
@@ -192,7 +196,7 @@ int bfcp_free_received_message_errors(bfcp_received_message_error *errors) {
         bfcp_received_message_error *next = NULL, *temp = errors;
         while (temp) {
             next = temp->next;
-            free(temp);
+            BFCP_FREE(BFCP_ALLOC_RECEIVED, temp);
             temp = next;
         }
     }
@@ -201,7 +205,8 @@ int bfcp_free_received_message_errors(bfcp_received_message_error *errors) {
 
 bfcp_received_attribute *bfcp_new_received_attribute(void) {
     bfcp_received_attribute *recvA =
-        (bfcp_received_attribute *)calloc(1, sizeof(bfcp_received_attribute));
+        (bfcp_received_attribute *)BFCP_CALLOC(BFCP_ALLOC_RECEIVED, 1,
+                                               sizeof(bfcp_received_attribute));
     if (!recvA) /* We could not allocate the memory, return with a failure */
         return NULL;
     recvA->type = INVALID_ATTRIBUTE;
@@ -220,19 +225,52 @@ int bfcp_free_received_attribute(bfcp_received_attribute *recvA) {
         bfcp_received_attribute *next = NULL, *temp = recvA;
         while (temp) {
             next = temp->next;
-            free(temp);
+            BFCP_FREE(BFCP_ALLOC_RECEIVED, temp);
             temp = next;
         }
     }
     return 0;
 }
 
+static bfcp_received_message *parse_message(bfcp_message *message,
+                                            int validated);
+
+static bfcp_received_message *probe_parse_message(bfcp_message *message,
+                                                  int validated) {
+    bfcp_received_message *recvM;
+
+    BFCP_PROBE1(parse_entry, message ? message->length : 0);
+    recvM = parse_message(message, validated);
+    BFCP_PROBE2(parse_exit, recvM ? recvM->primitive : 0,
+                recvM && recvM->errors ? 1 : 0);
+    return recvM;
+}
+
 bfcp_received_message *bfcp_parse_message(bfcp_message *message) {
+    return probe_parse_message(message, 0);
+}
+
+bfcp_received_message *bfcp_parse_validated_message(bfcp_message *message) {
+    return probe_parse_message(message, 1);
+}
+
+static bfcp_received_message *parse_message(bfcp_message *message,
+                                            int validated) {
     bfcp_received_attribute *temp1 = NULL, *temp2 = NULL, *previous = NULL;
     unsigned char *buffer;
     UINT16 ch16; /* 16 bits */
     UINT32 ch32; /* 32 bits */
-    bfcp_received_message *recvM = bfcp_new_received_message();
+    bfcp_received_message *recvM = NULL;
+
+    /* Drop the messages we can't walk safely before allocating anything */
+    if (!message ||
+        (!validated && bfcp_validate_message(message->buffer,
+                                             message->length) ==
+                           BFCP_PARSING_ERROR)) {
+        BFCP_msgLog(ERR, "Malformed BFCP message framing. Discarding !");
+        return NULL;
+    }
+    recvM = bfcp_new_received_message();
     if (!recvM) /* We could not allocate the memory, return with a failure */
         return NULL;
 
@@ -417,7 +455,7 @@ int bfcp_parse_arguments(bfcp_received_message *recvM, bfcp_message *message) {
     if (!recvM) /* We could not allocate the memory, return with a failure */
         return -1;
     else {
-        int floorID;
+        int floorID, check;
         bfcp_floor_id_list *tempID = NULL; /* To manage the FLOOR-ID List */
         bfcp_floor_request_information
             *tempInfo = NULL,
@@ -440,6 +478,21 @@ int bfcp_parse_arguments(bfcp_received_message *recvM, bfcp_message *message) {
             } else {
                 // BFCP_msgLog(INF,"< attribute [%s] (%d) ",
                 // getBfcpAttribute(temp->type), temp->type);
+                /* The schema rules out the attributes which can't be there */
+                check = bfcp_check_attribute(NULL, temp);
+                if (check == BFCP_PARSING_ERROR)
+                    return -1; /* We can't have this Attribute directly in a
+                                  primitive */
+                if (check == BFCP_WRONG_LENGTH) {
+                    recvM->errors = bfcp_received_message_add_error(
+                        recvM->errors, temp->type, BFCP_WRONG_LENGTH);
+                    if (!(recvM->errors))
+                        return -1; /* An error occurred while recording the
+                                      error, return with failure */
+                    temp->valid = 0; /* We mark the attribute as not valid */
+                    temp = temp->next;
+                    continue;
+                }
                 switch (temp->type) { /* ...if it's valid, we parse it */
                     case BENEFICIARY_ID:
                         recvM->arguments->bID =
@@ -608,12 +661,6 @@ int bfcp_parse_arguments(bfcp_received_message *recvM, bfcp_message *message) {
                                               the error, return with failure */
                         }
                         break;
-                    case USER_DISPLAY_NAME:
-                        return -1; /* We can't have this Attribute directly in a
-                                      primitive */
-                    case USER_URI:
-                        return -1; /* We can't have this Attribute directly in a
-                                      primitive */
                     case BENEFICIARY_INFORMATION:
                         recvM->arguments->beneficiary =
                             bfcp_parse_attribute_BENEFICIARY_INFORMATION(
@@ -650,7 +697,8 @@ int bfcp_parse_arguments(bfcp_received_message *recvM, bfcp_message *message) {
                             // Note(hsu)
                             //  FloorRequestInformation->OverallRequestStatus->FloorRequestStatus中
                             //  解析到了有效的FloorID，则添加至本地
-                            if (recvM->arguments->frqInfo->oRS &&
+                            if (recvM->arguments->frqInfo &&
+                                recvM->arguments->frqInfo->oRS &&
                                 recvM->arguments->frqInfo->oRS->floorID != 0) {
                                 tempID = recvM->arguments->fID;
                                 if (!tempID) {
@@ -686,6 +734,8 @@ int bfcp_parse_arguments(bfcp_received_message *recvM, bfcp_message *message) {
                                     return -1; /* An error occurred while
                                                   recording the error, return
                                                   with failure */
+                                tempInfo = previousInfo;
+                                break;
                             }
                             tempInfo->next = NULL;
                             previousInfo->next = tempInfo;
@@ -693,15 +743,6 @@ int bfcp_parse_arguments(bfcp_received_message *recvM, bfcp_message *message) {
                             break;
                         }
                         break;
-                    case REQUESTED_BY_INFORMATION:
-                        return -1; /* We can't have this Attribute directly in a
-                                      primitive */
-                    case FLOOR_REQUEST_STATUS:
-                        return -1; /* We can't have this Attribute directly in a
-                                      primitive */
-                    case OVERALL_REQUEST_STATUS:
-                        return -1; /* We can't have this Attribute directly in a
-                                      primitive */
                     case NONCE:
                         recvM->arguments->nonce =
                             bfcp_parse_attribute_NONCE(message, temp);
@@ -905,8 +946,9 @@ bfcp_error *bfcp_parse_attribute_ERROR_CODE(bfcp_message *message,
                     previous = NULL;
                     error->details = NULL;
                     for (i = 0; i < number; i++) {
-                        next = (bfcp_unknown_m_error_details *)calloc(
-                            1, sizeof(bfcp_unknown_m_error_details));
+                        next = (bfcp_unknown_m_error_details *)BFCP_CALLOC(
+                            BFCP_ALLOC_ATTRIBUTE, 1,
+                            sizeof(bfcp_unknown_m_error_details));
                         if (!next) {
                             BFCP_msgLog(INF,
                                         "< parse attribute ERROR_CODE details. "
@@ -944,8 +986,9 @@ char *bfcp_parse_attribute_ERROR_INFO(bfcp_message *message,
         char ch = '\0';
         unsigned char *buffer =
             message->buffer + recvA->position + 2; /* Skip the Header */
-        char *eInfo = (char *)calloc(
-            recvA->length - 1, sizeof(char)); /* Lenght is TLV Header too */
+        char *eInfo = (char *)BFCP_CALLOC(
+            BFCP_ALLOC_ATTRIBUTE, recvA->length - 1,
+            sizeof(char)); /* Lenght is TLV Header too */
         memcpy(eInfo, buffer, recvA->length - 2);
         memcpy(eInfo + (recvA->length - 2), &ch,
                1); /* We add a terminator char to the string */
@@ -965,8 +1008,9 @@ char *bfcp_parse_attribute_PARTICIPANT_PROVIDED_INFO(
         char ch = '\0';
         unsigned char *buffer =
             message->buffer + recvA->position + 2; /* Skip the Header */
-        char *pInfo = (char *)calloc(
-            recvA->length - 1, sizeof(char)); /* Lenght is TLV Header too */
+        char *pInfo = (char *)BFCP_CALLOC(
+            BFCP_ALLOC_ATTRIBUTE, recvA->length - 1,
+            sizeof(char)); /* Lenght is TLV Header too */
         memcpy(pInfo, buffer, recvA->length - 2);
         memcpy(pInfo + (recvA->length - 2), &ch,
                1); /* We add a terminator char to the string */
@@ -989,8 +1033,9 @@ char *bfcp_parse_attribute_STATUS_INFO(bfcp_message *message,
         char ch = '\0';
         unsigned char *buffer =
             message->buffer + recvA->position + 2; /* Skip the Header */
-        char *sInfo = (char *)calloc(
-            recvA->length - 1, sizeof(char)); /* Lenght is TLV Header too */
+        char *sInfo = (char *)BFCP_CALLOC(
+            BFCP_ALLOC_ATTRIBUTE, recvA->length - 1,
+            sizeof(char)); /* Lenght is TLV Header too */
         memcpy(sInfo, buffer, recvA->length - 2);
         memcpy(sInfo + (recvA->length - 2), &ch,
                1); /* We add a terminator char to the string */
@@ -1022,8 +1067,8 @@ bfcp_supported_list *bfcp_parse_attribute_SUPPORTED_ATTRIBUTES(
         first = NULL;
         previous = NULL;
         for (i = 0; i < number; i++) {
-            next =
-                (bfcp_supported_list *)calloc(1, sizeof(bfcp_supported_list));
+            next = (bfcp_supported_list *)BFCP_CALLOC(
+                BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_supported_list));
             if (next == NULL) {
                 /* Memory leak here. Previously parsed elemnts should be freed
                  */
@@ -1033,7 +1078,7 @@ bfcp_supported_list *bfcp_parse_attribute_SUPPORTED_ATTRIBUTES(
                             i);
                 return NULL;
             }
-            next->element = buffer[0];
+            next->element = buffer[i];
             /*
             BFCP_msgLog(INF, "< SUPPORTED_ATTRIBUTE: [%s] (%d) \n",
                         getBfcpAttribute((e_bfcp_attibutes)next->element),
@@ -1041,6 +1086,7 @@ bfcp_supported_list *bfcp_parse_attribute_SUPPORTED_ATTRIBUTES(
                         */
             if (!first) first = next;
             if (previous) previous->next = next;
+            previous = next;
         }
         next->next = NULL;
         return first;
@@ -1073,8 +1119,8 @@ bfcp_supported_list *bfcp_parse_attribute_SUPPORTED_PRIMITIVES(
 
         /* Let's parse each other supported primitive we find */
         for (i = 0; i < number; i++) {
-            next =
-                (bfcp_supported_list *)calloc(1, sizeof(bfcp_supported_list));
+            next = (bfcp_supported_list *)BFCP_CALLOC(
+                BFCP_ALLOC_ATTRIBUTE, 1, sizeof(bfcp_supported_list));
             if (!next) /* An error occurred in creating a new Supported
                           Attributes list */
                 return NULL;
@@ -1103,8 +1149,9 @@ char *bfcp_parse_attribute_USER_DISPLAY_NAME(bfcp_message *message,
         char ch = '\0';
         unsigned char *buffer =
             message->buffer + recvA->position + 2; /* Skip the Header */
-        char *display = (char *)calloc(
-            recvA->length - 1, sizeof(char)); /* Lenght is TLV Header too */
+        char *display = (char *)BFCP_CALLOC(
+            BFCP_ALLOC_ATTRIBUTE, recvA->length - 1,
+            sizeof(char)); /* Lenght is TLV Header too */
         memcpy(display, buffer, recvA->length - 2);
         memcpy(display + (recvA->length - 2), &ch,
                1); /* We add a terminator char to the string */
@@ -1127,8 +1174,9 @@ char *bfcp_parse_attribute_USER_URI(bfcp_message *message,
         char ch = '\0';
         unsigned char *buffer =
             message->buffer + recvA->position + 2; /* Skip the Header */
-        char *uri = (char *)calloc(recvA->length - 1,
-                                   sizeof(char)); /* Lenght is TLV Header too */
+        char *uri = (char *)BFCP_CALLOC(
+            BFCP_ALLOC_ATTRIBUTE, recvA->length - 1,
+            sizeof(char)); /* Lenght is TLV Header too */
         memcpy(uri, buffer, recvA->length - 2);
         memcpy(uri + (recvA->length - 2), &ch,
                1); /* We add a terminator char to the string */
@@ -1163,6 +1211,11 @@ bfcp_user_information *bfcp_parse_attribute_BENEFICIARY_INFORMATION(
             attribute = bfcp_parse_attribute(message);
             if (!attribute) /* An error occurred while parsing this attribute */
                 return NULL;
+            if (bfcp_check_attribute(recvA, attribute) ==
+                BFCP_WRONG_LENGTH) { /* It doesn't fit in the grouped attribute */
+                bfcp_free_received_attribute(attribute);
+                return NULL;
+            }
             switch (attribute->type) {
                 case USER_DISPLAY_NAME:
                     display = bfcp_parse_attribute_USER_DISPLAY_NAME(message,
@@ -1190,8 +1243,8 @@ bfcp_user_information *bfcp_parse_attribute_BENEFICIARY_INFORMATION(
         if (!beneficiary) /* An error occurred in creating a new Beneficiary
                              User Information */
             return NULL;
-        if (display) free(display);
-        if (uri) free(uri);
+        if (display) BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, display);
+        if (uri) BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, uri);
         message->position = recvA->position + recvA->length;
         if (((recvA->length) % 4) != 0)
             message->position = message->position + 4 - ((recvA->length) % 4);
@@ -1241,6 +1294,11 @@ bfcp_floor_request_information *bfcp_parse_attribute_FLOOR_REQUEST_INFORMATION(
             attribute = bfcp_parse_attribute(message);
             if (!attribute) /* An error occurred while parsing this attribute */
                 return NULL;
+            if (bfcp_check_attribute(recvA, attribute) ==
+                BFCP_WRONG_LENGTH) { /* It doesn't fit in the grouped attribute */
+                bfcp_free_received_attribute(attribute);
+                return NULL;
+            }
             BFCP_msgLog(INF,
                         "< parse attribute FLOOR_REQUEST_INFORMATION Floor "
                         "request ID[%d] information[%d / %s ]",
@@ -1323,7 +1381,7 @@ bfcp_floor_request_information *bfcp_parse_attribute_FLOOR_REQUEST_INFORMATION(
         if (!frqInfo) /* An error occurred in creating a new Floor Request
                          Information */
             return NULL;
-        if (pInfo) free(pInfo);
+        if (pInfo) BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, pInfo);
         message->position = recvA->position + recvA->length;
         if (((recvA->length) % 4) != 0)
             message->position = message->position + 4 - ((recvA->length) % 4);
@@ -1360,6 +1418,11 @@ bfcp_user_information *bfcp_parse_attribute_REQUESTED_BY_INFORMATION(
             attribute = bfcp_parse_attribute(message);
             if (!attribute) /* An error occurred while parsing this attribute */
                 return NULL;
+            if (bfcp_check_attribute(recvA, attribute) ==
+                BFCP_WRONG_LENGTH) { /* It doesn't fit in the grouped attribute */
+                bfcp_free_received_attribute(attribute);
+                return NULL;
+            }
             BFCP_msgLog(INF,
                         "< parse attribute REQUESTED_BY_INFORMATION Requested "
                         "by ID[%d] type[%d / %s]",
@@ -1393,8 +1456,8 @@ bfcp_user_information *bfcp_parse_attribute_REQUESTED_BY_INFORMATION(
         if (!requested_by) /* An error occurred in creating a new Beneficiary
                               User Information */
             return NULL;
-        if (display) free(display);
-        if (uri) free(uri);
+        if (display) BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, display);
+        if (uri) BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, uri);
         message->position = recvA->position + recvA->length;
         if (((recvA->length) % 4) != 0)
             message->position = message->position + 4 - ((recvA->length) % 4);
@@ -1431,7 +1494,7 @@ bfcp_floor_request_status *bfcp_parse_attribute_FLOOR_REQUEST_STATUS(
          * let's check it */
         message->position = recvA->position + 4;
 
-        while (recvA->length >= ((message->position) - (recvA->position))) {
+        while (recvA->length > ((message->position) - (recvA->position))) {
 #if HSU
             // Note(hsu)
             //  在下面的switch代码段中，检测到INVALID_ATTRIBUTE，会break，但是被switch拦截
@@ -1445,6 +1508,11 @@ bfcp_floor_request_status *bfcp_parse_attribute_FLOOR_REQUEST_STATUS(
             attribute = bfcp_parse_attribute(message);
             if (!attribute) /* An error occurred while parsing this attribute */
                 return NULL;
+            if (bfcp_check_attribute(recvA, attribute) ==
+                BFCP_WRONG_LENGTH) { /* It doesn't fit in the grouped attribute */
+                bfcp_free_received_attribute(attribute);
+                return NULL;
+            }
 
             /* BFCP_msgLog(INF,"< parse attribute FLOOR_REQUEST_STATUS Requested
             by floorId[%d] type[%d / %s]", fID ,
@@ -1492,7 +1560,7 @@ bfcp_floor_request_status *bfcp_parse_attribute_FLOOR_REQUEST_STATUS(
                      Information */
             return NULL;
         if (rs) bfcp_free_request_status(rs);
-        if (sInfo) free(sInfo);
+        if (sInfo) BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, sInfo);
         message->position = recvA->position + recvA->length;
         if (((recvA->length) % 4) != 0)
             message->position = message->position + 4 - ((recvA->length) % 4);
@@ -1533,6 +1601,11 @@ bfcp_overall_request_status *bfcp_parse_attribute_OVERALL_REQUEST_STATUS(
             attribute = bfcp_parse_attribute(message);
             if (!attribute) /* An error occurred while parsing this attribute */
                 return NULL;
+            if (bfcp_check_attribute(recvA, attribute) ==
+                BFCP_WRONG_LENGTH) { /* It doesn't fit in the grouped attribute */
+                bfcp_free_received_attribute(attribute);
+                return NULL;
+            }
             BFCP_msgLog(INF,
                         "< parse attribute OVERALL_REQUEST_STATUS Requested by "
                         "type[%d / %s]",
@@ -1581,7 +1654,7 @@ bfcp_overall_request_status *bfcp_parse_attribute_OVERALL_REQUEST_STATUS(
                      Information */
             return NULL;
         if (rs) bfcp_free_request_status(rs);
-        if (sInfo) free(sInfo);
+        if (sInfo) BFCP_FREE(BFCP_ALLOC_ATTRIBUTE, sInfo);
 #if HSU
         if (frs) bfcp_free_floor_request_status_list(frs);
 #endif // HSU
@@ -1622,8 +1695,8 @@ bfcp_digest *bfcp_parse_attribute_DIGEST(bfcp_message *message,
             bfcp_digest *digest =
                 bfcp_new_digest((UINT16 /* UINT16 */)ch); /* Algorithm */
             buffer = buffer + 1; /* Skip the Algorithm byte */
-            digest->text = (char *)calloc(
-                recvA->length - 2,
+            digest->text = (char *)BFCP_CALLOC(
+                BFCP_ALLOC_ATTRIBUTE, recvA->length - 2,
                 sizeof(char)); /* Lenght is TLV + Algorithm byte too */
             if (!digest)       /* An error occurred in creating a new Digest */
                 return NULL;
@@ -1636,4 +1709,98 @@ bfcp_digest *bfcp_parse_attribute_DIGEST(bfcp_message *message,
             return digest;
         }
     }
-}
\ No newline at end of file
+}
+/* Lazy parsing: only the framing is validated up front, each attribute is
+ * decoded when asked for */
+int bfcp_lazy_parse(bfcp_lazy_message *lazy, unsigned char *buffer,
+                    UINT32 length) {
+    UINT32 position;
+    UINT16 ch16; /* 16 bits */
+    UINT8 attrlen;
+
+    if (!lazy) return -1;
+    lazy->buffer = buffer;
+    lazy->count = 0;
+    lazy->error = BFCP_WRONG_LENGTH;
+    if (bfcp_peek_header(buffer, length, &lazy->header) < 0) return -1;
+    if (lazy->header.version != 1) {
+        lazy->error = BFCP_WRONG_VERSION;
+        return -1;
+    }
+    if (lazy->header.length != length || (length % 4) != 0) return -1;
+
+    /* Walk the TLVs: the attributes must exactly fill the payload */
+    for (position = 12; position < length;
+         position += attrlen + ((4 - (attrlen % 4)) % 4)) {
+        if (position + 2 > length) return -1;
+        memcpy(&ch16, buffer + position, 2);
+        ch16 = ntohs(ch16);
+        attrlen = (UINT8)(ch16 & 0x00FF);
+        if (attrlen < 2 || position + attrlen > length) return -1;
+        if (lazy->count == BFCP_LAZY_MAX_ATTRIBUTES) {
+            /* Too many attributes: the message must be parsed the usual way */
+            lazy->error = BFCP_PARSING_ERROR;
+            return -2;
+        }
+        lazy->attributes[lazy->count].type = (UINT8)((ch16 & 0xFE00) >> 9);
+        lazy->attributes[lazy->count].mandatory_bit =
+            (UINT8)((ch16 & 0x0100) >> 8);
+        lazy->attributes[lazy->count].length = attrlen;
+        lazy->attributes[lazy->count].position = (UINT16)position;
+        lazy->count++;
+    }
+    if (position != length) return -1;
+
+    lazy->error = 0;
+    return 0;
+}
+
+/* Find the 'nth' (starting from 0) attribute of a type: return its index, or -1
+ */
+int bfcp_lazy_find(const bfcp_lazy_message *lazy, e_bfcp_attibutes type,
+                   int nth) {
+    int i;
+
+    if (!lazy) return -1;
+    for (i = 0; i < lazy->count; i++) {
+        if (lazy->attributes[i].type == type && nth-- == 0) return i;
+    }
+    return -1;
+}
+
+/* Get the value of the 'nth' 16 bits attribute of a type (FLOOR-ID,
+ * BENEFICIARY-ID, FLOOR-REQUEST-ID, NONCE): return 0 if it is missing or
+ * malformed */
+UINT16 bfcp_lazy_get_u16(const bfcp_lazy_message *lazy, e_bfcp_attibutes type,
+                         int nth) {
+    const bfcp_attribute_schema *schema = bfcp_get_attribute_schema(type);
+    UINT16 ch16; /* 16 bits */
+    int i = bfcp_lazy_find(lazy, type, nth);
+
+    if (i < 0 || schema == NULL || schema->kind != e_bfcp_kind_u16 ||
+        lazy->attributes[i].length != schema->min_length)
+        return 0;
+    memcpy(&ch16, lazy->buffer + lazy->attributes[i].position + 2, 2);
+    return ntohs(ch16);
+}
+
+/* Prepare the 'nth' attribute of a type for one of the
+ * bfcp_parse_attribute_* methods, to decode it on demand */
+int bfcp_lazy_get_attribute(const bfcp_lazy_message *lazy,
+                            e_bfcp_attibutes type, int nth,
+                            bfcp_message *message,
+                            bfcp_received_attribute *recvA) {
+    int i = bfcp_lazy_find(lazy, type, nth);
+
+    if (i < 0 || !message || !recvA) return -1;
+    message->buffer = lazy->buffer;
+    message->length = (UINT16)lazy->header.length;
+    message->position = lazy->attributes[i].position;
+    memset(recvA, 0, sizeof(bfcp_received_attribute));
+    recvA->type = (e_bfcp_attibutes)lazy->attributes[i].type;
+    recvA->mandatory_bit = lazy->attributes[i].mandatory_bit;
+    recvA->length = lazy->attributes[i].length;
+    recvA->position = lazy->attributes[i].position;
+    recvA->valid = 1;
+    return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ *
+ * \brief Schema of the BFCP attributes
+ *
+ * One table, indexed by attribute type, tells the kind of payload of each
+ * attribute, the bounds of its Length, whether it may appear directly in a
+ * primitive and which attributes a grouped attribute may contain. The decoder
+ * checks every attribute against it before decoding it, and the encoder
+ * checks the kind and the bounds of every attribute it writes, so that both
+ * sides agree on the framing. The payload of each type is still decoded and
+ * encoded by its own function.
+ *
+ * \file bfcp_messages_schema.c
+ *
+ * \remarks :
+ */
+
+/* ==========================================================================*/
+/* include(s)                                                                */
+/* ==========================================================================*/
+#include "bfcp_messages.h"
+
+/* ==========================================================================*/
+/* Code                                                                      */
+/* ==========================================================================*/
+
+#define BFCP_CHILD(type)	((UINT32)1 << (type))
+
+/* Attributes of a user (BENEFICIARY-INFORMATION and REQUESTED-BY-INFORMATION) */
+#define BFCP_USER_CHILDREN	(BFCP_CHILD(USER_DISPLAY_NAME) | BFCP_CHILD(USER_URI))
+/* Attributes of a status (FLOOR-REQUEST-STATUS and OVERALL-REQUEST-STATUS) */
+#define BFCP_STATUS_CHILDREN	(BFCP_CHILD(REQUEST_STATUS) | BFCP_CHILD(STATUS_INFO))
+
+const bfcp_attribute_schema bfcp_attribute_schemas[BFCP_LAST_ATTRIBUTE+1] = {
+	/* kind, min, max, top level, children */
+	{ e_bfcp_kind_unknown, 0, 0, 0, 0 },		/* INVALID_ATTRIBUTE */
+	{ e_bfcp_kind_u16, 4, 4, 1, 0 },		/* BENEFICIARY_ID */
+	{ e_bfcp_kind_u16, 4, 4, 1, 0 },		/* FLOOR_ID */
+	{ e_bfcp_kind_u16, 4, 4, 1, 0 },		/* FLOOR_REQUEST_ID */
+	{ e_bfcp_kind_u16, 4, 4, 1, 0 },		/* PRIORITY */
+	{ e_bfcp_kind_u16, 4, 4, 1, 0 },		/* REQUEST_STATUS */
+	{ e_bfcp_kind_octets, 3, 255, 1, 0 },		/* ERROR_CODE */
+	{ e_bfcp_kind_octets, 2, 255, 1, 0 },		/* ERROR_INFO */
+	{ e_bfcp_kind_octets, 2, 255, 1, 0 },		/* PARTICIPANT_PROVIDED_INFO */
+	{ e_bfcp_kind_octets, 2, 255, 1, 0 },		/* STATUS_INFO */
+	{ e_bfcp_kind_octets, 3, 255, 1, 0 },		/* SUPPORTED_ATTRIBUTES */
+	{ e_bfcp_kind_octets, 3, 255, 1, 0 },		/* SUPPORTED_PRIMITIVES */
+	{ e_bfcp_kind_octets, 3, 255, 0, 0 },		/* USER_DISPLAY_NAME */
+	{ e_bfcp_kind_octets, 3, 255, 0, 0 },		/* USER_URI */
+	{ e_bfcp_kind_grouped, 4, 255, 1,		/* BENEFICIARY_INFORMATION */
+		BFCP_USER_CHILDREN },
+	{ e_bfcp_kind_grouped, 4, 255, 1,		/* FLOOR_REQUEST_INFORMATION */
+		BFCP_CHILD(OVERALL_REQUEST_STATUS) | BFCP_CHILD(FLOOR_REQUEST_STATUS) |
+		BFCP_CHILD(BENEFICIARY_INFORMATION) | BFCP_CHILD(REQUESTED_BY_INFORMATION) |
+		BFCP_CHILD(PRIORITY) | BFCP_CHILD(PARTICIPANT_PROVIDED_INFO) },
+	{ e_bfcp_kind_grouped, 4, 255, 0,		/* REQUESTED_BY_INFORMATION */
+		BFCP_USER_CHILDREN },
+	{ e_bfcp_kind_grouped, 4, 255, 0,		/* FLOOR_REQUEST_STATUS */
+		BFCP_STATUS_CHILDREN },
+	{ e_bfcp_kind_grouped, 4, 255, 0,		/* OVERALL_REQUEST_STATUS */
+		BFCP_STATUS_CHILDREN },
+	{ e_bfcp_kind_u16, 4, 4, 1, 0 },		/* NONCE */
+	{ e_bfcp_kind_octets, 4, 255, 1, 0 },		/* DIGEST */
+};
+
+/* Get the schema of an attribute type, or NULL if the codec doesn't know it */
+const bfcp_attribute_schema *bfcp_get_attribute_schema(UINT32 type)
+{
+	if((type > BFCP_LAST_ATTRIBUTE) || (bfcp_attribute_schemas[type].kind == e_bfcp_kind_unknown))
+		return NULL;
+	return &bfcp_attribute_schemas[type];
+}
+
+/* Check an attribute against the schema, directly in a primitive (parent is NULL) or in a grouped attribute */
+int bfcp_check_attribute(const bfcp_received_attribute *parent, const bfcp_received_attribute *attribute)
+{
+	const bfcp_attribute_schema *schema;
+
+	if(attribute == NULL)
+		return BFCP_PARSING_ERROR;
+	/* Whatever its type, an attribute has a TLV header and can't overflow the grouped attribute containing it */
+	if(attribute->length < 2)
+		return BFCP_WRONG_LENGTH;
+	if(parent && (attribute->position+attribute->length > parent->position+parent->length))
+		return BFCP_WRONG_LENGTH;
+	schema = bfcp_get_attribute_schema(attribute->type);
+	if(schema == NULL)
+		return BFCP_UNKNOWN_ATTRIBUTE;
+	if((attribute->length < schema->min_length) || (attribute->length > schema->max_length))
+		return BFCP_WRONG_LENGTH;
+	if(parent == NULL) {
+		if(!schema->top_level)
+			return BFCP_PARSING_ERROR;
+	} else if(((UINT32)parent->type > BFCP_LAST_ATTRIBUTE) ||
+			!(bfcp_attribute_schemas[parent->type].children & BFCP_CHILD(attribute->type)))
+		return BFCP_PARSING_ERROR;
+	return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ *
+ * \brief Framing validation of received messages
+ *
+ * The validator walks the Common Header and the TLV chain of a raw message,
+ * grouped attributes included, without allocating nor logging. It runs before
+ * the message is copied and parsed, so that truncated or hostile packets whose
+ * attributes would make the parser read past the buffer are dropped first.
+ *
+ * \file bfcp_messages_validate.c
+ *
+ * \remarks :
+ */
+
+/* ==========================================================================*/
+/* include(s)                                                                */
+/* ==========================================================================*/
+#include "bfcp_messages.h"
+
+/* ==========================================================================*/
+/* Code                                                                      */
+/* ==========================================================================*/
+
+/* Walk the attributes between 'position' and 'end': return 0, BFCP_PARSING_ERROR if they don't fit, or
+   else BFCP_WRONG_LENGTH (a Length out of the schema bounds) or BFCP_UNKNOWN_MANDATORY_ATTRIBUTE */
+static int bfcp_validate_attributes(const unsigned char *buffer, UINT32 position, UINT32 end, int depth)
+{
+	const bfcp_attribute_schema *schema;
+	UINT16 ch16;
+	UINT32 type, attrlen;
+	int status = 0, error;
+
+	if(depth > 2)	/* Groups nest at most twice (FLOOR-REQUEST-INFORMATION > OVERALL-REQUEST-STATUS) */
+		return BFCP_PARSING_ERROR;
+	while(position < end) {
+		if(position+2 > end)
+			return BFCP_PARSING_ERROR;
+		memcpy(&ch16, buffer+position, 2);
+		ch16 = ntohs(ch16);
+		type = (ch16 & 0xFE00) >> 9;
+		attrlen = ch16 & 0x00FF;
+		if((attrlen < 2) || (position+attrlen > end))
+			return BFCP_PARSING_ERROR;
+		schema = bfcp_get_attribute_schema(type);
+		if(schema == NULL) {
+			if((ch16 & 0x0100) && !status)	/* M bit: the receiver must understand it */
+				status = BFCP_UNKNOWN_MANDATORY_ATTRIBUTE;
+		} else if((attrlen < schema->min_length) || (attrlen > schema->max_length)) {
+			status = BFCP_WRONG_LENGTH;	/* The parser will report it */
+		} else if(schema->kind == e_bfcp_kind_grouped) {
+			error = bfcp_validate_attributes(buffer, position+4, position+attrlen, depth+1);
+			if(error == BFCP_PARSING_ERROR)
+				return error;
+			if(error && (status != BFCP_WRONG_LENGTH))
+				status = error;
+		}
+		/* Jump the attribute and its padding: the last one of a group may end the group unpadded */
+		position = position+attrlen+((4-(attrlen%4))%4);
+	}
+	return status;
+}
+
+/* Validate the framing of a raw message */
+int bfcp_validate_message(const unsigned char *buffer, UINT32 length)
+{
+	UINT32 ch32;
+
+	if((buffer == NULL) || (length < 12))
+		return BFCP_PARSING_ERROR;
+	memcpy(&ch32, buffer, 4);
+	ch32 = ntohl(ch32);
+	if(((ch32 & 0xE0000000) >> 29) != 1)
+		return BFCP_WRONG_VERSION;
+	if(((ch32 & 0x0000FFFF)*4+12 != length) || ((length%4) != 0))
+		return BFCP_WRONG_LENGTH;
+	return bfcp_validate_attributes(buffer, 12, length, 0);
+}
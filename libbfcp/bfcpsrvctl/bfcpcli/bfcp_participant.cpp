@@ -5,6 +5,7 @@
 
 #include "../../BFCPexception.h"
 #include "../../bfcp_threads.h"
+#include "../../bfcpmsg/bfcp_messages_cpp.h"
 #include "../../bfcpmsg/bfcp_strings.h"
 #ifdef QN_CROSS_COMPILE
 #include <android/log.h>
@@ -26,6 +27,19 @@ extern "C" void _ParticpantLog(char *pcFile, int iLine, int iErrorLevel,
     return _p.Log(pcFile, iLine, iErrorLevel, s);
 }
 
+/* Primitives and attributes the participant supports, announced in HelloAck */
+static const UINT8 _participant_primitives[] = {
+    e_primitive_FloorRequest, e_primitive_FloorRelease, e_primitive_FloorQuery,
+    e_primitive_FloorStatus,  e_primitive_Hello,        e_primitive_HelloAck,
+    e_primitive_Goodbye,      e_primitive_GoodbyeAck,   e_primitive_Error};
+static const UINT8 _participant_attributes[] = {
+    BENEFICIARY_ID, FLOOR_ID, FLOOR_REQUEST_ID, PRIORITY, REQUEST_STATUS,
+    ERROR_CODE, ERROR_INFO, PARTICIPANT_PROVIDED_INFO, STATUS_INFO,
+    SUPPORTED_ATTRIBUTES, SUPPORTED_PRIMITIVES, USER_DISPLAY_NAME, USER_URI,
+    BENEFICIARY_INFORMATION, FLOOR_REQUEST_INFORMATION,
+    REQUESTED_BY_INFORMATION, FLOOR_REQUEST_STATUS, OVERALL_REQUEST_STATUS,
+    NONCE, DIGEST};
+
 BFCP_Participant::BFCP_Participant(
     UINT32 p_confID, UINT16 p_userID, UINT16 p_floorID, UINT16 p_streamID,
     BFCP_Participant::ParticipantEvent *p_ParticipantEvent, int transport)
@@ -62,6 +76,18 @@ BFCP_Participant::BFCP_Participant(
     m_currentFloorRequestID = 0;
     bfcp_mutex_init(count_mutex, NULL);
     m_PartSocket = BFCP_INVALID_SOCKET;
+    /* Hello and the acks have a fixed shape: encode them once */
+    bfcp_template_init(&m_hello_template, e_primitive_Hello, 0, NULL, 0, NULL,
+                       0);
+    bfcp_template_init(&m_helloack_template, e_primitive_HelloAck, 0,
+                       _participant_primitives, sizeof(_participant_primitives),
+                       _participant_attributes, sizeof(_participant_attributes));
+    bfcp_template_init(&m_floorstatusack_template, e_primitive_FloorStatusAck,
+                       0, NULL, 0, NULL, 0);
+    bfcp_template_init(&m_floorrequeststatusack_template,
+                       e_primitive_FloorRequestStatusAck, 0, NULL, 0, NULL, 0);
+    bfcp_template_init(&m_goodbyeack_template, e_primitive_GoodbyeAck, 0, NULL,
+                       0, NULL, 0);
 
 #if HSU
     initStateMachine();
@@ -1593,171 +1619,63 @@ int BFCP_Participant::bfcp_hello_participant(
     st_bfcp_participant_information *participant) {
     if (participant == NULL) participant = m_bfcp_participant_information;
 
-    int error;
-    bfcp_arguments *arguments;
-    bfcp_message *message;
+    UINT16 transactionID;
 
     bfcp_mutex_lock(count_mutex);
-
-    /* Prepare a new 'Hello' message */
-    arguments = bfcp_new_arguments();
-    arguments->primitive = e_primitive_Hello;
-    arguments->entity = bfcp_new_entity(
-        participant->conferenceID, m_base_transactionID, participant->userID);
+    transactionID = m_base_transactionID;
     m_base_transactionID++;
-    message = bfcp_build_message(arguments);
-    if (!message) {
-        bfcp_mutex_unlock(count_mutex);
-        return -1;
-    }
-
     bfcp_mutex_unlock(count_mutex);
-    /* Send the message to the FCS */
-    error = sendBFCPmessage(m_PartSocket, message);
-    BFCP_SEND_CHECK_ERRORS();
 
-    return error;
+    /* Send the message to the FCS */
+    return sendBFCPtemplate(m_PartSocket, &m_hello_template,
+                            participant->conferenceID, transactionID,
+                            participant->userID);
 }
 
 int BFCP_Participant::bfcp_floorStatus_floorRequestStatus_Ack(
     e_bfcp_primitives primitive, UINT32 ConferenceID, UINT16 userID,
     UINT16 TransactionID) {
-    e_bfcp_primitives ack;
+    const bfcp_template *ack;
     if (primitive == e_primitive_FloorStatus) {
         Log(INF, "Sending FloorStatusAck:");
-        ack = e_primitive_FloorStatusAck;
+        ack = &m_floorstatusack_template;
     } else {
         Log(INF, "Sending FloorRequestStatusAck:");
-        ack = e_primitive_FloorRequestStatusAck;
+        ack = &m_floorrequeststatusack_template;
     }
-    int error;
-    bfcp_arguments *arguments;
-    bfcp_message *message;
 
     bfcp_mutex_lock(count_mutex);
-
-    /* Prepare a new 'Hello' message */
-    arguments = bfcp_new_arguments();
-    arguments->primitive = ack;
-    arguments->entity = bfcp_new_entity(ConferenceID, TransactionID, userID);
-    /* Create a list of all the primitives the FCS supports */
-    arguments->primitives = bfcp_new_supported_list(
-        e_primitive_FloorRequest, e_primitive_FloorRelease,
-        e_primitive_FloorQuery, e_primitive_FloorStatus, e_primitive_Hello,
-        e_primitive_HelloAck, e_primitive_Goodbye, e_primitive_GoodbyeAck,
-        e_primitive_Error, 0);
-
-    /* Create a list of all the attributes the FCS supports */
-    arguments->attributes = bfcp_new_supported_list(
-        BENEFICIARY_ID, FLOOR_ID, FLOOR_REQUEST_ID, PRIORITY, REQUEST_STATUS,
-        ERROR_CODE, ERROR_INFO, PARTICIPANT_PROVIDED_INFO, STATUS_INFO,
-        SUPPORTED_ATTRIBUTES, SUPPORTED_PRIMITIVES, USER_DISPLAY_NAME, USER_URI,
-        BENEFICIARY_INFORMATION, FLOOR_REQUEST_INFORMATION,
-        REQUESTED_BY_INFORMATION, FLOOR_REQUEST_STATUS, OVERALL_REQUEST_STATUS,
-        NONCE, DIGEST, 0);
     m_base_transactionID++;
-    message = bfcp_build_message(arguments);
-    if (!message) {
-        bfcp_mutex_unlock(count_mutex);
-        Log(INF, "Message ids NULL");
-        return -1;
-    }
-
     bfcp_mutex_unlock(count_mutex);
-    /* Send the message to the FCS */
-    error = sendBFCPmessage(m_PartSocket, message);
-    BFCP_SEND_CHECK_ERRORS();
 
-    return error;
+    /* Send the message to the FCS */
+    return sendBFCPtemplate(m_PartSocket, ack, ConferenceID, TransactionID,
+                            userID);
 }
 
 /* HelloAck */
 int BFCP_Participant::bfcp_helloAck_participant(UINT32 ConferenceID,
                                                 UINT16 userID,
                                                 UINT16 TransactionID) {
-    int error;
-    bfcp_arguments *arguments;
-    bfcp_message *message;
-
     bfcp_mutex_lock(count_mutex);
-
-    /* Prepare a new 'Hello' message */
-    arguments = bfcp_new_arguments();
-    arguments->primitive = e_primitive_HelloAck;
-    arguments->entity = bfcp_new_entity(ConferenceID, TransactionID, userID);
-    /* Create a list of all the primitives the FCS supports */
-    arguments->primitives = bfcp_new_supported_list(
-        e_primitive_FloorRequest, e_primitive_FloorRelease,
-        e_primitive_FloorQuery, e_primitive_FloorStatus, e_primitive_Hello,
-        e_primitive_HelloAck, e_primitive_Goodbye, e_primitive_GoodbyeAck,
-        e_primitive_Error, 0);
-
-    /* Create a list of all the attributes the FCS supports */
-    arguments->attributes = bfcp_new_supported_list(
-        BENEFICIARY_ID, FLOOR_ID, FLOOR_REQUEST_ID, PRIORITY, REQUEST_STATUS,
-        ERROR_CODE, ERROR_INFO, PARTICIPANT_PROVIDED_INFO, STATUS_INFO,
-        SUPPORTED_ATTRIBUTES, SUPPORTED_PRIMITIVES, USER_DISPLAY_NAME, USER_URI,
-        BENEFICIARY_INFORMATION, FLOOR_REQUEST_INFORMATION,
-        REQUESTED_BY_INFORMATION, FLOOR_REQUEST_STATUS, OVERALL_REQUEST_STATUS,
-        NONCE, DIGEST, 0);
     m_base_transactionID++;
-    message = bfcp_build_message(arguments);
-    if (!message) {
-        bfcp_mutex_unlock(count_mutex);
-        Log(INF, "Message ids NULL");
-        return -1;
-    }
-
     bfcp_mutex_unlock(count_mutex);
-    /* Send the message to the FCS */
-    error = sendBFCPmessage(m_PartSocket, message);
-    BFCP_SEND_CHECK_ERRORS();
 
-    return error;
+    /* Send the message to the FCS */
+    return sendBFCPtemplate(m_PartSocket, &m_helloack_template, ConferenceID,
+                            TransactionID, userID);
 }
 
 int BFCP_Participant::bfcp_goodbyeAck_participant(UINT32 ConferenceID,
                                                   UINT16 userID,
                                                   UINT16 TransactionID) {
-    int error;
-    bfcp_arguments *arguments;
-    bfcp_message *message;
-
     bfcp_mutex_lock(count_mutex);
-
-    /* Prepare a new 'Hello' message */
-    arguments = bfcp_new_arguments();
-    arguments->primitive = e_primitive_GoodbyeAck;
-    arguments->entity = bfcp_new_entity(ConferenceID, TransactionID, userID);
-    /* Create a list of all the primitives the FCS supports */
-    arguments->primitives = bfcp_new_supported_list(
-        e_primitive_FloorRequest, e_primitive_FloorRelease,
-        e_primitive_FloorQuery, e_primitive_FloorStatus, e_primitive_Hello,
-        e_primitive_HelloAck, e_primitive_Goodbye, e_primitive_GoodbyeAck,
-        e_primitive_Error, 0);
-
-    /* Create a list of all the attributes the FCS supports */
-    arguments->attributes = bfcp_new_supported_list(
-        BENEFICIARY_ID, FLOOR_ID, FLOOR_REQUEST_ID, PRIORITY, REQUEST_STATUS,
-        ERROR_CODE, ERROR_INFO, PARTICIPANT_PROVIDED_INFO, STATUS_INFO,
-        SUPPORTED_ATTRIBUTES, SUPPORTED_PRIMITIVES, USER_DISPLAY_NAME, USER_URI,
-        BENEFICIARY_INFORMATION, FLOOR_REQUEST_INFORMATION,
-        REQUESTED_BY_INFORMATION, FLOOR_REQUEST_STATUS, OVERALL_REQUEST_STATUS,
-        NONCE, DIGEST, 0);
     m_base_transactionID++;
-    message = bfcp_build_message(arguments);
-    if (!message) {
-        bfcp_mutex_unlock(count_mutex);
-        Log(INF, "Message ids NULL");
-        return -1;
-    }
-
     bfcp_mutex_unlock(count_mutex);
-    /* Send the message to the FCS */
-    error = sendBFCPmessage(m_PartSocket, message);
-    BFCP_SEND_CHECK_ERRORS();
 
-    return error;
+    /* Send the message to the FCS */
+    return sendBFCPtemplate(m_PartSocket, &m_goodbyeack_template, ConferenceID,
+                            TransactionID, userID);
 }
 
 int BFCP_Participant::bfcp_floorRequest_participant(UINT16 p_floorID) {
@@ -1795,11 +1713,8 @@ int BFCP_Participant::bfcp_floorRequest_participant(
         return -1;
     }
 
-    bfcp_arguments *arguments = NULL;
     bfcp_message *message;
     int error = 0;
-    size_t dLen = 0;
-    bfcp_floor_id_list *node = NULL;
 
     bfcp_floors_participant *tempnode, *temp_list_floors, *floors_IDs = NULL;
 
@@ -1839,48 +1754,28 @@ int BFCP_Participant::bfcp_floorRequest_participant(
 
     bfcp_mutex_lock(count_mutex);
 
-    /* Prepare a new 'FloorRequest' message */
-    arguments = bfcp_new_arguments();
-    arguments->primitive = e_primitive_FloorRequest;
-    arguments->entity = bfcp_new_entity(
-        participant->conferenceID, m_base_transactionID, participant->userID);
+    /* Encode the 'FloorRequest' message on the stack, in the order of
+     * bfcp_build_message_FloorRequest (1024 octets hold a few hundred floors
+     * besides the longest Participant-provided Info) */
+    BFCP_Encoder<1024> encoder(e_primitive_FloorRequest,
+                               participant->conferenceID, m_base_transactionID,
+                               participant->userID);
     m_base_transactionID++;
 
-    floors_IDs = list_floors;
-    if (floors_IDs != NULL)
-        node = bfcp_new_floor_id_list(floors_IDs->floorID, 0);
-    floors_IDs = floors_IDs->next;
+    for (floors_IDs = list_floors; floors_IDs != NULL;
+         floors_IDs = floors_IDs->next)
+        encoder.u16(FLOOR_ID, floors_IDs->floorID);
 
-    while (floors_IDs != NULL) {
-        bfcp_add_floor_id_list(node, floors_IDs->floorID, 0);
-        floors_IDs = floors_IDs->next;
-    }
+    if (beneficiaryID == 0) beneficiaryID = participant->userID;
+    if (beneficiaryID > 0) encoder.u16(BENEFICIARY_ID, beneficiaryID);
 
-    arguments->fID = node;
-
-    if (beneficiaryID > 0)
-        arguments->bID = beneficiaryID;
-    else
-        arguments->bID = participant->userID;
-
-    if (participant_info != NULL) {
-        /* If there's Participant-provided Info text, add it */
-        dLen = strlen(participant_info);
-        if (dLen != 0) {
-            arguments->pInfo = (char *)calloc(1, dLen * sizeof(char) + 1);
-            if (arguments->pInfo == NULL) {
-                bfcp_mutex_unlock(count_mutex);
-				Log(ERR, "arguments->pInfo is NULL ");
-                return -1;
-            }
-            memcpy(arguments->pInfo, participant_info, dLen + 1);
-        } else
-            arguments->pInfo = NULL;
-    }
+    /* If there's Participant-provided Info text, add it */
+    if (participant_info != NULL && participant_info[0] != '\0')
+        encoder.text(PARTICIPANT_PROVIDED_INFO, participant_info);
 
-    arguments->priority = priority;
+    if (priority < 5) encoder.priority(priority);
 
-    message = bfcp_build_message(arguments);
+    message = encoder.message();
     if (!message) {
         bfcp_mutex_unlock(count_mutex);
         Log(ERR, "Build message failed ");
@@ -1894,7 +1789,6 @@ int BFCP_Participant::bfcp_floorRequest_participant(
     /* Send the message to the FCS */
     error = sendBFCPmessage(m_PartSocket, message);
     Log(ERR, "Send BFCP message sock:%d, error code: %d\n", m_PartSocket, error);
-    BFCP_SEND_CHECK_ERRORS();
 
     return error;
 }
@@ -2347,6 +2241,56 @@ int BFCP_Participant::ProcessBFCPmessage(bfcp_received_message *m,
     return 0;
 }
 
+bool BFCP_Participant::ProcessLazyBFCPmessage(const bfcp_lazy_message *m,
+                                              BFCP_SOCKET s, int transport) {
+    const bfcp_lazy_attribute *attribute;
+    const unsigned char *element;
+    int i, j;
+
+    /* Output will be different according to the BFCP primitive in the message
+     * header */
+    s_bfcp_msg_event evt;
+    memset(&evt, 0, sizeof(s_bfcp_msg_event));
+    evt.Event = m->header.primitive;
+    evt.TransactionID = m->header.transactionID;
+    evt.userID = m->header.userID;
+    evt.conferenceID = m->header.conferenceID;
+    switch (m->header.primitive) {
+        case e_primitive_Hello:
+            Log(INF, "Hello:");
+            Log(INF, "TransactionID: %d", evt.TransactionID);
+            Log(INF, "UserID         %d", evt.userID);
+            Log(INF, "ConferenceID:  %d", evt.conferenceID);
+            bfcp_helloAck_participant(evt.conferenceID, evt.userID,
+                                      evt.TransactionID);
+            break;
+        case e_primitive_HelloAck:
+            Log(INF, "HelloAck:");
+            /* Each supported primitive or attribute takes an octet */
+            for (i = 0; i < m->count; i++) {
+                attribute = &m->attributes[i];
+                element = m->buffer + attribute->position + 2;
+                for (j = 0; j < attribute->length - 2; j++) {
+                    if (attribute->type == SUPPORTED_PRIMITIVES)
+                        evt.Support_primitives[element[j]] = true;
+                    else if (attribute->type == SUPPORTED_ATTRIBUTES)
+                        evt.Support_attributes[element[j]] = true;
+                }
+            }
+            break;
+        case e_primitive_ChairActionAck:
+            Log(INF, "ChairActionAck:");
+            Log(INF, "TransactionID: %d", evt.TransactionID);
+            Log(INF, "UserID         %d", evt.userID);
+            Log(INF, "ConferenceID:  %lu", evt.conferenceID);
+            break;
+        default:
+            return false;
+    }
+    BFCPFSM_FsmEvent(&evt);
+    return true;
+}
+
 /* Callback to receive notifications from the underlying library about incoming
  * BFCP messages */
 bool BFCP_Participant::bfcp_received_msg(bfcp_received_message *recv_msg) {
@@ -2751,8 +2695,11 @@ bool BFCP_Participant::BFCPFSM_UpdatesBfcpFsmEvent(s_bfcp_msg_event *p_bfcp_evt,
                     m_bfcp_participant_information->conferenceID;
             }
         }
-        if (m_ParticipantEvent)
+        if (m_ParticipantEvent) {
+            UINT64 start = BFCP_Metrics::Now();
             m_ParticipantEvent->OnBfcpParticipantEvent(p_evt, &bfcpFsmEvt);
+            m_metrics.Duration(&st_bfcp_metrics::callback_us, start);
+        }
     }
     return Status;
 }
@@ -2962,10 +2909,11 @@ bool BFCP_Participant::BFCPFSM_UpdateHwnd(s_bfcp_msg_event *p_evt) {
 void BFCP_Participant::Log(const char *pcFile, int iLine, int iErrLevel,
                            const char *pcFormat, ...) {
     va_list arg;
+    if (iErrLevel < m_logLevel) return;
     va_start(arg, pcFormat);
     if (m_ParticipantEvent)
         m_ParticipantEvent->Log(pcFile, iLine, iErrLevel, pcFormat, arg);
-    else {
+    else if (!BFCP_AsyncLog::Push(pcFile, iLine, iErrLevel, pcFormat, arg)) {
 #ifdef QN_CROSS_COMPILE
 	static char bfcp_log_buf[1024] = { 0 };
 	vsnprintf(bfcp_log_buf, sizeof(bfcp_log_buf), pcFormat, arg);
@@ -286,6 +286,12 @@ protected:
      * @return NULL , socket readed  , -1 error on socket.
      */
     virtual int ProcessBFCPmessage(bfcp_received_message * m, BFCP_SOCKET s);
+    /**
+     * Callback processing Hello, HelloAck and ChairActionAck from their
+     * unparsed attributes.
+     * @return true processed, false to be parsed for ProcessBFCPmessage.
+     */
+    virtual bool ProcessLazyBFCPmessage(const bfcp_lazy_message * m, BFCP_SOCKET s, int transport);
     /**
      * Callback used to prevent success of connection.
      * @param socket socket connected  .
@@ -329,6 +335,11 @@ private:
     bfcp_mutex_t count_mutex; /** \brief mutex used to prevent dual access */
     ParticipantEvent* m_ParticipantEvent ; /** \brief  ParticipantEvent class for OnBfcpParticipantEvent callback  */
     BFCP_SOCKET m_PartSocket ; /** \brief  socket used by this particpant */
+    bfcp_template m_hello_template ; /** \brief  Pre-encoded Hello, stamped with the IDs of each keepalive */
+    bfcp_template m_helloack_template ; /** \brief  Pre-encoded HelloAck */
+    bfcp_template m_floorstatusack_template ; /** \brief  Pre-encoded FloorStatusAck */
+    bfcp_template m_floorrequeststatusack_template ; /** \brief  Pre-encoded FloorRequestStatusAck */
+    bfcp_template m_goodbyeack_template ; /** \brief  Pre-encoded GoodbyeAck */
 #if HSU
     /*
     * Note(hsu)
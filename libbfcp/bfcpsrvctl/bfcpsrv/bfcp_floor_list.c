@@ -13,6 +13,80 @@
  * \remarks :
  */
  #include "bfcp_floor_list.h"
+#include "../../bfcpmsg/bfcp_alloc.h"
+
+/* The floors are indexed by an open addressing table mapping a floorID to its
+   position in lfloors->floors. The floorID is its own hash, so that small
+   dense floorIDs are directly indexed without any collision */
+
+/* Allocate an empty index able to hold Max_Num floors, at most half full */
+static UINT32 *bfcp_new_floor_index(UINT32 Max_Num, UINT32 *mask)
+{
+	UINT32 size = 8;
+	UINT32 *index;
+
+	while(size < 2*Max_Num)
+		size = size << 1;
+
+	index = (UINT32 *)BFCP_CALLOC(BFCP_ALLOC_FLOOR, size, sizeof(UINT32));
+	if(index != NULL)
+		*mask = size - 1;
+	return index;
+}
+
+/* Add the floor at this position to the index */
+static void bfcp_index_floor(bfcp_list_floors *lfloors, int position)
+{
+	UINT32 slot;
+
+	if(lfloors->floor_index == NULL)
+		return;
+
+	slot = lfloors->floors[position].floorID & lfloors->floor_index_mask;
+	while(lfloors->floor_index[slot] != 0)
+		slot = (slot + 1) & lfloors->floor_index_mask;
+	lfloors->floor_index[slot] = position + 1;
+}
+
+/* Index again all the floors (positions change when a floor is removed) */
+static void bfcp_rebuild_floor_index(bfcp_list_floors *lfloors)
+{
+	int i;
+
+	if(lfloors->floor_index == NULL)
+		return;
+
+	memset(lfloors->floor_index, 0, (lfloors->floor_index_mask + 1)*sizeof(UINT32));
+	for(i = 0; i < lfloors->actual_number_floors; i++)
+		bfcp_index_floor(lfloors, i);
+}
+
+/* Get the position of a floor, or -1 if it does not exist */
+static int bfcp_find_floor(bfcp_list_floors *lfloors, UINT16 floorID)
+{
+	UINT32 slot, position;
+	int i = 0;
+
+	if(lfloors->floors == NULL)
+		return -1;
+
+	if(lfloors->floor_index == NULL) {
+		/* No index available, fall back to a linear search */
+		while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
+			i = i + 1;
+		return (i < lfloors->actual_number_floors) ? i : -1;
+	}
+
+	slot = floorID & lfloors->floor_index_mask;
+	while((position = lfloors->floor_index[slot]) != 0) {
+		if(lfloors->floors[position-1].floorID == floorID)
+			return position - 1;
+		slot = (slot + 1) & lfloors->floor_index_mask;
+	}
+
+	/* A floor with this floorID does not exists in this conference */
+	return -1;
+}
 
 /* Create a new linked list of floors */
 struct bfcp_list_floors *bfcp_create_floor_list(UINT16 Max_Num)
@@ -24,22 +98,31 @@ struct bfcp_list_floors *bfcp_create_floor_list(UINT16 Max_Num)
 		Max_Num = 1;
 
 	/* Allocate a new container for the list of floors */
-	lfloors = (bfcp_list_floors *)calloc(1, sizeof(bfcp_list_floors));
+	lfloors = (bfcp_list_floors *)BFCP_CALLOC(BFCP_ALLOC_FLOOR, 1, sizeof(bfcp_list_floors));
 	if(lfloors == NULL)
 		return NULL;
 
 	/* Allocate a new array of floors */
-	floors = (bfcp_floors *)calloc(Max_Num, sizeof(bfcp_floors));
+	floors = (bfcp_floors *)BFCP_CALLOC(BFCP_ALLOC_FLOOR, Max_Num, sizeof(bfcp_floors));
 	if(floors == NULL) {
-		free(lfloors);
+		BFCP_FREE(BFCP_ALLOC_FLOOR, lfloors);
 		lfloors = NULL;
 		return NULL;
-	} else {
-		lfloors->number_floors = --Max_Num;
-		lfloors->actual_number_floors = 0;
-		lfloors->floors = floors;
 	}
 
+	/* Allocate the floorID index */
+	lfloors->floor_index = bfcp_new_floor_index(Max_Num, &lfloors->floor_index_mask);
+	if(lfloors->floor_index == NULL) {
+		BFCP_FREE(BFCP_ALLOC_FLOOR, floors);
+		BFCP_FREE(BFCP_ALLOC_FLOOR, lfloors);
+		lfloors = NULL;
+		return NULL;
+	}
+
+	lfloors->number_floors = --Max_Num;
+	lfloors->actual_number_floors = 0;
+	lfloors->floors = floors;
+
 	return lfloors;
 }
 
@@ -47,16 +130,12 @@ struct bfcp_list_floors *bfcp_create_floor_list(UINT16 Max_Num)
 int bfcp_insert_floor(bfcp_list_floors *lfloors, UINT16 floorID, UINT16 chairID)
 {
     int number_floors = 0 ;
-	int i = 0;
 	if(lfloors == NULL)
 		return -1;
 	if(floorID == 0)
 		return -1;
 
-	while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
-
-	if((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID == floorID))
+	if(bfcp_find_floor(lfloors, floorID) >= 0)
 		/* A floor with the same floorID already exists in this conference */
 		return -1;
 
@@ -71,7 +150,9 @@ int bfcp_insert_floor(bfcp_list_floors *lfloors, UINT16 floorID, UINT16 chairID)
 	lfloors->floors[lfloors->actual_number_floors].floorState = BFCP_FLOOR_STATE_WAITING;
 	lfloors->floors[lfloors->actual_number_floors].limit_granted_floor = 2;
 	lfloors->floors[lfloors->actual_number_floors].floorquery = NULL;
+	bfcp_index_floor(lfloors, lfloors->actual_number_floors);
 	lfloors->actual_number_floors= lfloors->actual_number_floors + 1;
+	lfloors->version++;
 
 	return lfloors->actual_number_floors;
 }
@@ -91,6 +172,8 @@ int bfcp_change_number_floors(bfcp_list_floors *lfloors, UINT16 Num)
 	bfcp_floors *floors = NULL;
 	floor_query *query = NULL;
 	floor_query *temp = NULL;
+	UINT32 *index = NULL;
+	UINT32 mask = 0;
 	int i = 0;
 
 	if(lfloors == NULL)
@@ -99,6 +182,10 @@ int bfcp_change_number_floors(bfcp_list_floors *lfloors, UINT16 Num)
 	if(Num == 0)
 		Num = 1;
 
+	/* Allocate the new floorID index first, nothing is changed if it fails */
+	index = bfcp_new_floor_index(Num, &mask);
+	if(index == NULL)
+		return -1;
 
 	if(lfloors->number_floors >= Num) {
 		for(i = Num;i <= lfloors->number_floors; i++) {
@@ -112,15 +199,17 @@ int bfcp_change_number_floors(bfcp_list_floors *lfloors, UINT16 Num)
 			while(query) {
 				temp = query;
 				query = query->next;
-				free(temp);
+				BFCP_FREE(BFCP_ALLOC_FLOOR, temp);
 				temp = NULL;
 			}	
 		}
 	}
 
-	floors = (bfcp_floors *)realloc(lfloors->floors, Num*sizeof(bfcp_floors));
-	if(floors == NULL)
+	floors = (bfcp_floors *)BFCP_REALLOC(BFCP_ALLOC_FLOOR, lfloors->floors, Num*sizeof(bfcp_floors));
+	if(floors == NULL) {
+		BFCP_FREE(BFCP_ALLOC_FLOOR, index);
 		return -1;
+	}
 
 	lfloors->floors = floors;
 
@@ -136,7 +225,7 @@ int bfcp_change_number_floors(bfcp_list_floors *lfloors, UINT16 Num)
 			while(query) {
 				temp = query;
 				query = query->next;
-				free(temp);
+				BFCP_FREE(BFCP_ALLOC_FLOOR, temp);
 				temp = NULL;
 			}
 		}
@@ -145,7 +234,13 @@ int bfcp_change_number_floors(bfcp_list_floors *lfloors, UINT16 Num)
 	if((lfloors->actual_number_floors) > Num)
 		lfloors->actual_number_floors = Num;
 
+	BFCP_FREE(BFCP_ALLOC_FLOOR, lfloors->floor_index);
+	lfloors->floor_index = index;
+	lfloors->floor_index_mask = mask;
+	bfcp_rebuild_floor_index(lfloors);
+
 	lfloors->number_floors = --Num;
+	lfloors->version++;
 
 	return 0;
 }
@@ -153,17 +248,12 @@ int bfcp_change_number_floors(bfcp_list_floors *lfloors, UINT16 Num)
 /* Check if a floor exists in a conference */
 int bfcp_exist_floor(bfcp_list_floors *lfloors, UINT16 floorID)
 {
-
-	int i = 0;
 	if(lfloors == NULL)
 		return -1;
 	if(floorID == 0)
 		return -1;
 
-	while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
-
-	if((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID == floorID))
+	if(bfcp_find_floor(lfloors, floorID) >= 0)
 		/* The floor exists */
 		return 0;
 	else
@@ -183,10 +273,8 @@ int bfcp_delete_floor(bfcp_list_floors *lfloors, UINT16 floorID)
 	if(lfloors == NULL)
 		return -1;
 
-	while(i < lfloors->actual_number_floors && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
-
-	if(i >= lfloors->actual_number_floors)
+	i = bfcp_find_floor(lfloors, floorID);
+	if(i < 0)
 		/* This floor does not exist in this conference */
 		return -1;
 
@@ -210,11 +298,13 @@ int bfcp_delete_floor(bfcp_list_floors *lfloors, UINT16 floorID)
 	while(query) {
 		temp = query;
 		query = query->next;
-		free(temp);
+		BFCP_FREE(BFCP_ALLOC_FLOOR, temp);
 		temp = NULL;
 	}
 
 	lfloors->actual_number_floors = lfloors->actual_number_floors - 1;
+	bfcp_rebuild_floor_index(lfloors);
+	lfloors->version++;
 
 	return lfloors->actual_number_floors;
 }
@@ -230,15 +320,15 @@ int bfcp_change_chair(bfcp_list_floors *lfloors, UINT16 floorID, UINT16 chairID)
 		return -1;
 
 
-	while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
+	i = bfcp_find_floor(lfloors, floorID);
 
-    if(i >= lfloors->actual_number_floors){
+    if(i < 0){
         /* A floor with this floorID does not exists in this conference */
         return -1;
     }
 
     lfloors->floors[i].chairID = chairID;
+    lfloors->version++;
 
     return 0;
 }
@@ -253,10 +343,9 @@ int bfcp_return_number_granted_floor(bfcp_list_floors *lfloors, UINT16 floorID)
 	if(floorID == 0)
 		return -1;
 
-	while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
+	i = bfcp_find_floor(lfloors, floorID);
 
-	if(i >= lfloors->actual_number_floors)
+	if(i < 0)
 		/* A floor with this floorID does not exists in this conference */
 		return -1;
 	
@@ -274,10 +363,9 @@ int bfcp_change_number_granted_floor(bfcp_list_floors *lfloors, UINT16 floorID,
 		return -1;
 
 
-	while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
+	i = bfcp_find_floor(lfloors, floorID);
 
-	if(i >= lfloors->actual_number_floors)
+	if(i < 0)
 		/* A floor with this floorID does not exists in this conference */
 		return -1;
 
@@ -285,6 +373,7 @@ int bfcp_change_number_granted_floor(bfcp_list_floors *lfloors, UINT16 floorID,
 		lfloors->floors[i].limit_granted_floor = USHRT_MAX;
 	else
 		lfloors->floors[i].limit_granted_floor = (1 + limit_granted_floor);
+	lfloors->version++;
 
 	return 0;
 }
@@ -301,14 +390,14 @@ int bfcp_change_state_floor(bfcp_list_floors *lfloors, UINT16 floorID, e_floor_s
 	if( (state < BFCP_FLOOR_STATE_WAITING)||(state > BFCP_FLOOR_STATE_GRANTED))
 		return -1;
 
-	while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
+	i = bfcp_find_floor(lfloors, floorID);
 
-    if(i >= lfloors->actual_number_floors)
+    if(i < 0)
         /* A floor with this floorID does not exists in this conference */
         return -1;
 
     lfloors->floors[i].floorState = state ;
+    lfloors->version++;
     return 0;
 }
 
@@ -324,10 +413,9 @@ e_floor_state bfcp_return_state_floor(bfcp_list_floors *lfloors, UINT16 floorID)
 	if(lfloors->floors == NULL)
 		return -1;
 
-	while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
+	i = bfcp_find_floor(lfloors, floorID);
 
-	if(i >= lfloors->actual_number_floors)
+	if(i < 0)
 		/* A floor with this floorID does not exists in this conference */
 		return -1;
 
@@ -344,10 +432,9 @@ int bfcp_return_position_floor(bfcp_list_floors *lfloors, UINT16 floorID)
 	if(lfloors == NULL)
 		return -1;
 
-	while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
+	i = bfcp_find_floor(lfloors, floorID);
 
-	if(i >= lfloors->actual_number_floors)
+	if(i < 0)
 		/* A floor with this floorID does not exists in this conference */
 		return -1;
 
@@ -363,10 +450,9 @@ UINT16 bfcp_return_chair_floor(bfcp_list_floors *lfloors, UINT16 floorID)
 	if(lfloors == NULL)
 		return 0;
 
-	while((i < lfloors->actual_number_floors) && (lfloors->floors[i].floorID != floorID))
-		i = i + 1;
+	i = bfcp_find_floor(lfloors, floorID);
 
-	if(i >= lfloors->actual_number_floors)
+	if(i < 0)
 	  	/* A floor with this floorID does not exists in this conference */
 		  return 0;
 
@@ -409,12 +495,14 @@ int bfcp_clean_floor_list(bfcp_list_floors *lfloors)
 		while(query) {
 			temp = query;
 			query = query->next;
-			free(temp);
+			BFCP_FREE(BFCP_ALLOC_FLOOR, temp);
 			temp = NULL;
 		}
 	}
 
 	lfloors->actual_number_floors = 0;
+	bfcp_rebuild_floor_index(lfloors);
+	lfloors->version++;
 
 	return 0;
 }
@@ -429,9 +517,11 @@ int bfcp_remove_floor_list(bfcp_list_floors **lfloorsp)
 		return 0;
 	error = bfcp_clean_floor_list(lfloors);
 	if(error == 0) {
-		free(lfloors->floors);
+		BFCP_FREE(BFCP_ALLOC_FLOOR, lfloors->floors);
 		lfloors->floors = NULL;
-		free(lfloors);
+		BFCP_FREE(BFCP_ALLOC_FLOOR, lfloors->floor_index);
+		lfloors->floor_index = NULL;
+		BFCP_FREE(BFCP_ALLOC_FLOOR, lfloors);
 		*lfloorsp = NULL;
 	} else
 		return -1;
@@ -456,7 +546,7 @@ int remove_request_from_the_floor(bfcp_floors *floors, UINT16 userID)
 		/* If this user exists in the request list, we remove it from the node */
 		floors->floorquery = floorquery->next;
 		floorquery->next = NULL;
-		free(floorquery);
+		BFCP_FREE(BFCP_ALLOC_FLOOR, floorquery);
 		floorquery = NULL;
 		return 0;
 	}
@@ -466,7 +556,7 @@ int remove_request_from_the_floor(bfcp_floors *floors, UINT16 userID)
 			newnode= floorquery->next;
 			floorquery->next = newnode->next;
 			newnode->next = NULL;
-			free(newnode);
+			BFCP_FREE(BFCP_ALLOC_FLOOR, newnode);
 			newnode = NULL;
 			return 0;
 		}
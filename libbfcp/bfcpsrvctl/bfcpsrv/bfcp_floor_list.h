@@ -51,6 +51,9 @@ typedef struct bfcp_list_floors {
 	UINT16 number_floors;		/* The maximum allowed number of floors in this conference */
 	UINT16 actual_number_floors;	/* The currently available floors in this conference */
 	struct bfcp_floors *floors;			/* List of floors */
+	UINT32 *floor_index;		/* FloorID -> position+1 table (0 means empty slot) */
+	UINT32 floor_index_mask;	/* Size of the floor_index table minus one (power of two) */
+	UINT32 version;			/* Bumped at every change of the floors, to let readers cache their state */
 } bfcp_list_floors;
 /* Pointer to a list of floors */
 typedef bfcp_list_floors *lfloors;
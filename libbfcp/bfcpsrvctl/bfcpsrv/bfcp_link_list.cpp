@@ -15,12 +15,117 @@
 
 #include "../../bfcp_threads.h"
 #include "../../BFCPexception.h"
+#include "../../bfcpmsg/bfcp_alloc.h"
 #include "bfcp_link_list.h"
 
 BFCP_LinkList::BFCP_LinkList(){
+    bfcp_slab_init(&m_node_slab, sizeof(bfcp_node), BFCP_SLAB_CHUNK_OBJECTS);
+    bfcp_slab_init(&m_floor_slab, sizeof(bfcp_floor), BFCP_SLAB_CHUNK_OBJECTS);
+    bfcp_slab_init(&m_query_slab, sizeof(floor_request_query), BFCP_SLAB_CHUNK_OBJECTS);
 }
 
 BFCP_LinkList::~BFCP_LinkList(void){
+    bfcp_slab_destroy(&m_query_slab);
+    bfcp_slab_destroy(&m_floor_slab);
+    bfcp_slab_destroy(&m_node_slab);
+}
+
+/* Get a new FloorRequest node from the node slab */
+bfcp_node *BFCP_LinkList::bfcp_new_node(void)
+{
+	pnode node = (pnode)bfcp_slab_alloc(&m_node_slab);
+
+	if(node != NULL)
+		BFCP_ALLOC_OBJECT(BFCP_ALLOC_REQUEST, sizeof(bfcp_node));
+	return node;
+}
+
+/* Free the texts of a FloorRequest node and give it back to the slab (floors and queries are not freed) */
+void BFCP_LinkList::bfcp_free_node(bfcp_node *node)
+{
+	if(node == NULL)
+		return;
+
+	bfcp_free_info(&node->participant_info, node->participant_buf);
+	bfcp_free_info(&node->chair_info, node->chair_buf);
+	bfcp_slab_free(&m_node_slab, node);
+	BFCP_FREE_OBJECT(BFCP_ALLOC_REQUEST, sizeof(bfcp_node));
+}
+
+/* Get a new floor from the floor slab */
+bfcp_floor *BFCP_LinkList::bfcp_new_floor(void)
+{
+	pfloor floor = (pfloor)bfcp_slab_alloc(&m_floor_slab);
+
+	if(floor != NULL) {
+		floor->pID = BFCP_NULL_THREAD_HANDLE;
+		BFCP_ALLOC_OBJECT(BFCP_ALLOC_REQUEST, sizeof(bfcp_floor));
+	}
+	return floor;
+}
+
+/* Free the text of a floor and give it back to the slab */
+void BFCP_LinkList::bfcp_free_floor(bfcp_floor *floor)
+{
+	if(floor == NULL)
+		return;
+
+	bfcp_free_info(&floor->chair_info, floor->chair_buf);
+	bfcp_slab_free(&m_floor_slab, floor);
+	BFCP_FREE_OBJECT(BFCP_ALLOC_REQUEST, sizeof(bfcp_floor));
+}
+
+/* Get a new FloorRequestQuery from the query slab */
+floor_request_query *BFCP_LinkList::bfcp_new_request_query(void)
+{
+	floor_request_query *query = (floor_request_query *)bfcp_slab_alloc(&m_query_slab);
+
+	if(query != NULL)
+		BFCP_ALLOC_OBJECT(BFCP_ALLOC_REQUEST, sizeof(floor_request_query));
+	return query;
+}
+
+/* Give a FloorRequestQuery back to the slab */
+void BFCP_LinkList::bfcp_free_request_query(floor_request_query *query)
+{
+	if(query == NULL)
+		return;
+
+	bfcp_slab_free(&m_query_slab, query);
+	BFCP_FREE_OBJECT(BFCP_ALLOC_REQUEST, sizeof(floor_request_query));
+}
+
+/* Replace a text, stored in 'buffer' when short enough (an empty or NULL text removes it) */
+int BFCP_LinkList::bfcp_set_info(char **info, char *buffer, const char *text)
+{
+	size_t dLen;
+
+	bfcp_free_info(info, buffer);
+	if(text == NULL)
+		return 0;
+
+	dLen = strlen(text);
+	if(dLen == 0)
+		return 0;
+
+	if(dLen < BFCP_INLINE_INFO_SIZE)
+		*info = buffer;
+	else {
+		*info = (char *)BFCP_CALLOC(BFCP_ALLOC_QUEUE, 1, dLen*sizeof(char)+1);
+		if(*info == NULL)
+			return -1;
+	}
+	memcpy(*info, text, dLen+1);
+
+	return 0;
+}
+
+/* Free a text set by bfcp_set_info */
+void BFCP_LinkList::bfcp_free_info(char **info, char *buffer)
+{
+	if(*info != buffer)
+		BFCP_FREE(BFCP_ALLOC_QUEUE, *info);
+	*info = NULL;
 }
 
 /* Create a new linked list of BFCP queues */
@@ -29,7 +134,7 @@ struct bfcp_queue *BFCP_LinkList::bfcp_create_list(void)
 	bfcp_queue *conference;
 
 	/* Create a new list of BFCP queues */
-	conference = (bfcp_queue *)calloc(1, sizeof(bfcp_queue));
+	conference = (bfcp_queue *)BFCP_CALLOC(BFCP_ALLOC_QUEUE, 1, sizeof(bfcp_queue));
 
 	/* Initialize the list */
 	if(conference == NULL)
@@ -52,14 +157,13 @@ struct bfcp_node *BFCP_LinkList::bfcp_init_request(UINT16 userID, UINT16 benefic
 
 	pnode newnode;
 	pfloor floor_list;
-	size_t dLen;
 
 	/* Check if the priority argument is valid */
 	if(priority > BFCP_HIGHEST_PRIORITY)
 		priority = BFCP_HIGHEST_PRIORITY;
 	
 	/* Create a new node */
-	newnode = (pnode)calloc(1, sizeof(bfcp_node));
+	newnode = bfcp_new_node();
 	if(!newnode)
 		return (NULL);
 
@@ -71,25 +175,22 @@ struct bfcp_node *BFCP_LinkList::bfcp_init_request(UINT16 userID, UINT16 benefic
 	newnode->queue_position = 0;
 	newnode->chair_info = NULL;
 	newnode->floorrequest = NULL;
+	memset(&newnode->trace, 0, sizeof(newnode->trace));
 
 	/* Add participant-provided text, if present */
-	if(participant_info != NULL) {
-		dLen= strlen(participant_info);
-		if(dLen != 0) {
-			newnode->participant_info = (char *)calloc(1, dLen*sizeof(char)+1);
-			if(newnode->participant_info == NULL)
-				return NULL;
-			memcpy(newnode->participant_info, participant_info, dLen+1);
-		}
-	} else
-		newnode->participant_info= NULL;
+	if(bfcp_set_info(&newnode->participant_info, newnode->participant_buf, participant_info) == -1) {
+		bfcp_free_node(newnode);
+		return NULL;
+	}
 
 	/* Create a new list of floors */
-	floor_list = (pfloor)calloc(1, sizeof(bfcp_floor));
+	floor_list = bfcp_new_floor();
 
 	/* Initialize the list */
-	if(floor_list == NULL)
+	if(floor_list == NULL) {
+		bfcp_free_node(newnode);
 		return NULL;
+	}
 	else{
 		floor_list->floorID = floorID;
 		floor_list->status = BFCP_FLOOR_STATE_WAITING;
@@ -120,7 +221,7 @@ int BFCP_LinkList::bfcp_add_floor_to_request(pnode newnode, UINT16 floorID)
 	}
 
 	/* Create a new list of floors */
-	floor_list = (pfloor)calloc(1, sizeof(bfcp_floor));
+	floor_list = bfcp_new_floor();
 
 	/* Initialize the list */
 	if(floor_list == NULL)
@@ -167,26 +268,18 @@ int BFCP_LinkList::bfcp_insert_request(bfcp_queue *conference, pnode newnode, UI
 		return -1;
 
 	pnode traverse;
-	size_t dLen, y = 1;
+	size_t y = 1;
 
 	/* Add the floorRequestID to the node */
 	newnode->floorRequestID = floorRequestID;	
+	conference->version++;
 	Log(INF, ">> Inserting floorRequestID [%d] request into queue[0x%p]",floorRequestID, conference);
 
 	if(chair_info != NULL) {
-		dLen = strlen(chair_info);
-		if(dLen != 0) {
-			if(newnode->chair_info != NULL) {
-				free(newnode->chair_info);
-				newnode->chair_info = NULL;
-			}
-			newnode->chair_info = (char *)calloc(1, dLen*sizeof(char)+1);
-			if(newnode->chair_info == NULL)
-				return -1;
-			memcpy(newnode->chair_info, chair_info, dLen+1);
-		}
+		if((strlen(chair_info) != 0) && (bfcp_set_info(&newnode->chair_info, newnode->chair_buf, chair_info) == -1))
+			return -1;
 	} else
-		newnode->chair_info = NULL;
+		bfcp_free_info(&newnode->chair_info, newnode->chair_buf);
 
 	/* Insert the new node in the structure*/
 	traverse = conference->head;
@@ -286,9 +379,9 @@ int BFCP_LinkList::bfcp_change_status(bfcp_queue *conference, UINT16 floorID, UI
 
 	pnode traverse;
 	pfloor floor;
-	size_t dLen;
 	
 	traverse = conference->head;
+	conference->version++;
 
 	while(traverse && (traverse->floorRequestID != floorRequestID))
 		traverse = traverse->next;
@@ -303,19 +396,10 @@ int BFCP_LinkList::bfcp_change_status(bfcp_queue *conference, UINT16 floorID, UI
 			floor->status = status;
 			/* If there's chair-provided text, add it */
 			if(floor_chair_info != NULL) {
-				dLen = strlen(floor_chair_info);
-				if(dLen != 0) {
-					if(floor->chair_info != NULL) {
-						free(floor->chair_info);
-						floor->chair_info = NULL;
-					}
-					floor->chair_info = (char *)calloc(1, dLen*sizeof(char)+1);
-					if(floor->chair_info == NULL)
-						return -1;
-					memcpy(floor->chair_info, floor_chair_info, dLen+1);
-				}
+				if((strlen(floor_chair_info) != 0) && (bfcp_set_info(&floor->chair_info, floor->chair_buf, floor_chair_info) == -1))
+					return -1;
 			} else
-			floor->chair_info = NULL;
+				bfcp_free_info(&floor->chair_info, floor->chair_buf);
 			return 0;
 		}
 		floor = floor->next;
@@ -391,6 +475,9 @@ int BFCP_LinkList::bfcp_delete_node_with_floorID(UINT32 conferenceID, bfcp_queue
     int delete_node = 0, i = 0;
 
     traverse = conference->head;
+    conference->version++;
+    if(accepted != NULL)
+        accepted->version++;
 
     while(traverse) {
         floor = traverse->floor;
@@ -441,14 +528,14 @@ int BFCP_LinkList::bfcp_delete_node_with_floorID(UINT32 conferenceID, bfcp_queue
                         i = bfcp_return_position_floor(lfloors, temp->floorID);
                         if(i != -1) {
                             if(lfloors != NULL) {
-                                if(lfloors->floors != NULL)
+                                if(lfloors->floors != NULL) {
                                     lfloors->floors[i].floorState = BFCP_FLOOR_STATE_WAITING;
+                                    lfloors->version++;
+                                }
                             }
                         }
                     }
-                    free(temp->chair_info);
-                    temp->chair_info = NULL;
-                    free(temp);
+                    bfcp_free_floor(temp);
                     temp = NULL;
                     temp = next;
                 }
@@ -457,16 +544,12 @@ int BFCP_LinkList::bfcp_delete_node_with_floorID(UINT32 conferenceID, bfcp_queue
                 temp_request = traverse_temp->floorrequest;
                 while(temp_request != NULL) {
                     next_request = temp_request->next;
-                    free(temp_request);
+                    bfcp_free_request_query(temp_request);
                     temp_request = NULL;
                     temp_request = next_request;
                 }
 
-                free(traverse_temp->participant_info);
-                traverse_temp->participant_info = NULL;
-                free(traverse_temp->chair_info);
-                traverse_temp->chair_info = NULL;
-                free(traverse_temp);
+                bfcp_free_node(traverse_temp);
                 traverse_temp = NULL;
                 floor = NULL;
                 delete_node = 1;
@@ -498,6 +581,7 @@ int BFCP_LinkList::bfcp_delete_node_with_userID(bfcp_queue *conference, UINT16 u
     int i = 0;
 
     traverse = conference->head;
+    conference->version++;
 
     while(traverse!=NULL) {
         if((traverse->userID == userID) || (traverse->beneficiaryID == userID)) {
@@ -533,12 +617,12 @@ int BFCP_LinkList::bfcp_delete_node_with_userID(bfcp_queue *conference, UINT16 u
                 next = temp->next;
                 if(temp->status == 2) {
                     i = bfcp_return_position_floor(lfloors, temp->floorID);
-                    if(i != -1)
+                    if(i != -1) {
                         lfloors->floors[i].floorState = BFCP_FLOOR_STATE_WAITING;
+                        lfloors->version++;
+                    }
                 }
-                free(temp->chair_info);
-                temp->chair_info = NULL;
-                free(temp);
+                bfcp_free_floor(temp);
                 temp = NULL;
                 temp = next;
             }
@@ -546,16 +630,12 @@ int BFCP_LinkList::bfcp_delete_node_with_userID(bfcp_queue *conference, UINT16 u
             temp_request = traverse_temp->floorrequest;
             while(temp_request != NULL) {
                 next_request = temp_request->next;
-                free(temp_request);
+                bfcp_free_request_query(temp_request);
                 temp_request = NULL;
                 temp_request = next_request;
             }
 
-            free(traverse_temp->participant_info);
-            traverse_temp->participant_info = NULL;
-            free(traverse_temp->chair_info);
-            traverse_temp->chair_info = NULL;
-            free(traverse_temp);
+            bfcp_free_node(traverse_temp);
             traverse_temp = NULL;
         } else
             traverse = traverse->next;
@@ -576,6 +656,7 @@ bfcp_floor *BFCP_LinkList::bfcp_delete_request(bfcp_queue *conference, UINT16 fl
 	pfloor temp, floor;
 
 	traverse = conference->head;
+	conference->version++;
 
 	while(traverse && (traverse->floorRequestID != floorRequestID))
 		traverse = traverse->next;
@@ -614,11 +695,7 @@ bfcp_floor *BFCP_LinkList::bfcp_delete_request(bfcp_queue *conference, UINT16 fl
 	/* Remove the list of requests */
 	remove_request_list_of_node(traverse->floorrequest);
 
-	free(traverse->participant_info);
-	traverse->participant_info = NULL;
-	free(traverse->chair_info);
-	traverse->chair_info = NULL;
-	free(traverse);
+	bfcp_free_node(traverse);
 	traverse = NULL;
 
 	return temp;
@@ -634,6 +711,7 @@ bfcp_node *BFCP_LinkList::bfcp_extract_request(bfcp_queue *conference, UINT16 fl
 
 	pnode traverse;
 	traverse = conference->head;
+	conference->version++;
 
 	while(traverse && (traverse->floorRequestID != floorRequestID))
 		traverse = traverse->next;
@@ -690,6 +768,7 @@ int BFCP_LinkList::bfcp_clean_request_list(bfcp_queue *conference)
 	floor_request_query *next_request;
 
 	traverse = conference->head;
+	conference->version++;
 	while(traverse) {
 		node = traverse;
 		traverse = traverse->next;
@@ -703,9 +782,7 @@ int BFCP_LinkList::bfcp_clean_request_list(bfcp_queue *conference)
 				temp->pID = BFCP_NULL_THREAD_HANDLE;
 			}
 			next = temp->next;
-			free(temp->chair_info);
-			temp->chair_info = NULL;
-			free(temp);
+			bfcp_free_floor(temp);
 			temp = NULL;
 			temp = next;
 		}
@@ -713,16 +790,12 @@ int BFCP_LinkList::bfcp_clean_request_list(bfcp_queue *conference)
 		temp_request = node->floorrequest;
 		while(temp_request) {
 			next_request = temp_request->next;
-			free(temp_request);
+			bfcp_free_request_query(temp_request);
 			temp_request = NULL;
 			temp_request = next_request;
 		}
 
-		free(node->participant_info);
-		node->participant_info = NULL;
-		free(node->chair_info);
-		node->chair_info = NULL;
-		free(node);
+		bfcp_free_node(node);
 		node = NULL;
 	}
 	conference->head = NULL;
@@ -742,7 +815,7 @@ int BFCP_LinkList::bfcp_remove_request_list(bfcp_queue **conference_p)
 
 	error = bfcp_clean_request_list(conference);
 	if(error==0) {
-		free(conference);
+		BFCP_FREE(BFCP_ALLOC_QUEUE, conference);
 		conference = NULL;
 		*conference_p = NULL;
 	}
@@ -784,82 +857,19 @@ int BFCP_LinkList::bfcp_kill_threads_request_with_FloorRequestID(bfcp_queue *con
 	return 0;
 }
 
-/* Convert a 'bfcp_node' info to 'bfcp_floor_request_information' (bfcp_messages.h) */
-bfcp_floor_request_information *BFCP_LinkList::bfcp_show_floorrequest_information(bfcp_queue *conference, lusers users, UINT32 floorRequestID, int type_queue)
+/* Look for a FloorRequest in one of the BFCP queues */
+bfcp_node *BFCP_LinkList::bfcp_find_request(bfcp_queue *conference, UINT16 floorRequestID)
 {
 	if(conference == NULL)
 		return NULL;
 
 	pnode traverse;
-	pfloor floor;
-	bfcp_user_information *beneficiary_info, *user_info;
-	bfcp_floor_request_information *frqInfo;
-	bfcp_overall_request_status *oRS = NULL;
-	bfcp_floor_request_status *fRS_temp = NULL, *fRS = NULL;
-	
 	traverse = conference->tail;
-	
-	if(!traverse)
-		/* The list is empty */
-		return NULL;
-    e_bfcp_status e_status = BFCP_PENDING ;
-	while(traverse) {
-		if(traverse->floorRequestID == floorRequestID) {
-			if(type_queue == 0){
-				/* Granted */
-				e_status = BFCP_GRANTED ;
-				oRS = bfcp_new_overall_request_status(traverse->floorRequestID, BFCP_GRANTED, 0, traverse->chair_info);
-			} else if(type_queue==1) {
-				/* Accepted */
-				e_status = BFCP_ACCEPTED ;
-				oRS = bfcp_new_overall_request_status(traverse->floorRequestID, BFCP_ACCEPTED, traverse->queue_position, traverse->chair_info);
-			} else if(type_queue==2) {
-				/* Pending */
-				e_status = BFCP_PENDING ;
-				oRS = bfcp_new_overall_request_status(traverse->floorRequestID, BFCP_PENDING, traverse->priority, traverse->chair_info);
-			} else {
-				/* Revoke */
-				e_status = BFCP_REVOKED ;
-				oRS = bfcp_new_overall_request_status(traverse->floorRequestID, BFCP_REVOKED, 0, traverse->chair_info);
-            }
-			floor = traverse->floor;
-			if(floor != NULL) {
-				fRS = bfcp_new_floor_request_status(floor->floorID, e_status , 0, floor->chair_info);
-				floor = floor->next;
-				while(floor) {
-					fRS_temp = bfcp_new_floor_request_status(floor->floorID, e_status, 0, floor->chair_info);
-					if(fRS_temp != NULL)
-						bfcp_list_floor_request_status(fRS, fRS_temp, NULL);
-					floor = floor->next;
-				}
-			}
 
-            if(traverse->beneficiaryID !=0) {
-                beneficiary_info = BFCP_LinkList_show_user_information(users, traverse->beneficiaryID);
-                if(beneficiary_info == NULL) {
-					bfcp_free_user_information(beneficiary_info);
-					return NULL;
-				}
-			} else
-				beneficiary_info=NULL;
-
-            if(traverse->userID != 0) {
-                    user_info = BFCP_LinkList_show_user_information(users, traverse->userID);
-                if(user_info == NULL) {
-					bfcp_free_user_information(user_info);
-					return NULL;
-				}
-			} else
-				user_info = NULL;
-		
-			frqInfo = bfcp_new_floor_request_information(traverse->floorRequestID, oRS, fRS, beneficiary_info, user_info, traverse->priority, traverse->participant_info);
-			return frqInfo;
-		}
+	while(traverse && (traverse->floorRequestID != floorRequestID))
 		traverse = traverse->prev;
-	}
 
-	/* If we arrived so far, something wrong happened */
-	return NULL;
+	return traverse;
 }
 
 /* Create a new linked list of floors */
@@ -869,10 +879,9 @@ bfcp_floor *BFCP_LinkList::create_floor_list(UINT16 floorID, e_floor_state statu
 		return NULL;
 
 	bfcp_floor *floor_list;
-	size_t dLen;
 
 	/* Create a new list of floors */
-	floor_list = (pfloor)calloc(1, sizeof(bfcp_floor));
+	floor_list = bfcp_new_floor();
 
 	/* Initialize the list*/
 	if(floor_list == NULL)
@@ -882,16 +891,10 @@ bfcp_floor *BFCP_LinkList::create_floor_list(UINT16 floorID, e_floor_state statu
 		floor_list->status = status;
 		floor_list->pID = BFCP_NULL_THREAD_HANDLE;
 		/* If there's chair-provided text, add it */
-		if(floor_chair_info != NULL) {
-			dLen= strlen(floor_chair_info);
-			if(dLen != 0) {
-				floor_list->chair_info = (char *)calloc(1, dLen*sizeof(char)+1);
-				if(floor_list->chair_info == NULL)
-					return NULL;
-				memcpy(floor_list->chair_info, floor_chair_info, dLen+1);
-			}
-		} else
-			floor_list->chair_info = NULL;
+		if(bfcp_set_info(&floor_list->chair_info, floor_list->chair_buf, floor_chair_info) == -1) {
+			bfcp_free_floor(floor_list);
+			return NULL;
+		}
 	
 		floor_list->next = NULL;
 	}
@@ -908,10 +911,9 @@ bfcp_floor *BFCP_LinkList::add_floor_list(bfcp_floor *floor_list, UINT16 floorID
 		return NULL;
 
 	pfloor ini_floor_list, floor;
-	size_t dLen;
 
     /* Create a new floor instance */
-	floor = (pfloor)calloc(1, sizeof(bfcp_floor));
+	floor = bfcp_new_floor();
 
 	/* Initialize the floor */
 	if(floor == NULL)
@@ -922,16 +924,10 @@ bfcp_floor *BFCP_LinkList::add_floor_list(bfcp_floor *floor_list, UINT16 floorID
 		floor->status = status;
 		floor->pID = BFCP_NULL_THREAD_HANDLE;
 		/* If there's chair-provided text, add it */
-		if(floor_chair_info != NULL) {
-			dLen = strlen(floor_chair_info);
-			if(dLen != 0) {
-				floor->chair_info = (char *)calloc(1, dLen*sizeof(char)+1);
-				if(floor->chair_info == NULL)
-					return NULL;
-				memcpy(floor->chair_info, floor_chair_info, dLen+1);
-			}
-		} else
-			floor->chair_info = NULL;
+		if(bfcp_set_info(&floor->chair_info, floor->chair_buf, floor_chair_info) == -1) {
+			bfcp_free_floor(floor);
+			return NULL;
+		}
 
 		floor->next = floor_list;
 		floor_list = floor;	
@@ -943,16 +939,10 @@ bfcp_floor *BFCP_LinkList::add_floor_list(bfcp_floor *floor_list, UINT16 floorID
 		floor->status = status;
 		floor->pID = BFCP_NULL_THREAD_HANDLE;
 		/* If there's chair-provided text, add it */
-		if(floor_chair_info != NULL) {
-			dLen = strlen(floor_chair_info);
-			if(dLen != 0) {
-				floor->chair_info = (char *)calloc(1, dLen*sizeof(char)+1);
-				if(floor->chair_info == NULL)
-					return NULL;
-				memcpy(floor->chair_info, floor_chair_info, dLen+1);
-			}
-		} else
-			floor->chair_info = NULL;
+		if(bfcp_set_info(&floor->chair_info, floor->chair_buf, floor_chair_info) == -1) {
+			bfcp_free_floor(floor);
+			return NULL;
+		}
 
 		floor->next = ini_floor_list->next;
 		ini_floor_list->next = floor;	
@@ -969,9 +959,7 @@ int BFCP_LinkList::remove_floor_list(bfcp_floor *floor_list)
 	/* Free all the elements from the floor list */
 	while(floor_list) {
 		next = floor_list->next;
-		free(floor_list->chair_info);
-		floor_list->chair_info = NULL;
-		free(floor_list);
+		bfcp_free_floor(floor_list);
 		floor_list = NULL;
 		floor_list = next;
 	}
@@ -988,7 +976,7 @@ int BFCP_LinkList::remove_request_list_of_node(floor_request_query *floorrequest
 	while(floorrequest) {
 		next = floorrequest->next;
 		floorrequest->next = NULL;
-		free(floorrequest);
+		bfcp_free_request_query(floorrequest);
 		floorrequest = NULL;
 		floorrequest = next;
 	}
@@ -1020,7 +1008,7 @@ int BFCP_LinkList::add_request_to_the_node(pnode traverse, UINT16 userID, int so
 
 	if(exist_query == 0) {
 		/* Create the new node */
-		newnode = (floor_request_query *)calloc(1, sizeof(floor_request_query));
+		newnode = bfcp_new_request_query();
 		if(newnode == NULL)
 			return -1;
 	
@@ -1054,7 +1042,7 @@ int BFCP_LinkList::remove_request_from_the_node(pnode traverse, UINT16 userID)
 	if(floorrequest->userID == userID) {
 		traverse->floorrequest = floorrequest->next;
 		floorrequest->next = NULL;
-		free(floorrequest);
+		bfcp_free_request_query(floorrequest);
 		floorrequest = NULL;
 		return 0;
 	}
@@ -1063,7 +1051,7 @@ int BFCP_LinkList::remove_request_from_the_node(pnode traverse, UINT16 userID)
 		if(floorrequest->next->userID == userID) {
 			newnode = floorrequest->next;
 			floorrequest->next = newnode->next;
-			free(newnode);
+			bfcp_free_request_query(newnode);
 			newnode = NULL;
 			return 0;
 		}
@@ -1087,6 +1075,9 @@ int BFCP_LinkList::bfcp_accepted_pending_node_with_floorID(UINT32 conferenceID,
 	pfloor floor;
 
 	traverse = conference->head;
+	conference->version++;
+	if(accepted != NULL)
+		accepted->version++;
 
 	while(traverse) {
 		floor = traverse->floor;
@@ -1094,7 +1085,7 @@ int BFCP_LinkList::bfcp_accepted_pending_node_with_floorID(UINT32 conferenceID,
 		while((floor != NULL) && (floor->floorID >= floorID)) {
 			if(floor->floorID == floorID) {
 				floor->status = BFCP_FLOOR_STATE_ACCEPTED;
-				floor->chair_info = NULL;
+				bfcp_free_info(&floor->chair_info, floor->chair_buf);
 			}
 
 			/* If all the floors in the request have been accepted... */
@@ -1142,6 +1133,7 @@ int BFCP_LinkList::bfcp_change_queue_position(bfcp_queue *conference, UINT16 flo
 
 	pnode traverse;
 	traverse = conference->head;
+	conference->version++;
 
 	while(traverse && (traverse->floorRequestID != floorRequestID))
 		traverse = traverse->next;
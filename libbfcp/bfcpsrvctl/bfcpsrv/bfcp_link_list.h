@@ -23,8 +23,12 @@
 #include "../../bfcpmsg/bfcp_messages.h"
 #include "bfcp_floor_list.h"
 #include "bfcp_user_list.h"
+#include "bfcp_slab.h"
 #include "../../bfcp_threads.h"
 
+/* Info strings up to this size (with the trailing NUL) are stored in the structure itself */
+#define BFCP_INLINE_INFO_SIZE	32
+
 
 /* FloorRequestQuery instance (to notify about request events) */
 typedef struct floor_request_query {
@@ -41,11 +45,34 @@ typedef struct bfcp_floor {
 	char *chair_info;		/* Chair-provided text about ChairActions */
 	BFCP_THREAD_HANDLE pID;			/* Thread handling this request */
 	struct bfcp_floor *next;	/* Next Floor in the list */
+	char chair_buf[BFCP_INLINE_INFO_SIZE];	/* Inline storage for a short chair_info */
 } bfcp_floor;
 
 /* Pointer to a specific instance */
 typedef bfcp_floor *pfloor;
 
+/** \brief Stages of a FloorRequest through the server, see bfcp_request_trace */
+typedef enum {
+	BFCP_TRACE_RECEIVED = 0,	/** \brief FloorRequest read from the connection */
+	BFCP_TRACE_PENDING,		/** \brief Inserted in the Pending list */
+	BFCP_TRACE_NOTIFIED,		/** \brief Passed to the application (chair) */
+	BFCP_TRACE_DECIDED,		/** \brief First answer of the application (FloorRequestRespons) */
+	BFCP_TRACE_GRANTED,		/** \brief Moved to the Granted list */
+	BFCP_TRACE_STATUS		/** \brief FloorRequestStatus sent (every one) */
+} e_bfcp_trace_stage;
+
+/** \brief Monotonic times of the stages of a FloorRequest (BFCP_Metrics::Now, 0: not reached) */
+/** \struct bfcp_request_trace */
+typedef struct bfcp_request_trace {
+	UINT64 received;
+	UINT64 pending;
+	UINT64 notified;
+	UINT64 decided;
+	UINT64 granted;
+	UINT64 status;		/** \brief Last FloorRequestStatus sent */
+	UINT16 statuses;	/** \brief FloorRequestStatus sent */
+} bfcp_request_trace;
+
 /** \brief FloorRequest information */
 /** \struct bfcp_node */
 typedef struct bfcp_node {
@@ -59,6 +86,9 @@ typedef struct bfcp_node {
 	struct floor_request_query *floorrequest;	/** \brief Array of queries for this request */
 	struct bfcp_floor *floor;			/** \brief List of floors in this request */
 	struct bfcp_node *next, *prev;			/** \brief This is a double-linked list */
+	char participant_buf[BFCP_INLINE_INFO_SIZE];	/** \brief Inline storage for a short participant_info */
+	char chair_buf[BFCP_INLINE_INFO_SIZE];	/** \brief Inline storage for a short chair_info */
+	bfcp_request_trace trace;			/** \brief Latency of the request through the server */
 } bfcp_node;
 /* Pointer to a specific instance */
 typedef bfcp_node *pnode;
@@ -75,6 +105,7 @@ A BFCP queue is structured as follows:
 typedef struct bfcp_queue {
     pnode head;  /* The first element in the list */
     pnode tail;  /* The last element in the list */
+    UINT32 version;  /* Bumped at every change of the list, to let readers cache its state */
 } bfcp_queue;
 
 class BFCP_LinkList 
@@ -83,7 +114,6 @@ class BFCP_LinkList
 public:
     BFCP_LinkList( );
     virtual ~BFCP_LinkList(void);
-    virtual bfcp_user_information* BFCP_LinkList_show_user_information(lusers list_users, UINT16 userID) = 0;
     virtual void Log(const  char* pcFile, int iLine, int iErrorLevel,const  char* pcFormat, ...) = 0;
     
 protected:
@@ -121,8 +151,8 @@ protected:
     int bfcp_remove_request_list(bfcp_queue **conference);
     /* Kill all the running threads handling a specific FloorRequest */
     int bfcp_kill_threads_request_with_FloorRequestID(bfcp_queue *conference, UINT16 floorRequestID);
-    /* Convert a 'bfcp_node' info to 'bfcp_floor_request_information' (bfcp_messages.h) */
-    bfcp_floor_request_information *bfcp_show_floorrequest_information(bfcp_queue *conference, lusers users, UINT32 FloorRequestID, int type_queue);
+    /* Look for a FloorRequest in one of the BFCP queues */
+    bfcp_node *bfcp_find_request(bfcp_queue *conference, UINT16 floorRequestID);
 
 
     /******************/
@@ -145,5 +175,27 @@ protected:
     int bfcp_accepted_pending_node_with_floorID(UINT32 conferenceID, bfcp_queue *accepted, bfcp_queue *conference, UINT16 floorID, bfcp_list_floors *lfloors, int type_list);
     /* Change position in queue to a FloorRequest */
     int bfcp_change_queue_position(bfcp_queue *conference, UINT16 floorRequestID, UINT16 queue_position);
+
+    /* Get a new FloorRequest node from the node slab */
+    bfcp_node *bfcp_new_node(void);
+    /* Free the texts of a FloorRequest node and give it back to the slab (floors and queries are not freed) */
+    void bfcp_free_node(bfcp_node *node);
+    /* Get a new floor from the floor slab */
+    bfcp_floor *bfcp_new_floor(void);
+    /* Free the text of a floor and give it back to the slab */
+    void bfcp_free_floor(bfcp_floor *floor);
+    /* Get a new FloorRequestQuery from the query slab */
+    floor_request_query *bfcp_new_request_query(void);
+    /* Give a FloorRequestQuery back to the slab */
+    void bfcp_free_request_query(floor_request_query *query);
+    /* Replace a text, stored in 'buffer' when short enough (an empty or NULL text removes it) */
+    int bfcp_set_info(char **info, char *buffer, const char *text);
+    /* Free a text set by bfcp_set_info */
+    void bfcp_free_info(char **info, char *buffer);
+
+private:
+    bfcp_slab m_node_slab;	/* Slab of FloorRequest nodes */
+    bfcp_slab m_floor_slab;	/* Slab of floors of the FloorRequests */
+    bfcp_slab m_query_slab;	/* Slab of FloorRequestQuery subscribers */
 };
 #endif
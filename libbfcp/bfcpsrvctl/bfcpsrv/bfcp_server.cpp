@@ -30,18 +30,14 @@
 #include <sstream>
 
 #include "../../BFCPexception.h"
+#include "../../bfcp_probes.h"
+#include "../../bfcpmsg/bfcp_alloc.h"
 #include "../../bfcpmsg/bfcp_strings.h"
 #include "bfcp_link_list.h"
 #ifdef QN_CROSS_COMPILE
 #include <android/log.h>
 #endif
 
-/* Macro to check for errors after sending a BFCP message */
-
-#define BFCP_SEND_CHECK_ERRORS()                           \
-    if (arguments != NULL) bfcp_free_arguments(arguments); \
-    if (message != NULL) bfcp_free_message(message);
-
 extern "C" void _ServerLog(char *pcFile, int iLine, int iErrorLevel,
                            char *pcFormat, ...) {
     static BFCP_Server _p;
@@ -60,6 +56,19 @@ extern "C" void _ServerLog(char *pcFile, int iLine, int iErrorLevel,
     } while (false);
 #endif  // HSU
 
+/* Primitives and attributes the FCS supports, announced in HelloAck */
+static const UINT8 _server_primitives[] = {
+    e_primitive_FloorRequest, e_primitive_FloorRelease, e_primitive_FloorStatus,
+    e_primitive_Hello,        e_primitive_HelloAck,     e_primitive_Goodbye,
+    e_primitive_GoodbyeAck,   e_primitive_Error};
+static const UINT8 _server_attributes[] = {
+    BENEFICIARY_ID, FLOOR_ID, FLOOR_REQUEST_ID, PRIORITY, REQUEST_STATUS,
+    ERROR_CODE, ERROR_INFO, PARTICIPANT_PROVIDED_INFO, STATUS_INFO,
+    SUPPORTED_ATTRIBUTES, SUPPORTED_PRIMITIVES, USER_DISPLAY_NAME, USER_URI,
+    BENEFICIARY_INFORMATION, FLOOR_REQUEST_INFORMATION,
+    REQUESTED_BY_INFORMATION, FLOOR_REQUEST_STATUS, OVERALL_REQUEST_STATUS,
+    NONCE, DIGEST};
+
 BFCP_Server::BFCP_Server(UINT8 Max_conf, UINT32 p_confID, UINT32 p_userID,
                          UINT32 p_floorID, UINT32 p_streamID,
                          BFCP_Server::ServerEvent *p_ServerEvent, int transport)
@@ -79,6 +88,18 @@ BFCP_Server::BFCP_Server(UINT8 Max_conf, UINT32 p_confID, UINT32 p_userID,
     m_streamID = p_streamID;
     setName("Server");
     m_trIdGenerator = 100;
+    memset(&m_snapshot, 0, sizeof(m_snapshot));
+    m_snapshot_valid = false;
+    memset(m_snapshot_versions, 0, sizeof(m_snapshot_versions));
+    m_requestTracing = false;
+    /* Acks have a fixed shape: encode them once */
+    bfcp_template_init(&m_helloack_template, e_primitive_HelloAck, 0,
+                       _server_primitives, sizeof(_server_primitives),
+                       _server_attributes, sizeof(_server_attributes));
+    bfcp_template_init(&m_chairactionack_template, e_primitive_ChairActionAck,
+                       0, NULL, 0, NULL, 0);
+    bfcp_template_init(&m_goodbyeack_template, e_primitive_GoodbyeAck, 0, NULL,
+                       0, NULL, 0);
 
     Log(INF,
         "BFCP_Server:: created Server conferenceID[%d] first userID[%d] "
@@ -104,7 +125,7 @@ BFCP_Server::BFCP_Server(UINT8 Max_conf, UINT32 p_confID, UINT32 p_userID,
         bfcp_mutex_lock(count_mutex);
         free(struct_server);
         struct_server = NULL;
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         throw IllegalArgumentException(
             "BFCP_Server:: Allocate and setup invalid");
     }
@@ -161,9 +182,10 @@ BFCP_Server::~BFCP_Server(void) {
     bfcp_mutex_destroy(count_mutex);
 }
 
-void BFCP_Server::initStateMachine() {
-    // By default init for particpant
-    st_BFCP_fsm BFCPStateMachine[BFCP_ACT_LAST][BFCP_ACT_LAST] = {
+/* Transitions of the sessions of the users, shared by all of them: a session
+   only keeps its current state (bfcp_user::session_state) */
+const BFCP_Server::st_BFCP_fsm
+    BFCP_Server::s_stateMachine[BFCP_ACT_LAST][BFCP_ACT_LAST] = {
         /* from BFCP_ACT_UNDEFINED */
         {
             {BFCP_ACT_UNDEFINED,
@@ -1460,7 +1482,10 @@ void BFCP_Server::initStateMachine() {
             {BFCP_ACT_SERVER_SHARE,
              &BFCP_fsm::BFCPFSM_NullFunction} /* BFCP_ACT_SERVER_SHARE */
         }};
-    BFCPFSM_init(BFCPStateMachine);
+
+void BFCP_Server::initStateMachine() {
+    /* The server socket goes through the same transitions */
+    BFCPFSM_init(s_stateMachine);
 }
 
 /**
@@ -1679,6 +1704,14 @@ bool BFCP_Server::OnBFCPDisconnected(BFCP_SOCKET socket) {
     s_bfcp_msg_event evt;
     memset(&evt, 0, sizeof(s_bfcp_msg_event));
     if (socket == getServerSocket()) {
+        /* The sessions of all the users start again */
+        bfcp_mutex_lock(count_mutex);
+        int i = CheckConferenceAndUser(m_struct_server, m_confID, 0,
+                                       BFCP_INVALID_SOCKET);
+        if (i >= 0)
+            bfcp_reset_user_sessions(m_struct_server->list_conferences[i].user,
+                                     BFCP_ACT_INITIALIZED);
+        UnlockServer();
         return FsmCtrlPerform(BFCP_fsm::BFCP_ACT_DISCONNECTED, &evt);
     } else {
         /* Lookup conference for all user with the same sockfd */
@@ -1691,6 +1724,10 @@ bool BFCP_Server::OnBFCPDisconnected(BFCP_SOCKET socket) {
                 /* Reset the sock fd associated with this user */
                 bfcp_set_user_sockfd(m_struct_server, m_confID, UserID,
                                      BFCP_INVALID_SOCKET, BFCP_OVER_TCP);
+                /* Only the session of this user ends, the application is not
+                   notified: the server socket is still connected */
+                bfcp_set_user_session_server(m_struct_server, m_confID, UserID,
+                                             BFCP_ACT_INITIALIZED);
             }
         }
     }
@@ -1844,26 +1881,26 @@ int BFCP_Server::bfcp_initialize_conference_server(
         /* A conference with this conferenceID already exists */
         Log(ERR,
             "Could not create conference: conference ID %u is aready used.");
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
     /* Create a list for Pending request */
     conference_server->list_conferences[i].pending = bfcp_create_list();
     if (!conference_server->list_conferences[i].pending) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
     /* Create a list for Accepted request */
     conference_server->list_conferences[i].accepted = bfcp_create_list();
     if (!conference_server->list_conferences[i].accepted) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
     /* Create a list for Granted request */
     conference_server->list_conferences[i].granted = bfcp_create_list();
     if (!conference_server->list_conferences[i].granted) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -1873,7 +1910,7 @@ int BFCP_Server::bfcp_initialize_conference_server(
     conference_server->list_conferences[i].user =
         bfcp_create_user_list(Max_Number_Floor_Request, Max_Num_floors);
     if (!conference_server->list_conferences[i].user) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -1881,7 +1918,7 @@ int BFCP_Server::bfcp_initialize_conference_server(
     conference_server->list_conferences[i].floor =
         bfcp_create_floor_list(Max_Num_floors);
     if (!conference_server->list_conferences[i].floor) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -1905,7 +1942,7 @@ int BFCP_Server::bfcp_initialize_conference_server(
 
     conference_server->Actual_number_conference = ++i;
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -1926,7 +1963,7 @@ int BFCP_Server::bfcp_destroy_conference_server(
                                BFCP_INVALID_SOCKET);
     if (i < 0) {
         /* A conference with this conferenceID does NOT exist */
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -1937,40 +1974,40 @@ int BFCP_Server::bfcp_destroy_conference_server(
     /* We free the list of Pending requests */
     error = bfcp_clean_request_list(remove_conference->pending);
     if (error == 0) {
-        free(remove_conference->pending);
+        BFCP_FREE(BFCP_ALLOC_QUEUE, remove_conference->pending);
         remove_conference->pending = NULL;
     } else {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
     /* We free the list of Accepted requests */
     error = bfcp_clean_request_list(remove_conference->accepted);
     if (error == 0) {
-        free(remove_conference->accepted);
+        BFCP_FREE(BFCP_ALLOC_QUEUE, remove_conference->accepted);
         remove_conference->accepted = NULL;
     } else {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
     /* We free the list of Granted requests */
     error = bfcp_clean_request_list(remove_conference->granted);
     if (error == 0) {
-        free(remove_conference->granted);
+        BFCP_FREE(BFCP_ALLOC_QUEUE, remove_conference->granted);
         remove_conference->granted = NULL;
     } else {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
     /* We free the list of floors */
     error = bfcp_remove_floor_list(&(remove_conference->floor));
     if (error == 0) {
-        free(remove_conference->floor);
+        BFCP_FREE(BFCP_ALLOC_FLOOR, remove_conference->floor);
         remove_conference->floor = NULL;
     }
     /* We free the list of users */
     error = bfcp_remove_user_list(&(remove_conference->user));
     if (error == 0) {
-        free(remove_conference->user);
+        BFCP_FREE(BFCP_ALLOC_USER, remove_conference->user);
         remove_conference->user = NULL;
     }
 
@@ -2005,7 +2042,7 @@ int BFCP_Server::bfcp_destroy_conference_server(
 
     conference_server->Actual_number_conference = actual_conference;
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -2055,12 +2092,12 @@ int BFCP_Server::bfcp_change_number_granted_floor_server(
         value = bfcp_change_number_granted_floor(
             server->list_conferences[i].floor, floorID, limit_granted_floor);
         if (value == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -2079,12 +2116,12 @@ int BFCP_Server::bfcp_change_user_req_floors_server(
         value = bfcp_change_user_req_floors(server->list_conferences[i].user,
                                             Max_Number_Floor_Request);
         if (value == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -2113,11 +2150,11 @@ int BFCP_Server::bfcp_change_chair_policy(st_bfcp_server *conference_server,
             automatic_accepted_deny_policy;
     } else {
         /* A conference with this conferenceID does NOT exist */
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -2143,7 +2180,7 @@ int BFCP_Server::bfcp_add_floor_server(st_bfcp_server *server,
             if (error == -1) {
                 Log(ERR, "bfcp_add_floor_server: could not insert floor ID %d",
                     floorID);
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
             error = bfcp_change_number_granted_floor(
@@ -2153,7 +2190,7 @@ int BFCP_Server::bfcp_add_floor_server(st_bfcp_server *server,
                 Log(ERR,
                     "bfcp_add_floor_server: could not set floor limit to %d",
                     limit_granted_floor);
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -2;
             }
         } else {
@@ -2167,11 +2204,11 @@ int BFCP_Server::bfcp_add_floor_server(st_bfcp_server *server,
         Log(ERR,
             "bfcp_add_floor_server: conference ID %u does not exist. ret=%d",
             conferenceID, i);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -2193,7 +2230,7 @@ int BFCP_Server::bfcp_delete_floor_server(st_bfcp_server *server,
         error = bfcp_delete_a_floor_from_user_list(
             server->list_conferences[i].user, value);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -2204,7 +2241,7 @@ int BFCP_Server::bfcp_delete_floor_server(st_bfcp_server *server,
             server->list_conferences[i].pending, floorID,
             server->list_conferences[i].floor, 1);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
         /* Remove the floor from the Accepted list */
@@ -2214,7 +2251,7 @@ int BFCP_Server::bfcp_delete_floor_server(st_bfcp_server *server,
             server->list_conferences[i].accepted, floorID,
             server->list_conferences[i].floor, 0);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
         /* Remove the floor from the Granted list */
@@ -2224,7 +2261,7 @@ int BFCP_Server::bfcp_delete_floor_server(st_bfcp_server *server,
             server->list_conferences[i].granted, floorID,
             server->list_conferences[i].floor, 0);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -2234,23 +2271,23 @@ int BFCP_Server::bfcp_delete_floor_server(st_bfcp_server *server,
         if (give_free_floors_to_the_accepted_nodes(
                 server->list_conferences + i, laccepted,
                 server->list_conferences[i].floor, NULL) == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
         /* Remove the floor from the floor list */
         error = bfcp_delete_floor(server->list_conferences[i].floor, floorID);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     } else {
         /* A conference with this conferenceID does NOT exist */
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -2299,7 +2336,7 @@ int BFCP_Server::bfcp_add_chair_server(st_bfcp_server *server,
         }
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
     return error;
 }
 
@@ -2350,7 +2387,7 @@ int BFCP_Server::bfcp_delete_chair_server(st_bfcp_server *server,
                                         traverse, BFCP_CANCELLED,
                                         newrequest->fd, newrequest->transport);
                                     if (error == -1) {
-                                        bfcp_mutex_unlock(count_mutex);
+                                        UnlockServer();
                                         return -1;
                                     }
                                     newrequest = newrequest->next;
@@ -2368,7 +2405,7 @@ int BFCP_Server::bfcp_delete_chair_server(st_bfcp_server *server,
                     server->list_conferences[i].pending, floorID,
                     server->list_conferences[i].floor, 0);
                 if (error == -1) {
-                    bfcp_mutex_unlock(count_mutex);
+                    UnlockServer();
                     return -1;
                 }
             }
@@ -2380,7 +2417,7 @@ int BFCP_Server::bfcp_delete_chair_server(st_bfcp_server *server,
                     server->list_conferences[i].pending, floorID,
                     server->list_conferences[i].floor, 0);
                 if (error == -1) {
-                    bfcp_mutex_unlock(count_mutex);
+                    UnlockServer();
                     return -1;
                 }
 
@@ -2402,7 +2439,7 @@ int BFCP_Server::bfcp_delete_chair_server(st_bfcp_server *server,
                                         traverse, BFCP_ACCEPTED, newrequest->fd,
                                         newrequest->transport);
                                     if (error == -1) {
-                                        bfcp_mutex_unlock(count_mutex);
+                                        UnlockServer();
                                         return -1;
                                     }
                                     newrequest = newrequest->next;
@@ -2418,7 +2455,7 @@ int BFCP_Server::bfcp_delete_chair_server(st_bfcp_server *server,
                         server->list_conferences + i,
                         server->list_conferences[i].accepted,
                         server->list_conferences[i].floor, NULL) == -1) {
-                    bfcp_mutex_unlock(count_mutex);
+                    UnlockServer();
                     return -1;
                 } else {
                     /*send floor information after accepted all the floors*/
@@ -2442,7 +2479,7 @@ int BFCP_Server::bfcp_delete_chair_server(st_bfcp_server *server,
                                                 BFCP_GRANTED, newrequest->fd,
                                                 newrequest->transport);
                                         if (error == -1) {
-                                            bfcp_mutex_unlock(count_mutex);
+                                            UnlockServer();
                                             return -1;
                                         }
                                         newrequest = newrequest->next;
@@ -2459,12 +2496,12 @@ int BFCP_Server::bfcp_delete_chair_server(st_bfcp_server *server,
             error = bfcp_change_chair(server->list_conferences[i].floor,
                                       floorID, 0);
             if (error == -1) {
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
         }
     }
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
     return 0;
 }
 
@@ -2481,7 +2518,7 @@ int BFCP_Server::bfcp_add_user_server(st_bfcp_server *server,
         error = bfcp_add_user(server->list_conferences[i].user, userID,
                               user_URI, user_display_name);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
 #if HSU
         } else if (error == 0) {
@@ -2493,11 +2530,11 @@ int BFCP_Server::bfcp_add_user_server(st_bfcp_server *server,
         }
     } else {
         /* A conference with this conferenceID does NOT exist */
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -2523,7 +2560,7 @@ int BFCP_Server::bfcp_set_user_sockfd(st_bfcp_server *server,
                 "confD[%d] User[%d] failed",
                 server->list_conferences[i].user, p_sockfd, conferenceID,
                 userID);
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
 #if HSU
         } else {
@@ -2540,11 +2577,11 @@ int BFCP_Server::bfcp_set_user_sockfd(st_bfcp_server *server,
             "bfcp_set_user_sockfd A conference with this conferenceID [%d] "
             "does NOT exist",
             conferenceID);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
     return 0;
 }
 
@@ -2561,10 +2598,37 @@ BFCP_SOCKET BFCP_Server::bfcp_get_user_sockfd(st_bfcp_server *server,
         sockfd = bfcp_get_user_socket(server->list_conferences[i].user, userID,
                                       p_transport);
     }
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
     return sockfd;
 }
 
+int BFCP_Server::bfcp_set_user_session_server(st_bfcp_server *server,
+                                              UINT32 conferenceID,
+                                              UINT16 userID,
+                                              e_BFCP_ACT p_state) {
+    int i, error = -1;
+
+    bfcp_mutex_lock(count_mutex);
+    i = CheckConferenceAndUser(server, conferenceID, 0, BFCP_INVALID_SOCKET);
+    if (i >= 0)
+        error = bfcp_set_user_session(server->list_conferences[i].user, userID,
+                                      (UINT8)p_state);
+    UnlockServer();
+    return error;
+}
+
+BFCP_fsm::e_BFCP_ACT BFCP_Server::bfcp_get_user_session_server(
+    st_bfcp_server *server, UINT32 conferenceID, UINT16 userID) {
+    int i, state = -1;
+
+    bfcp_mutex_lock(count_mutex);
+    i = CheckConferenceAndUser(server, conferenceID, 0, BFCP_INVALID_SOCKET);
+    if (i >= 0)
+        state = bfcp_get_user_session(server->list_conferences[i].user, userID);
+    UnlockServer();
+    return state < 0 ? BFCP_ACT_UNDEFINED : (e_BFCP_ACT)state;
+}
+
 /* Remove a participant from the list of users of a BFCP Conference */
 int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
                                          UINT32 conferenceID, UINT16 userID) {
@@ -2584,14 +2648,14 @@ int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
         error = bfcp_remove_floorrequest_from_all_nodes(
             server->list_conferences + i, userID);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
         /* Remove the user from the FloorQuery list */
         error = bfcp_remove_floorquery_from_all_nodes(
             server->list_conferences[i].floor, userID);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
         /* Checks if the user is chair of any floors */
@@ -2604,7 +2668,7 @@ int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
                     error = bfcp_delete_chair_server(
                         server, conferenceID, lfloors->floors[y].floorID);
                     if (error == -1) {
-                        bfcp_mutex_unlock(count_mutex);
+                        UnlockServer();
                         return -1;
                     }
                 }
@@ -2622,7 +2686,7 @@ int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
                         server->list_conferences + i, 0, 0, traverse,
                         BFCP_CANCELLED);
                     if (error == -1) {
-                        bfcp_mutex_unlock(count_mutex);
+                        UnlockServer();
                         return -1;
                     }
                 }
@@ -2642,7 +2706,7 @@ int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
                         server->list_conferences + i, 0, 0, traverse,
                         BFCP_CANCELLED);
                     if (error == -1) {
-                        bfcp_mutex_unlock(count_mutex);
+                        UnlockServer();
                         return -1;
                     }
                 }
@@ -2661,7 +2725,7 @@ int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
                         server->list_conferences + i, 0, 0, traverse,
                         BFCP_CANCELLED);
                     if (error == -1) {
-                        bfcp_mutex_unlock(count_mutex);
+                        UnlockServer();
                         return -1;
                     }
                 }
@@ -2674,7 +2738,7 @@ int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
             server->list_conferences[i].pending, userID,
             server->list_conferences[i].floor);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -2683,7 +2747,7 @@ int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
             server->list_conferences[i].accepted, userID,
             server->list_conferences[i].floor);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -2692,14 +2756,14 @@ int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
             server->list_conferences[i].granted, userID,
             server->list_conferences[i].floor);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
         /* Finally remove the user from the conference */
         error = bfcp_delete_user(server->list_conferences[i].user, userID);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -2709,127 +2773,73 @@ int BFCP_Server::bfcp_delete_user_server(st_bfcp_server *server,
         if (give_free_floors_to_the_accepted_nodes(
                 server->list_conferences + i, laccepted,
                 server->list_conferences[i].floor, NULL) == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     } else {
         /* A conference with this conferenceID does NOT exist */
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         Log(ERR,
             "bfcp_delete_user_server: no such user %u or conference %u. err=%d",
             userID, conferenceID, i);
         return -1;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
 
-/* Create a new 'bfcp_floor_request_information' (bfcp_messages.h) out of a
- * 'pnode' */
-bfcp_floor_request_information *BFCP_Server::create_floor_request_userID(
-    pnode traverse, lusers users, UINT16 userID, UINT16 request_status, int i) {
-    if (traverse == NULL) return NULL;
-    if (users == NULL) return NULL;
-
-    bfcp_user_information *user_info;
-    bfcp_user_information *beneficiary_info;
-    bfcp_floor *node;
-    bfcp_floor_request_information *frqInfo = NULL;
-    bfcp_overall_request_status *oRS = NULL;
-    bfcp_floor_request_status *fRS_temp = NULL, *fRS = NULL;
-
-    /* If there's a beneficiary, add its information */
-    if (traverse->beneficiaryID != 0) {
-        beneficiary_info =
-            bfcp_show_user_information(users, traverse->beneficiaryID);
-        if (beneficiary_info == NULL) {
-            bfcp_free_user_information(beneficiary_info);
-            return NULL;
-        }
-    } else
-        beneficiary_info = NULL;
-    /* If there's user information, add it */
-    if (traverse->userID != 0) {
-        user_info = bfcp_show_user_information(users, traverse->userID);
-        if (user_info == NULL) {
-            bfcp_free_user_information(user_info);
-            return NULL;
-        }
-    } else
-        user_info = NULL;
-
-    node = traverse->floor;
-    if (node != NULL) {
-        fRS = bfcp_new_floor_request_status(node->floorID, request_status, i,
-                                            node->chair_info);
-        if (fRS == NULL) return NULL;
-        node = node->next;
-        while (node != NULL) {
-            fRS_temp = bfcp_new_floor_request_status(
-                node->floorID, request_status, i, node->chair_info);
-            if (fRS_temp != NULL)
-                bfcp_list_floor_request_status(fRS, fRS_temp, NULL);
-            node = node->next;
-        }
-    } else
-        return NULL;
-
-    oRS = bfcp_new_overall_request_status(
-        traverse->floorRequestID, request_status, i, traverse->chair_info);
+/* Add the FLOOR-REQUEST-INFORMATION of a request: its overall status, the
+ * status of 'floorID' (of each of its floors, with their chair text, if
+ * 'floorID' is 0), its users, priority and participant text. Nothing is added
+ * if the request has no floor to report */
+bool BFCP_Server::encode_floor_request_information(
+    BFCP_ServerEncoder &encoder, pnode node, lusers users, UINT16 floorID,
+    UINT16 status, int queue_position, int floor_queue_position,
+    e_bfcp_priority priority) {
+    if (node == NULL) return false;
+    if (floorID == 0 && node->floor == NULL) return false;
 
-    frqInfo = bfcp_new_floor_request_information(
-        traverse->floorRequestID, oRS, fRS, beneficiary_info, user_info,
-        traverse->priority, traverse->participant_info);
+    pfloor floor;
 
-    return frqInfo;
+    encoder.group(FLOOR_REQUEST_INFORMATION, node->floorRequestID)
+        .group(OVERALL_REQUEST_STATUS, node->floorRequestID)
+        .requestStatus((e_bfcp_status)status, (UINT8)queue_position)
+        .text(STATUS_INFO, node->chair_info)
+        .end();
+    if (floorID != 0) {
+        encoder.group(FLOOR_REQUEST_STATUS, floorID)
+            .requestStatus((e_bfcp_status)status, (UINT8)floor_queue_position)
+            .end();
+    } else {
+        for (floor = node->floor; floor != NULL; floor = floor->next)
+            encoder.group(FLOOR_REQUEST_STATUS, floor->floorID)
+                .requestStatus((e_bfcp_status)status,
+                               (UINT8)floor_queue_position)
+                .text(STATUS_INFO, floor->chair_info)
+                .end();
+    }
+    encode_user_information(encoder, BENEFICIARY_INFORMATION, users,
+                            node->beneficiaryID);
+    encode_user_information(encoder, REQUESTED_BY_INFORMATION, users,
+                            node->userID);
+    /* The priority is optional: out of range means none */
+    if (priority <= BFCP_HIGHEST_PRIORITY) encoder.priority(priority);
+    encoder.text(PARTICIPANT_PROVIDED_INFO, node->participant_info).end();
+    return true;
 }
 
-/* Create a new 'bfcp_floor_request_information' (bfcp_messages.h) out of a
- * floor */
-bfcp_floor_request_information *BFCP_Server::create_floor_message(
-    UINT16 floorID, pnode traverse, lusers users, UINT16 request_status,
-    int i) {
-    if (traverse == NULL) return NULL;
-    if (users == NULL) return NULL;
-
-    bfcp_user_information *user_info;
-    bfcp_user_information *beneficiary_info;
-    bfcp_floor_request_information *frqInfo = NULL;
-    bfcp_floor_request_status *fRS = NULL;
-    bfcp_overall_request_status *oRS = NULL;
-
-    /* If there's a beneficiary, add its information */
-    if (traverse->beneficiaryID != 0) {
-        beneficiary_info =
-            bfcp_show_user_information(users, traverse->beneficiaryID);
-        if (beneficiary_info == NULL) {
-            bfcp_free_user_information(beneficiary_info);
-            return NULL;
-        }
-    } else
-        beneficiary_info = NULL;
-
-    /* If there's user information, add its information */
-    if (traverse->userID != 0) {
-        user_info = bfcp_show_user_information(users, traverse->userID);
-        if (user_info == NULL) {
-            bfcp_free_user_information(user_info);
-            return NULL;
-        }
-    } else
-        user_info = NULL;
-
-    /* Setup the Floor Request Information by preparing its sub-attributes */
-    fRS = bfcp_new_floor_request_status(floorID, request_status, i, NULL);
-    oRS = bfcp_new_overall_request_status(
-        traverse->floorRequestID, request_status, i, traverse->chair_info);
-    frqInfo = bfcp_new_floor_request_information(
-        traverse->floorRequestID, oRS, fRS, beneficiary_info, user_info,
-        traverse->priority, traverse->participant_info);
-
-    return frqInfo;
+/* Add the BENEFICIARY-INFORMATION or REQUESTED-BY-INFORMATION of a user, if
+ * there is one */
+void BFCP_Server::encode_user_information(BFCP_ServerEncoder &encoder,
+                                          e_bfcp_attibutes type, lusers users,
+                                          UINT16 userID) {
+    if (userID == 0) return;
+    encoder.group(type, userID)
+        .text(USER_DISPLAY_NAME, bfcp_obtain_user_display_name(users, userID))
+        .text(USER_URI, bfcp_obtain_userURI(users, userID))
+        .end();
 }
 
 /* Setup and send a floorstatus BFCP message */
@@ -2841,13 +2851,8 @@ int BFCP_Server::bfcp_show_floor_information(UINT32 conferenceID,
                                              pnode newnode, UINT16 status) {
     if (conference == NULL) return 0;
 
-    int error, i, transport;
-    pnode traverse;
-    pfloor floor;
+    int transport;
     bfcp_message *message = NULL;
-    bfcp_arguments *arguments = NULL;
-    bfcp_floor_request_information *frqInfo = NULL, *list_frqInfo = NULL;
-    bfcp_floor_id_list *fID;
     BFCP_SOCKET sockfd;
 
     sockfd = bfcp_get_user_socket(conference->user, userID, &transport);
@@ -2857,26 +2862,90 @@ int BFCP_Server::bfcp_show_floor_information(UINT32 conferenceID,
         TransactionID = ++m_trIdGenerator;
     }
 
-    arguments = bfcp_new_arguments();
-    if (!arguments) return -1;
+    BFCP_ServerEncoder encoder(e_primitive_FloorStatus, conferenceID,
+                               TransactionID, userID);
+    message = bfcp_encode_floor_information(encoder, conferenceID,
+                                            TransactionID, userID, conference,
+                                            floorID, newnode, status, NULL);
+    if (!message) return -1;
 
-    arguments->entity = bfcp_new_entity(conferenceID, TransactionID, userID);
-    arguments->primitive = e_primitive_FloorStatus;
-    if (floorID != 0)
-        fID = bfcp_new_floor_id_list(floorID, 0);
-    else
-        fID = NULL;
+    return sendBFCPmessage(sockfd, message);
+}
 
-    arguments->fID = fID;
+/* Encode a floorstatus BFCP message once and send it to every user of
+ * 'userIDs': only the TransactionID and UserID of the common header are
+ * rewritten for each recipient */
+int BFCP_Server::bfcp_broadcast_floor_information(
+    UINT32 conferenceID, UINT16 TransactionID, const std::vector<UINT16> &userIDs,
+    st_bfcp_conference *conference, UINT16 floorID, pnode newnode,
+    UINT16 status) {
+    if (conference == NULL) return 0;
+
+    int error = 0, transport;
+    bool per_user = false;
+    UINT16 trID;
+    bfcp_message *message = NULL;
+    BFCP_SOCKET sockfd;
+    std::vector<UINT16>::const_iterator it;
+    BFCP_ServerEncoder encoder(e_primitive_FloorStatus, conferenceID,
+                               TransactionID, 0);
+
+    for (it = userIDs.begin(); it != userIDs.end(); ++it) {
+        sockfd = bfcp_get_user_socket(conference->user, *it, &transport);
+        if (sockfd == BFCP_INVALID_SOCKET) {
+            Log(ERR, "FloorStatus not sent: no socket for user %u", *it);
+            error = -1;
+            continue;
+        }
+
+        trID = TransactionID;
+        if (trID == 0 && transport == BFCP_OVER_UDP) trID = ++m_trIdGenerator;
+
+        if (message == NULL || per_user) {
+            /* An empty floor is reported with the recipient's own user
+             * information: such a payload has to be built for each user */
+            message = bfcp_encode_floor_information(
+                encoder, conferenceID, trID, *it, conference, floorID, newnode,
+                status, &per_user);
+            if (!message) return -1;
+        } else {
+            bfcp_stamp_commonheader(message, trID, *it);
+        }
+
+        if (sendBFCPmessage(sockfd, message) < 0) {
+            Log(ERR, "FloorStatus not sent to user %u on sockfd %d", *it,
+                sockfd);
+            error = -1;
+        }
+    }
+
+    return error;
+}
+
+/* Encode a floorstatus BFCP message. When no request involves the floor, the
+ * message describes the recipient itself and *per_user is set */
+bfcp_message *BFCP_Server::bfcp_encode_floor_information(
+    BFCP_ServerEncoder &encoder, UINT32 conferenceID, UINT16 TransactionID,
+    UINT16 userID, st_bfcp_conference *conference, UINT16 floorID,
+    pnode newnode, UINT16 status, bool *per_user) {
+    if (conference == NULL) return NULL;
+
+    int i;
+    bool empty = true;
+    pnode traverse;
+    pfloor floor;
+
+    if (per_user) *per_user = false;
+
+    encoder.reset(e_primitive_FloorStatus, conferenceID, TransactionID,
+                  userID);
+    if (floorID != 0) encoder.u16(FLOOR_ID, floorID);
 
     if ((status > BFCP_GRANTED) && (newnode != NULL)) {
-        frqInfo =
-            create_floor_message(floorID, newnode, conference->user, status, 0);
-        if ((frqInfo != NULL) && (list_frqInfo != NULL))
-            bfcp_add_floor_request_information_list(list_frqInfo, frqInfo,
-                                                    NULL);
-        else if (list_frqInfo == NULL)
-            list_frqInfo = frqInfo;
+        if (encode_floor_request_information(encoder, newnode,
+                                             conference->user, floorID, status,
+                                             0, 0, newnode->priority))
+            empty = false;
     }
 
     if (conference->granted != NULL) {
@@ -2884,20 +2953,13 @@ int BFCP_Server::bfcp_show_floor_information(UINT32 conferenceID,
         traverse = conference->granted->tail;
         while (traverse) {
             if ((newnode == NULL) || (status <= BFCP_GRANTED) ||
-                ((newnode != NULL) &&
-                 (newnode->floorRequestID != traverse->floorRequestID))) {
-                floor = traverse->floor;
-                while (floor) {
-                    if (floor->floorID == floorID) {
-                        frqInfo = create_floor_message(floorID, traverse,
-                                                       conference->user, 3, 0);
-                        if ((frqInfo != NULL) && (list_frqInfo != NULL))
-                            bfcp_add_floor_request_information_list(
-                                list_frqInfo, frqInfo, NULL);
-                        else if (list_frqInfo == NULL)
-                            list_frqInfo = frqInfo;
-                    }
-                    floor = floor->next;
+                (newnode->floorRequestID != traverse->floorRequestID)) {
+                for (floor = traverse->floor; floor; floor = floor->next) {
+                    if (floor->floorID == floorID &&
+                        encode_floor_request_information(
+                            encoder, traverse, conference->user, floorID,
+                            BFCP_GRANTED, 0, 0, traverse->priority))
+                        empty = false;
                 }
             }
             traverse = traverse->prev;
@@ -2910,20 +2972,13 @@ int BFCP_Server::bfcp_show_floor_information(UINT32 conferenceID,
         i = 1;
         while (traverse) {
             if ((newnode == NULL) || (status <= BFCP_GRANTED) ||
-                ((newnode != NULL) &&
-                 (newnode->floorRequestID != traverse->floorRequestID))) {
-                floor = traverse->floor;
-                while (floor) {
-                    if (floor->floorID == floorID) {
-                        frqInfo = create_floor_message(floorID, traverse,
-                                                       conference->user, 2, i);
-                        if ((frqInfo != NULL) && (list_frqInfo != NULL))
-                            bfcp_add_floor_request_information_list(
-                                list_frqInfo, frqInfo, NULL);
-                        else if (list_frqInfo == NULL)
-                            list_frqInfo = frqInfo;
-                    }
-                    floor = floor->next;
+                (newnode->floorRequestID != traverse->floorRequestID)) {
+                for (floor = traverse->floor; floor; floor = floor->next) {
+                    if (floor->floorID == floorID &&
+                        encode_floor_request_information(
+                            encoder, traverse, conference->user, floorID,
+                            BFCP_ACCEPTED, i, i, traverse->priority))
+                        empty = false;
                 }
             }
             i = i + 1;
@@ -2932,64 +2987,40 @@ int BFCP_Server::bfcp_show_floor_information(UINT32 conferenceID,
     }
 
     if (conference->pending != NULL) {
-        /* This is the Accepted queue */
+        /* This is the Pending queue */
         traverse = conference->pending->tail;
         while (traverse) {
             if ((newnode == NULL) || (status <= BFCP_GRANTED) ||
-                ((newnode != NULL) &&
-                 (newnode->floorRequestID != traverse->floorRequestID))) {
-                floor = traverse->floor;
-                while (floor) {
-                    if (floor->floorID == floorID) {
-                        frqInfo = create_floor_message(floorID, traverse,
-                                                       conference->user, 1, 0);
-                        if ((frqInfo != NULL) && (list_frqInfo != NULL))
-                            bfcp_add_floor_request_information_list(
-                                list_frqInfo, frqInfo, NULL);
-                        else if (list_frqInfo == NULL)
-                            list_frqInfo = frqInfo;
-                    }
-                    floor = floor->next;
+                (newnode->floorRequestID != traverse->floorRequestID)) {
+                for (floor = traverse->floor; floor; floor = floor->next) {
+                    if (floor->floorID == floorID &&
+                        encode_floor_request_information(
+                            encoder, traverse, conference->user, floorID,
+                            BFCP_PENDING, 0, 0, traverse->priority))
+                        empty = false;
                 }
             }
             traverse = traverse->prev;
         }
     }
-    bool freeNode = false;
-    pnode tmpnode = NULL;
-    if (!list_frqInfo) {
-        tmpnode =
-            bfcp_init_request(userID, 0, BFCP_NORMAL_PRIORITY, NULL, floorID);
-        frqInfo = create_floor_message(floorID, tmpnode, conference->user,
-                                       BFCP_RELEASED, 0);
-        if ((frqInfo != NULL) && (list_frqInfo != NULL))
-            bfcp_add_floor_request_information_list(list_frqInfo, frqInfo,
-                                                    NULL);
-        else if (list_frqInfo == NULL)
-            list_frqInfo = frqInfo;
-    }
-
-    arguments->frqInfo = list_frqInfo;
 
-    message = bfcp_build_message(arguments);
-    if (!message) {
-        return -1;
-    }
-    error = sendBFCPmessage(sockfd, message);
-    BFCP_SEND_CHECK_ERRORS();
-    if (freeNode) {
+    if (empty) {
+        /* Report the floor as released by the recipient itself */
+        pnode tmpnode =
+            bfcp_init_request(userID, 0, BFCP_NORMAL_PRIORITY, NULL, floorID);
         if (tmpnode) {
+            encode_floor_request_information(encoder, tmpnode,
+                                             conference->user, floorID,
+                                             BFCP_RELEASED, 0, 0,
+                                             tmpnode->priority);
+            remove_floor_list(tmpnode->floor);
             remove_request_list_of_node(tmpnode->floorrequest);
-            free(tmpnode->participant_info);
-            tmpnode->participant_info = NULL;
-            free(tmpnode->chair_info);
-            tmpnode->chair_info = NULL;
-            free(tmpnode);
-            tmpnode = NULL;
+            bfcp_free_node(tmpnode);
         }
-        freeNode = false;
+        if (per_user) *per_user = true;
     }
-    return error;
+
+    return encoder.message();
 }
 
 /* Prepare the needed arguments for a FloorRequestStatus BFCP message */
@@ -3014,17 +3045,16 @@ int BFCP_Server::bfcp_print_information_floor(st_bfcp_conference *conference,
             bfcp_return_position_floor(conference->floor, floor->floorID);
         if (position >= 0) {
             if (conference->floor->floors != NULL) {
-                query = conference->floor->floors[position].floorquery;
-                int cl;
-                while (query != NULL) {
-                    error = bfcp_show_floor_information(
-                        conference->conferenceID, TransactionID, query->userID,
-                        conference, floor->floorID, &cl, newnode, status);
-
-                    if (error == -1) {
-                        return -1;
-                    }
-                    query = query->next;
+                std::vector<UINT16> users;
+                for (query = conference->floor->floors[position].floorquery;
+                     query != NULL; query = query->next)
+                    users.push_back(query->userID);
+
+                error = bfcp_broadcast_floor_information(
+                    conference->conferenceID, TransactionID, users, conference,
+                    floor->floorID, newnode, status);
+                if (error == -1) {
+                    return -1;
                 }
             }
         }
@@ -3032,16 +3062,30 @@ int BFCP_Server::bfcp_print_information_floor(st_bfcp_conference *conference,
     }
 
     newrequest = newnode->floorrequest;
-
-    while (newrequest != NULL) {
-        error = bfcp_show_requestfloor_information(
-            conference->user, conference->accepted, conference->conferenceID,
-            newrequest->userID, 0, newnode, status, newrequest->fd,
-            newrequest->transport);
+    if (newrequest != NULL) {
+        /* The FloorRequestStatus payload is the same for every subscriber */
+        bfcp_message *message;
+        bool donotresend = false;
+        BFCP_ServerEncoder encoder(e_primitive_FloorRequestStatus,
+                                   conference->conferenceID, 0,
+                                   newrequest->userID);
+
+        message = bfcp_encode_requestfloor_information(
+            encoder, conference->user, conference->accepted,
+            conference->conferenceID, newrequest->userID, 0, newnode, status,
+            &donotresend);
+        if (!message) return -1;
+
+        for (error = 0; newrequest != NULL; newrequest = newrequest->next) {
+            bfcp_stamp_commonheader(message, 0, newrequest->userID);
+            if (sendBFCPmessage(newrequest->fd, message, donotresend) == -1) {
+                error = -1;
+                break;
+            }
+        }
         if (error == -1) {
             return -1;
         }
-        newrequest = newrequest->next;
     }
     return 0;
 }
@@ -3050,90 +3094,63 @@ int BFCP_Server::bfcp_print_information_floor(st_bfcp_conference *conference,
 int BFCP_Server::bfcp_show_requestfloor_information(
     bfcp_list_users *list_users, bfcp_queue *accepted_queue,
     UINT32 conferenceID, UINT16 userID, UINT16 TransactionID, pnode newnode,
-    UINT16 status, BFCP_SOCKET sockfd, int transport) {
+    UINT16 status, BFCP_SOCKET sockfd, int /*transport*/) {
     if (newnode == NULL) return 0;
     if (status <= 0) return 0;
     if (list_users == NULL) return 0;
 
-    bfcp_arguments *arguments = NULL;
     bfcp_message *message = NULL;
-    bfcp_floor *floorID;
-    bfcp_user_information *beneficiary_info, *user_info;
-    pnode traverse = NULL;
-    bfcp_overall_request_status *oRS = NULL;
-    bfcp_floor_request_status *fRS_temp = NULL, *fRS = NULL;
-    int i = 0, error = 0;
+    int error = 0;
 
     /* Intermediate BFCP_PENDING and BFCP_GRANTED floor status should NOT be
      * resent */
     bool donotresend = false;
+    BFCP_ServerEncoder encoder(e_primitive_FloorRequestStatus, conferenceID,
+                               TransactionID, userID);
 
-    arguments = bfcp_new_arguments();
-    if (!arguments) return -1;
+    message = bfcp_encode_requestfloor_information(
+        encoder, list_users, accepted_queue, conferenceID, userID,
+        TransactionID, newnode, status, &donotresend);
+    if (!message) {
+        return -1;
+    }
+    error = sendBFCPmessage(sockfd, message, donotresend);
+    if (error == 0) TraceRequest(newnode, BFCP_TRACE_STATUS, status);
 
-    arguments->entity = bfcp_new_entity(conferenceID, TransactionID, userID);
-    arguments->primitive = e_primitive_FloorRequestStatus;
+    return error;
+}
 
-    if (newnode->beneficiaryID != 0) {
-        beneficiary_info = bfcp_new_user_information(
-            newnode->beneficiaryID,
-            (char *)bfcp_obtain_user_display_name(list_users,
-                                                  newnode->beneficiaryID),
-            (char *)bfcp_obtain_userURI(list_users, newnode->beneficiaryID));
-        if (beneficiary_info == NULL) {
-            bfcp_free_user_information(beneficiary_info);
-            return -1;
-        }
-    } else
-        beneficiary_info = NULL;
-
-    if (newnode->userID != 0) {
-        user_info = bfcp_new_user_information(
-            newnode->userID,
-            (char *)bfcp_obtain_user_display_name(list_users, newnode->userID),
-            (char *)bfcp_obtain_userURI(list_users, newnode->userID));
-        if (user_info == NULL) {
-            bfcp_free_user_information(user_info);
-            return -1;
-        }
-    } else
-        user_info = NULL;
-
-    floorID = newnode->floor;
-    if (floorID != NULL)
-        fRS = bfcp_new_floor_request_status(floorID->floorID, status, 0,
-                                            floorID->chair_info);
-    if (fRS == NULL) return -1;
-    floorID = floorID->next;
-    while (floorID != NULL) {
-        fRS_temp = bfcp_new_floor_request_status(floorID->floorID, status, 0,
-                                                 floorID->chair_info);
-        if (fRS_temp != NULL)
-            bfcp_list_floor_request_status(fRS, fRS_temp, NULL);
-        floorID = floorID->next;
-    }
+/* Encode a FloorRequestStatus BFCP message */
+bfcp_message *BFCP_Server::bfcp_encode_requestfloor_information(
+    BFCP_ServerEncoder &encoder, bfcp_list_users *list_users,
+    bfcp_queue *accepted_queue, UINT32 conferenceID, UINT16 userID,
+    UINT16 TransactionID, pnode newnode, UINT16 status, bool *donotresend) {
+    if (newnode == NULL) return NULL;
+    if (status <= 0) return NULL;
+    if (list_users == NULL) return NULL;
+
+    pnode traverse = NULL;
+    int i = 0, queue_position = 0;
+
+    /* Intermediate BFCP_PENDING and BFCP_ACCEPTED floor status should NOT be
+     * resent */
+    *donotresend = false;
 
     switch (status) {
         case BFCP_PENDING:
             /* Pending request */
-            oRS = bfcp_new_overall_request_status(newnode->floorRequestID,
-                                                  status, newnode->priority,
-                                                  newnode->chair_info);
-            donotresend = true;
+            queue_position = newnode->priority;
+            *donotresend = true;
             break;
         case BFCP_ACCEPTED:
-            /* Accepted request */
-            oRS = bfcp_new_overall_request_status(
-                newnode->floorRequestID, status, 0, newnode->chair_info);
-            donotresend = true;
+            /* Accepted request: its position in the Accepted queue */
+            *donotresend = true;
             if (accepted_queue != NULL) {
                 traverse = accepted_queue->tail;
                 i = 1;
                 while (traverse != NULL) {
                     if (traverse->floorRequestID == newnode->floorRequestID) {
-                        oRS = bfcp_new_overall_request_status(
-                            traverse->floorRequestID, status, i,
-                            traverse->chair_info);
+                        queue_position = i;
                         break;
                     } else
                         i = i + 1;
@@ -3142,23 +3159,16 @@ int BFCP_Server::bfcp_show_requestfloor_information(
             }
             break;
         default:
-            oRS = bfcp_new_overall_request_status(
-                newnode->floorRequestID, status, 0, newnode->chair_info);
             break;
     }
 
-    arguments->frqInfo = bfcp_new_floor_request_information(
-        newnode->floorRequestID, oRS, fRS, beneficiary_info, user_info,
-        BFCP_NORMAL_PRIORITY, newnode->participant_info);
-
-    message = bfcp_build_message(arguments);
-    if (!message) {
-        return -1;
-    }
-    error = sendBFCPmessage(sockfd, message, donotresend);
-    BFCP_SEND_CHECK_ERRORS();
-
-    return error;
+    encoder.reset(e_primitive_FloorRequestStatus, conferenceID, TransactionID,
+                  userID);
+    if (!encode_floor_request_information(encoder, newnode, list_users, 0,
+                                          status, queue_position, 0,
+                                          BFCP_NORMAL_PRIORITY))
+        return NULL;
+    return encoder.message();
 }
 
 /* Handle a BFCP message a client sent to the FCS */
@@ -3173,6 +3183,65 @@ int BFCP_Server::ProcessBFCPmessage(bfcp_received_message *m, BFCP_SOCKET s) {
     }
 }
 
+bool BFCP_Server::ProcessLazyBFCPmessage(const bfcp_lazy_message *m,
+                                         BFCP_SOCKET s, int transport) {
+    s_bfcp_msg_event evt;
+    int i;
+
+    switch (m->header.primitive) {
+        case e_primitive_Hello:
+            /* A Hello has no attribute: leave any to the parser and the
+             * error answers of bfcp_received_msg */
+            if (m->count != 0) return false;
+            Log(INF, "On Socket {%d] Hello:", s);
+            Log(INF, "TransactionID: %d", m->header.transactionID);
+            Log(INF, "UserID         %d", m->header.userID);
+            Log(INF, "ConferenceID:  %d", m->header.conferenceID);
+            memset(&evt, 0, sizeof(s_bfcp_msg_event));
+            evt.transport = transport;
+            evt.Event = e_primitive_Hello;
+            evt.TransactionID = m->header.transactionID;
+            evt.userID = m->header.userID;
+            evt.conferenceID = m->header.conferenceID;
+            evt.sockfd = s;
+            BFCPFSM_FsmEvent(&evt);
+            return true;
+
+        case e_primitive_HelloAck:
+            /* Nothing to do with the lists supported by the participant */
+            for (i = 0; i < m->count; i++) {
+                if (m->attributes[i].type != SUPPORTED_PRIMITIVES &&
+                    m->attributes[i].type != SUPPORTED_ATTRIBUTES)
+                    return false;
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/* A request the chair ended (or the chair timeout cancelled) no longer counts
+ * among the ongoing requests of its user (its beneficiary, if any) */
+void BFCP_Server::bfcp_deleted_node_request(st_bfcp_conference *conference,
+                                            pnode node) {
+    if (conference == NULL) return;
+    if (node == NULL) return;
+
+    int position_floor;
+    pfloor floor;
+
+    for (floor = node->floor; floor != NULL; floor = floor->next) {
+        position_floor =
+            bfcp_return_position_floor(conference->floor, floor->floorID);
+        if (position_floor != -1)
+            bfcp_deleted_user_request(
+                conference->user,
+                node->beneficiaryID ? node->beneficiaryID : node->userID,
+                position_floor);
+    }
+}
+
 /* Remove all floor requests made by a user from all existing nodes */
 int BFCP_Server::bfcp_remove_floorrequest_from_all_nodes(
     st_bfcp_conference *server, UINT16 userID) {
@@ -3250,29 +3319,36 @@ void *BFCP_Server::WatchDog(void *st_thread)
     floorRequestID = thread->floorRequestID;
     chair_wait_request = thread->chair_wait_request;
 
-    bfcp_mutex_unlock(bfcpServer->count_mutex);
+    bfcpServer->UnlockServer();
     /* Free the thread */
     free(thread);
     thread = NULL;
 
     BFCP_SLEEP(chair_wait_request * 1000);
-    /*if the queue is a pending queue*/
+
+    bfcp_mutex_lock(bfcpServer->count_mutex);
+    /* The request expired only if the chair left it in the Pending queue */
+    traverse = NULL;
     if ((server != NULL) && (server->pending != NULL)) {
         traverse = server->pending->tail;
-        while (traverse) {
-            if ((traverse->floorRequestID) == floorRequestID)
-                bfcpServer->bfcp_print_information_floor(server, 0, 0, traverse,
-                                                         BFCP_CANCELLED);
+        while (traverse && (traverse->floorRequestID != floorRequestID))
             traverse = traverse->prev;
-        }
     }
+    if (traverse != NULL) {
+        BFCP_PROBE2(watchdog_expired, (int)server->conferenceID,
+                    (int)floorRequestID);
+        bfcpServer->bfcp_print_information_floor(server, 0, 0, traverse,
+                                                 BFCP_CANCELLED);
+        bfcpServer->bfcp_deleted_node_request(server, traverse);
 
-    /* If the request is from the Pending list, remove it */
-    list_floors =
-        bfcpServer->bfcp_delete_request(server->pending, floorRequestID, 0);
+        /* Remove the request from the Pending list */
+        list_floors =
+            bfcpServer->bfcp_delete_request(server->pending, floorRequestID, 0);
 
-    /* Free all the elements from the floors list */
-    bfcpServer->remove_floor_list(list_floors);
+        /* Free all the elements from the floors list */
+        bfcpServer->remove_floor_list(list_floors);
+    }
+    bfcpServer->UnlockServer();
     return NULL;
 }
 
@@ -3335,7 +3411,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
         bfcp_error_code(conferenceID, newnode->userID, TransactionID,
                         (e_bfcp_error_codes)error, errortext, NULL, sockfd, y,
                         transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -3395,20 +3471,16 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
                     server->list_conferences[i].conferenceID, newnode->userID,
                     TransactionID, newnode, BFCP_DENIED, sockfd, transport);
                 if (error == -1) {
-                    bfcp_mutex_unlock(count_mutex);
+                    UnlockServer();
                     return -1;
                 }
 
                 /* Remove the request node */
                 remove_floor_list(newnode->floor);
                 remove_request_list_of_node(newnode->floorrequest);
-                free(newnode->participant_info);
-                newnode->participant_info = NULL;
-                free(newnode->chair_info);
-                newnode->chair_info = NULL;
-                free(newnode);
+                bfcp_free_node(newnode);
                 newnode = NULL;
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return 0;
             }
 
@@ -3423,13 +3495,9 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
                 /* Remove the request node */
                 remove_floor_list(newnode->floor);
                 remove_request_list_of_node(newnode->floorrequest);
-                free(newnode->participant_info);
-                newnode->participant_info = NULL;
-                free(newnode->chair_info);
-                newnode->chair_info = NULL;
-                free(newnode);
+                bfcp_free_node(newnode);
                 newnode = NULL;
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return 0;
             }
         }
@@ -3439,7 +3507,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
         bfcp_error_code(conferenceID, newnode->userID, TransactionID,
                         BFCP_INVALID_FLOORID, errortext, NULL, sockfd, y,
                         transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -3466,17 +3534,13 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
                 /* Remove the node */
                 remove_floor_list(newnode->floor);
                 remove_request_list_of_node(newnode->floorrequest);
-                free(newnode->participant_info);
-                newnode->participant_info = NULL;
-                free(newnode->chair_info);
-                newnode->chair_info = NULL;
-                free(newnode);
+                bfcp_free_node(newnode);
                 newnode = NULL;
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return 0;
             }
         } else {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     }
@@ -3495,7 +3559,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
                 /* Allocate a new thread handler */
                 st_thread = (struct_thread)calloc(1, sizeof(bfcp_thread));
                 if (st_thread == NULL) {
-                    bfcp_mutex_unlock(count_mutex);
+                    UnlockServer();
                     return -1;
                 }
 
@@ -3547,7 +3611,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
         error = bfcp_insert_request(server->list_conferences[i].accepted,
                                     newnode, floorRequestID, NULL);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -3555,7 +3619,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
         error = bfcp_print_information_floor(server->list_conferences + i, 0, 0,
                                              newnode, BFCP_ACCEPTED);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -3567,7 +3631,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
             server->list_conferences[i].conferenceID, newnode->userID,
             TransactionID, newnode, BFCP_ACCEPTED, sockfd, transport);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -3603,7 +3667,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
                                 newnode->userID, TransactionID, newnode,
                                 BFCP_GRANTED, sockfd, transport);
                             if (error == -1) {
-                                bfcp_mutex_unlock(count_mutex);
+                                UnlockServer();
                                 return -1;
                             }
                         }
@@ -3616,7 +3680,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
         error = bfcp_insert_request(server->list_conferences[i].pending,
                                     newnode, floorRequestID, NULL);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -3624,7 +3688,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
         error = bfcp_print_information_floor(server->list_conferences + i, 0, 0,
                                              newnode, BFCP_PENDING);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -3636,7 +3700,7 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
             server->list_conferences[i].conferenceID, newnode->userID,
             TransactionID, newnode, BFCP_PENDING, sockfd, transport);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     }
@@ -3649,11 +3713,11 @@ int BFCP_Server::bfcp_FloorRequest_server(st_bfcp_server *server,
     error =
         add_request_to_the_node(newnode, newnode->userID, sockfd, transport);
     if (error == -1) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -3727,7 +3791,7 @@ int BFCP_Server::bfcp_FloorRelease_server(st_bfcp_server *server,
         bfcp_error_code(conferenceID, userID, TransactionID,
                         (e_bfcp_error_codes)error, errortext, NULL, sockfd, y,
                         transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
     /* Check if this request node is in the Accepted list */
@@ -3763,7 +3827,7 @@ int BFCP_Server::bfcp_FloorRelease_server(st_bfcp_server *server,
                 bfcp_error_code(conferenceID, userID, TransactionID,
                                 BFCP_FLOORREQUEST_DOES_NOT_EXIST, errortext,
                                 NULL, sockfd, y, transport);
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
         } else {
@@ -3794,13 +3858,13 @@ int BFCP_Server::bfcp_FloorRelease_server(st_bfcp_server *server,
             server->list_conferences[i].conferenceID, userID, TransactionID,
             newnode, BFCP_RELEASED, sockfd, transport);
     if (error == -1) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
     error = remove_request_from_the_node(newnode, userID);
     if (error == -1) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -3813,7 +3877,7 @@ int BFCP_Server::bfcp_FloorRelease_server(st_bfcp_server *server,
         error = bfcp_print_information_floor(server->list_conferences + i, 0, 0,
                                              newnode, BFCP_RELEASED);
     if (error == -1) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -3822,11 +3886,7 @@ int BFCP_Server::bfcp_FloorRelease_server(st_bfcp_server *server,
     /* Remove the list of requests */
     remove_request_list_of_node(newnode->floorrequest);
 
-    free(newnode->participant_info);
-    newnode->participant_info = NULL;
-    free(newnode->chair_info);
-    newnode->chair_info = NULL;
-    free(newnode);
+    bfcp_free_node(newnode);
     newnode = NULL;
 
     while (list_floors != NULL) {
@@ -3848,7 +3908,7 @@ int BFCP_Server::bfcp_FloorRelease_server(st_bfcp_server *server,
             error = bfcp_deleted_user_request(server->list_conferences[i].user,
                                               userID, position_floor);
             if (error == -1) {
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
         }
@@ -3860,20 +3920,18 @@ int BFCP_Server::bfcp_FloorRelease_server(st_bfcp_server *server,
         if (give_free_floors_to_the_accepted_nodes(
                 server->list_conferences + i, laccepted,
                 server->list_conferences[i].floor, NULL) == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
         /* Destroy the floors list */
         temp = list_floors;
         list_floors = list_floors->next;
-        free(temp->chair_info);
-        temp->chair_info = NULL;
-        free(temp);
+        bfcp_free_floor(temp);
         temp = NULL;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -3899,9 +3957,6 @@ int BFCP_Server::bfcp_ChairAction_server(
     bfcp_node *newnode = NULL;
     bfcp_floor *node = NULL;
     bfcp_queue *laccepted;
-    bfcp_arguments *arguments = NULL;
-    bfcp_message *message = NULL;
-    size_t dLen;
 
     actual_conference = server->Actual_number_conference - 1;
     for (i = 0; i < actual_conference; i++) {
@@ -3919,7 +3974,7 @@ int BFCP_Server::bfcp_ChairAction_server(
         bfcp_error_code(conferenceID, userID, TransactionID,
                         BFCP_CONFERENCE_DOES_NOT_EXIST, errortext, NULL, sockfd,
                         y, transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -3930,7 +3985,7 @@ int BFCP_Server::bfcp_ChairAction_server(
         bfcp_error_code(conferenceID, userID, TransactionID,
                         BFCP_USER_DOES_NOT_EXIST, errortext, NULL, sockfd, y,
                         transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -3945,7 +4000,7 @@ int BFCP_Server::bfcp_ChairAction_server(
             bfcp_error_code(conferenceID, userID, TransactionID,
                             BFCP_INVALID_FLOORID, errortext, NULL, sockfd, y,
                             transport);
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -3958,7 +4013,7 @@ int BFCP_Server::bfcp_ChairAction_server(
             bfcp_error_code(conferenceID, userID, TransactionID,
                             BFCP_UNAUTHORIZED_OPERATION, errortext, NULL,
                             sockfd, y, transport);
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     }
@@ -3975,7 +4030,7 @@ int BFCP_Server::bfcp_ChairAction_server(
             bfcp_error_code(conferenceID, userID, TransactionID,
                             BFCP_FLOORREQUEST_DOES_NOT_EXIST, errortext, NULL,
                             sockfd, y, transport);
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
         /* Check if the floors involved in the accepted request exist */
@@ -3990,7 +4045,7 @@ int BFCP_Server::bfcp_ChairAction_server(
                 bfcp_error_code(conferenceID, userID, TransactionID,
                                 BFCP_INVALID_FLOORID, errortext, NULL, sockfd,
                                 y, transport);
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
         }
@@ -4024,7 +4079,7 @@ int BFCP_Server::bfcp_ChairAction_server(
             error = bfcp_insert_request(server->list_conferences[i].accepted,
                                         newnode, floorRequestID, chair_info);
             if (error == -1) {
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
 
@@ -4032,7 +4087,7 @@ int BFCP_Server::bfcp_ChairAction_server(
             error = bfcp_print_information_floor(server->list_conferences + i,
                                                  0, 0, newnode, BFCP_ACCEPTED);
             if (error == -1) {
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
 
@@ -4041,7 +4096,7 @@ int BFCP_Server::bfcp_ChairAction_server(
             if (give_free_floors_to_the_accepted_nodes(
                     server->list_conferences + i, laccepted,
                     server->list_conferences[i].floor, chair_info) == -1) {
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
         }
@@ -4058,24 +4113,14 @@ int BFCP_Server::bfcp_ChairAction_server(
             bfcp_error_code(conferenceID, userID, TransactionID,
                             BFCP_FLOORREQUEST_DOES_NOT_EXIST, errortext, NULL,
                             sockfd, y, transport);
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
         /* If there's chair-provided text information, add it to the request
          * node */
-        if (chair_info != NULL) {
-            dLen = strlen(chair_info);
-            if (dLen != 0) {
-                if (newnode->chair_info != NULL) {
-                    free(newnode->chair_info);
-                    newnode->chair_info = NULL;
-                }
-                newnode->chair_info =
-                    (char *)calloc(1, dLen * sizeof(char) + 1);
-                memcpy(newnode->chair_info, chair_info, dLen + 1);
-            }
-        }
+        if (chair_info != NULL && strlen(chair_info) != 0)
+            bfcp_set_info(&newnode->chair_info, newnode->chair_buf, chair_info);
 
         /* Remove the threads handling this node */
         floor = newnode->floor;
@@ -4094,19 +4139,11 @@ int BFCP_Server::bfcp_ChairAction_server(
                 if (node->floorID == tempnode->floorID) {
                     /* If there's chair-provided text for this floor, add it */
                     if (tempnode->chair_info != NULL) {
-                        dLen = strlen(tempnode->chair_info);
-                        if (dLen != 0) {
-                            if (node->chair_info != NULL) {
-                                free(node->chair_info);
-                                node->chair_info = NULL;
-                            }
-                            node->chair_info =
-                                (char *)calloc(1, dLen * sizeof(char) + 1);
-                            memcpy(node->chair_info, tempnode->chair_info,
-                                   dLen + 1);
-                        }
+                        if (strlen(tempnode->chair_info) != 0)
+                            bfcp_set_info(&node->chair_info, node->chair_buf,
+                                          tempnode->chair_info);
                     } else
-                        node->chair_info = NULL;
+                        bfcp_free_info(&node->chair_info, node->chair_buf);
                 }
             }
         }
@@ -4114,19 +4151,16 @@ int BFCP_Server::bfcp_ChairAction_server(
         error = bfcp_print_information_floor(server->list_conferences + i, 0, 0,
                                              newnode, BFCP_DENIED);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
+        bfcp_deleted_node_request(server->list_conferences + i, newnode);
 
         /* Remove the request node from the Pending list */
         if (newnode != NULL) {
             remove_floor_list(newnode->floor);
             remove_request_list_of_node(newnode->floorrequest);
-            free(newnode->participant_info);
-            newnode->participant_info = NULL;
-            free(newnode->chair_info);
-            newnode->chair_info = NULL;
-            free(newnode);
+            bfcp_free_node(newnode);
             newnode = NULL;
         }
     } else if (RequestStatus == BFCP_REVOKED) {
@@ -4142,21 +4176,14 @@ int BFCP_Server::bfcp_ChairAction_server(
             bfcp_error_code(conferenceID, userID, TransactionID,
                             BFCP_FLOORREQUEST_DOES_NOT_EXIST, errortext, NULL,
                             sockfd, y, transport);
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
         /* If there's chair-provided text information, add it to the request
          * node */
-        if (chair_info != NULL) {
-            dLen = strlen(chair_info);
-            if (dLen != 0) {
-                if (newnode->chair_info != NULL) free(newnode->chair_info);
-                newnode->chair_info =
-                    (char *)calloc(1, dLen * sizeof(char) + 1);
-                memcpy(newnode->chair_info, chair_info, dLen + 1);
-            }
-        }
+        if (chair_info != NULL && strlen(chair_info) != 0)
+            bfcp_set_info(&newnode->chair_info, newnode->chair_buf, chair_info);
 
         /* Add the chair-provided information to each floor */
         for (tempnode = list_floors; tempnode != NULL;
@@ -4165,19 +4192,11 @@ int BFCP_Server::bfcp_ChairAction_server(
                 if (node->floorID == tempnode->floorID) {
                     /* If there's chair-provided text for this floor, add it */
                     if (tempnode->chair_info != NULL) {
-                        dLen = strlen(tempnode->chair_info);
-                        if (dLen != 0) {
-                            if (node->chair_info != NULL) {
-                                free(node->chair_info);
-                                node->chair_info = NULL;
-                            }
-                            node->chair_info =
-                                (char *)calloc(1, dLen * sizeof(char) + 1);
-                            memcpy(node->chair_info, tempnode->chair_info,
-                                   dLen + 1);
-                        }
+                        if (strlen(tempnode->chair_info) != 0)
+                            bfcp_set_info(&node->chair_info, node->chair_buf,
+                                          tempnode->chair_info);
                     } else
-                        node->chair_info = NULL;
+                        bfcp_free_info(&node->chair_info, node->chair_buf);
                 }
             }
         }
@@ -4186,19 +4205,16 @@ int BFCP_Server::bfcp_ChairAction_server(
         error = bfcp_print_information_floor(server->list_conferences + i, 0, 0,
                                              newnode, BFCP_REVOKED);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
+        bfcp_deleted_node_request(server->list_conferences + i, newnode);
 
         /* Remove the request node from the Granted list */
         if (newnode != NULL) {
             tempfloors = newnode->floor;
             remove_request_list_of_node(newnode->floorrequest);
-            free(newnode->participant_info);
-            newnode->participant_info = NULL;
-            free(newnode->chair_info);
-            newnode->chair_info = NULL;
-            free(newnode);
+            bfcp_free_node(newnode);
             newnode = NULL;
         }
 
@@ -4209,13 +4225,11 @@ int BFCP_Server::bfcp_ChairAction_server(
                                             free_floors->floorID,
                                             BFCP_FLOOR_STATE_WAITING);
             if (error == -1) {
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
             next = free_floors->next;
-            free(free_floors->chair_info);
-            free_floors->chair_info = NULL;
-            free(free_floors);
+            bfcp_free_floor(free_floors);
             free_floors = NULL;
             free_floors = next;
         }
@@ -4224,41 +4238,27 @@ int BFCP_Server::bfcp_ChairAction_server(
         if (give_free_floors_to_the_accepted_nodes(
                 server->list_conferences + i, laccepted,
                 server->list_conferences[i].floor, chair_info) == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     } else {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
     /* Free the floors list */
     while (list_floors) {
         next_floors = list_floors->next;
-        free(list_floors->chair_info);
-        list_floors->chair_info = NULL;
-        free(list_floors);
+        bfcp_free_floor(list_floors);
         list_floors = NULL;
         list_floors = next_floors;
     }
 
-    /* Send the ChairActionAck to the client */
-    arguments = bfcp_new_arguments();
-    if (!arguments) {
-        bfcp_mutex_unlock(count_mutex);
-        return -1;
-    }
-    arguments->entity = bfcp_new_entity(conferenceID, TransactionID, userID);
-    arguments->primitive = e_primitive_ChairActionAck;
+    UnlockServer();
 
-    message = bfcp_build_message(arguments);
-    if (!message) {
-        bfcp_mutex_unlock(count_mutex);
-        return -1;
-    }
-    bfcp_mutex_unlock(count_mutex);
-    error = sendBFCPmessage(sockfd, message);
-    BFCP_SEND_CHECK_ERRORS();
+    /* Send the ChairActionAck to the client */
+    sendBFCPtemplate(sockfd, &m_chairactionack_template, conferenceID,
+                     TransactionID, userID);
 
     return 0;
 }
@@ -4273,8 +4273,6 @@ int BFCP_Server::bfcp_hello_server(st_bfcp_server *server, UINT32 conferenceID,
     if (TransactionID <= 0) return -1;
 
     int i, error;
-    bfcp_arguments *arguments = NULL;
-    bfcp_message *message = NULL;
 
     bfcp_mutex_lock(count_mutex);
 #if HSU
@@ -4297,7 +4295,7 @@ int BFCP_Server::bfcp_hello_server(st_bfcp_server *server, UINT32 conferenceID,
         bfcp_error_code(conferenceID, userID, TransactionID,
                         BFCP_CONFERENCE_DOES_NOT_EXIST, errortext, NULL, sockfd,
                         y, transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -4310,7 +4308,7 @@ int BFCP_Server::bfcp_hello_server(st_bfcp_server *server, UINT32 conferenceID,
         bfcp_error_code(conferenceID, userID, TransactionID,
                         BFCP_USER_DOES_NOT_EXIST, errortext, NULL, sockfd, y,
                         transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -4319,54 +4317,14 @@ int BFCP_Server::bfcp_hello_server(st_bfcp_server *server, UINT32 conferenceID,
         sprintf(errortext, "Server error");
         bfcp_error_code(conferenceID, userID, TransactionID, BFCP_GENERIC_ERROR,
                         errortext, NULL, sockfd, y, transport);
-        bfcp_mutex_unlock(count_mutex);
-        return -1;
-    }
-    arguments = bfcp_new_arguments();
-    if (!arguments) {
-        bfcp_mutex_unlock(count_mutex);
-        return -1;
-    }
-    arguments->entity = bfcp_new_entity(conferenceID, TransactionID, userID);
-    arguments->primitive = e_primitive_HelloAck;
-
-    /* Create a list of all the primitives the FCS supports */
-    arguments->primitives = bfcp_new_supported_list(
-        e_primitive_FloorRequest, e_primitive_FloorRelease,
-        /* e_primitive_FloorRequestQuery,
-        e_primitive_FloorRequestStatus,
-        e_primitive_UserQuery,
-        e_primitive_UserStatus,
-*/
-        //e_primitive_FloorQuery,
-        /*
-        e_primitive_ChairAction,
-        e_primitive_ChairActionAck,*/
-        e_primitive_FloorStatus, e_primitive_Hello, e_primitive_HelloAck,
-        e_primitive_Goodbye, e_primitive_GoodbyeAck, e_primitive_Error, 0);
-
-    /* Create a list of all the attributes the FCS supports */
-    arguments->attributes = bfcp_new_supported_list(
-        BENEFICIARY_ID, FLOOR_ID, FLOOR_REQUEST_ID, PRIORITY, REQUEST_STATUS,
-        ERROR_CODE, ERROR_INFO, PARTICIPANT_PROVIDED_INFO, STATUS_INFO,
-        SUPPORTED_ATTRIBUTES, SUPPORTED_PRIMITIVES, USER_DISPLAY_NAME, USER_URI,
-        BENEFICIARY_INFORMATION, FLOOR_REQUEST_INFORMATION,
-        REQUESTED_BY_INFORMATION, FLOOR_REQUEST_STATUS, OVERALL_REQUEST_STATUS,
-        NONCE, DIGEST, 0);
-
-    message = bfcp_build_message(arguments);
-    if (!message) {
-        Log(ERR, "BFCPServer: Failed to build HelloAck message");
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
-
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     Log(INF, "BFCPServer: sending HelloAck sock fd %d", sockfd);
-    error = sendBFCPmessage(sockfd, message);
-
-    BFCP_SEND_CHECK_ERRORS();
+    error = sendBFCPtemplate(sockfd, &m_helloack_template, conferenceID,
+                             TransactionID, userID);
     if (error < 0)
         Log(INF, "BFCPServer: failed to send HelloAck. err %d on sockfd %d",
             error, sockfd);
@@ -4383,11 +4341,8 @@ int BFCP_Server::bfcp_userquery_server(st_bfcp_server *server,
     if (conferenceID <= 0) return -1;
     if (userID <= 0) return -1;
 
-    bfcp_arguments *arguments = NULL;
     bfcp_message *message = NULL;
-    bfcp_user_information *beneficiary_info;
     int error, actual_conference = 0, i, j;
-    bfcp_floor_request_information *frqInfo = NULL, *list_frqInfo = NULL;
     pnode traverse;
 
     bfcp_mutex_lock(count_mutex);
@@ -4406,7 +4361,7 @@ int BFCP_Server::bfcp_userquery_server(st_bfcp_server *server,
         bfcp_error_code(conferenceID, userID, TransactionID,
                         BFCP_CONFERENCE_DOES_NOT_EXIST, errortext, NULL, sockfd,
                         y, transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -4417,7 +4372,7 @@ int BFCP_Server::bfcp_userquery_server(st_bfcp_server *server,
         bfcp_error_code(conferenceID, userID, TransactionID,
                         BFCP_USER_DOES_NOT_EXIST, errortext, NULL, sockfd, y,
                         transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -4434,50 +4389,32 @@ int BFCP_Server::bfcp_userquery_server(st_bfcp_server *server,
             bfcp_error_code(conferenceID, userID, TransactionID,
                             BFCP_USER_DOES_NOT_EXIST, errortext, NULL, sockfd,
                             y, transport);
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     }
 
     /* Prepare an UserStatus message */
-    arguments = bfcp_new_arguments();
-    if (!arguments) {
-        bfcp_mutex_unlock(count_mutex);
-        return -1;
-    }
-
-    arguments->entity = bfcp_new_entity(conferenceID, TransactionID, userID);
-    arguments->primitive = e_primitive_UserStatus;
+    lusers users = server->list_conferences[i].user;
+    BFCP_ServerEncoder encoder(e_primitive_UserStatus, conferenceID,
+                               TransactionID, userID);
 
     /* Add the Beneficiary information, if needed */
     if (beneficiaryID != 0) {
-        beneficiary_info = bfcp_show_user_information(
-            server->list_conferences[i].user, beneficiaryID);
-        if (beneficiary_info == NULL) {
-            bfcp_free_user_information(beneficiary_info);
-            bfcp_mutex_unlock(count_mutex);
-            return -1;
-        }
+        encode_user_information(encoder, BENEFICIARY_INFORMATION, users,
+                                beneficiaryID);
         userID = beneficiaryID;
-    } else
-        beneficiary_info = NULL;
-
-    arguments->beneficiary = beneficiary_info;
+    }
 
     /*if the queue is a granted queue*/
     if (server->list_conferences[i].granted != NULL) {
         traverse = server->list_conferences[i].granted->tail;
         while (traverse) {
             if ((traverse->userID == userID) ||
-                (traverse->beneficiaryID == userID)) {
-                frqInfo = create_floor_request_userID(
-                    traverse, server->list_conferences[i].user, userID, 3, 0);
-                if ((frqInfo != NULL) && (list_frqInfo != NULL))
-                    bfcp_add_floor_request_information_list(list_frqInfo,
-                                                            frqInfo, NULL);
-                else if (list_frqInfo == NULL)
-                    list_frqInfo = frqInfo;
-            }
+                (traverse->beneficiaryID == userID))
+                encode_floor_request_information(encoder, traverse, users, 0,
+                                                 BFCP_GRANTED, 0, 0,
+                                                 traverse->priority);
             traverse = traverse->prev;
         }
     }
@@ -4488,15 +4425,10 @@ int BFCP_Server::bfcp_userquery_server(st_bfcp_server *server,
         j = 1;
         while (traverse) {
             if ((traverse->userID == userID) ||
-                (traverse->beneficiaryID == userID)) {
-                frqInfo = create_floor_request_userID(
-                    traverse, server->list_conferences[i].user, userID, 2, j);
-                if ((frqInfo != NULL) && (list_frqInfo != NULL))
-                    bfcp_add_floor_request_information_list(list_frqInfo,
-                                                            frqInfo, NULL);
-                else if (list_frqInfo == NULL)
-                    list_frqInfo = frqInfo;
-            }
+                (traverse->beneficiaryID == userID))
+                encode_floor_request_information(encoder, traverse, users, 0,
+                                                 BFCP_ACCEPTED, j, j,
+                                                 traverse->priority);
             j = j + 1;
             traverse = traverse->prev;
         }
@@ -4507,32 +4439,22 @@ int BFCP_Server::bfcp_userquery_server(st_bfcp_server *server,
         traverse = server->list_conferences[i].pending->tail;
         while (traverse) {
             if ((traverse->userID == userID) ||
-                (traverse->beneficiaryID == userID)) {
-                frqInfo = create_floor_request_userID(
-                    traverse, server->list_conferences[i].user, userID, 1, 0);
-                if ((frqInfo != NULL) && (list_frqInfo != NULL))
-                    bfcp_add_floor_request_information_list(list_frqInfo,
-                                                            frqInfo, NULL);
-                else if (list_frqInfo == NULL)
-                    list_frqInfo = frqInfo;
-            }
+                (traverse->beneficiaryID == userID))
+                encode_floor_request_information(encoder, traverse, users, 0,
+                                                 BFCP_PENDING, 0, 0,
+                                                 traverse->priority);
             traverse = traverse->prev;
         }
     }
 
-    arguments->frqInfo = list_frqInfo;
-
-    message = bfcp_build_message(arguments);
+    message = encoder.message();
     if (!message) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
     error = sendBFCPmessage(sockfd, message);
-
-    BFCP_SEND_CHECK_ERRORS();
-
     return error;
 }
 
@@ -4580,14 +4502,14 @@ int BFCP_Server::bfcp_floorquery_server(st_bfcp_server *server,
     }
 
     if (i < 0) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return i;
     }
 
     error = bfcp_floor_query_server(server->list_conferences[i].floor,
                                     list_floors, userID, sockfd, transport);
     if (error < 0) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return error;
     }
 
@@ -4603,7 +4525,7 @@ int BFCP_Server::bfcp_floorquery_server(st_bfcp_server *server,
                 bfcp_error_code(conferenceID, userID, TransactionID,
                                 BFCP_INVALID_FLOORID, errortext, NULL, sockfd,
                                 y, transport);
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
         }
@@ -4614,7 +4536,7 @@ int BFCP_Server::bfcp_floorquery_server(st_bfcp_server *server,
         error = bfcp_remove_floorquery_from_all_nodes(
             server->list_conferences[i].floor, userID);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -4623,7 +4545,7 @@ int BFCP_Server::bfcp_floorquery_server(st_bfcp_server *server,
                                             server->list_conferences + i, 0,
                                             client, NULL, 0);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
     }
@@ -4645,7 +4567,7 @@ int BFCP_Server::bfcp_floorquery_server(st_bfcp_server *server,
                             server->list_conferences + i, list_floors->floorID,
                             &cl, NULL, 0);
                         if (error == -1) {
-                            bfcp_mutex_unlock(count_mutex);
+                            UnlockServer();
                             return -1;
                         }
                     }
@@ -4656,14 +4578,12 @@ int BFCP_Server::bfcp_floorquery_server(st_bfcp_server *server,
 
         /* Remove the floor from the list */
         next_floors = list_floors->next;
-        free(list_floors->chair_info);
-        list_floors->chair_info = NULL;
-        free(list_floors);
+        bfcp_free_floor(list_floors);
         list_floors = NULL;
         list_floors = next_floors;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 
     return 0;
 }
@@ -4689,7 +4609,7 @@ int BFCP_Server::bfcp_floor_query_server(bfcp_list_floors *lfloors,
                 if (query->userID == userID) {
                     lfloors->floors[i].floorquery = query->next;
                     query->next = NULL;
-                    free(query);
+                    BFCP_FREE(BFCP_ALLOC_FLOOR, query);
                     query = NULL;
                 } else {
                     while (query->next) {
@@ -4698,7 +4618,7 @@ int BFCP_Server::bfcp_floor_query_server(bfcp_list_floors *lfloors,
                             query_temp = query->next;
                             query->next = query_temp->next;
                             query_temp->next = NULL;
-                            free(query_temp);
+                            BFCP_FREE(BFCP_ALLOC_FLOOR, query_temp);
                             query_temp = NULL;
                             break;
                         } else
@@ -4728,7 +4648,8 @@ int BFCP_Server::bfcp_floor_query_server(bfcp_list_floors *lfloors,
             }
             if (exist_user == 0) {
                 /* Allocate a new node */
-                newnode = (floor_query *)calloc(1, sizeof(floor_query));
+                newnode = (floor_query *)BFCP_CALLOC(BFCP_ALLOC_FLOOR, 1,
+                                                     sizeof(floor_query));
                 if (newnode == NULL) return -1;
 
                 query = lfloors->floors[i].floorquery;
@@ -4756,9 +4677,7 @@ int BFCP_Server::bfcp_floorrequestquery_server(
     if (conferenceID <= 0) return -1;
     if (userID <= 0) return -1;
 
-    bfcp_arguments *arguments = NULL;
     bfcp_message *message = NULL;
-    bfcp_floor_request_information *frqInfo, *list_frqInfo = NULL;
     int actual_conference, i, error;
     bfcp_mutex_lock(count_mutex);
     actual_conference = server->Actual_number_conference - 1;
@@ -4775,7 +4694,7 @@ int BFCP_Server::bfcp_floorrequestquery_server(
         bfcp_error_code(conferenceID, userID, TransactionID,
                         BFCP_CONFERENCE_DOES_NOT_EXIST, errortext, NULL, sockfd,
                         y, transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -4786,7 +4705,7 @@ int BFCP_Server::bfcp_floorrequestquery_server(
         bfcp_error_code(conferenceID, userID, TransactionID,
                         BFCP_USER_DOES_NOT_EXIST, errortext, NULL, sockfd, y,
                         transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
@@ -4808,68 +4727,49 @@ int BFCP_Server::bfcp_floorrequestquery_server(
                 bfcp_error_code(conferenceID, userID, TransactionID,
                                 BFCP_FLOORREQUEST_DOES_NOT_EXIST, errortext,
                                 NULL, sockfd, y, transport);
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return -1;
             }
         }
     }
 
     /* Prepare the FloorRequestStatus message */
-    arguments = bfcp_new_arguments();
-    if (!arguments) {
-        bfcp_mutex_unlock(count_mutex);
-        return -1;
-    }
-    arguments->entity = bfcp_new_entity(conferenceID, TransactionID, userID);
-    arguments->primitive = e_primitive_FloorRequestStatus;
+    lusers users = server->list_conferences[i].user;
+    pnode node;
+    BFCP_ServerEncoder encoder(e_primitive_FloorRequestStatus, conferenceID,
+                               TransactionID, userID);
 
     /* Granted list*/
-    frqInfo = bfcp_show_floorrequest_information(
-        server->list_conferences[i].granted, server->list_conferences[i].user,
-        floorRequestID, 0);
-    if (frqInfo != NULL) {
-        if (list_frqInfo != NULL)
-            bfcp_add_floor_request_information_list(list_frqInfo, frqInfo,
-                                                    NULL);
-        else
-            list_frqInfo = frqInfo;
-    }
+    node = bfcp_find_request(server->list_conferences[i].granted,
+                             floorRequestID);
+    if (node != NULL)
+        encode_floor_request_information(encoder, node, users, 0,
+                                         BFCP_GRANTED, 0, 0, node->priority);
 
     /* Accepted list*/
-    frqInfo = bfcp_show_floorrequest_information(
-        server->list_conferences[i].accepted, server->list_conferences[i].user,
-        floorRequestID, 1);
-    if (frqInfo != NULL) {
-        if (list_frqInfo != NULL)
-            bfcp_add_floor_request_information_list(list_frqInfo, frqInfo,
-                                                    NULL);
-        else
-            list_frqInfo = frqInfo;
-    }
+    node = bfcp_find_request(server->list_conferences[i].accepted,
+                             floorRequestID);
+    if (node != NULL)
+        encode_floor_request_information(encoder, node, users, 0,
+                                         BFCP_ACCEPTED, node->queue_position,
+                                         0, node->priority);
 
     /* Pending list*/
-    frqInfo = bfcp_show_floorrequest_information(
-        server->list_conferences[i].pending, server->list_conferences[i].user,
-        floorRequestID, 2);
-    if (frqInfo != NULL) {
-        if (list_frqInfo != NULL)
-            bfcp_add_floor_request_information_list(list_frqInfo, frqInfo,
-                                                    NULL);
-        else
-            list_frqInfo = frqInfo;
-    }
-
-    arguments->frqInfo = list_frqInfo;
-
-    message = bfcp_build_message(arguments);
+    node = bfcp_find_request(server->list_conferences[i].pending,
+                             floorRequestID);
+    if (node != NULL)
+        encode_floor_request_information(encoder, node, users, 0,
+                                         BFCP_PENDING, node->priority, 0,
+                                         node->priority);
+
+    message = encoder.message();
     if (!message) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return -1;
     }
 
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
     error = sendBFCPmessage(sockfd, message);
-    BFCP_SEND_CHECK_ERRORS();
     return error;
 }
 
@@ -4908,7 +4808,7 @@ int BFCP_Server::check_accepted_node(st_bfcp_conference *conference,
         newnode = bfcp_extract_request(conference->accepted,
                                        queue_accepted->floorRequestID);
         if (newnode == NULL) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
 
@@ -4922,21 +4822,22 @@ int BFCP_Server::check_accepted_node(st_bfcp_conference *conference,
         error = bfcp_insert_request(conference->granted, newnode,
                                     newnode->floorRequestID, chair_info);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
+        TraceRequest(newnode, BFCP_TRACE_GRANTED);
 
         /* Prepare all floor information needed by interested users */
         error = bfcp_print_information_floor(conference, 0, 0, newnode,
                                              BFCP_GRANTED);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return -1;
         }
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return 0;
     } else
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
     return 1;
 }
 
@@ -4974,42 +4875,32 @@ int BFCP_Server::bfcp_error_code(UINT32 conferenceID, UINT16 userID,
                                  const char *error_info,
                                  bfcp_unknown_m_error_details *details,
                                  BFCP_SOCKET sockfd, int i, int transport) {
-    int error;
-    size_t dLen;
-    bfcp_arguments *arguments = NULL;
-    bfcp_message *message = NULL;
+    /* Error replies are encoded on the stack: Header + ERROR-CODE + ERROR-INFO
+     * (attribute lengths are 8 bits) always fit */
+    unsigned char buffer[12 + 2 * 256];
+    UINT8 unknown_types[64];
+    UINT16 count = 0;
+    bfcp_message message;
+    int length;
+
     Log(WAR, "bfcp_error_code UserID[%d] code[%d] msg[%s]", userID, code,
         error_info ? error_info : "");
-    arguments = bfcp_new_arguments();
-    if (!arguments) return -1;
-
-    arguments->entity = bfcp_new_entity(conferenceID, TransactionID, userID);
-    arguments->primitive = e_primitive_Error;
-
-    arguments->error = bfcp_new_error(code, NULL);
-    if (!arguments->error) {
-        /* An error occurred when creating a new Error Code */
-        bfcp_free_error(arguments->error);
+    for (; details != NULL && count < sizeof(unknown_types);
+         details = details->next)
+        unknown_types[count++] = (UINT8)details->unknown_type;
+    if (code == BFCP_UNKNOWN_MANDATORY_ATTRIBUTE && count == 0)
+        /* There has to be AT LEAST one error detail for error 4 */
         return -1;
-    }
 
-    if (error_info != NULL) { /* If there's error text, add it */
-        dLen = strlen(error_info);
-        if (dLen != 0) {
-            arguments->eInfo = (char *)calloc(1, dLen * sizeof(char) + 1);
-            memcpy(arguments->eInfo, error_info, dLen + 1);
-        } else
-            arguments->eInfo = NULL;
-    } else
-        arguments->eInfo = NULL;
+    length = bfcp_encode_message_Error(buffer, sizeof(buffer), conferenceID,
+                                       TransactionID, userID, code,
+                                       unknown_types, count, error_info, 0);
+    if (length < 0 || length > (int)sizeof(buffer)) return -1;
 
-    message = bfcp_build_message(arguments);
-    if (!message) {
-        return -1;
-    }
-    error = sendBFCPmessage(sockfd, message);
-    BFCP_SEND_CHECK_ERRORS();
-    return error;
+    message.buffer = buffer;
+    message.position = 0;
+    message.length = (UINT16)length;
+    return sendBFCPmessage(sockfd, &message);
 }
 
 /* incoming connections and messages */
@@ -5310,6 +5201,7 @@ bool BFCP_Server::bfcp_received_msg(bfcp_received_message *recv_msg,
                                 recv_msg->arguments->bID,
                                 recv_msg->arguments->priority,
                                 recv_msg->arguments->pInfo, parse_floor->ID);
+                            TraceRequest(node, BFCP_TRACE_RECEIVED);
                             parse_floor = parse_floor->next;
                             while (parse_floor != NULL) {
                                 Log(INF, "FloorID next:       %d",
@@ -5396,13 +5288,36 @@ void BFCP_Server::DumpServer() {
     bfcp_user *user = NULL;
     floor_query *query = NULL;
     st_bfcp_server *server = m_struct_server;
+    st_bfcp_floor_snapshot snapshot;
 
     for (int i = 0; i < server->Actual_number_conference; i++) {
         Log(INF, "CONFERENCE:");
         Log(INF, "ConferenceID: %d", server->list_conferences[i].conferenceID);
-        /* Print the list of floors */
+        /* Print the floors of the managed conference from the snapshot, when
+         * it holds all of them */
         list_floor = server->list_conferences[i].floor;
-        if (list_floor != NULL) {
+        if (server->list_conferences[i].conferenceID == m_confID &&
+            GetFloorSnapshot(&snapshot) &&
+            snapshot.number_floors == snapshot.total_floors) {
+            Log(INF, "FLOORS");
+            for (int j = 0; j < snapshot.number_floors; j++) {
+                Log(INF, "FloorID: %u ", snapshot.floorID[j]);
+                Log(INF, "ChairID: %u", snapshot.chairID[j]);
+                if (snapshot.floorState[j] == BFCP_FLOOR_STATE_WAITING)
+                    Log(INF, " state: FREE");
+                else if (snapshot.floorState[j] == BFCP_FLOOR_STATE_ACCEPTED)
+                    Log(INF, " state: ACCEPTED");
+                else if (snapshot.floorState[j] >= BFCP_FLOOR_STATE_GRANTED)
+                    Log(INF, " state: GRANTED");
+                else
+                    Log(INF, " state: error!");
+                Log(INF, "Holder: %u", snapshot.holderID[j]);
+                Log(INF, "Queued requests: %u", snapshot.queue_length[j]);
+            }
+            Log(INF, "Requests: pending %u accepted %u granted %u",
+                snapshot.pending_count, snapshot.accepted_count,
+                snapshot.granted_count);
+        } else if (list_floor != NULL) {
             Log(INF, "Maximum number of floors in the conference: %i",
                 list_floor->number_floors + 1);
             Log(INF, "FLOORS");
@@ -5517,6 +5432,66 @@ void BFCP_Server::print_requests_list(st_bfcp_server *server, int index,
     }
 }
 
+bool BFCP_Server::BFCPFSM_FsmEvent(s_bfcp_msg_event *p_evt) {
+    e_BFCP_ACT action = BFCPFSM_EventAction(p_evt);
+    if (action == BFCP_ACT_UNDEFINED) return false;
+    return SessionCtrlPerform(action, p_evt);
+}
+
+bool BFCP_Server::SessionCtrlPerform(e_BFCP_ACT p_evt,
+                                     s_bfcp_msg_event *p_bfcp_evt) {
+    if (!p_bfcp_evt || p_evt <= BFCP_ACT_UNDEFINED || p_evt >= BFCP_ACT_LAST)
+        return false;
+
+    e_BFCP_ACT state = bfcp_get_user_session_server(
+        m_struct_server, p_bfcp_evt->conferenceID, p_bfcp_evt->userID);
+    /* A new or ended session starts in the state of the server socket, as the
+       transport of its user is up once the server socket is connected */
+    if (state == BFCP_ACT_UNDEFINED || state == BFCP_ACT_INITIALIZED ||
+        state == BFCP_ACT_DISCONNECTED)
+        state = (m_bfcpFsmSt == BFCP_ACT_CONNECTED) ? BFCP_ACT_CONNECTED
+                                                    : BFCP_ACT_INITIALIZED;
+
+    const st_BFCP_fsm &transition = s_stateMachine[state][p_evt];
+    if (!transition.function) {
+        Log(WAR, "FSM [Session %u/%u] state[%s] event[%s] => No action",
+            p_bfcp_evt->conferenceID, p_bfcp_evt->userID,
+            getBfcpFsmAct(state), getBfcpFsmAct(p_evt));
+        return false;
+    }
+    Log(INF,
+        "FSM [Session %u/%u] current state[%s] event[%s] from sockfd [%d] "
+        "expected state[%s] ... perform action",
+        p_bfcp_evt->conferenceID, p_bfcp_evt->userID, getBfcpFsmAct(state),
+        getBfcpFsmAct(p_evt), p_bfcp_evt->sockfd,
+        getBfcpFsmAct(transition.new_state));
+    bool Status = (*this.*transition.function)(p_bfcp_evt);
+    BFCP_PROBE5(fsm_transition, "Session", (int)state, (int)p_evt,
+                (int)(Status ? transition.new_state : state), (int)Status);
+    if (Status) {
+        Log(INF,
+            "FSM [Session %u/%u] action sucessful. Current state [%s] => new "
+            "state [%s]",
+            p_bfcp_evt->conferenceID, p_bfcp_evt->userID, getBfcpFsmAct(state),
+            getBfcpFsmAct(transition.new_state));
+        /* Looked up again: the action may have added or removed the user */
+        bfcp_set_user_session_server(m_struct_server, p_bfcp_evt->conferenceID,
+                                     p_bfcp_evt->userID, transition.new_state);
+        BFCPFSM_UpdatesBfcpFsmEvent(p_bfcp_evt, p_evt, transition.new_state);
+    } else if (p_evt == BFCP_ACT_FloorStatusGranted) {
+        Log(INF, "Providing callback for event %s and status %s ",
+            getBfcpFsmAct(p_evt), getBfcpStatus(p_bfcp_evt->Status));
+        BFCPFSM_UpdatesBfcpFsmEvent(p_bfcp_evt, p_evt, state);
+    } else {
+        Log(INF,
+            "FSM [Session %u/%u] event %s and status %s NOT successful, state "
+            "will not change",
+            p_bfcp_evt->conferenceID, p_bfcp_evt->userID, getBfcpFsmAct(p_evt),
+            getBfcpStatus(p_bfcp_evt->Status));
+    }
+    return Status;
+}
+
 bool BFCP_Server::BFCPFSM_UpdatesBfcpFsmEvent(s_bfcp_msg_event *p_bfcp_evt,
                                               e_BFCP_ACT p_evt,
                                               e_BFCP_ACT p_st) {
@@ -5590,7 +5565,17 @@ bool BFCP_Server::BFCPFSM_UpdatesBfcpFsmEvent(s_bfcp_msg_event *p_bfcp_evt,
             bfcpFsmEvt.FloorID = m_floorID;
             bfcpFsmEvt.conferenceID = m_confID;
         }
+        if (p_evt == BFCP_ACT_FloorRequest && p_bfcp_evt &&
+            p_bfcp_evt->pt_param) {
+            /* The node was inserted in the Pending list by
+             * BFCPFSM_FloorRequest */
+            bfcp_mutex_lock(count_mutex);
+            TraceRequest(*(pnode *)p_bfcp_evt->pt_param, BFCP_TRACE_NOTIFIED);
+            bfcp_mutex_unlock(count_mutex);
+        }
+        UINT64 start = BFCP_Metrics::Now();
         m_ServerEvent->OnBfcpServerEvent(p_evt, &bfcpFsmEvt);
+        m_metrics.Duration(&st_bfcp_metrics::callback_us, start);
     }
     return Status;
 }
@@ -5677,7 +5662,7 @@ bool BFCP_Server::BFCPFSM_Hello(s_bfcp_msg_event *p_evt) {
 #endif  // HSU
             }
           
-            return FsmCtrlPerform(BFCP_fsm::BFCP_ACT_HelloAck, p_evt);
+            return SessionCtrlPerform(BFCP_fsm::BFCP_ACT_HelloAck, p_evt);
         }
     }
     return status;
@@ -5784,7 +5769,7 @@ bool BFCP_Server::BFCPFSM_FloorRequest(s_bfcp_msg_event *p_evt) {
         bfcp_error_code(conferenceID, newnode->userID, TransactionID,
                         (e_bfcp_error_codes)error, errortext, NULL, sockfd, y,
                         p_evt->transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return false;
     }
 
@@ -5862,17 +5847,13 @@ bool BFCP_Server::BFCPFSM_FloorRequest(s_bfcp_msg_event *p_evt) {
                 /* Remove the node */
                 remove_floor_list(newnode->floor);
                 remove_request_list_of_node(newnode->floorrequest);
-                free(newnode->participant_info);
-                newnode->participant_info = NULL;
-                free(newnode->chair_info);
-                newnode->chair_info = NULL;
-                free(newnode);
+                bfcp_free_node(newnode);
                 newnode = NULL;
-                bfcp_mutex_unlock(count_mutex);
+                UnlockServer();
                 return status;
             }
         } else {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return status;
         }
     }
@@ -5893,9 +5874,10 @@ bool BFCP_Server::BFCPFSM_FloorRequest(s_bfcp_msg_event *p_evt) {
     error = bfcp_insert_request(server->list_conferences[i].pending, newnode,
                                 floorRequestID, NULL);
     if (error == -1) {
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return status;
     }
+    TraceRequest(newnode, BFCP_TRACE_PENDING);
 
     /* Store floor request ID */
     p_evt->FloorRequestID = floorRequestID;
@@ -5909,7 +5891,7 @@ bool BFCP_Server::BFCPFSM_FloorRequest(s_bfcp_msg_event *p_evt) {
         Log(ERR,
             "BFCPFSM_FloorRequest send  BFCPFSM_FloorRequestStatus PENDING "
             "failed ! ");
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return status;
     } else {
         server->list_conferences[i].floorRequestID =
@@ -5920,11 +5902,11 @@ bool BFCP_Server::BFCPFSM_FloorRequest(s_bfcp_msg_event *p_evt) {
         error = add_request_to_the_node(newnode, newnode->userID, sockfd,
                                         p_evt->transport);
         if (error == -1) {
-            bfcp_mutex_unlock(count_mutex);
+            UnlockServer();
             return status;
         }
     }
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
     return true;
 }
 
@@ -5943,44 +5925,19 @@ bool BFCP_Server::SendHello(UINT32 p_userID, const char *remoteAddr,
         return false;
     }
 
-    bfcp_arguments *arguments = bfcp_new_arguments();
+    int unreliable = 0;
     if (tr == BFCP_OVER_UDP) {
         if (remoteAddr != NULL)
             SetRemoteAddressAndPort(s, remoteAddr, remotePort);
         trID = m_trIdGenerator++;
-        arguments->unreliable = 1;
-    } else {
-        arguments->unreliable = 0;
+        unreliable = 1;
     }
 
-    arguments->entity = bfcp_new_entity(m_confID, trID, p_userID);
-    arguments->primitive = e_primitive_Hello;
+    /* Hello has no attributes: the FCS lists what it supports in HelloAck */
+    BFCP_Encoder<64> encoder(e_primitive_Hello, m_confID, trID, p_userID,
+                             unreliable);
 
-    /* Create a list of all the primitives the FCS supports */
-    arguments->primitives = bfcp_new_supported_list(
-        e_primitive_FloorRequest, e_primitive_FloorRelease,
-        /* e_primitive_FloorRequestQuery,
-        e_primitive_FloorRequestStatus,
-        e_primitive_UserQuery,
-        e_primitive_UserStatus,
-*/
-        //e_primitive_FloorQuery,
-        /*
-        e_primitive_ChairAction,
-        e_primitive_ChairActionAck,*/
-        e_primitive_FloorStatus, e_primitive_Hello, e_primitive_HelloAck,
-        e_primitive_Goodbye, e_primitive_GoodbyeAck, e_primitive_Error, 0);
-
-    /* Create a list of all the attributes the FCS supports */
-    arguments->attributes = bfcp_new_supported_list(
-        BENEFICIARY_ID, FLOOR_ID, FLOOR_REQUEST_ID, PRIORITY, REQUEST_STATUS,
-        ERROR_CODE, ERROR_INFO, PARTICIPANT_PROVIDED_INFO, STATUS_INFO,
-        SUPPORTED_ATTRIBUTES, SUPPORTED_PRIMITIVES, USER_DISPLAY_NAME, USER_URI,
-        BENEFICIARY_INFORMATION, FLOOR_REQUEST_INFORMATION,
-        REQUESTED_BY_INFORMATION, FLOOR_REQUEST_STATUS, OVERALL_REQUEST_STATUS,
-        NONCE, DIGEST, 0);
-
-    bfcp_message *message = bfcp_build_message(arguments);
+    bfcp_message *message = encoder.message();
     if (!message) {
         Log(ERR, "BFCPServer: Failed to build Hello message");
         return false;
@@ -5988,8 +5945,6 @@ bool BFCP_Server::SendHello(UINT32 p_userID, const char *remoteAddr,
 
     Log(INF, "BFCPServer: sending Hello to socket [%d]", s);
     error = sendBFCPmessage(s, message);
-
-    BFCP_SEND_CHECK_ERRORS();
     if (error < 0)
         Log(INF, "BFCPServer: failed to send Hello. err %d on sockfd [%d]",
             error, s);
@@ -6130,6 +6085,7 @@ bool BFCP_Server::FloorRequestRespons(
                         newnode = bfcp_extract_request(
                             m_struct_server->list_conferences[i].pending,
                             p_floorRequestID);
+                        TraceRequest(newnode, BFCP_TRACE_DECIDED);
                         /* Move the node to the Accepted list */
                         newnode->priority = p_priority;
                         if (p_beneficiaryID && !newnode->beneficiaryID)
@@ -6216,6 +6172,7 @@ bool BFCP_Server::FloorRequestRespons(
                             m_struct_server->list_conferences[i].accepted,
                             p_floorRequestID);
                         if (newnode) {
+                            TraceRequest(newnode, BFCP_TRACE_DECIDED);
                             /* Move the node to the Accepted list */
                             newnode->priority = p_priority;
                             if (p_beneficiaryID && !newnode->beneficiaryID)
@@ -6227,6 +6184,7 @@ bool BFCP_Server::FloorRequestRespons(
                                 Log(ERR, "bfcp_insert_request falied ");
                                 Status = false;
                             } else {
+                                TraceRequest(newnode, BFCP_TRACE_GRANTED);
                                 /* TODO Prepare all floor information needed by
                                  * interested users */
                                 /* Send FloorRequestStatus */
@@ -6273,6 +6231,7 @@ bool BFCP_Server::FloorRequestRespons(
                         p_floorRequestID, m_confID);
                     Status = false;
                 } else {
+                    TraceRequest(newnode, BFCP_TRACE_DECIDED);
                     if (p_beneficiaryID && !newnode->beneficiaryID)
                         newnode->beneficiaryID = p_beneficiaryID;
 
@@ -6294,15 +6253,13 @@ bool BFCP_Server::FloorRequestRespons(
                                                     p_floorRequestID, newnode,
                                                     p_InformALL);
                     }
+                    bfcp_deleted_node_request(
+                        m_struct_server->list_conferences + i, newnode);
                     /* Remove the request node from the Pending list */
                     if (newnode != NULL) {
                         remove_floor_list(newnode->floor);
                         remove_request_list_of_node(newnode->floorrequest);
-                        free(newnode->participant_info);
-                        newnode->participant_info = NULL;
-                        free(newnode->chair_info);
-                        newnode->chair_info = NULL;
-                        free(newnode);
+                        bfcp_free_node(newnode);
                         newnode = NULL;
                     }
                 }
@@ -6330,6 +6287,7 @@ bool BFCP_Server::FloorRequestRespons(
                     }
                 }
                 if (newnode != NULL) {
+                    TraceRequest(newnode, BFCP_TRACE_DECIDED);
                     if (p_beneficiaryID && !newnode->beneficiaryID)
                         newnode->beneficiaryID = p_beneficiaryID;
                     /* all floor information needed by interested users */
@@ -6351,15 +6309,13 @@ bool BFCP_Server::FloorRequestRespons(
                                                     p_floorRequestID, newnode,
                                                     p_InformALL);
                     }
+                    bfcp_deleted_node_request(
+                        m_struct_server->list_conferences + i, newnode);
                     /* Remove the request node from the Granted list */
                     if (newnode != NULL) {
                         tempfloors = newnode->floor;
                         remove_request_list_of_node(newnode->floorrequest);
-                        free(newnode->participant_info);
-                        newnode->participant_info = NULL;
-                        free(newnode->chair_info);
-                        newnode->chair_info = NULL;
-                        free(newnode);
+                        bfcp_free_node(newnode);
                         newnode = NULL;
                     }
 
@@ -6376,9 +6332,7 @@ bool BFCP_Server::FloorRequestRespons(
                             Status = false;
                         }
                         next = free_floors->next;
-                        free(free_floors->chair_info);
-                        free_floors->chair_info = NULL;
-                        free(free_floors);
+                        bfcp_free_floor(free_floors);
                         free_floors = NULL;
                         free_floors = next;
                     }
@@ -6401,14 +6355,12 @@ bool BFCP_Server::FloorRequestRespons(
         /* Free the floors list */
         while (list_floors) {
             next_floors = list_floors->next;
-            free(list_floors->chair_info);
-            list_floors->chair_info = NULL;
-            free(list_floors);
+            bfcp_free_floor(list_floors);
             list_floors = NULL;
             list_floors = next_floors;
         }
     }
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
     return Status;
 }
 
@@ -6450,8 +6402,9 @@ bool BFCP_Server::SendGoodBye(UINT32 p_userID) {
 
     if (transport == BFCP_OVER_UDP) transID = m_trIdGenerator++;
 
-    m = bfcp_build_message_Goodbye(bfcp_new_entity(m_confID, p_userID, transID),
-                                   (transport == BFCP_OVER_UDP) ? 1 : 0);
+    BFCP_Encoder<64> encoder(e_primitive_Goodbye, m_confID, transID, p_userID,
+                             (transport == BFCP_OVER_UDP) ? 1 : 0);
+    m = encoder.message();
 
     if (m) return sendBFCPmessage(sockfd, m);
 
@@ -6461,8 +6414,6 @@ bool BFCP_Server::SendGoodBye(UINT32 p_userID) {
 bool BFCP_Server::AnswerGoodByeAck(UINT32 ConferenceID, UINT16 p_userID,
                                    UINT16 TransactionID, BFCP_SOCKET sockfd,
                                    int /*transport*/) {
-    bfcp_message *m;
-
     /* Check if this conference exists and if user is in the conf */
     int i = CheckConferenceAndUser(m_struct_server, m_confID, p_userID,
                                    BFCP_INVALID_SOCKET);
@@ -6485,11 +6436,8 @@ bool BFCP_Server::AnswerGoodByeAck(UINT32 ConferenceID, UINT16 p_userID,
         return false;
     }
 
-    m = bfcp_build_message_GoodbyeAck(
-        bfcp_new_entity(ConferenceID, p_userID, TransactionID));
-
-    if (m) return (sendBFCPmessage(sockfd, m) >= 1);
-    return false;
+    return (sendBFCPtemplate(sockfd, &m_goodbyeack_template, ConferenceID,
+                             TransactionID, p_userID) >= 1);
 }
 
 bool BFCP_Server::SendFloorStatus(UINT32 p_userID, UINT16 p_TransactionID,
@@ -6499,7 +6447,7 @@ bool BFCP_Server::SendFloorStatus(UINT32 p_userID, UINT16 p_TransactionID,
     bfcp_mutex_lock(count_mutex);
     Status = FloorStatusRespons(p_userID, p_TransactionID, p_floorRequestID,
                                 p_node, p_InformALL);
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
     return Status;
 }
 
@@ -6578,44 +6526,39 @@ bool BFCP_Server::FloorStatusRespons(UINT32 p_userID, UINT16 p_TransactionID,
             // floor status to list of users
             bfcp_user *user = NULL;
             bfcp_list_users *list_user = NULL;
+            std::vector<UINT16> users;
             list_user = m_struct_server->list_conferences[i].user;
             if (list_user != NULL) {
                 user = list_user->users;
                 while (user) {
-                    Log(INF,
-                        " May send FloorStatus to user %d on sockFD %d and uri "
-                        "%s",
-                        user->userID, user->sockFd, user->user_URI);
                     if (user->userID != p_userID) {
                         Log(INF,
                             "Sending FloorStatus to user %d on sockFD %d and "
                             "uri %s",
                             user->userID, user->sockFd, user->user_URI);
-                        if (bfcp_show_floor_information(
-                                m_confID, 0, user->userID,
-                                m_struct_server->list_conferences + i,
-                                m_floorID, NULL, p_node, bfcp_status) == -1) {
-                            Log(ERR,
-                                "FloorStatusRespons send  FloorStatus %s "
-                                "failed ! ",
-                                getBfcpStatus(bfcp_status));
-                        }
+                        users.push_back(user->userID);
                     }
                     user = user->next;
                 }
+                if (bfcp_broadcast_floor_information(
+                        m_confID, 0, users,
+                        m_struct_server->list_conferences + i, m_floorID,
+                        p_node, bfcp_status) == -1) {
+                    Log(ERR, "FloorStatusRespons send  FloorStatus %s failed ! ",
+                        getBfcpStatus(bfcp_status));
+                }
             }
         }
     }
 
+    remove_floor_list(list_floors);
     return Status;
 }
 
 bool BFCP_Server::GetFloorState(e_bfcp_status *p_bfcp_status, UINT32 *p_userID,
                                 UINT32 *p_beneficiaryID,
                                 UINT16 *p_floorRequestID) {
-    bool Status = true;
-    int actual_conference = 0;
-    int i = 0;
+    st_bfcp_floor_snapshot snapshot;
 
     if (!p_bfcp_status || !p_userID || !p_beneficiaryID || !p_floorRequestID)
         return false;
@@ -6624,46 +6567,221 @@ bool BFCP_Server::GetFloorState(e_bfcp_status *p_bfcp_status, UINT32 *p_userID,
     *p_userID = 0;
     *p_beneficiaryID = 0;
     *p_floorRequestID = 0;
-    actual_conference = m_struct_server->Actual_number_conference - 1;
-    for (i = 0; i < actual_conference; i++) {
-        if (m_struct_server->list_conferences[i].conferenceID == m_confID)
+    if (!GetFloorSnapshot(&snapshot)) return false;
+
+    if (snapshot.head_floorRequestID != 0) {
+        *p_userID = snapshot.head_userID;
+        *p_beneficiaryID = snapshot.head_beneficiaryID;
+        *p_floorRequestID = snapshot.head_floorRequestID;
+        *p_bfcp_status = snapshot.head_status;
+    }
+    Log(INF,
+        "GetFloorState [%s] UserID[%d] beneficiaryID[%d] "
+        "floorRequestID[%d]",
+        getBfcpStatus(*p_bfcp_status), *p_userID, *p_beneficiaryID,
+        *p_floorRequestID);
+    return true;
+}
+
+bool BFCP_Server::GetFloorSnapshot(st_bfcp_floor_snapshot *p_snapshot) {
+    UINT32 sequence;
+
+    if (!p_snapshot) return false;
+
+    /* Retry until the snapshot was copied while no new one was written */
+    do {
+        sequence = m_snapshot.sequence;
+        BFCP_MEMORY_BARRIER();
+        memcpy(p_snapshot, &m_snapshot, sizeof(st_bfcp_floor_snapshot));
+        BFCP_MEMORY_BARRIER();
+    } while ((sequence & 1) || (sequence != m_snapshot.sequence));
+
+    return p_snapshot->conferenceID != 0;
+}
+
+void BFCP_Server::GetMetrics(st_bfcp_metrics *p_metrics) {
+    st_bfcp_floor_snapshot snapshot;
+
+    if (!p_metrics) return;
+
+    BFCPConnection::GetMetrics(p_metrics);
+    if (GetFloorSnapshot(&snapshot)) {
+        p_metrics->pending_count = snapshot.pending_count;
+        p_metrics->accepted_count = snapshot.accepted_count;
+        p_metrics->granted_count = snapshot.granted_count;
+    }
+}
+
+void BFCP_Server::TraceRequest(pnode node, e_bfcp_trace_stage stage,
+                               UINT16 status) {
+    st_bfcp_request_trace_event event;
+    bfcp_request_trace *trace;
+    UINT64 now = BFCP_Metrics::Now();
+
+    if (node == NULL) return;
+    trace = &node->trace;
+    if (stage != BFCP_TRACE_RECEIVED && trace->received == 0)
+        trace->received = now; /* Not created from a FloorRequest */
+
+    switch (stage) {
+        case BFCP_TRACE_RECEIVED:
+            trace->received = ReceivedAt() ? ReceivedAt() : now;
+            break;
+        case BFCP_TRACE_PENDING:
+            trace->pending = now;
+            m_metrics.Duration(&st_bfcp_metrics::request_pending_us,
+                               trace->received, now);
+            break;
+        case BFCP_TRACE_NOTIFIED:
+            trace->notified = now;
+            m_metrics.Duration(&st_bfcp_metrics::request_notify_us,
+                               trace->pending ? trace->pending : trace->received,
+                               now);
+            break;
+        case BFCP_TRACE_DECIDED:
+            /* Only the first answer of the application */
+            if (trace->decided) return;
+            trace->decided = now;
+            m_metrics.Duration(&st_bfcp_metrics::request_decision_us,
+                               trace->notified ? trace->notified
+                                               : trace->received,
+                               now);
+            break;
+        case BFCP_TRACE_GRANTED:
+            if (trace->granted) return;
+            trace->granted = now;
+            m_metrics.Duration(&st_bfcp_metrics::request_grant_us,
+                               trace->decided ? trace->decided : trace->received,
+                               now);
+            m_metrics.Duration(&st_bfcp_metrics::request_total_us,
+                               trace->received, now);
+            break;
+        case BFCP_TRACE_STATUS:
+            trace->status = now;
+            trace->statuses++;
+            m_metrics.Duration(&st_bfcp_metrics::request_status_us,
+                               trace->received, now);
             break;
     }
-    if (i <= actual_conference) {
-        bfcp_mutex_lock(count_mutex);
-        // int status_floor = BFCP_FLOOR_STATE_WAITING ;
-        pnode node = m_struct_server->list_conferences[i].granted->head;
-        if (node) {
-            *p_userID = node->userID;
-            *p_beneficiaryID = node->beneficiaryID;
-            *p_floorRequestID = node->floorRequestID;
-            *p_bfcp_status = BFCP_GRANTED;
-        } else {
-            node = m_struct_server->list_conferences[i].accepted->head;
-            if (node) {
-                *p_userID = node->userID;
-                *p_beneficiaryID = node->beneficiaryID;
-                *p_floorRequestID = node->floorRequestID;
-                *p_bfcp_status = BFCP_ACCEPTED;
-            } else {
-                node = m_struct_server->list_conferences[i].pending->head;
-                if (node) {
-                    *p_userID = node->userID;
-                    *p_beneficiaryID = node->beneficiaryID;
-                    *p_floorRequestID = node->floorRequestID;
+
+    if (!m_requestTracing || m_ServerEvent == NULL) return;
+    event.conferenceID = m_confID;
+    event.floorRequestID = node->floorRequestID;
+    event.userID = node->userID;
+    event.beneficiaryID = node->beneficiaryID;
+    event.status = status;
+    event.stage = stage;
+    event.trace = *trace;
+    m_ServerEvent->OnBfcpRequestTrace(&event);
+}
+
+void BFCP_Server::PublishFloorSnapshot() {
+    st_bfcp_conference *conference = NULL;
+    bfcp_list_floors *lfloors = NULL;
+    bfcp_queue *queues[3];
+    UINT16 *counts[3];
+    e_bfcp_status statuses[3] = {BFCP_GRANTED, BFCP_ACCEPTED, BFCP_PENDING};
+    pnode node = NULL;
+    pfloor floor = NULL;
+    int i = 0, j = 0, k = 0;
+
+    if (m_struct_server != NULL) {
+        for (i = 0; i < m_struct_server->Actual_number_conference; i++) {
+            if (m_struct_server->list_conferences[i].conferenceID == m_confID) {
+                conference = &m_struct_server->list_conferences[i];
+                break;
+            }
+        }
+    }
+    if (conference == NULL) {
+        /* Publish an empty snapshot once, when the conference goes away */
+        if (m_snapshot.conferenceID == 0) return;
+        m_snapshot_valid = false;
+        m_snapshot.sequence++;
+        BFCP_MEMORY_BARRIER();
+        m_snapshot.conferenceID = 0;
+        m_snapshot.head_floorRequestID = 0;
+        m_snapshot.number_floors = 0;
+        m_snapshot.total_floors = 0;
+        BFCP_MEMORY_BARRIER();
+        m_snapshot.sequence++;
+        return;
+    }
+
+    lfloors = conference->floor;
+    queues[0] = conference->granted;
+    queues[1] = conference->accepted;
+    queues[2] = conference->pending;
+    if (m_snapshot_valid &&
+        m_snapshot_versions[0] == (lfloors ? lfloors->version : 0) &&
+        m_snapshot_versions[1] == (queues[2] ? queues[2]->version : 0) &&
+        m_snapshot_versions[2] == (queues[1] ? queues[1]->version : 0) &&
+        m_snapshot_versions[3] == (queues[0] ? queues[0]->version : 0))
+        /* Nothing changed since the last snapshot */
+        return;
+
+    m_snapshot_versions[0] = lfloors ? lfloors->version : 0;
+    m_snapshot_versions[1] = queues[2] ? queues[2]->version : 0;
+    m_snapshot_versions[2] = queues[1] ? queues[1]->version : 0;
+    m_snapshot_versions[3] = queues[0] ? queues[0]->version : 0;
+    m_snapshot_valid = true;
+
+    m_snapshot.sequence++;
+    BFCP_MEMORY_BARRIER();
+
+    m_snapshot.conferenceID = conference->conferenceID;
+    m_snapshot.number_floors = 0;
+    m_snapshot.total_floors = 0;
+    if (lfloors != NULL && lfloors->floors != NULL) {
+        for (j = 0; j < lfloors->actual_number_floors &&
+                    j < BFCP_SNAPSHOT_MAX_FLOORS;
+             j++) {
+            m_snapshot.floorID[j] = lfloors->floors[j].floorID;
+            m_snapshot.chairID[j] = lfloors->floors[j].chairID;
+            m_snapshot.floorState[j] = (UINT8)lfloors->floors[j].floorState;
+            m_snapshot.holderID[j] = 0;
+            m_snapshot.queue_length[j] = 0;
+        }
+        m_snapshot.number_floors = j;
+        m_snapshot.total_floors = lfloors->actual_number_floors;
+    }
+
+    /* Walk the lists once: counts, first request, holders and queue lengths */
+    counts[0] = &m_snapshot.granted_count;
+    counts[1] = &m_snapshot.accepted_count;
+    counts[2] = &m_snapshot.pending_count;
+    m_snapshot.head_floorRequestID = 0;
+    m_snapshot.head_userID = 0;
+    m_snapshot.head_beneficiaryID = 0;
+    m_snapshot.head_status = BFCP_PENDING;
+    for (k = 0; k < 3; k++) {
+        *counts[k] = 0;
+        if (queues[k] == NULL) continue;
+        for (node = queues[k]->head; node != NULL; node = node->next) {
+            (*counts[k])++;
+            if (m_snapshot.head_floorRequestID == 0) {
+                m_snapshot.head_status = statuses[k];
+                m_snapshot.head_userID = node->userID;
+                m_snapshot.head_beneficiaryID = node->beneficiaryID;
+                m_snapshot.head_floorRequestID = node->floorRequestID;
+            }
+            for (floor = node->floor; floor != NULL; floor = floor->next) {
+                for (j = 0; j < m_snapshot.number_floors; j++) {
+                    if (m_snapshot.floorID[j] != floor->floorID) continue;
+                    if (k == 0) {
+                        if (m_snapshot.holderID[j] == 0)
+                            m_snapshot.holderID[j] = node->userID;
+                    } else {
+                        m_snapshot.queue_length[j]++;
+                    }
+                    break;
                 }
             }
         }
-        bfcp_mutex_unlock(count_mutex);
-        Log(INF,
-            "GetFloorState [%s] UserID[%d] beneficiaryID[%d] "
-            "floorRequestID[%d]",
-            getBfcpStatus(*p_bfcp_status), *p_userID, *p_beneficiaryID,
-            *p_floorRequestID);
-    } else {
-        Status = false;
     }
-    return Status;
+
+    BFCP_MEMORY_BARRIER();
+    m_snapshot.sequence++;
 }
 
 void BFCP_Server::OnGoodBye(UINT32 ConferenceID, UINT16 userID,
@@ -6707,7 +6825,7 @@ void BFCP_Server::OnGoodBye(UINT32 ConferenceID, UINT16 userID,
     if (i < 0) {
         bfcp_error_code(ConferenceID, userID, TransactionID, error, errortext,
                         NULL, p_sockfd, 0, transport);
-        bfcp_mutex_unlock(count_mutex);
+        UnlockServer();
         return;
     }
 
@@ -6715,12 +6833,16 @@ void BFCP_Server::OnGoodBye(UINT32 ConferenceID, UINT16 userID,
     if (m_ServerEvent) {
         st_BFCP_fsm_event FsmEvt;
 
-        FsmEvt.State = m_bfcpFsmSt;
+        int session = bfcp_get_user_session(
+            m_struct_server->list_conferences[i].user, userID);
+        FsmEvt.State = session < 0 ? BFCP_ACT_UNDEFINED : (e_BFCP_ACT)session;
         FsmEvt.TransactionID = TransactionID;
         FsmEvt.userID = userID;
         FsmEvt.conferenceID = ConferenceID;
 
+        UINT64 start = BFCP_Metrics::Now();
         m_ServerEvent->OnBfcpServerEvent(BFCP_ACT_GoodBye, &FsmEvt);
+        m_metrics.Duration(&st_bfcp_metrics::callback_us, start);
     }
 
     /* Send ack */
@@ -6730,16 +6852,17 @@ void BFCP_Server::OnGoodBye(UINT32 ConferenceID, UINT16 userID,
             "GoodBye received: user is going to be removed from conference");
         bfcp_delete_user_server(m_struct_server, ConferenceID, userID);
     }
-    bfcp_mutex_unlock(count_mutex);
+    UnlockServer();
 }
 
 void BFCP_Server::Log(const char *pcFile, int iLine, int iErrLevel,
                       const char *pcFormat, ...) {
     va_list arg;
+    if (iErrLevel < m_logLevel) return;
     va_start(arg, pcFormat);
     if (m_ServerEvent != NULL)
         m_ServerEvent->Log(pcFile, iLine, iErrLevel, pcFormat, arg);
-    else {
+    else if (!BFCP_AsyncLog::Push(pcFile, iLine, iErrLevel, pcFormat, arg)) {
 #ifdef QN_CROSS_COMPILE
 	static char bfcp_log_buf[1024] = { 0 };
 	vsnprintf(bfcp_log_buf, sizeof(bfcp_log_buf), pcFormat, arg);
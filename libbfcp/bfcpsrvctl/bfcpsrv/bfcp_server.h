@@ -46,10 +46,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <vector>
 #include "../../BFCPconnection.h"
 #include "../../BFCP_fsm.h"
 #include "../../bfcp_threads.h"
 #include "../../bfcpmsg/bfcp_messages.h"
+#include "../../bfcpmsg/bfcp_messages_cpp.h"
 #include "bfcp_user_list.h"
 #include "bfcp_link_list.h"
 
@@ -84,6 +86,51 @@ typedef struct  {
 #define BFCP_SERVER_BASE_FLOORID  1
 #define BFCP_SERVER_BASE_STREAMID 0
 #define BFCP_MAX_CONF           64                   /** @brief The default max conference by server  */
+#define BFCP_SNAPSHOT_MAX_FLOORS 16                  /** @brief The max number of floors published in a floor state snapshot  */
+
+/**  \struct  st_bfcp_floor_snapshot 
+ * \brief Floor state of the conference managed by the server (its ConferenceID only), laid out as arrays indexed by floor position
+ *
+ * The snapshot is republished by the server whenever a floor or a request queue
+ * changed while count_mutex was held, and is read without the lock : \c sequence is odd
+ * while a new snapshot is being written, and readers retry until they copy it
+ * between two equal even values (see \ref BFCP_Server::GetFloorSnapshot ).
+*/
+typedef struct  {
+	volatile UINT32 sequence;	/**  \brief  Seqlock counter, odd while the snapshot is being written */
+	UINT32 conferenceID;		/**  \brief  The BFCP ConferenceID (0 if the conference is not managed anymore) */
+	e_bfcp_status head_status;	/**  \brief  Status of the first request (granted, then accepted, then pending) */
+	UINT16 head_userID;		/**  \brief  UserID of the first request */
+	UINT16 head_beneficiaryID;	/**  \brief  BeneficiaryID of the first request */
+	UINT16 head_floorRequestID;	/**  \brief  FloorRequestID of the first request (0 if there is no request) */
+	UINT16 pending_count;		/**  \brief  Number of requests in the Pending list */
+	UINT16 accepted_count;		/**  \brief  Number of requests in the Accepted list */
+	UINT16 granted_count;		/**  \brief  Number of requests in the Granted list */
+	UINT16 number_floors;		/**  \brief  Number of floors published in the arrays below */
+	UINT16 total_floors;		/**  \brief  Number of floors of the conference: more than number_floors when it has more than BFCP_SNAPSHOT_MAX_FLOORS */
+	UINT16 floorID[BFCP_SNAPSHOT_MAX_FLOORS];	/**  \brief  FloorID of each floor */
+	UINT16 chairID[BFCP_SNAPSHOT_MAX_FLOORS];	/**  \brief  Chair of each floor (0 if no chair) */
+	UINT16 holderID[BFCP_SNAPSHOT_MAX_FLOORS];	/**  \brief  UserID of the first granted request of each floor (0 if free) */
+	UINT16 queue_length[BFCP_SNAPSHOT_MAX_FLOORS];	/**  \brief  Number of pending and accepted requests of each floor */
+	UINT8 floorState[BFCP_SNAPSHOT_MAX_FLOORS];	/**  \brief  State of each floor (e_floor_state) */
+} st_bfcp_floor_snapshot;
+
+/**  \struct  st_bfcp_request_trace_event
+ * \brief A FloorRequest reached a stage, see \ref BFCP_Server::SetRequestTracing
+*/
+typedef struct  {
+	UINT32 conferenceID;		/**  \brief  The BFCP ConferenceID */
+	UINT16 floorRequestID;		/**  \brief  FloorRequestID of the request */
+	UINT16 userID;			/**  \brief  UserID of the requester */
+	UINT16 beneficiaryID;		/**  \brief  BeneficiaryID of the request (0 if none) */
+	UINT16 status;			/**  \brief  e_bfcp_status of the FloorRequestStatus sent, for BFCP_TRACE_STATUS */
+	e_bfcp_trace_stage stage;	/**  \brief  Stage reached */
+	bfcp_request_trace trace;	/**  \brief  Times of the stages reached so far */
+} st_bfcp_request_trace_event;
+
+/** \brief Encoder of the messages the FCS sends: 2 KB on the stack hold a FloorStatus with a dozen requests, larger messages move to the heap */
+typedef BFCP_Encoder<2048> BFCP_ServerEncoder;
+
 /**
  * BFCP Floor control server manager class 
  *
@@ -167,6 +214,14 @@ public:
        virtual ~ServerEvent() {};	
 
         virtual void Log(const  char* /*pcFile*/, int /*iLine*/, int /*iErrorLevel*/, const  char* /*pcFormat*/, va_list /*args*/) { }
+
+    /**
+     *  \brief Stage of a FloorRequest, only called when \ref SetRequestTracing is on
+     *
+     * Called with the server locked: the BFCP_Server must not be called back.
+     * @param p_event request and times of its stages
+     */
+       virtual void OnBfcpRequestTrace(const st_bfcp_request_trace_event* /*p_event*/) { }
     };
 
      /**
@@ -346,10 +401,33 @@ public:
      */
      
     bool GetFloorState(e_bfcp_status* p_bfcp_status , UINT32* p_userID ,  UINT32* p_beneficiaryID , UINT16* p_floorRequestID  );
+
+    /**
+     * copy the last published floor state of the conference, without waiting for the requests being processed
+     * @param p_snapshot receives the snapshot: its arrays hold the first BFCP_SNAPSHOT_MAX_FLOORS floors only, number_floors
+     * is less than total_floors when some are missing
+     * @return true success , false the conference is not managed anymore
+     */
+    bool GetFloorSnapshot(st_bfcp_floor_snapshot* p_snapshot);
+
+    /**
+     * copy the connection metrics, with the request queue depths of the last published floor state
+     * @param p_metrics receives the metrics
+     */
+    virtual void GetMetrics(st_bfcp_metrics* p_metrics);
+
+    /**
+     * report every stage of the FloorRequests to ServerEvent::OnBfcpRequestTrace.
+     * The durations of the stages are always counted in the request_*_us histograms of the metrics
+     * @param p_on true to report, false to stop (default)
+     */
+    void SetRequestTracing(bool p_on) { m_requestTracing = p_on; }
     
 protected:
     /** \brief  BFCPconnection callback  */
     virtual int ProcessBFCPmessage(bfcp_received_message * m, BFCP_SOCKET s);
+    /** \brief  BFCPconnection callback: Hello and HelloAck, unparsed  */
+    virtual bool ProcessLazyBFCPmessage(const bfcp_lazy_message * m, BFCP_SOCKET s, int transport);
     
     virtual bool OnBFCPConnected(BFCP_SOCKET socket, const char * remoteIp , int remotePort);
     virtual bool OnBFCPDisconnected(BFCP_SOCKET socket) ;
@@ -359,11 +437,17 @@ protected:
     {
         return bfcp_error_code( conferenceID , userID , TransactionID , code  , error_info,details, sockfd,  i,  transport);
     } ;
-    /** \brief callback link_list */
-    virtual bfcp_user_information* BFCP_LinkList_show_user_information(lusers list_users, UINT16 userID) {
-        return bfcp_show_user_information(list_users, userID);};
 
   
+    /**
+     * \brief FSM event of a received message, performed on the session of its user.
+     * Every user of the conference has its own state (bfcp_user::session_state) and goes
+     * through the transitions of s_stateMachine: a participant does not change the state
+     * of the others. The FSM of BFCP_fsm only follows the server socket (CONNECTED / DISCONNECTED).
+     */
+    virtual bool BFCPFSM_FsmEvent(s_bfcp_msg_event* p_evt);
+    /** \brief FsmCtrlPerform on the session of the user of p_bfcp_evt (conferenceID, userID) */
+    bool SessionCtrlPerform(e_BFCP_ACT p_evt, s_bfcp_msg_event* p_bfcp_evt);
     /** \brief Virtual FSM exit function */
     bool BFCPFSM_UpdatesBfcpFsmEvent( s_bfcp_msg_event* p_bfcp_evt , e_BFCP_ACT p_evt , e_BFCP_ACT p_st );
     /** \brief FSM transistion */
@@ -391,7 +475,22 @@ private:
     UINT16              m_floorID ;
     UINT16              m_streamID ;
     void                initStateMachine(void);
+    /** \brief Transitions of the sessions of the users, immutable and shared by all of them */
+    static const st_BFCP_fsm s_stateMachine[BFCP_ACT_LAST][BFCP_ACT_LAST];
     void                print_requests_list(st_bfcp_server* server, int index, e_bfcp_status status);
+    /** \brief Republish the floor state snapshot if a floor or a request queue changed (count_mutex held) */
+    void                PublishFloorSnapshot(void);
+    /** \brief Publish the pending floor state and release count_mutex */
+    void                UnlockServer(void) { PublishFloorSnapshot(); bfcp_mutex_unlock(count_mutex); }
+    st_bfcp_floor_snapshot m_snapshot;	/* Floor state readable without count_mutex */
+    bool                m_snapshot_valid;	/* False until the versions below match the managed conference */
+    UINT32              m_snapshot_versions[4];	/* Floors, Pending, Accepted and Granted versions the snapshot was built from */
+    bfcp_template       m_helloack_template;	/* Pre-encoded HelloAck, stamped with the IDs of each Hello */
+    bfcp_template       m_chairactionack_template;	/* Pre-encoded ChairActionAck */
+    volatile bool       m_requestTracing;	/* Report the stages of the requests, see SetRequestTracing */
+    /** \brief Stamp a stage of a request, count its duration and report it if tracing is on */
+    void                TraceRequest(pnode node, e_bfcp_trace_stage stage, UINT16 status = 0);
+    bfcp_template       m_goodbyeack_template;	/* Pre-encoded GoodbyeAck */
     bool FloorStatusRespons(UINT32 p_userID ,  UINT16 p_TransactionID , UINT16 p_floorRequestID , bfcp_node *node , bool p_InformALL );
    
     UINT16		m_trIdGenerator;
@@ -425,6 +524,10 @@ private:
     /** \brief assign the socket file descriptor and the transpor to the user */
     int bfcp_set_user_sockfd(st_bfcp_server *server, UINT32 conferenceID,UINT16 userID, BFCP_SOCKET p_sockfd, int transport );
     BFCP_SOCKET bfcp_get_user_sockfd(st_bfcp_server *server, UINT32 conferenceID,UINT16 userID, int * p_transport);
+    /** \brief set the state of the session of a user, -1 if the user does not exist */
+    int bfcp_set_user_session_server(st_bfcp_server *server, UINT32 conferenceID, UINT16 userID, e_BFCP_ACT p_state);
+    /** \brief state of the session of a user, BFCP_ACT_UNDEFINED before its first message or if the user does not exist */
+    e_BFCP_ACT bfcp_get_user_session_server(st_bfcp_server *server, UINT32 conferenceID, UINT16 userID);
     /* Remove a participant from the list of users of a BFCP Conference */
     int bfcp_delete_user_server(st_bfcp_server *server, UINT32 ConferenceID, UINT16 userID);
 
@@ -444,17 +547,23 @@ private:
     /* Helper methods */
     /******************/
 
-    /** \brief Create a new 'bfcp_floor_request_information' (bfcp_messages.h) out of a 'pnode' */
-    bfcp_floor_request_information *create_floor_request_userID(pnode traverse, lusers users, UINT16 userID, UINT16 request_status, int i);
-    /** \brief Create a new 'bfcp_floor_request_information' (bfcp_messages.h) out of a floor */
-    bfcp_floor_request_information *create_floor_message(UINT16 floorID, pnode traverse, lusers users, UINT16 request_status, int i);
+    /** \brief Add the FLOOR-REQUEST-INFORMATION of a request, about 'floorID' or about all of its floors if 0 */
+    bool encode_floor_request_information(BFCP_ServerEncoder &encoder, pnode node, lusers users, UINT16 floorID, UINT16 status, int queue_position, int floor_queue_position, e_bfcp_priority priority);
+    /** \brief Add the BENEFICIARY-INFORMATION or REQUESTED-BY-INFORMATION of a user */
+    void encode_user_information(BFCP_ServerEncoder &encoder, e_bfcp_attibutes type, lusers users, UINT16 userID);
     /** \brief Prepare the needed arguments for a FloorRequestStatus BFCP message */
     int bfcp_print_information_floor(st_bfcp_conference *conference, UINT16 userID, UINT16 TransactionID, pnode newnode, UINT16 status);
     /** \brief Setup and send a FloorRequestStatus BFCP message */
     int bfcp_show_requestfloor_information(bfcp_list_users *list_users, bfcp_queue *accepted_queue, 
 					   UINT32 ConferenceID, UINT16 userID, UINT16 TransactionID,
 					   pnode newnode, UINT16 status, BFCP_SOCKET socket, int transport);
+    /** \brief Encode a FloorRequestStatus BFCP message, tell if it must not be retransmitted */
+    bfcp_message *bfcp_encode_requestfloor_information(BFCP_ServerEncoder &encoder, bfcp_list_users *list_users, bfcp_queue *accepted_queue,
+					   UINT32 ConferenceID, UINT16 userID, UINT16 TransactionID,
+					   pnode newnode, UINT16 status, bool *donotresend);
 
+    /** \brief Stop counting a request the chair ended among the ongoing requests of its user */
+    void bfcp_deleted_node_request(st_bfcp_conference *conference, pnode node);
     /** \brief Remove all floor requests made by a user from all existing nodes */
     int bfcp_remove_floorrequest_from_all_nodes(st_bfcp_conference *server, UINT16 userID);
     /** \brief Remove all floor requests made by a user from a queue */
@@ -488,6 +597,10 @@ private:
     int bfcp_error_code(UINT32 ConferenceID, UINT16 userID, UINT16 TransactionID, e_bfcp_error_codes code,const char *error_info, bfcp_unknown_m_error_details *details, BFCP_SOCKET sockfd, int i, int transport);
     /** \brief Setup and send a floorstatus BFCP message */
     int bfcp_show_floor_information(UINT32 conferenceID, UINT16 TransactionID, UINT16 userID, st_bfcp_conference *conference, UINT16 floorID, int *client, pnode newnode, UINT16 status);
+    /** \brief Encode a floorstatus BFCP message once and send it to a list of users */
+    int bfcp_broadcast_floor_information(UINT32 conferenceID, UINT16 TransactionID, const std::vector<UINT16> &userIDs, st_bfcp_conference *conference, UINT16 floorID, pnode newnode, UINT16 status);
+    /** \brief Encode a floorstatus BFCP message, tell if its payload depends on the recipient */
+    bfcp_message *bfcp_encode_floor_information(BFCP_ServerEncoder &encoder, UINT32 conferenceID, UINT16 TransactionID, UINT16 userID, st_bfcp_conference *conference, UINT16 floorID, pnode newnode, UINT16 status, bool *per_user);
     /** \brief Handle an incoming ChairAction message */
     int bfcp_ChairAction_server(st_bfcp_server *server, UINT32 conferenceID, bfcp_floor *list_floors, UINT16 userID, UINT16 floorRequestID, int RequestStatus, char *chair_info, UINT16 queue_position, UINT16 TransactionID, BFCP_SOCKET sockfd, int y, int transport);
     /** \brief Handle an incoming FloorRequestQuery message */
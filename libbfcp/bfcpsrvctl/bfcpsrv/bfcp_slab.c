@@ -0,0 +1,121 @@
+/**
+ *
+ * \brief Fixed-size object allocator
+ *
+ * \file bfcp_slab.c
+ *
+ * \remarks :
+ */
+ #include "bfcp_slab.h"
+#include "../../bfcpmsg/bfcp_alloc.h"
+
+/* Objects are aligned as the strictest of a pointer and a double */
+#define BFCP_SLAB_ALIGN	(sizeof(double) > sizeof(void *) ? sizeof(double) : sizeof(void *))
+
+/* Initialize a slab of objects of the given size */
+int bfcp_slab_init(bfcp_slab *slab, size_t object_size, UINT16 chunk_objects)
+{
+	if(slab == NULL)
+		return -1;
+	if(object_size == 0)
+		return -1;
+
+	if(object_size < sizeof(void *))
+		object_size = sizeof(void *);
+	if(chunk_objects == 0)
+		chunk_objects = BFCP_SLAB_CHUNK_OBJECTS;
+
+	slab->object_size = (object_size + BFCP_SLAB_ALIGN - 1) & ~(BFCP_SLAB_ALIGN - 1);
+	slab->chunk_objects = chunk_objects;
+	slab->free_list = NULL;
+	slab->chunks = NULL;
+	slab->used_objects = 0;
+	slab->total_objects = 0;
+	bfcp_mutex_init(slab->mutex, NULL);
+
+	return 0;
+}
+
+/* Add a new chunk to the free list of a slab (mutex held) */
+static int bfcp_slab_grow(bfcp_slab *slab)
+{
+	bfcp_slab_chunk *chunk;
+	unsigned char *object;
+	size_t header;
+	int i;
+
+	header = (sizeof(bfcp_slab_chunk) + BFCP_SLAB_ALIGN - 1) & ~(BFCP_SLAB_ALIGN - 1);
+	chunk = (bfcp_slab_chunk *)BFCP_MALLOC(BFCP_ALLOC_SLAB, header + slab->chunk_objects*slab->object_size);
+	if(chunk == NULL)
+		return -1;
+
+	chunk->next = slab->chunks;
+	slab->chunks = chunk;
+
+	/* Thread the new objects on the free list */
+	object = (unsigned char *)chunk + header;
+	for(i = 0; i < slab->chunk_objects; i++) {
+		*(void **)object = slab->free_list;
+		slab->free_list = object;
+		object = object + slab->object_size;
+	}
+	slab->total_objects = slab->total_objects + slab->chunk_objects;
+
+	return 0;
+}
+
+/* Get a zeroed object from a slab */
+void *bfcp_slab_alloc(bfcp_slab *slab)
+{
+	void *object;
+
+	if(slab == NULL)
+		return NULL;
+
+	bfcp_mutex_lock(slab->mutex);
+	if((slab->free_list == NULL) && (bfcp_slab_grow(slab) == -1)) {
+		bfcp_mutex_unlock(slab->mutex);
+		return NULL;
+	}
+	object = slab->free_list;
+	slab->free_list = *(void **)object;
+	slab->used_objects++;
+	bfcp_mutex_unlock(slab->mutex);
+
+	memset(object, 0, slab->object_size);
+	return object;
+}
+
+/* Give an object back to its slab */
+void bfcp_slab_free(bfcp_slab *slab, void *object)
+{
+	if((slab == NULL) || (object == NULL))
+		return;
+
+	bfcp_mutex_lock(slab->mutex);
+	*(void **)object = slab->free_list;
+	slab->free_list = object;
+	slab->used_objects--;
+	bfcp_mutex_unlock(slab->mutex);
+}
+
+/* Release all the chunks of a slab (objects still in use become invalid) */
+void bfcp_slab_destroy(bfcp_slab *slab)
+{
+	bfcp_slab_chunk *chunk, *next;
+
+	if(slab == NULL)
+		return;
+
+	bfcp_mutex_lock(slab->mutex);
+	for(chunk = slab->chunks; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		BFCP_FREE(BFCP_ALLOC_SLAB, chunk);
+	}
+	slab->chunks = NULL;
+	slab->free_list = NULL;
+	slab->used_objects = 0;
+	slab->total_objects = 0;
+	bfcp_mutex_unlock(slab->mutex);
+	bfcp_mutex_destroy(slab->mutex);
+}
@@ -0,0 +1,57 @@
+/**
+ *
+ * \brief Fixed-size object allocator
+ *
+ * Objects are carved out of chunks and recycled through a free list, so that
+ * the request churn of a long-lived conference does not fragment the heap.
+ *
+ * \file bfcp_slab.h
+ *
+ * \remarks :
+ */
+ #ifndef _BFCP_SLAB_H
+#define _BFCP_SLAB_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "../../bfcpmsg/bfcp_messages.h"
+#include "../../bfcp_threads.h"
+
+/* Default number of objects carved out of each chunk */
+#define BFCP_SLAB_CHUNK_OBJECTS	64
+
+/* Chunk of objects */
+typedef struct bfcp_slab_chunk {
+	struct bfcp_slab_chunk *next;	/* Next chunk of this slab */
+} bfcp_slab_chunk;
+
+/* Slab of fixed-size objects */
+typedef struct bfcp_slab {
+	size_t object_size;		/* Size of an object, rounded up for alignment */
+	UINT16 chunk_objects;		/* Number of objects in each chunk */
+	void *free_list;		/* Free objects, linked through their first word */
+	bfcp_slab_chunk *chunks;	/* Chunks allocated so far */
+	UINT32 used_objects;		/* Objects currently handed out */
+	UINT32 total_objects;		/* Objects available in all the chunks */
+	bfcp_mutex_t mutex;		/* Protects the free list */
+} bfcp_slab;
+
+
+#if defined __cplusplus
+	extern "C" {
+#endif
+
+/* Initialize a slab of objects of the given size */
+int bfcp_slab_init(bfcp_slab *slab, size_t object_size, UINT16 chunk_objects);
+/* Get a zeroed object from a slab */
+void *bfcp_slab_alloc(bfcp_slab *slab);
+/* Give an object back to its slab */
+void bfcp_slab_free(bfcp_slab *slab, void *object);
+/* Release all the chunks of a slab (objects still in use become invalid) */
+void bfcp_slab_destroy(bfcp_slab *slab);
+
+#if defined __cplusplus
+	}
+#endif
+
+#endif
@@ -16,6 +16,7 @@
 #include "../../bfcp_threads.h"
 #include "../../BFCPexception.h"
 #include "../../bfcpmsg/bfcp_messages.h"
+#include "../../bfcpmsg/bfcp_alloc.h"
 #include "bfcp_user_list.h"
 
 
@@ -37,7 +38,7 @@ struct bfcp_list_users *BFCP_UserList::bfcp_create_user_list (UINT16 Max_Number_
 		Num_floors = 1;
 
 	/* Allocate a new list of users */
-	lusers = (bfcp_list_users *)calloc(1, sizeof(bfcp_list_users));
+	lusers = (bfcp_list_users *)BFCP_CALLOC(BFCP_ALLOC_USER, 1, sizeof(bfcp_list_users));
 
 	/* Initialize the list */
 	if(lusers == NULL)
@@ -121,7 +122,7 @@ int BFCP_UserList::bfcp_change_number_users_floors(lusers list_users, UINT16 Num
 				user->numberfloorrequest[i] = 0;
 		}
 
-		list_floors = (int *)realloc(user->numberfloorrequest, (Num_floors)*sizeof(int));
+		list_floors = (int *)BFCP_REALLOC(BFCP_ALLOC_USER, user->numberfloorrequest, (Num_floors)*sizeof(int));
 		if(list_floors == NULL)
 			return -1;
 
@@ -182,6 +183,55 @@ BFCP_SOCKET BFCP_UserList::bfcp_get_user_socket(lusers list_users, UINT16 userID
 	return BFCP_INVALID_SOCKET;
 }
 
+/* Set the state of the session of a user of this list */
+int BFCP_UserList::bfcp_set_user_session(lusers list_users, UINT16 userID, UINT8 state)
+{
+	users user = NULL;
+	if(list_users == NULL)
+		return -1;
+	if(userID <= 0)
+		return -1;
+
+	for (user = list_users->users; user; user = user->next)
+	{
+		if(user->userID == userID)
+		{
+			user->session_state = state;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* Get the state of the session of a user of this list */
+int BFCP_UserList::bfcp_get_user_session(lusers list_users, UINT16 userID)
+{
+	users user = NULL;
+	if(list_users == NULL)
+		return -1;
+	if(userID <= 0)
+		return -1;
+
+	for (user = list_users->users; user; user = user->next)
+	{
+		if(user->userID == userID)
+			return user->session_state;
+	}
+	return -1;
+}
+
+/* Set the state of the sessions of all the users of this list */
+int BFCP_UserList::bfcp_reset_user_sessions(lusers list_users, UINT8 state)
+{
+	users user = NULL;
+	if(list_users == NULL)
+		return -1;
+
+	for (user = list_users->users; user; user = user->next)
+		user->session_state = state;
+	return 0;
+}
+
 
 /* Add a new user to this list */
 int BFCP_UserList::bfcp_add_user(lusers list_users, UINT16 userID,  char *user_URI, char *user_display_name)
@@ -202,7 +252,7 @@ int BFCP_UserList::bfcp_add_user(lusers list_users, UINT16 userID,  char *user_U
 	}
 
 	/* Create a new user instance */
-	node_user = (bfcp_user *)calloc(1, sizeof(bfcp_user));
+	node_user = (bfcp_user *)BFCP_CALLOC(BFCP_ALLOC_USER, 1, sizeof(bfcp_user));
 
 	/* Initialize the new user */
 	if(node_user == NULL)
@@ -214,7 +264,7 @@ int BFCP_UserList::bfcp_add_user(lusers list_users, UINT16 userID,  char *user_U
 		if(user_URI != NULL) {
 			dLen = strlen(user_URI);
 			if(dLen != 0) {
-				node_user->user_URI = (char *)calloc(1, dLen*sizeof(char)+1);
+				node_user->user_URI = (char *)BFCP_CALLOC(BFCP_ALLOC_USER, 1, dLen*sizeof(char)+1);
 				if(node_user->user_URI == NULL)
 					return -1;
 				memcpy(node_user->user_URI, user_URI, dLen+1);
@@ -226,7 +276,7 @@ int BFCP_UserList::bfcp_add_user(lusers list_users, UINT16 userID,  char *user_U
 		if(user_display_name != NULL) {
 			dLen = strlen(user_display_name);
 			if(dLen != 0) {
-				node_user->user_display_name = (char *)calloc(1, dLen*sizeof(char)+1);
+				node_user->user_display_name = (char *)BFCP_CALLOC(BFCP_ALLOC_USER, 1, dLen*sizeof(char)+1);
 				if(node_user->user_display_name == NULL)
 					return -1;
 				memcpy(node_user->user_display_name, user_display_name, dLen+1);
@@ -235,7 +285,7 @@ int BFCP_UserList::bfcp_add_user(lusers list_users, UINT16 userID,  char *user_U
 			node_user->user_display_name = NULL;
 
 		/* Create a list for floor requests by this user */
-		node_user->numberfloorrequest = (int *)calloc(list_users->maxnumberfloors + 1, sizeof(int));
+		node_user->numberfloorrequest = (int *)BFCP_CALLOC(BFCP_ALLOC_USER, list_users->maxnumberfloors + 1, sizeof(int));
 		if(node_user->numberfloorrequest == NULL)
 			return -1;
 
@@ -292,13 +342,13 @@ int BFCP_UserList::bfcp_delete_user(lusers list_users, UINT16 userID)
 		return 0;
 	
 	/* Free the user node */
-	free(temp_list_users->user_URI);
+	BFCP_FREE(BFCP_ALLOC_USER, temp_list_users->user_URI);
 	temp_list_users->user_URI = NULL;
-	free(temp_list_users->user_display_name);
+	BFCP_FREE(BFCP_ALLOC_USER, temp_list_users->user_display_name);
 	temp_list_users->user_display_name = NULL;
-	free(temp_list_users->numberfloorrequest);
+	BFCP_FREE(BFCP_ALLOC_USER, temp_list_users->numberfloorrequest);
 	temp_list_users->numberfloorrequest = NULL;
-	free(temp_list_users);
+	BFCP_FREE(BFCP_ALLOC_USER, temp_list_users);
 	temp_list_users = NULL;
 
 	return(0);
@@ -420,7 +470,7 @@ int BFCP_UserList::bfcp_delete_a_floor_from_user_list(lusers list_users, UINT16
 			temp_list_users->numberfloorrequest[i-1] = temp_list_users->numberfloorrequest[i];
 		temp_list_users->numberfloorrequest[i-1] = 0;
 
-		list_floors = (int *)realloc(temp_list_users->numberfloorrequest, (list_users->maxnumberfloors+1)*sizeof(int));
+		list_floors = (int *)BFCP_REALLOC(BFCP_ALLOC_USER, temp_list_users->numberfloorrequest, (list_users->maxnumberfloors+1)*sizeof(int));
 		if(list_floors == NULL)
 			return -1;
 	}
@@ -476,13 +526,13 @@ int BFCP_UserList::bfcp_clean_user_list(lusers list_users)
 	while(temp_list_users) {
 		temp = temp_list_users;
 		temp_list_users = temp_list_users->next;
-		free(temp->user_URI);
+		BFCP_FREE(BFCP_ALLOC_USER, temp->user_URI);
 		temp->user_URI = NULL;
-		free(temp->user_display_name);
+		BFCP_FREE(BFCP_ALLOC_USER, temp->user_display_name);
 		temp->user_display_name = NULL;
-		free(temp->numberfloorrequest);
+		BFCP_FREE(BFCP_ALLOC_USER, temp->numberfloorrequest);
 		temp->numberfloorrequest = NULL;
-		free(temp);
+		BFCP_FREE(BFCP_ALLOC_USER, temp);
 		temp = NULL;
 	}
 
@@ -502,7 +552,7 @@ int BFCP_UserList::bfcp_remove_user_list(bfcp_list_users **lusers_p)
 	error = bfcp_clean_user_list(lusers);
 
 	if(error == 0) {
-		free(lusers);
+		BFCP_FREE(BFCP_ALLOC_USER, lusers);
 		lusers = NULL;
 		*lusers_p = NULL;
 	} else
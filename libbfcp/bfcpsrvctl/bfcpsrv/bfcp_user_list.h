@@ -41,6 +41,7 @@ typedef struct bfcp_user
     int *numberfloorrequest;	/* Number of floor requests made by this user for each floor in the conference */
     BFCP_SOCKET sockFd ;
     int bfcp_transport;		/* transport used by sock fd associated with user */   
+    UINT8 session_state;	/* State of the session of the user (BFCP_fsm::e_BFCP_ACT), 0 before its first message */
     struct bfcp_user *next;	/* Next user in the list */
 }
 bfcp_user;
@@ -85,6 +86,11 @@ protected:
     int bfcp_add_user(lusers list_users, UINT16 userID, char *user_URI, char *user_display_name);
     int bfcp_set_user_socket(lusers list_users, UINT16 userID, BFCP_SOCKET p_sockfd, int transport );
     BFCP_SOCKET bfcp_get_user_socket(lusers list_users, UINT16 userID, int * p_transport );
+    /* Set and get the state of the session of a user, -1 if the user does not exist */
+    int bfcp_set_user_session(lusers list_users, UINT16 userID, UINT8 state);
+    int bfcp_get_user_session(lusers list_users, UINT16 userID);
+    /* Set the state of the sessions of all the users of this list */
+    int bfcp_reset_user_sessions(lusers list_users, UINT8 state);
     /* Delete an existing user from this list */
     int bfcp_delete_user(lusers list_users, UINT16 userID);
     /* Add a new FloorRequest to the list of requests made by this user */